@@ -0,0 +1,179 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:41:07 2026 +0000
+ *
+ * @brief Implements the coarse block-matching estimates
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <bob.core/assert.h>
+
+#include "BlockMatching.h"
+#include "Trace.h"
+
+static void check_parameters(int radius, int block, int scale) {
+  if (radius < 0) {
+    boost::format m("block-matching search radius should be non-negative, but you set it to %d");
+    m % radius;
+    throw std::runtime_error(m.str());
+  }
+  if (block < 1) {
+    boost::format m("block size should be at least 1, but you set it to %d");
+    m % block;
+    throw std::runtime_error(m.str());
+  }
+  if (scale < 1) {
+    boost::format m("block-matching downsampling scale should be at least 1, but you set it to %d");
+    m % scale;
+    throw std::runtime_error(m.str());
+  }
+}
+
+/**
+ * Averages cells of scale x scale pixels of the input into a contiguous,
+ * row-major buffer of height x width cells. Partial cells on the right and
+ * bottom borders average the pixels they have.
+ */
+static void downsample(const blitz::Array<double,2>& input, int scale,
+    int height, int width, std::vector<double>& output) {
+  output.assign(height*width, 0.);
+  for (int y=0; y<input.extent(0); ++y) {
+    double* row = &output[(y/scale)*width];
+    for (int x=0; x<input.extent(1); ++x) row[x/scale] += input(y,x);
+  }
+  for (int cy=0; cy<height; ++cy) {
+    const int rows = std::min(scale, input.extent(0) - cy*scale);
+    for (int cx=0; cx<width; ++cx) {
+      const int cols = std::min(scale, input.extent(1) - cx*scale);
+      output[cy*width+cx] /= rows*cols;
+    }
+  }
+}
+
+/**
+ * Pads a contiguous, row-major image by radius pixels on every side,
+ * replicating its border pixels
+ */
+static void pad(const std::vector<double>& input, int height, int width,
+    int radius, std::vector<double>& output) {
+  const int padded = width + 2*radius;
+  output.resize((height + 2*radius)*padded);
+  for (int y=0; y<height+2*radius; ++y) {
+    const double* in = &input[std::min(std::max(y-radius, 0), height-1)*width];
+    double* out = &output[y*padded];
+    for (int x=0; x<padded; ++x)
+      out[x] = in[std::min(std::max(x-radius, 0), width-1)];
+  }
+}
+
+/**
+ * Interpolation of a regular grid of block centres along one dimension: the
+ * index of the first of the two neighbouring blocks of every pixel, and the
+ * weight of the second one
+ */
+static void centres(int size, int scale, int block, int blocks,
+    std::vector<int>& first, std::vector<double>& weight) {
+  first.resize(size);
+  weight.resize(size);
+  for (int k=0; k<size; ++k) {
+    const double coarse = (k + 0.5) / scale - 0.5;
+    double t = (coarse - 0.5*(block-1)) / block;
+    t = std::min(std::max(t, 0.), blocks-1.);
+    first[k] = std::min(static_cast<int>(t), std::max(blocks-2, 0));
+    weight[k] = t - first[k];
+  }
+}
+
+void bob::ip::optflow::blockMatching(const blitz::Array<double,2>& i1,
+    const blitz::Array<double,2>& i2, int radius, int block, int scale,
+    blitz::Array<double,2>& u, blitz::Array<double,2>& v) {
+
+  bob::core::array::assertSameShape(i1, i2);
+  bob::core::array::assertSameShape(i1, u);
+  bob::core::array::assertSameShape(u, v);
+  check_parameters(radius, block, scale);
+  if (!i1.size()) return;
+
+  bob::ip::optflow::trace::Span span("block_matching");
+
+  const int height = (i1.extent(0) + scale - 1) / scale;
+  const int width = (i1.extent(1) + scale - 1) / scale;
+  std::vector<double> c1, c2, p2;
+  downsample(i1, scale, height, width, c1);
+  downsample(i2, scale, height, width, c2);
+  pad(c2, height, width, radius, p2);
+  const int padded = width + 2*radius;
+
+  const int bh = (height + block - 1) / block;
+  const int bw = (width + block - 1) / block;
+  std::vector<double> sad(bh*bw), best(bh*bw);
+  std::vector<int> best_dy(bh*bw, 0), best_dx(bh*bw, 0);
+  std::vector<double> diff(width);
+
+  // No displacement first, so it wins all ties
+  for (int k=-1; k<(2*radius+1)*(2*radius+1); ++k) {
+    const int dy = k < 0 ? 0 : k/(2*radius+1) - radius;
+    const int dx = k < 0 ? 0 : k%(2*radius+1) - radius;
+    if (k >= 0 && !dy && !dx) continue;
+
+    std::fill(sad.begin(), sad.end(), 0.);
+    for (int y=0; y<height; ++y) {
+      // contiguous and independent per pixel, so compilers vectorize it
+      const double* a = &c1[y*width];
+      const double* b = &p2[(y+radius+dy)*padded + radius+dx];
+      for (int x=0; x<width; ++x) diff[x] = std::fabs(a[x] - b[x]);
+      double* s = &sad[(y/block)*bw];
+      for (int x=0; x<width; ++x) s[x/block] += diff[x];
+    }
+
+    if (k < 0) {
+      best = sad;
+      continue;
+    }
+    for (int b=0; b<bh*bw; ++b) {
+      if (sad[b] < best[b]) {
+        best[b] = sad[b];
+        best_dy[b] = dy;
+        best_dx[b] = dx;
+      }
+    }
+  }
+
+  std::vector<int> y0, x0;
+  std::vector<double> wy, wx;
+  centres(i1.extent(0), scale, block, bh, y0, wy);
+  centres(i1.extent(1), scale, block, bw, x0, wx);
+  const int y_next = bh > 1 ? bw : 0;
+  const int x_next = bw > 1 ? 1 : 0;
+
+  for (int y=0; y<i1.extent(0); ++y) {
+    for (int x=0; x<i1.extent(1); ++x) {
+      const int b = y0[y]*bw + x0[x];
+      const double w00 = (1.-wy[y])*(1.-wx[x]);
+      const double w01 = (1.-wy[y])*wx[x];
+      const double w10 = wy[y]*(1.-wx[x]);
+      const double w11 = wy[y]*wx[x];
+      u(y,x) = scale * (w00*best_dx[b] + w01*best_dx[b+x_next] +
+          w10*best_dx[b+y_next] + w11*best_dx[b+y_next+x_next]);
+      v(y,x) = scale * (w00*best_dy[b] + w01*best_dy[b+x_next] +
+          w10*best_dy[b+y_next] + w11*best_dy[b+y_next+x_next]);
+    }
+  }
+
+}
+
+void bob::ip::optflow::blockMatching(const blitz::Array<double,2>& i1,
+    const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
+    int radius, int block, int scale,
+    blitz::Array<double,2>& u, blitz::Array<double,2>& v) {
+  bob::core::array::assertSameShape(i1, i2);
+  blockMatching(i1, i3, radius, block, scale, u, v);
+  u *= 0.5;
+  v *= 0.5;
+}
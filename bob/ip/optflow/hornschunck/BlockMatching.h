@@ -0,0 +1,52 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:41:07 2026 +0000
+ *
+ * @brief Coarse block-matching estimates, to initialize the flow solvers on
+ * large displacements
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BOB_IP_OPTFLOW_BLOCKMATCHING_H
+#define BOB_IP_OPTFLOW_BLOCKMATCHING_H
+
+#include <blitz/array.h>
+
+namespace bob { namespace ip { namespace optflow {
+
+  /**
+   * Estimates a coarse flow from i1 to i2, as an initial guess for the
+   * Horn & Schunck solvers, which only converge well for displacements
+   * of about a pixel.
+   *
+   * Both images are first downsampled by averaging cells of scale x scale
+   * pixels. The downsampled i1 is divided in blocks of block x block
+   * pixels and, for every block, the displacement within radius
+   * (downsampled) pixels in each direction with the smallest sum of
+   * absolute differences (SAD) to i2 is kept. Pixels of i2 beyond its
+   * borders replicate the nearest border pixel. On ties, no displacement
+   * wins over any other, then the first one in row-major order.
+   *
+   * Displacements are scaled back to pixels and bilinearly interpolated
+   * between the centres of the blocks into u and v, which have the same
+   * shape as the images. Like the flow of the solvers, i1(y,x) moves to
+   * i2(y+v,x+u).
+   */
+  void blockMatching(const blitz::Array<double,2>& i1,
+      const blitz::Array<double,2>& i2, int radius, int block, int scale,
+      blitz::Array<double,2>& u, blitz::Array<double,2>& v);
+
+  /**
+   * Like the above, for the 3 images of HornAndSchunckFlow: matches i1 to
+   * i3 and halves the displacements, which gives the flow per frame,
+   * centred on i2.
+   */
+  void blockMatching(const blitz::Array<double,2>& i1,
+      const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
+      int radius, int block, int scale,
+      blitz::Array<double,2>& u, blitz::Array<double,2>& v);
+
+}}}
+
+#endif /* BOB_IP_OPTFLOW_BLOCKMATCHING_H */
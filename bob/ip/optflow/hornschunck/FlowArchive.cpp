@@ -0,0 +1,538 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:09:40 2026 +0000
+ *
+ * @brief Implementation of the flow archive writer and reader
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <bob.core/assert.h>
+#include <zlib.h>
+
+#include "FlowArchive.h"
+
+static const char MAGIC[] = "BOBFLOW1";
+static const char INDEX_MAGIC[] = "BOBFIDX1";
+static const uint32_t VERSION = 2;
+static const uint64_t ENTRY = 16; ///< bytes per frame on the index
+static const uint64_t FOOTER = 24; ///< bytes after the index
+
+/**
+ * The bytes before the first chunk, which version 2 grew with the
+ * prediction
+ */
+static uint64_t header_size(uint32_t version) {
+  return version < 2 ? 32 : 40;
+}
+
+/**
+ * The number of values of a frame (u then v), or 0 if its packed residuals
+ * (8 bytes per value, at most) could not be indexed with 32-bit sizes
+ */
+static uint64_t frame_values(int64_t height, int64_t width) {
+  const uint64_t n = 2 * static_cast<uint64_t>(height) * width;
+  if (n > 0xffffffffu / 8 || compressBound(n * 8) > 0xffffffffu) return 0;
+  return n;
+}
+
+/**
+ * Converts a frame into codes: quantized values (as int64) or the raw bit
+ * patterns of the doubles, if lossless. Returns how many values were
+ * saturated to the int16 range.
+ */
+static uint64_t quantize(const double* values, size_t n, double step,
+    uint64_t* codes) {
+  if (step <= 0.) {
+    std::memcpy(codes, values, n * sizeof(double));
+    return 0;
+  }
+  uint64_t saturated = 0;
+  for (size_t k=0; k<n; ++k) {
+    double q = values[k] / step;
+    if (!(q == q)) q = 0.; //NaN
+    if (q > 32767.) { q = 32767.; ++saturated; }
+    if (q < -32768.) { q = -32768.; ++saturated; }
+    codes[k] = static_cast<uint64_t>(static_cast<int64_t>(std::floor(q + .5)));
+  }
+  return saturated;
+}
+
+/**
+ * Converts codes back into values, the inverse of quantize()
+ */
+static void dequantize(const uint64_t* codes, size_t n, double step,
+    double* values) {
+  if (step <= 0.) {
+    std::memcpy(values, codes, n * sizeof(double));
+    return;
+  }
+  for (size_t k=0; k<n; ++k)
+    values[k] = static_cast<int64_t>(codes[k]) * step;
+}
+
+/**
+ * Packs the prediction residuals of a frame with 2 planes of n/2 values.
+ * Keyframes are predicted from the left neighbour, along each plane, other
+ * frames from the codes of their reference (previous).
+ */
+static void pack(const uint64_t* codes, const uint64_t* previous, size_t n,
+    bool quantized, std::vector<uint8_t>& out) {
+
+  const size_t plane = n / 2;
+  out.clear();
+  if (quantized) {
+    out.reserve(n);
+    for (size_t k=0; k<n; ++k) {
+      int64_t pred = 0;
+      if (previous) pred = static_cast<int64_t>(previous[k]);
+      else if (k % plane) pred = static_cast<int64_t>(codes[k-1]);
+      int64_t r = static_cast<int64_t>(codes[k]) - pred;
+      uint64_t z = (static_cast<uint64_t>(r) << 1) ^ static_cast<uint64_t>(r >> 63);
+      while (z >= 0x80) {
+        out.push_back(static_cast<uint8_t>(z | 0x80));
+        z >>= 7;
+      }
+      out.push_back(static_cast<uint8_t>(z));
+    }
+  }
+  else {
+    //byte planes, so that the (often constant) high order bytes compress well
+    out.resize(n * 8);
+    for (size_t k=0; k<n; ++k) {
+      uint64_t pred = 0;
+      if (previous) pred = previous[k];
+      else if (k % plane) pred = codes[k-1];
+      uint64_t r = codes[k] ^ pred;
+      for (size_t b=0; b<8; ++b) out[b*n + k] = static_cast<uint8_t>(r >> (8*b));
+    }
+  }
+}
+
+/**
+ * Recovers the codes of a frame, the inverse of pack()
+ */
+static void unpack(const std::vector<uint8_t>& in, const uint64_t* previous,
+    size_t n, bool quantized, uint64_t* codes) {
+
+  const size_t plane = n / 2;
+  if (quantized) {
+    size_t pos = 0;
+    for (size_t k=0; k<n; ++k) {
+      uint64_t z = 0;
+      for (int shift=0; ; shift += 7) {
+        if (pos >= in.size() || shift > 63)
+          throw std::runtime_error("flow archive chunk is corrupted: truncated residuals");
+        uint8_t byte = in[pos++];
+        z |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+      }
+      int64_t r = static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+      int64_t pred = 0;
+      if (previous) pred = static_cast<int64_t>(previous[k]);
+      else if (k % plane) pred = static_cast<int64_t>(codes[k-1]);
+      codes[k] = static_cast<uint64_t>(pred + r);
+    }
+  }
+  else {
+    if (in.size() != n * 8)
+      throw std::runtime_error("flow archive chunk is corrupted: unexpected size");
+    for (size_t k=0; k<n; ++k) {
+      uint64_t r = 0;
+      for (size_t b=0; b<8; ++b) r |= static_cast<uint64_t>(in[b*n + k]) << (8*b);
+      uint64_t pred = 0;
+      if (previous) pred = previous[k];
+      else if (k % plane) pred = codes[k-1];
+      codes[k] = r ^ pred;
+    }
+  }
+}
+
+template <typename T> static void put(std::ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T> static void get(std::istream& is, T& value) {
+  is.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+bob::ip::optflow::FlowArchiveWriter::FlowArchiveWriter
+(const std::string& filename, const blitz::TinyVector<int,2>& shape,
+ double step, size_t keyframe, int level, size_t queue,
+ bob::ip::optflow::FlowPrediction prediction):
+  m_shape(shape),
+  m_step(step),
+  m_keyframe(keyframe),
+  m_prediction(prediction),
+  m_level(level),
+  m_capacity(queue),
+  m_frames(0),
+  m_closed(false),
+  m_saturated(0),
+  m_stop(false)
+{
+  if (shape(0) <= 0 || shape(1) <= 0) {
+    boost::format m("flow archive shape should be positive, but it is (%d, %d)");
+    m % shape(0) % shape(1);
+    throw std::runtime_error(m.str());
+  }
+  if (!(step >= 0.)) {
+    boost::format m("quantization step should be zero (lossless) or positive, but you set it to %g");
+    m % step;
+    throw std::runtime_error(m.str());
+  }
+  if (keyframe < 1) throw std::runtime_error("keyframe interval should be at least 1");
+  if (level < 0 || level > 9) {
+    boost::format m("compression level should be between 0 and 9, but you set it to %d");
+    m % level;
+    throw std::runtime_error(m.str());
+  }
+  if (queue < 1) throw std::runtime_error("writer queue should hold at least 1 frame");
+  if (prediction != PredictPrevious && prediction != PredictKeyframe) {
+    boost::format m("unknown flow archive prediction %d");
+    m % prediction;
+    throw std::runtime_error(m.str());
+  }
+  if (!frame_values(shape(0), shape(1))) {
+    boost::format m("flow archive shape (%d, %d) is too large: chunk sizes are indexed with 32 bits");
+    m % shape(0) % shape(1);
+    throw std::runtime_error(m.str());
+  }
+
+  m_file.open(filename.c_str(), std::ios::binary | std::ios::trunc);
+  if (!m_file) {
+    boost::format m("cannot open flow archive `%s' for writing");
+    m % filename;
+    throw std::runtime_error(m.str());
+  }
+
+  m_file.write(MAGIC, 8);
+  put(m_file, VERSION);
+  put(m_file, static_cast<int32_t>(shape(0)));
+  put(m_file, static_cast<int32_t>(shape(1)));
+  put(m_file, static_cast<uint32_t>(keyframe));
+  put(m_file, step);
+  put(m_file, static_cast<uint32_t>(prediction));
+  put(m_file, static_cast<uint32_t>(0));
+  if (!m_file) {
+    boost::format m("cannot write the header of flow archive `%s'");
+    m % filename;
+    throw std::runtime_error(m.str());
+  }
+
+  m_thread = std::thread(&bob::ip::optflow::FlowArchiveWriter::run, this);
+}
+
+bob::ip::optflow::FlowArchiveWriter::~FlowArchiveWriter() {
+  try {
+    close();
+  }
+  catch (...) {
+  }
+}
+
+void bob::ip::optflow::FlowArchiveWriter::write
+(const blitz::Array<double,2>& u, const blitz::Array<double,2>& v) {
+
+  bob::core::array::assertSameShape(u, m_shape);
+  bob::core::array::assertSameShape(v, m_shape);
+  if (m_closed) throw std::runtime_error("cannot write to a closed flow archive");
+
+  //copies outside the lock, so the background thread is not held up
+  const size_t plane = m_shape(0) * m_shape(1);
+  std::vector<double> frame(2 * plane);
+  double* p = &frame[0];
+  for (int y=0; y<m_shape(0); ++y)
+    for (int x=0; x<m_shape(1); ++x, ++p) {
+      p[0] = u(y,x);
+      p[plane] = v(y,x);
+    }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_changed.wait(lock, [this]{ return m_queue.size() < m_capacity || m_error; });
+  if (m_error) std::rethrow_exception(m_error);
+  m_queue.push_back(std::vector<double>());
+  m_queue.back().swap(frame);
+  ++m_frames;
+  m_changed.notify_all();
+}
+
+void bob::ip::optflow::FlowArchiveWriter::run() {
+
+  const size_t n = frame_values(m_shape(0), m_shape(1));
+  std::vector<uint64_t> codes(n), previous(n);
+  std::vector<uint8_t> packed, chunk;
+
+  for (size_t frame=0; ; ++frame) {
+    std::vector<double> values;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_changed.wait(lock, [this]{ return !m_queue.empty() || m_stop; });
+      if (m_queue.empty()) return; //stopped and drained
+      values.swap(m_queue.front());
+    }
+
+    try {
+      m_saturated += quantize(&values[0], n, m_step, &codes[0]);
+      bool key = (frame % m_keyframe) == 0;
+      pack(&codes[0], key? 0 : &previous[0], n, m_step > 0., packed);
+      uLongf size = compressBound(packed.size());
+      chunk.resize(size);
+      if (compress2(&chunk[0], &size, &packed[0], packed.size(), m_level) != Z_OK)
+        throw std::runtime_error("cannot compress flow archive chunk");
+
+      m_index.push_back(static_cast<uint64_t>(m_file.tellp()));
+      m_index.push_back(size);
+      m_index.push_back(packed.size());
+      m_file.write(reinterpret_cast<const char*>(&chunk[0]), size);
+      if (!m_file) throw std::runtime_error("cannot write flow archive chunk");
+      //previous holds the reference of the next frames
+      if (key || m_prediction == PredictPrevious) codes.swap(previous);
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_error = std::current_exception();
+      m_queue.clear();
+      m_changed.notify_all();
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.pop_front();
+    m_changed.notify_all();
+  }
+}
+
+void bob::ip::optflow::FlowArchiveWriter::close() {
+
+  if (m_closed) return;
+  m_closed = true;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_changed.notify_all();
+  }
+  m_thread.join();
+
+  if (m_error) {
+    m_file.close();
+    std::rethrow_exception(m_error);
+  }
+
+  uint64_t index = static_cast<uint64_t>(m_file.tellp());
+  for (size_t k=0; k<m_index.size(); k+=3) {
+    put(m_file, m_index[k]);
+    put(m_file, static_cast<uint32_t>(m_index[k+1]));
+    put(m_file, static_cast<uint32_t>(m_index[k+2]));
+  }
+  if (!m_file) {
+    m_file.close();
+    throw std::runtime_error("cannot write flow archive index");
+  }
+  put(m_file, static_cast<uint64_t>(m_index.size() / 3));
+  put(m_file, index);
+  m_file.write(INDEX_MAGIC, 8);
+  m_file.close();
+  if (!m_file) throw std::runtime_error("cannot write flow archive index");
+}
+
+bob::ip::optflow::FlowArchiveReader::FlowArchiveReader
+(const std::string& filename):
+  m_prediction(PredictPrevious),
+  m_file(filename.c_str(), std::ios::binary),
+  m_cached(0),
+  m_key(0)
+{
+  if (!m_file) {
+    boost::format m("cannot open flow archive `%s' for reading");
+    m % filename;
+    throw std::runtime_error(m.str());
+  }
+
+  char magic[8];
+  uint32_t version, keyframe;
+  int32_t height, width;
+  m_file.read(magic, 8);
+  get(m_file, version);
+  get(m_file, height);
+  get(m_file, width);
+  get(m_file, keyframe);
+  get(m_file, m_step);
+  if (!m_file || std::memcmp(magic, MAGIC, 8) || height <= 0 || width <= 0
+      || keyframe < 1) {
+    boost::format m("file `%s' is not a flow archive");
+    m % filename;
+    throw std::runtime_error(m.str());
+  }
+  if (version < 1 || version > VERSION) {
+    boost::format m("flow archive `%s' has version %u, but only versions 1 to %u are supported");
+    m % filename % version % VERSION;
+    throw std::runtime_error(m.str());
+  }
+  if (version >= 2) {
+    uint32_t prediction, reserved;
+    get(m_file, prediction);
+    get(m_file, reserved);
+    if (!m_file || prediction > PredictKeyframe) {
+      boost::format m("flow archive `%s' has a corrupted header");
+      m % filename;
+      throw std::runtime_error(m.str());
+    }
+    m_prediction = static_cast<bob::ip::optflow::FlowPrediction>(prediction);
+  }
+  const uint64_t header = header_size(version);
+  const uint64_t n = frame_values(height, width);
+  if (!n) {
+    boost::format m("flow archive `%s' has shape (%d, %d), which is too large");
+    m % filename % height % width;
+    throw std::runtime_error(m.str());
+  }
+  m_shape = blitz::TinyVector<int,2>(height, width);
+  m_keyframe = keyframe;
+
+  m_file.seekg(0, std::ios::end);
+  const uint64_t end = static_cast<uint64_t>(m_file.tellg());
+
+  uint64_t frames = 0, index = 0;
+  if (end >= header + FOOTER) {
+    m_file.seekg(end - FOOTER);
+    get(m_file, frames);
+    get(m_file, index);
+    m_file.read(magic, 8);
+  }
+  if (end < header + FOOTER || !m_file || std::memcmp(magic, INDEX_MAGIC, 8)) {
+    boost::format m("flow archive `%s' has no index - was it closed properly?");
+    m % filename;
+    throw std::runtime_error(m.str());
+  }
+
+  //the index sits between the last chunk and the footer
+  if (index < header || index > end - FOOTER ||
+      frames != (end - FOOTER - index) / ENTRY ||
+      (end - FOOTER - index) % ENTRY) {
+    boost::format m("flow archive `%s' has a corrupted index: %u frame(s) at offset %u do not fit a file of %u bytes");
+    m % filename % frames % index % end;
+    throw std::runtime_error(m.str());
+  }
+
+  m_file.seekg(index);
+  m_offset.resize(frames);
+  m_compressed.resize(frames);
+  m_raw.resize(frames);
+  for (size_t k=0; k<frames; ++k) {
+    get(m_file, m_offset[k]);
+    get(m_file, m_compressed[k]);
+    get(m_file, m_raw[k]);
+  }
+  if (!m_file) {
+    boost::format m("flow archive `%s' has a truncated index");
+    m % filename;
+    throw std::runtime_error(m.str());
+  }
+
+  //chunks lie between the header and the index, and unpack to the frame
+  //values: exactly 8 bytes each if lossless, 1 to 8 bytes each otherwise
+  for (size_t k=0; k<frames; ++k) {
+    const bool raw = m_step > 0. ? (m_raw[k] >= n && m_raw[k] <= 8 * n) :
+      m_raw[k] == 8 * n;
+    if (m_offset[k] < header || m_offset[k] > index || !m_compressed[k] ||
+        m_compressed[k] > index - m_offset[k] || !raw) {
+      boost::format m("flow archive `%s' has a corrupted index: frame %u has a chunk of %u bytes at offset %u, unpacking to %u bytes, for %u values");
+      m % filename % k % m_compressed[k] % m_offset[k] % m_raw[k] % n;
+      throw std::runtime_error(m.str());
+    }
+  }
+
+  m_cached = frames;
+  m_key = frames;
+}
+
+bob::ip::optflow::FlowArchiveReader::~FlowArchiveReader() { }
+
+void bob::ip::optflow::FlowArchiveReader::decode(size_t index,
+    const uint64_t* reference, uint64_t* codes) {
+
+  m_chunk.resize(m_compressed[index]);
+  m_file.seekg(m_offset[index]);
+  m_file.read(reinterpret_cast<char*>(&m_chunk[0]), m_chunk.size());
+  if (!m_file) {
+    m_file.clear();
+    boost::format m("cannot read chunk of frame %u from flow archive");
+    m % index;
+    throw std::runtime_error(m.str());
+  }
+
+  m_packed.resize(m_raw[index]);
+  uLongf size = m_packed.size();
+  if (uncompress(&m_packed[0], &size, &m_chunk[0], m_chunk.size()) != Z_OK ||
+      size != m_packed.size()) {
+    boost::format m("chunk of frame %u on flow archive is corrupted");
+    m % index;
+    throw std::runtime_error(m.str());
+  }
+
+  //predictions are read before being overwritten, value by value
+  unpack(m_packed, reference, m_codes.size(), m_step > 0., codes);
+}
+
+void bob::ip::optflow::FlowArchiveReader::read(size_t index,
+    blitz::Array<double,2>& u, blitz::Array<double,2>& v) {
+
+  bob::core::array::assertSameShape(u, m_shape);
+  bob::core::array::assertSameShape(v, m_shape);
+  if (index >= size()) {
+    boost::format m("cannot read frame %u from a flow archive with %u frame(s)");
+    m % index % size();
+    throw std::runtime_error(m.str());
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  //allocated on first use, so opening an archive is cheap
+  const size_t n = frame_values(m_shape(0), m_shape(1));
+  m_codes.resize(n);
+  const size_t key = index - (index % m_keyframe);
+  const uint64_t* codes = &m_codes[0];
+
+  if (m_prediction == PredictKeyframe) {
+    //decodes the keyframe, unless cached, then the frame from it
+    m_key_codes.resize(n);
+    if (m_key != key) {
+      m_key = size(); //in case decoding fails
+      decode(key, 0, &m_key_codes[0]);
+      m_key = key;
+    }
+    if (index == key) codes = &m_key_codes[0];
+    else if (m_cached != index) {
+      m_cached = size();
+      decode(index, &m_key_codes[0], &m_codes[0]);
+      m_cached = index;
+    }
+  }
+  else {
+    //decodes from the keyframe, or continues from the cached frame
+    size_t start = key;
+    if (m_cached < size() && m_cached >= start && m_cached <= index)
+      start = m_cached + 1;
+    for (size_t k=start; k<=index; ++k) {
+      m_cached = size(); //in case decoding fails
+      decode(k, k == key ? 0 : &m_codes[0], &m_codes[0]);
+      m_cached = k;
+    }
+  }
+
+  const size_t plane = m_shape(0) * m_shape(1);
+  std::vector<double> values(2 * plane);
+  dequantize(codes, values.size(), m_step, &values[0]);
+  const double* p = &values[0];
+  for (int y=0; y<m_shape(0); ++y)
+    for (int x=0; x<m_shape(1); ++x, ++p) {
+      u(y,x) = p[0];
+      v(y,x) = p[plane];
+    }
+}
@@ -0,0 +1,228 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:09:40 2026 +0000
+ *
+ * @brief Indexed, chunked and compressed storage of optical flow sequences
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BOB_IP_OPTFLOW_FLOWARCHIVE_H
+#define BOB_IP_OPTFLOW_FLOWARCHIVE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+#include <blitz/array.h>
+
+namespace bob { namespace ip { namespace optflow {
+
+  /**
+   * What the frames between keyframes are predicted from
+   */
+  typedef enum FlowPrediction {
+    PredictPrevious = 0, ///< the previous frame, for the smallest archives
+    PredictKeyframe ///< the last keyframe, for the fastest random access
+  } FlowPrediction;
+
+  /**
+   * File layout (all values in the host byte order):
+   *
+   * 1. A header: the magic "BOBFLOW1", the format version (uint32), the
+   *    height and width of the flow fields (int32), the keyframe interval
+   *    (uint32), the quantization step (float64, 0 if lossless) and, from
+   *    version 2 on, the FlowPrediction (uint32) and a reserved uint32
+   *    (0). Version 1 archives predict from the previous frame;
+   * 2. One compressed chunk per frame, holding both the u and v planes;
+   * 3. The frame index: for each frame, the chunk offset (uint64), its
+   *    compressed and raw sizes (uint32);
+   * 4. A footer: the number of frames (uint64), the offset of the index
+   *    (uint64) and the magic "BOBFIDX1".
+   *
+   * Chunk sizes are indexed with 32 bits, which limits flow fields to about
+   * 2^28 pixels. Readers check the index against the size of the file and
+   * of the frames before trusting it.
+   *
+   * With a quantization step, values are rounded to the nearest multiple of
+   * the step and saturated to the int16 range (e.g., +/-512 pixels with a
+   * step of 1/64), the writer counting saturated values. Without it, the
+   * float64 values are kept bit-exact.
+   *
+   * Every keyframe is coded on its own, each value being predicted from its
+   * left neighbour. The frames in between are predicted from the previous
+   * frame or from the last keyframe (see FlowPrediction). Residuals are then
+   * packed (zig-zag varints when quantized, byte planes of the XOR-ed bit
+   * patterns when lossless) and deflated with zlib.
+   *
+   * Decoding a keyframe reads a single chunk. Decoding another frame reads,
+   * at most, all chunks since the last keyframe when predicting from the
+   * previous frame (keyframe chunks), or 2 chunks (the keyframe and the
+   * frame) when predicting from the keyframe. The latter makes larger
+   * archives, as frames drift away from their keyframe.
+   */
+  class FlowArchiveWriter {
+
+    public: //api
+
+      /**
+       * Creates a new archive, overwriting any existing file.
+       *
+       * @param filename The file to write
+       * @param shape The shape of every flow field
+       * @param step The quantization step, in pixels (0 for lossless)
+       * @param keyframe Every how many frames a keyframe is coded (1 means
+       * all frames are keyframes)
+       * @param level The zlib compression level (0 to 9)
+       * @param queue How many frames may wait to be encoded, before write()
+       * blocks
+       * @param prediction What frames between keyframes are predicted from
+       */
+      FlowArchiveWriter(const std::string& filename,
+          const blitz::TinyVector<int,2>& shape, double step=0.,
+          size_t keyframe=8, int level=6, size_t queue=4,
+          FlowPrediction prediction=PredictPrevious);
+
+      /**
+       * Closes the archive if that was not done already. Errors are ignored:
+       * call close() to get notified.
+       */
+      virtual ~FlowArchiveWriter();
+
+      /**
+       * Queues a frame. The flow is copied, then encoded and written by a
+       * background thread. Blocks while the queue is full. Errors found by
+       * the background thread are thrown here or on close().
+       */
+      void write(const blitz::Array<double,2>& u,
+          const blitz::Array<double,2>& v);
+
+      /**
+       * Waits for all queued frames to be written, then writes the index and
+       * closes the file. Further calls have no effect.
+       */
+      void close();
+
+      /**
+       * The number of frames written (or queued) so far
+       */
+      inline size_t size() const { return m_frames; }
+
+      /**
+       * The number of values saturated to the int16 range by quantization,
+       * in the frames encoded so far (all frames, once close() returned)
+       */
+      inline uint64_t getSaturated() const { return m_saturated; }
+
+      inline const blitz::TinyVector<int,2>& getShape() const { return m_shape; }
+      inline double getStep() const { return m_step; }
+      inline size_t getKeyframe() const { return m_keyframe; }
+      inline FlowPrediction getPrediction() const { return m_prediction; }
+
+    private: //not copiable, owns a thread
+
+      FlowArchiveWriter(const FlowArchiveWriter&);
+      FlowArchiveWriter& operator= (const FlowArchiveWriter&);
+
+      void run(); ///< the background writer
+
+    private: //representation
+
+      blitz::TinyVector<int,2> m_shape;
+      double m_step;
+      size_t m_keyframe;
+      FlowPrediction m_prediction;
+      int m_level;
+      size_t m_capacity;
+      size_t m_frames;
+      bool m_closed;
+      std::atomic<uint64_t> m_saturated; ///< updated by the writer thread
+
+      std::ofstream m_file;
+      std::vector<uint64_t> m_index; ///< offset and sizes, per frame
+
+      std::mutex m_mutex;
+      std::condition_variable m_changed;
+      std::deque<std::vector<double> > m_queue; ///< u then v, per frame
+      bool m_stop;
+      std::exception_ptr m_error;
+      std::thread m_thread;
+
+  };
+
+  /**
+   * Reads frames from an archive produced by FlowArchiveWriter, in any order.
+   * The last decoded frame (and keyframe, when predicting from keyframes) is
+   * cached, so reading frames in sequence decodes each chunk once. Reading is
+   * serialized, so a reader may be shared between threads.
+   */
+  class FlowArchiveReader {
+
+    public: //api
+
+      /**
+       * Opens an existing archive and loads its index
+       */
+      FlowArchiveReader(const std::string& filename);
+
+      virtual ~FlowArchiveReader();
+
+      /**
+       * Decodes a frame into u and v, which should have the archive shape.
+       * See FlowArchiveWriter for the chunks this reads.
+       */
+      void read(size_t index, blitz::Array<double,2>& u,
+          blitz::Array<double,2>& v);
+
+      /**
+       * The number of frames on the archive
+       */
+      inline size_t size() const { return m_offset.size(); }
+
+      inline const blitz::TinyVector<int,2>& getShape() const { return m_shape; }
+      inline double getStep() const { return m_step; }
+      inline size_t getKeyframe() const { return m_keyframe; }
+      inline FlowPrediction getPrediction() const { return m_prediction; }
+
+    private: //not copiable, owns a file
+
+      FlowArchiveReader(const FlowArchiveReader&);
+      FlowArchiveReader& operator= (const FlowArchiveReader&);
+
+      /**
+       * Decodes a frame into codes, predicted from reference (0 for
+       * keyframes), which may be codes itself
+       */
+      void decode(size_t index, const uint64_t* reference, uint64_t* codes);
+
+    private: //representation
+
+      blitz::TinyVector<int,2> m_shape;
+      double m_step;
+      size_t m_keyframe;
+      FlowPrediction m_prediction;
+
+      std::ifstream m_file;
+      std::vector<uint64_t> m_offset;
+      std::vector<uint32_t> m_compressed;
+      std::vector<uint32_t> m_raw;
+
+      std::mutex m_mutex;
+      std::vector<uint64_t> m_codes; ///< of the cached frame (u then v)
+      size_t m_cached; ///< index of the cached frame, or size() if none
+      std::vector<uint64_t> m_key_codes; ///< of the cached keyframe
+      size_t m_key; ///< index of the cached keyframe, or size() if none
+      std::vector<uint8_t> m_chunk;
+      std::vector<uint8_t> m_packed;
+
+  };
+
+}}}
+
+#endif /* BOB_IP_OPTFLOW_FLOWARCHIVE_H */
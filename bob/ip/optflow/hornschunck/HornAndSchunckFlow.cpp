@@ -8,11 +8,19 @@
  * Copyright (C) 2011-2013 Idiap Research Institute, Martigny, Switzerland
  */
 
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <boost/format.hpp>
 #include <bob.core/assert.h>
 #include <bob.sp/conv.h>
 #include <bob.sp/extrapolate.h>
 
 #include "HornAndSchunckFlow.h"
+#include "Trace.h"
 
 static const double LAPLACIAN_014_KERNEL_DATA[] = {0,.25,0,.25,0,.25,0,.25,0};
 static const blitz::Array<double,2> LAPLACIAN_014_KERNEL(const_cast<double*>(LAPLACIAN_014_KERNEL_DATA), blitz::shape(3,3), blitz::neverDeleteData);
@@ -37,83 +45,1043 @@ void bob::ip::optflow::laplacian_avg_hs(const blitz::Array<double,2>& input,
   bob::sp::conv(input, LAPLACIAN_12_KERNEL, output,
       bob::sp::Conv::Valid);
 }
-bob::ip::optflow::VanillaHornAndSchunckFlow::VanillaHornAndSchunckFlow
-(const blitz::TinyVector<int,2>& shape) :
-  m_gradient(shape),
-  m_ex(shape),
-  m_ey(shape),
-  m_et(shape),
-  m_u(shape),
-  m_v(shape),
-  m_cterm(shape)
-{
+
+blitz::TinyVector<int,2> bob::ip::optflow::blockShape
+(const blitz::TinyVector<int,2>& shape, int block) {
+  if (block < 1) {
+    boost::format m("block size should be at least 1, but you set it to %d");
+    m % block;
+    throw std::runtime_error(m.str());
+  }
+  return blitz::TinyVector<int,2>((shape(0) + block - 1) / block,
+      (shape(1) + block - 1) / block);
 }
 
-bob::ip::optflow::VanillaHornAndSchunckFlow::~VanillaHornAndSchunckFlow() { }
+blitz::TinyVector<int,2> bob::ip::optflow::maskShape
+(const blitz::TinyVector<int,2>& shape, bool packed) {
+  if (!packed) return shape;
+  return blitz::TinyVector<int,2>(shape(0), (shape(1) + 7) / 8);
+}
 
-void bob::ip::optflow::VanillaHornAndSchunckFlow::setShape
-(const blitz::TinyVector<int,2>& shape) {
-  m_gradient.setShape(shape);
-  m_ex.resize(shape);
-  m_ey.resize(shape);
-  m_et.resize(shape);
-  m_u.resize(shape);
-  m_v.resize(shape);
-  m_cterm.resize(shape);
+/**
+ * One pass of a 3x3 erosion (a pixel stays set if all its
+ * neighbours are set) or dilation (a pixel is set if any neighbour is)
+ */
+static void morph3x3(const blitz::Array<uint8_t,2>& input,
+    blitz::Array<uint8_t,2>& output, bool erode) {
+  const int height = input.extent(0);
+  const int width = input.extent(1);
+  for (int y=0; y<height; ++y) {
+    for (int x=0; x<width; ++x) {
+      bool value = erode;
+      for (int j=std::max(0, y-1); j<=std::min(height-1, y+1); ++j)
+        for (int i=std::max(0, x-1); i<=std::min(width-1, x+1); ++i)
+          if ((input(j,i) != 0) != erode) value = !erode;
+      output(y,x) = value;
+    }
+  }
 }
 
-void bob::ip::optflow::VanillaHornAndSchunckFlow::operator() (double alpha,
-    size_t iterations, const blitz::Array<double,2>& i1,
-    const blitz::Array<double,2>& i2, blitz::Array<double,2>& u0,
-    blitz::Array<double,2>& v0) const {
+void bob::ip::optflow::openMask(blitz::Array<uint8_t,2>& mask) {
+  blitz::Array<uint8_t,2> eroded(mask.shape());
+  morph3x3(mask, eroded, true);
+  morph3x3(eroded, mask, false);
+}
+
+/**
+ * Marks the blocks in which any pixel changed by more than the threshold
+ */
+static void mark_changes(const blitz::Array<double,2>& i1,
+    const blitz::Array<double,2>& i2, double threshold, int block,
+    blitz::Array<bool,2>& marked) {
+  for (int y=0; y<i1.extent(0); ++y)
+    for (int x=0; x<i1.extent(1); ++x)
+      if (std::fabs(i2(y,x) - i1(y,x)) > threshold)
+        marked(y / block, x / block) = true;
+}
 
+/**
+ * Turns runs of marked blocks into regions, merging runs spanning the same
+ * columns on consecutive rows of blocks
+ */
+static void merge_blocks(const blitz::Array<bool,2>& marked, int block,
+    const blitz::TinyVector<int,2>& shape,
+    std::vector<bob::ip::optflow::Region>& regions) {
+  const size_t first = regions.size();
+  for (int by=0; by<marked.extent(0); ++by) {
+    const int y = by*block;
+    const int height = std::min(block, shape(0) - y);
+    for (int bx=0; bx<marked.extent(1); ++bx) {
+      if (!marked(by,bx)) continue;
+      const int x = bx*block;
+      while (bx+1 < marked.extent(1) && marked(by,bx+1)) ++bx;
+      const int width = std::min((bx+1)*block, shape(1)) - x;
+      bool merged = false;
+      for (size_t k=first; k<regions.size() && !merged; ++k) {
+        bob::ip::optflow::Region& r = regions[k];
+        if (r(0) + r(2) == y && r(1) == x && r(3) == width) {
+          r(2) += height;
+          merged = true;
+        }
+      }
+      if (!merged)
+        regions.push_back(bob::ip::optflow::Region(y, x, height, width));
+    }
+  }
+}
+
+static void check_threshold(double threshold) {
+  if (threshold < 0.) {
+    boost::format m("change threshold should be non-negative, but you set it to %g");
+    m % threshold;
+    throw std::runtime_error(m.str());
+  }
+}
+
+void bob::ip::optflow::changedRegions(const blitz::Array<double,2>& i1,
+    const blitz::Array<double,2>& i2, double threshold, int block,
+    std::vector<bob::ip::optflow::Region>& regions) {
   bob::core::array::assertSameShape(i1, i2);
-  bob::core::array::assertSameShape(i1, m_ex);
-  bob::core::array::assertSameShape(u0, m_u);
-  bob::core::array::assertSameShape(v0, m_v);
+  check_threshold(threshold);
+  blitz::Array<bool,2> marked(blockShape(i1.shape(), block));
+  marked = false;
+  mark_changes(i1, i2, threshold, block, marked);
+  merge_blocks(marked, block, i1.shape(), regions);
+}
 
-  m_gradient(i1, i2, m_ex, m_ey, m_et);
-  double a2 = std::pow(alpha, 2);
+void bob::ip::optflow::changedRegions(const blitz::Array<double,2>& i1,
+    const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
+    double threshold, int block,
+    std::vector<bob::ip::optflow::Region>& regions) {
+  bob::core::array::assertSameShape(i1, i2);
+  bob::core::array::assertSameShape(i2, i3);
+  check_threshold(threshold);
+  blitz::Array<bool,2> marked(blockShape(i1.shape(), block));
+  marked = false;
+  mark_changes(i1, i2, threshold, block, marked);
+  mark_changes(i2, i3, threshold, block, marked);
+  merge_blocks(marked, block, i1.shape(), regions);
+}
+
+void bob::ip::optflow::tileRegions(const blitz::TinyVector<int,2>& shape,
+    int tile, std::vector<bob::ip::optflow::Region>& tiles) {
+  if (tile < 1) {
+    boost::format m("tile size should be at least 1, but you set it to %d");
+    m % tile;
+    throw std::runtime_error(m.str());
+  }
+  for (int y=0; y<shape(0); y+=tile)
+    for (int x=0; x<shape(1); x+=tile)
+      tiles.push_back(bob::ip::optflow::Region(y, x,
+            std::min(tile, shape(0) - y), std::min(tile, shape(1) - x)));
+}
+
+/**
+ * Performs one Horn & Schunck update from the averaged flow (u_bar, v_bar),
+ * in a single pass over the image. The observer is called with the previous
+ * and the new estimates for every pixel, before u0 and v0 are overwritten.
+ * This is the same computation as the array expressions in the solvers.
+ */
+template <typename T>
+static void fused_update(double a2, const blitz::Array<double,2>& ex,
+    const blitz::Array<double,2>& ey, const blitz::Array<double,2>& et,
+    const blitz::Array<double,2>& u_bar, const blitz::Array<double,2>& v_bar,
+    blitz::Array<double,2>& u0, blitz::Array<double,2>& v0, T& observer) {
+  for (int y=0; y<u0.extent(0); ++y) {
+    for (int x=0; x<u0.extent(1); ++x) {
+      const double cterm = (ex(y,x)*u_bar(y,x) + ey(y,x)*v_bar(y,x) +
+          et(y,x)) / (ex(y,x)*ex(y,x) + ey(y,x)*ey(y,x) + a2);
+      const double u = u_bar(y,x) - ex(y,x)*cterm;
+      const double v = v_bar(y,x) - ey(y,x)*cterm;
+      observer(y, x, u0(y,x), v0(y,x), u, v);
+      u0(y,x) = u;
+      v0(y,x) = v;
+    }
+  }
+}
+
+/**
+ * Sets the flow estimates to zero, allocating them on first use
+ */
+static void zero_flow(const blitz::TinyVector<int,2>& shape,
+    blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) {
+  if (u0.extent(0) != shape(0) || u0.extent(1) != shape(1)) {
+    u0.resize(shape);
+    v0.resize(shape);
+  }
+  u0 = 0.;
+  v0 = 0.;
+}
+
+/**
+ * Runs the solver iterations from precomputed gradients, like the solvers
+ * do, fusing the observer into the update of the final iteration only. With
+ * no iterations, the observer sees the initial estimates, unchanged.
+ */
+template <typename L, typename T>
+static void solve_with_epilogue(double a2, size_t iterations,
+    const blitz::Array<double,2>& ex,
+    const blitz::Array<double,2>& ey, const blitz::Array<double,2>& et,
+    blitz::Array<double,2>& u_bar, blitz::Array<double,2>& v_bar,
+    blitz::Array<double,2>& cterm, blitz::Array<double,2>& u0,
+    blitz::Array<double,2>& v0, T& observer) {
   for (size_t i=0; i<iterations; ++i) {
-    bob::ip::optflow::laplacian_avg_hs(u0, m_u);
-    bob::ip::optflow::laplacian_avg_hs(v0, m_v);
-    m_cterm = (m_ex*m_u + m_ey*m_v + m_et) /
-      (blitz::pow2(m_ex) + blitz::pow2(m_ey) + a2);
-    u0 = m_u - m_ex*m_cterm;
-    v0 = m_v - m_ey*m_cterm;
+    bob::ip::optflow::trace::Span iteration("iteration");
+    L::apply(u0, u_bar);
+    L::apply(v0, v_bar);
+    if (i+1 < iterations) {
+      cterm = (ex*u_bar + ey*v_bar + et) /
+        (blitz::pow2(ex) + blitz::pow2(ey) + a2);
+      u0 = u_bar - ex*cterm;
+      v0 = v_bar - ey*cterm;
+    }
+    else fused_update(a2, ex, ey, et, u_bar, v_bar, u0, v0, observer);
+  }
+  if (!iterations) {
+    for (int y=0; y<u0.extent(0); ++y)
+      for (int x=0; x<u0.extent(1); ++x)
+        observer(y, x, u0(y,x), v0(y,x), u0(y,x), v0(y,x));
   }
 }
 
-void bob::ip::optflow::VanillaHornAndSchunckFlow::evalEc2
-(const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
- blitz::Array<double,2>& error) const {
+/**
+ * Records, per block, the last iteration with a significant update and the
+ * largest update magnitude on the final iteration.
+ */
+class ConvergenceTracker {
+
+  public:
+
+    ConvergenceTracker(double threshold, int block,
+        blitz::Array<int32_t,2>& last, blitz::Array<double,2>& magnitude):
+      m_threshold2(threshold*threshold),
+      m_block(block),
+      m_iteration(0),
+      m_final(false),
+      m_last(last),
+      m_magnitude(magnitude)
+    {
+      m_last = 0;
+      m_magnitude = 0.;
+    }
+
+    void next(bool final) {
+      ++m_iteration;
+      m_final = final;
+    }
+
+    void operator() (int y, int x, double u_prev, double v_prev, double u,
+        double v) {
+      const double du = u - u_prev;
+      const double dv = v - v_prev;
+      const double d2 = du*du + dv*dv;
+      const int by = y / m_block;
+      const int bx = x / m_block;
+      if (d2 > m_threshold2) m_last(by,bx) = m_iteration;
+      if (m_final && d2 > m_magnitude(by,bx)) m_magnitude(by,bx) = d2;
+    }
+
+    void finish() {
+      m_magnitude = blitz::sqrt(m_magnitude);
+    }
+
+  private:
+
+    double m_threshold2;
+    int m_block;
+    int32_t m_iteration;
+    bool m_final;
+    blitz::Array<int32_t,2>& m_last;
+    blitz::Array<double,2>& m_magnitude;
+
+};
+
+bob::ip::optflow::FlowStatistics::FlowStatistics
+(const blitz::TinyVector<int,2>& shape, int tile, int bins):
+  tile(tile),
+  mean(0.),
+  max(0.),
+  energy(0.)
+{
+  if (bins < 1) {
+    boost::format m("the direction histogram should have at least 1 bin, but you set it to %d");
+    m % bins;
+    throw std::runtime_error(m.str());
+  }
+  blitz::TinyVector<int,2> tiles = blockShape(shape, tile);
+  histogram.resize(bins);
+  tileMean.resize(tiles);
+  tileMax.resize(tiles);
+  tileEnergy.resize(tiles);
+  tileHistogram.resize(tiles(0), tiles(1), bins);
+}
+
+/**
+ * Accumulates FlowStatistics from the final estimates of every pixel
+ */
+class StatisticsAccumulator {
+
+  public:
+
+    StatisticsAccumulator(const blitz::TinyVector<int,2>& shape,
+        bob::ip::optflow::FlowStatistics& s):
+      m_shape(shape),
+      m_bins(s.histogram.extent(0)),
+      m_s(s)
+    {
+      bob::core::array::assertSameShape(s.tileMean,
+          bob::ip::optflow::blockShape(shape, s.tile));
+      bob::core::array::assertSameShape(s.tileMax, s.tileMean);
+      bob::core::array::assertSameShape(s.tileEnergy, s.tileMean);
+      bob::core::array::assertSameDimensionLength(s.tileHistogram.extent(0),
+          s.tileMean.extent(0));
+      bob::core::array::assertSameDimensionLength(s.tileHistogram.extent(1),
+          s.tileMean.extent(1));
+      bob::core::array::assertSameDimensionLength(s.tileHistogram.extent(2),
+          m_bins);
+      m_s.tileMean = 0.;
+      m_s.tileMax = 0.;
+      m_s.tileEnergy = 0.;
+      m_s.tileHistogram = 0.;
+    }
+
+    void operator() (int y, int x, double, double, double u, double v) {
+      const double e = u*u + v*v;
+      const double m = std::sqrt(e);
+      const int ty = y / m_s.tile;
+      const int tx = x / m_s.tile;
+      m_s.tileMean(ty,tx) += m;
+      m_s.tileEnergy(ty,tx) += e;
+      if (m > m_s.tileMax(ty,tx)) m_s.tileMax(ty,tx) = m;
+      if (m > 0.) {
+        int bin = static_cast<int>((std::atan2(v, u) + M_PI) / (2*M_PI) * m_bins);
+        if (bin >= m_bins) bin = m_bins - 1; //atan2() may return +pi
+        m_s.tileHistogram(ty,tx,bin) += m;
+      }
+    }
+
+    /**
+     * Turns sums into means and computes the statistics of the whole frame
+     */
+    void finish() {
+      const int tile = m_s.tile;
+      double sum = 0., energy = 0.;
+      m_s.max = 0.;
+      m_s.histogram = 0.;
+      for (int ty=0; ty<m_s.tileMean.extent(0); ++ty) {
+        for (int tx=0; tx<m_s.tileMean.extent(1); ++tx) {
+          const double pixels = std::min(tile, m_shape(0) - ty*tile) *
+            std::min(tile, m_shape(1) - tx*tile);
+          sum += m_s.tileMean(ty,tx);
+          energy += m_s.tileEnergy(ty,tx);
+          m_s.tileMean(ty,tx) /= pixels;
+          m_s.tileEnergy(ty,tx) /= pixels;
+          if (m_s.tileMax(ty,tx) > m_s.max) m_s.max = m_s.tileMax(ty,tx);
+          for (int b=0; b<m_bins; ++b)
+            m_s.histogram(b) += m_s.tileHistogram(ty,tx,b);
+        }
+      }
+      const double pixels = double(m_shape(0)) * m_shape(1);
+      m_s.mean = sum / pixels;
+      m_s.energy = energy / pixels;
+    }
+
+  private:
+
+    blitz::TinyVector<int,2> m_shape;
+    int m_bins;
+    bob::ip::optflow::FlowStatistics& m_s;
+
+};
+
+bob::ip::optflow::LabelStatistics::LabelStatistics
+(int labels, int bins, double range):
+  range(range)
+{
+  if (labels < 0) {
+    boost::format m("the number of labels should be non-negative, but you set it to %d");
+    m % labels;
+    throw std::runtime_error(m.str());
+  }
+  if (bins < 1) {
+    boost::format m("the magnitude histogram should have at least 1 bin, but you set it to %d");
+    m % bins;
+    throw std::runtime_error(m.str());
+  }
+  if (!(range > 0.)) {
+    boost::format m("the range of the magnitude histogram should be positive, but you set it to %g");
+    m % range;
+    throw std::runtime_error(m.str());
+  }
+  count.resize(labels);
+  mean.resize(labels, 2);
+  covariance.resize(labels, 2, 2);
+  histogram.resize(labels, bins);
+}
+
+/**
+ * Accumulates LabelStatistics from the flow of every pixel, with partial
+ * moments per stripe of rows, so stripes can be accumulated in any order (or
+ * in parallel) with the same results. Moments are updated with Welford's
+ * method and stripes are merged in order with Chan's formulas, so the
+ * covariance of flows far from zero does not cancel out.
+ */
+class LabelAccumulator {
+
+  public:
+
+    static const int STRIPE = 64; ///< rows per stripe, at least
+    static const size_t PARTIALS = 1 << 25; ///< bytes for all stripes, at most
+
+    LabelAccumulator(const blitz::TinyVector<int,2>& shape,
+        const blitz::Array<int32_t,2>& labels,
+        bob::ip::optflow::LabelStatistics& s):
+      m_labels(labels),
+      m_n(s.count.extent(0)),
+      m_bins(s.histogram.extent(1)),
+      m_scale(m_bins / s.range),
+      m_rows(stripe_rows(shape(0), m_n, m_bins)),
+      m_stripes((shape(0) + m_rows - 1) / m_rows),
+      m_count(m_stripes*m_n, 0),
+      m_moments(m_stripes*m_n*MOMENTS, 0.),
+      m_histogram(m_stripes*m_n*m_bins, 0),
+      m_s(s)
+    {
+      bob::core::array::assertSameShape(labels, shape);
+      bob::core::array::assertSameShape(s.mean,
+          blitz::TinyVector<int,2>(m_n, 2));
+      bob::core::array::assertSameShape(s.covariance,
+          blitz::TinyVector<int,3>(m_n, 2, 2));
+      bob::core::array::assertSameDimensionLength(s.histogram.extent(0), m_n);
+    }
+
+    inline int stripes() const { return m_stripes; }
+
+    void operator() (int y, int x, double, double, double u, double v) {
+      const int32_t l = m_labels(y,x);
+      if (l < 0 || l >= m_n) return;
+      const size_t k = (y / m_rows)*m_n + l;
+      const double n = static_cast<double>(++m_count[k]);
+      double* m = &m_moments[k*MOMENTS];
+      const double du = u - m[0];
+      const double dv = v - m[1];
+      m[0] += du / n;
+      m[1] += dv / n;
+      m[2] += du*(u - m[0]);
+      m[3] += du*(v - m[1]);
+      m[4] += dv*(v - m[1]);
+      const double t = std::sqrt(u*u + v*v) * m_scale;
+      //beyond the range, or NaN, on the last bin
+      const int bin = t < m_bins ? static_cast<int>(t) : m_bins - 1;
+      ++m_histogram[k*m_bins + bin];
+    }
+
+    /**
+     * Accumulates the pixels of a stripe from complete flow fields
+     */
+    void accumulate(int stripe, const blitz::Array<double,2>& u,
+        const blitz::Array<double,2>& v) {
+      const int last = std::min((stripe + 1)*m_rows, u.extent(0));
+      for (int y=stripe*m_rows; y<last; ++y)
+        for (int x=0; x<u.extent(1); ++x)
+          (*this)(y, x, 0., 0., u(y,x), v(y,x));
+    }
+
+    /**
+     * Merges the stripes, in order, and turns moments into statistics
+     */
+    void finish() {
+      m_s.histogram = 0;
+      for (int l=0; l<m_n; ++l) {
+        int64_t count = 0;
+        double m[MOMENTS] = {0., 0., 0., 0., 0.};
+        for (int stripe=0; stripe<m_stripes; ++stripe) {
+          const size_t k = stripe*m_n + l;
+          for (int b=0; b<m_bins; ++b)
+            m_s.histogram(l,b) += m_histogram[k*m_bins + b];
+          if (!m_count[k]) continue;
+          const double* p = &m_moments[k*MOMENTS];
+          const double na = static_cast<double>(count);
+          const double nb = static_cast<double>(m_count[k]);
+          const double w = na*nb / (na + nb);
+          const double du = p[0] - m[0];
+          const double dv = p[1] - m[1];
+          m[0] += du * nb / (na + nb);
+          m[1] += dv * nb / (na + nb);
+          m[2] += p[2] + du*du*w;
+          m[3] += p[3] + du*dv*w;
+          m[4] += p[4] + dv*dv*w;
+          count += m_count[k];
+        }
+        m_s.count(l) = count;
+        if (!count) {
+          m_s.mean(l, blitz::Range::all()) = 0.;
+          m_s.covariance(l, blitz::Range::all(), blitz::Range::all()) = 0.;
+          continue;
+        }
+        m_s.mean(l,0) = m[0];
+        m_s.mean(l,1) = m[1];
+        m_s.covariance(l,0,0) = m[2] / count;
+        m_s.covariance(l,0,1) = m[3] / count;
+        m_s.covariance(l,1,0) = m_s.covariance(l,0,1);
+        m_s.covariance(l,1,1) = m[4] / count;
+      }
+    }
+
+  private:
+
+    static const int MOMENTS = 5; ///< means of u and v, and the sums of
+                                  ///< squared deviations uu, uv and vv
+
+    /**
+     * Rows per stripe: STRIPE, or more if the partial statistics of that
+     * many stripes would not fit in PARTIALS bytes. Depends neither on the
+     * number of threads nor on the order stripes are accumulated in.
+     */
+    static int stripe_rows(int height, int labels, int bins) {
+      const size_t bytes = std::max<size_t>(1, static_cast<size_t>(labels) *
+          (1 + MOMENTS + bins) * 8);
+      const int stripes = std::max<size_t>(1, PARTIALS / bytes);
+      const int rows = (height + stripes - 1) / stripes;
+      return rows > STRIPE ? rows : STRIPE;
+    }
+
+    const blitz::Array<int32_t,2>& m_labels;
+    int m_n;
+    int m_bins;
+    double m_scale;
+    int m_rows;
+    int m_stripes;
+    std::vector<int64_t> m_count; ///< per stripe and label
+    std::vector<double> m_moments; ///< per stripe and label
+    std::vector<int64_t> m_histogram; ///< per stripe and label
+    bob::ip::optflow::LabelStatistics& m_s;
+
+};
+
+void bob::ip::optflow::labelStatistics(const blitz::Array<double,2>& u,
+    const blitz::Array<double,2>& v, const blitz::Array<int32_t,2>& labels,
+    bob::ip::optflow::LabelStatistics& statistics, size_t threads) {
 
   bob::core::array::assertSameShape(u, v);
-  bob::core::array::assertSameShape(u, error);
-  bob::core::array::assertSameShape(u, m_u);
+  bob::ip::optflow::trace::Span span("label_statistics");
 
-  laplacian_avg_hs(u, m_u);
-  laplacian_avg_hs(v, m_u);
-  error = blitz::pow2(m_u - u) + blitz::pow2(m_v - v);
+  LabelAccumulator accumulator(u.shape(), labels, statistics);
+  const int stripes = accumulator.stripes();
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  const int chunks = std::min<int>(threads, stripes);
 
+  if (chunks <= 1) {
+    for (int stripe=0; stripe<stripes; ++stripe)
+      accumulator.accumulate(stripe, u, v);
+  }
+  else {
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> workers;
+    for (int c=0; c<chunks; ++c) {
+      const int first = (c * stripes) / chunks;
+      const int last = ((c + 1) * stripes) / chunks;
+      workers.push_back(std::thread([&, c, first, last]() {
+            try {
+              for (int stripe=first; stripe<last; ++stripe)
+                accumulator.accumulate(stripe, u, v);
+            }
+            catch (...) {
+              errors[c] = std::current_exception();
+            }
+            }));
+    }
+    for (auto& w: workers) w.join();
+    for (auto& e: errors) if (e) std::rethrow_exception(e);
+  }
+
+  accumulator.finish();
 }
 
-void bob::ip::optflow::VanillaHornAndSchunckFlow::evalEb
-(const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
- const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
- blitz::Array<double,2>& error) const {
+int bob::ip::optflow::countLabels(const blitz::Array<int32_t,2>& labels) {
+  int32_t largest = -1;
+  for (int y=0; y<labels.extent(0); ++y)
+    for (int x=0; x<labels.extent(1); ++x)
+      largest = std::max(largest, labels(y,x));
+  return largest + 1;
+}
+
+bob::ip::optflow::HoofFeatures::HoofFeatures
+(const blitz::TinyVector<int,2>& shape, int cell, int bins, int block,
+ double epsilon):
+  cell(cell),
+  block(block),
+  epsilon(epsilon)
+{
+  if (bins < 1) {
+    boost::format m("the orientation histograms should have at least 1 bin, but you set it to %d");
+    m % bins;
+    throw std::runtime_error(m.str());
+  }
+  if (block < 1) {
+    boost::format m("blocks should have at least 1 cell, but you set it to %d");
+    m % block;
+    throw std::runtime_error(m.str());
+  }
+  if (!(epsilon > 0.)) {
+    boost::format m("the block normalization epsilon should be positive, but you set it to %g");
+    m % epsilon;
+    throw std::runtime_error(m.str());
+  }
+  blitz::TinyVector<int,2> n = blockShape(shape, cell);
+  cells.resize(n(0), n(1), bins);
+  blocks.resize(std::max(n(0) - block + 1, 0), std::max(n(1) - block + 1, 0),
+      block*block*bins);
+}
+
+/**
+ * Accumulates HoofFeatures from the flow of every pixel. Rows of cells are
+ * independent, so they can be accumulated in any order (or in parallel).
+ */
+class HoofAccumulator {
+
+  public:
+
+    HoofAccumulator(const blitz::TinyVector<int,2>& shape,
+        bob::ip::optflow::HoofFeatures& f):
+      m_shape(shape),
+      m_bins(f.cells.extent(2)),
+      m_scale(m_bins / (2*M_PI)),
+      m_f(f)
+    {
+      blitz::TinyVector<int,2> n = bob::ip::optflow::blockShape(shape, f.cell);
+      bob::core::array::assertSameShape(f.cells,
+          blitz::TinyVector<int,3>(n(0), n(1), m_bins));
+      bob::core::array::assertSameShape(f.blocks,
+          blitz::TinyVector<int,3>(std::max(n(0) - f.block + 1, 0),
+            std::max(n(1) - f.block + 1, 0), f.block*f.block*m_bins));
+      m_f.cells = 0.;
+    }
+
+    inline int rows() const { return m_f.cells.extent(0); }
+
+    void operator() (int y, int x, double, double, double u, double v) {
+      const double m = std::sqrt(u*u + v*v);
+      if (!(m > 0.)) return; //static, or NaN
+      m_f.cells(y / m_f.cell, x / m_f.cell, bin(u, v)) += m;
+    }
+
+    /**
+     * Accumulates a row of cells from complete flow fields, computing the
+     * magnitudes and bins of every image row in a contiguous pass first
+     */
+    void accumulate(int row, const blitz::Array<double,2>& u,
+        const blitz::Array<double,2>& v) {
+      const int width = m_shape(1);
+      std::vector<double> magnitude(width);
+      std::vector<int> bins(width);
+      const int last = std::min((row + 1)*m_f.cell, m_shape(0));
+      for (int y=row*m_f.cell; y<last; ++y) {
+        for (int x=0; x<width; ++x) {
+          magnitude[x] = std::sqrt(u(y,x)*u(y,x) + v(y,x)*v(y,x));
+          bins[x] = bin(u(y,x), v(y,x));
+        }
+        for (int x=0; x<width; ++x) {
+          if (magnitude[x] > 0.)
+            m_f.cells(row, x / m_f.cell, bins[x]) += magnitude[x];
+        }
+      }
+    }
+
+    /**
+     * Groups and normalizes cell histograms into blocks
+     */
+    void finish() {
+      const int block = m_f.block;
+      const double e2 = m_f.epsilon * m_f.epsilon;
+      for (int by=0; by<m_f.blocks.extent(0); ++by) {
+        for (int bx=0; bx<m_f.blocks.extent(1); ++bx) {
+          double norm = e2;
+          for (int j=0; j<block; ++j)
+            for (int i=0; i<block; ++i)
+              for (int b=0; b<m_bins; ++b)
+                norm += m_f.cells(by+j,bx+i,b) * m_f.cells(by+j,bx+i,b);
+          const double scale = 1. / std::sqrt(norm);
+          int k = 0;
+          for (int j=0; j<block; ++j)
+            for (int i=0; i<block; ++i)
+              for (int b=0; b<m_bins; ++b)
+                m_f.blocks(by,bx,k++) = m_f.cells(by+j,bx+i,b) * scale;
+        }
+      }
+    }
+
+  private:
+
+    inline int bin(double u, double v) const {
+      const int b = static_cast<int>((std::atan2(v, u) + M_PI) * m_scale);
+      return b < m_bins ? b : m_bins - 1; //atan2() may return +pi
+    }
+
+    blitz::TinyVector<int,2> m_shape;
+    int m_bins;
+    double m_scale;
+    bob::ip::optflow::HoofFeatures& m_f;
+
+};
+
+void bob::ip::optflow::hoof(const blitz::Array<double,2>& u,
+    const blitz::Array<double,2>& v, bob::ip::optflow::HoofFeatures& features,
+    size_t threads) {
 
-  bob::core::array::assertSameShape(i1, i2);
   bob::core::array::assertSameShape(u, v);
-  bob::core::array::assertSameShape(u, error);
-  bob::core::array::assertSameShape(error, m_u);
-  m_gradient(i1, i2, m_ex, m_ey, m_et);
-  error = m_ex*u + m_ey*v + m_et;
+  bob::ip::optflow::trace::Span span("hoof");
+
+  HoofAccumulator accumulator(u.shape(), features);
+  const int rows = accumulator.rows();
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  const int chunks = std::min<int>(threads, rows);
+
+  if (chunks <= 1) {
+    for (int row=0; row<rows; ++row) accumulator.accumulate(row, u, v);
+  }
+  else {
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> workers;
+    for (int c=0; c<chunks; ++c) {
+      const int first = (c * rows) / chunks;
+      const int last = ((c + 1) * rows) / chunks;
+      workers.push_back(std::thread([&, c, first, last]() {
+            try {
+              for (int row=first; row<last; ++row)
+                accumulator.accumulate(row, u, v);
+            }
+            catch (...) {
+              errors[c] = std::current_exception();
+            }
+            }));
+    }
+    for (auto& w: workers) w.join();
+    for (auto& e: errors) if (e) std::rethrow_exception(e);
+  }
 
+  accumulator.finish();
 }
 
-bob::ip::optflow::HornAndSchunckFlow::HornAndSchunckFlow
-(const blitz::TinyVector<int,2>& shape) :
+/**
+ * Thresholds the final estimates of every pixel into a motion mask, unpacked
+ * or packed in bits
+ */
+class MaskWriter {
+
+  public:
+
+    MaskWriter(const blitz::TinyVector<int,2>& shape, double threshold,
+        bool packed, blitz::Array<uint8_t,2>& mask):
+      m_threshold2(threshold*threshold),
+      m_packed(packed),
+      m_mask(mask)
+    {
+      if (threshold < 0.) {
+        boost::format m("motion threshold should be non-negative, but you set it to %g");
+        m % threshold;
+        throw std::runtime_error(m.str());
+      }
+      bob::core::array::assertSameShape(mask,
+          bob::ip::optflow::maskShape(shape, packed));
+      if (packed) m_mask = 0;
+    }
+
+    void operator() (int y, int x, double, double, double u, double v) {
+      const bool moving = u*u + v*v > m_threshold2;
+      if (!m_packed) m_mask(y,x) = moving;
+      else if (moving) m_mask(y, x >> 3) |= 0x80 >> (x & 7);
+    }
+
+  private:
+
+    double m_threshold2;
+    bool m_packed;
+    blitz::Array<uint8_t,2>& m_mask;
+
+};
+
+/**
+ * Returns the median of the given values, reordering them. With an even
+ * number of values, returns the mean of the middle two, like numpy.median().
+ */
+static double median(std::vector<double>& values) {
+  const size_t middle = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + middle, values.end());
+  const double upper = values[middle];
+  if (values.size() % 2) return upper;
+  const double lower = *std::max_element(values.begin(),
+      values.begin() + middle);
+  return (lower + upper) / 2.;
+}
+
+/**
+ * Pools the final estimates of every pixel over blocks. Pixels are seen in
+ * row-major order, so a row of blocks is complete (and reduced) once its
+ * last image row was seen: medians only keep one row of blocks at a time.
+ */
+class BlockPooler {
+
+  public:
+
+    BlockPooler(const blitz::TinyVector<int,2>& shape, int block,
+        bob::ip::optflow::BlockReduction reduction,
+        blitz::Array<double,2>& bu, blitz::Array<double,2>& bv):
+      m_shape(shape),
+      m_block(block),
+      m_reduction(reduction),
+      m_bu(bu),
+      m_bv(bv)
+    {
+      bob::core::array::assertSameShape(bu,
+          bob::ip::optflow::blockShape(shape, block));
+      bob::core::array::assertSameShape(bv, bu);
+      m_bu = 0.;
+      m_bv = 0.;
+      if (reduction == bob::ip::optflow::BlockMedian) {
+        m_u.resize(bu.extent(1));
+        m_v.resize(bu.extent(1));
+        for (size_t k=0; k<m_u.size(); ++k) {
+          m_u[k].reserve(block*block);
+          m_v[k].reserve(block*block);
+        }
+      }
+    }
+
+    void operator() (int y, int x, double, double, double u, double v) {
+      const int bx = x / m_block;
+      if (m_reduction == bob::ip::optflow::BlockMean) {
+        m_bu(y / m_block, bx) += u;
+        m_bv(y / m_block, bx) += v;
+      }
+      else {
+        m_u[bx].push_back(u);
+        m_v[bx].push_back(v);
+      }
+      if (x == m_shape(1) - 1 &&
+          ((y + 1) % m_block == 0 || y == m_shape(0) - 1))
+        reduce(y / m_block);
+    }
+
+  private:
+
+    /**
+     * Reduces a complete row of blocks
+     */
+    void reduce(int by) {
+      const int rows = std::min(m_block, m_shape(0) - by*m_block);
+      for (int bx=0; bx<m_bu.extent(1); ++bx) {
+        if (m_reduction == bob::ip::optflow::BlockMean) {
+          const double pixels = rows * std::min(m_block,
+              m_shape(1) - bx*m_block);
+          m_bu(by,bx) /= pixels;
+          m_bv(by,bx) /= pixels;
+        }
+        else {
+          m_bu(by,bx) = median(m_u[bx]);
+          m_bv(by,bx) = median(m_v[bx]);
+          m_u[bx].clear();
+          m_v[bx].clear();
+        }
+      }
+    }
+
+    blitz::TinyVector<int,2> m_shape;
+    int m_block;
+    bob::ip::optflow::BlockReduction m_reduction;
+    blitz::Array<double,2>& m_bu;
+    blitz::Array<double,2>& m_bv;
+    std::vector<std::vector<double> > m_u; ///< values of the current blocks
+    std::vector<std::vector<double> > m_v; ///< values of the current blocks
+
+};
+
+/**
+ * A rectangle of pixels, rows [y0, y1) and columns [x0, x1)
+ */
+struct Box {
+
+  int y0, x0, y1, x1;
+
+  bool empty() const { return y0 >= y1 || x0 >= x1; }
+
+  blitz::TinyVector<int,2> shape() const {
+    return blitz::TinyVector<int,2>(y1 - y0, x1 - x0);
+  }
+
+  /**
+   * The rows and columns of this box, on the image or within another box
+   */
+  blitz::Range rows() const { return blitz::Range(y0, y1 - 1); }
+
+  blitz::Range cols() const { return blitz::Range(x0, x1 - 1); }
+
+  blitz::Range rows(const Box& outer) const {
+    return blitz::Range(y0 - outer.y0, y1 - outer.y0 - 1);
+  }
+
+  blitz::Range cols(const Box& outer) const {
+    return blitz::Range(x0 - outer.x0, x1 - outer.x0 - 1);
+  }
+
+  /**
+   * This box grown by margin pixels on each side, clipped to the image
+   */
+  Box grow(int margin, const blitz::TinyVector<int,2>& shape) const {
+    Box retval = {std::max(0, y0 - margin), std::max(0, x0 - margin),
+      std::min(shape(0), y1 + margin), std::min(shape(1), x1 + margin)};
+    return retval;
+  }
+
+};
+
+/**
+ * Checks the regions and the halo for estimateRegions()
+ */
+static void check_regions(const std::vector<bob::ip::optflow::Region>& regions,
+    int halo) {
+  if (halo < 0) {
+    boost::format m("region halo should be non-negative, but you set it to %d");
+    m % halo;
+    throw std::runtime_error(m.str());
+  }
+  for (size_t k=0; k<regions.size(); ++k) {
+    if (regions[k](2) < 0 || regions[k](3) < 0) {
+      boost::format m("regions should have a non-negative height and width, but region %u is (%d, %d, %d, %d)");
+      m % k % regions[k](0) % regions[k](1) % regions[k](2) % regions[k](3);
+      throw std::runtime_error(m.str());
+    }
+  }
+}
+
+/**
+ * How far from a pixel the gradient operators read the images: 1 pixel for
+ * the kernels, plus 4 standard deviations if images are smoothed
+ */
+static int gradient_reach(double sigma) {
+  return 1 + (sigma > 0. ? static_cast<int>(std::ceil(4.*sigma)) : 0);
+}
+
+/**
+ * Runs the solver iterations on a region of the image only, starting from
+ * the estimates u_init and v_init. The region, grown by the halo, is
+ * updated, while the flow on the pixel ring around it is kept, as the
+ * boundary condition of the Laplacian. Gradients are evaluated by
+ * gradient(crop, ex, ey, et), on a crop of the images covering the reach of
+ * their operators. The updated pixels (or, if !with_halo, those of the
+ * region only) are written to u0 and v0, which may be u_init and v_init.
+ * Updates are the same computations as the array expressions in the solvers.
+ */
+template <typename L, typename F>
+static void solve_region(double a2, size_t iterations,
+    const bob::ip::optflow::Region& region, int halo, int reach, F gradient,
+    const blitz::Array<double,2>& u_init,
+    const blitz::Array<double,2>& v_init, bool with_halo,
+    blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) {
+
+  const blitz::TinyVector<int,2> shape = u0.shape();
+  const Box given = {region(0), region(1), region(0) + region(2),
+    region(1) + region(3)};
+  if (given.empty()) return;
+  const Box updated = given.grow(halo, shape);
+  if (updated.empty()) return; //outside the image
+  const Box window = updated.grow(1, shape);
+  const Box crop = window.grow(reach, shape);
+
+  blitz::Array<double,2> cex(crop.shape());
+  blitz::Array<double,2> cey(crop.shape());
+  blitz::Array<double,2> cet(crop.shape());
+  gradient(crop, cex, cey, cet);
+  const blitz::Range wy = window.rows(crop), wx = window.cols(crop);
+  blitz::Array<double,2> ex = cex(wy, wx);
+  blitz::Array<double,2> ey = cey(wy, wx);
+  blitz::Array<double,2> et = cet(wy, wx);
+
+  const blitz::Range ay = window.rows(), ax = window.cols();
+  blitz::Array<double,2> u(u_init(ay, ax).copy());
+  blitz::Array<double,2> v(v_init(ay, ax).copy());
+  blitz::Array<double,2> u_bar(window.shape());
+  blitz::Array<double,2> v_bar(window.shape());
+  blitz::Array<double,2> cterm(window.shape());
+
+  const blitz::Range ry = updated.rows(window), rx = updated.cols(window);
+  for (size_t i=0; i<iterations; ++i) {
+    L::apply(u, u_bar);
+    L::apply(v, v_bar);
+    cterm = (ex*u_bar + ey*v_bar + et) /
+      (blitz::pow2(ex) + blitz::pow2(ey) + a2);
+    u(ry, rx) = u_bar(ry, rx) - ex(ry, rx)*cterm(ry, rx);
+    v(ry, rx) = v_bar(ry, rx) - ey(ry, rx)*cterm(ry, rx);
+  }
+
+  const Box& output = with_halo ? updated : given;
+  const blitz::Range oy = output.rows(window), ox = output.cols(window);
+  const blitz::Range uy = output.rows(), ux = output.cols();
+  u0(uy, ux) = u(oy, ox);
+  v0(uy, ux) = v(oy, ox);
+
+}
+
+/**
+ * The number of images each family of gradients takes
+ */
+static int gradient_frames(const bob::ip::optflow::ForwardGradient&) {
+  return 2;
+}
+
+static int gradient_frames(const bob::ip::optflow::CentralGradient&) {
+  return 3;
+}
+
+/**
+ * Evaluates a gradient on frames, which should be as many as it takes
+ */
+static void evaluate_gradient(const bob::ip::optflow::ForwardGradient& g,
+    const bob::ip::optflow::Frames& frames, blitz::Array<double,2>& ex,
+    blitz::Array<double,2>& ey, blitz::Array<double,2>& et) {
+  g(*frames.image[0], *frames.image[1], ex, ey, et);
+}
+
+static void evaluate_gradient(const bob::ip::optflow::CentralGradient& g,
+    const bob::ip::optflow::Frames& frames, blitz::Array<double,2>& ex,
+    blitz::Array<double,2>& ey, blitz::Array<double,2>& et) {
+  g(*frames.image[0], *frames.image[1], *frames.image[2], ex, ey, et);
+}
+
+/**
+ * Evaluates the gradients of type G, with the given smoothing, on crops of
+ * the frames, for solve_region()
+ */
+template <typename G>
+struct CropGradient {
+
+  const bob::ip::optflow::Frames& frames;
+  double sigma;
+
+  void operator()(const Box& crop, blitz::Array<double,2>& ex,
+      blitz::Array<double,2>& ey, blitz::Array<double,2>& et) const {
+    const blitz::Range y = crop.rows(), x = crop.cols();
+    blitz::Array<double,2> c[3];
+    for (int k=0; k<frames.size; ++k) {
+      c[k].resize(crop.shape());
+      c[k] = (*frames.image[k])(y, x);
+    }
+    const bob::ip::optflow::Frames cropped = (frames.size == 2) ?
+      bob::ip::optflow::Frames(c[0], c[1]) :
+      bob::ip::optflow::Frames(c[0], c[1], c[2]);
+    G g(crop.shape());
+    g.setSigma(sigma);
+    evaluate_gradient(g, cropped, ex, ey, et);
+  }
+
+};
+
+bob::ip::optflow::FlowSolver::~FlowSolver() { }
+
+template <typename G, typename L>
+bob::ip::optflow::HornAndSchunckSolver<G,L>::HornAndSchunckSolver
+(const blitz::TinyVector<int,2>& shape, const std::string& name) :
+  m_name(name),
   m_gradient(shape),
   m_ex(shape),
   m_ey(shape),
@@ -124,9 +1092,11 @@ bob::ip::optflow::HornAndSchunckFlow::HornAndSchunckFlow
 {
 }
 
-bob::ip::optflow::HornAndSchunckFlow::~HornAndSchunckFlow() { }
+template <typename G, typename L>
+bob::ip::optflow::HornAndSchunckSolver<G,L>::~HornAndSchunckSolver() { }
 
-void bob::ip::optflow::HornAndSchunckFlow::setShape
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::setShape
 (const blitz::TinyVector<int,2>& shape) {
   m_gradient.setShape(shape);
   m_ex.resize(shape);
@@ -137,22 +1107,48 @@ void bob::ip::optflow::HornAndSchunckFlow::setShape
   m_cterm.resize(shape);
 }
 
-void bob::ip::optflow::HornAndSchunckFlow::operator() (double alpha,
-    size_t iterations, const blitz::Array<double,2>& i1,
-    const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
-    blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const {
+template <typename G, typename L>
+int bob::ip::optflow::HornAndSchunckSolver<G,L>::getFrames() const {
+  return gradient_frames(m_gradient);
+}
 
-  bob::core::array::assertSameShape(i1, i2);
-  bob::core::array::assertSameShape(i2, i3);
-  bob::core::array::assertSameShape(i1, m_ex);
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::check
+(const bob::ip::optflow::Frames& frames, const blitz::Array<double,2>& u0,
+ const blitz::Array<double,2>& v0) const {
+  if (frames.size != getFrames()) {
+    boost::format m("%s estimates the flow from %d images, but you gave %d");
+    m % m_name % getFrames() % frames.size;
+    throw std::runtime_error(m.str());
+  }
+  for (int k=0; k<frames.size; ++k)
+    bob::core::array::assertSameShape(*frames.image[k], m_ex);
   bob::core::array::assertSameShape(u0, m_u);
   bob::core::array::assertSameShape(v0, m_v);
+}
+
+template <typename G, typename L>
+const char* bob::ip::optflow::HornAndSchunckSolver<G,L>::span
+(const char* method) const {
+  if (!bob::ip::optflow::trace::enabled()) return 0;
+  return bob::ip::optflow::trace::intern(m_name + "." + method);
+}
 
-  m_gradient(i1, i2, i3, m_ex, m_ey, m_et);
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::operator() (double alpha,
+    size_t iterations, const bob::ip::optflow::Frames& frames,
+    blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate"));
+
+  check(frames, u0, v0);
+
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
   double a2 = std::pow(alpha, 2);
   for (size_t i=0; i<iterations; ++i) {
-    bob::ip::optflow::laplacian_avg_hs_opencv(u0, m_u);
-    bob::ip::optflow::laplacian_avg_hs_opencv(v0, m_v);
+    bob::ip::optflow::trace::Span iteration("iteration");
+    L::apply(u0, m_u);
+    L::apply(v0, m_v);
     m_cterm = (m_ex*m_u + m_ey*m_v + m_et) /
       (blitz::pow2(m_ex) + blitz::pow2(m_ey) + a2);
     u0 = m_u - m_ex*m_cterm;
@@ -160,7 +1156,215 @@ void bob::ip::optflow::HornAndSchunckFlow::operator() (double alpha,
   }
 }
 
-void bob::ip::optflow::HornAndSchunckFlow::evalEc2
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateGradients
+(double alpha, size_t iterations, const blitz::Array<int16_t,2>& ex,
+ const blitz::Array<int16_t,2>& ey, const blitz::Array<int16_t,2>& et,
+ double scale, blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_gradients"));
+
+  if (!(scale > 0.)) {
+    boost::format m("the scale of the gradients should be positive, but you set it to %g");
+    m % scale;
+    throw std::runtime_error(m.str());
+  }
+  bob::core::array::assertSameShape(ex, m_ex);
+  bob::core::array::assertSameShape(ey, m_ex);
+  bob::core::array::assertSameShape(et, m_ex);
+  bob::core::array::assertSameShape(u0, m_u);
+  bob::core::array::assertSameShape(v0, m_v);
+
+  // With gradients scale*G, every update only depends on alpha/scale
+  m_ex = blitz::cast<double>(ex);
+  m_ey = blitz::cast<double>(ey);
+  m_et = blitz::cast<double>(et);
+  double a2 = std::pow(alpha / scale, 2);
+  for (size_t i=0; i<iterations; ++i) {
+    bob::ip::optflow::trace::Span iteration("iteration");
+    L::apply(u0, m_u);
+    L::apply(v0, m_v);
+    m_cterm = (m_ex*m_u + m_ey*m_v + m_et) /
+      (blitz::pow2(m_ex) + blitz::pow2(m_ey) + a2);
+    u0 = m_u - m_ex*m_cterm;
+    v0 = m_v - m_ey*m_cterm;
+  }
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateConvergence
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ blitz::Array<double,2>& u0, blitz::Array<double,2>& v0, double threshold,
+ int block, blitz::Array<int32_t,2>& last,
+ blitz::Array<double,2>& magnitude) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_convergence"));
+
+  check(frames, u0, v0);
+  blitz::TinyVector<int,2> shape = blockShape(m_ex.shape(), block);
+  bob::core::array::assertSameShape(last, shape);
+  bob::core::array::assertSameShape(magnitude, shape);
+
+  ConvergenceTracker tracker(threshold, block, last, magnitude);
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
+  double a2 = std::pow(alpha, 2);
+  for (size_t i=0; i<iterations; ++i) {
+    bob::ip::optflow::trace::Span iteration("iteration");
+    L::apply(u0, m_u);
+    L::apply(v0, m_v);
+    tracker.next(i+1 == iterations);
+    fused_update(a2, m_ex, m_ey, m_et, m_u, m_v, u0, v0, tracker);
+  }
+  tracker.finish();
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateStatistics
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+ bob::ip::optflow::FlowStatistics& statistics) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_statistics"));
+
+  check(frames, u0, v0);
+
+  StatisticsAccumulator accumulator(m_ex.shape(), statistics);
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
+  solve_with_epilogue<L>(std::pow(alpha, 2), iterations, m_ex, m_ey, m_et,
+      m_u, m_v, m_cterm, u0, v0, accumulator);
+  accumulator.finish();
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateLabelStatistics
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+ const blitz::Array<int32_t,2>& labels,
+ bob::ip::optflow::LabelStatistics& statistics) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_label_statistics"));
+
+  check(frames, u0, v0);
+
+  LabelAccumulator accumulator(m_ex.shape(), labels, statistics);
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
+  solve_with_epilogue<L>(std::pow(alpha, 2), iterations, m_ex, m_ey, m_et,
+      m_u, m_v, m_cterm, u0, v0, accumulator);
+  accumulator.finish();
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateHoof
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+ bob::ip::optflow::HoofFeatures& features) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_hoof"));
+
+  check(frames, u0, v0);
+
+  HoofAccumulator accumulator(m_ex.shape(), features);
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
+  solve_with_epilogue<L>(std::pow(alpha, 2), iterations, m_ex, m_ey, m_et,
+      m_u, m_v, m_cterm, u0, v0, accumulator);
+  accumulator.finish();
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateMask
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+ double threshold, bool packed, blitz::Array<uint8_t,2>& mask) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_mask"));
+
+  check(frames, u0, v0);
+
+  MaskWriter writer(m_ex.shape(), threshold, packed, mask);
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
+  solve_with_epilogue<L>(std::pow(alpha, 2), iterations, m_ex, m_ey, m_et,
+      m_u, m_v, m_cterm, u0, v0, writer);
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateMask
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ double threshold, bool packed, blitz::Array<uint8_t,2>& mask) const {
+  zero_flow(m_ex.shape(), m_u0, m_v0);
+  estimateMask(alpha, iterations, frames, m_u0, m_v0, threshold, packed,
+      mask);
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateBlocks
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+ int block, bob::ip::optflow::BlockReduction reduction,
+ blitz::Array<double,2>& bu, blitz::Array<double,2>& bv) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_blocks"));
+
+  check(frames, u0, v0);
+
+  BlockPooler pooler(m_ex.shape(), block, reduction, bu, bv);
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
+  solve_with_epilogue<L>(std::pow(alpha, 2), iterations, m_ex, m_ey, m_et,
+      m_u, m_v, m_cterm, u0, v0, pooler);
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateBlocks
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ int block, bob::ip::optflow::BlockReduction reduction,
+ blitz::Array<double,2>& bu, blitz::Array<double,2>& bv) const {
+  zero_flow(m_ex.shape(), m_u0, m_v0);
+  estimateBlocks(alpha, iterations, frames, m_u0, m_v0, block, reduction, bu,
+      bv);
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateRegions
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+ const std::vector<bob::ip::optflow::Region>& regions, int halo) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_regions"));
+
+  check(frames, u0, v0);
+  check_regions(regions, halo);
+
+  const double sigma = m_gradient.getSigma();
+  const CropGradient<G> gradient = {frames, sigma};
+  const double a2 = std::pow(alpha, 2);
+  for (size_t k=0; k<regions.size(); ++k) {
+    bob::ip::optflow::trace::Span region("region");
+    solve_region<L>(a2, iterations, regions[k], halo, gradient_reach(sigma),
+        gradient, u0, v0, true, u0, v0);
+  }
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::estimateTile
+(double alpha, size_t iterations, const bob::ip::optflow::Frames& frames,
+ const blitz::Array<double,2>& u_init, const blitz::Array<double,2>& v_init,
+ const bob::ip::optflow::Region& tile, int halo, blitz::Array<double,2>& u0,
+ blitz::Array<double,2>& v0) const {
+
+  bob::ip::optflow::trace::Span span(this->span("estimate_tile"));
+
+  check(frames, u0, v0);
+  bob::core::array::assertSameShape(u_init, u0);
+  bob::core::array::assertSameShape(v_init, v0);
+  check_regions(std::vector<bob::ip::optflow::Region>(1, tile), halo);
+
+  const double sigma = m_gradient.getSigma();
+  const CropGradient<G> gradient = {frames, sigma};
+  solve_region<L>(std::pow(alpha, 2), iterations, tile, halo,
+      gradient_reach(sigma), gradient, u_init, v_init, false, u0, v0);
+}
+
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::evalEc2
 (const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
  blitz::Array<double,2>& error) const {
 
@@ -168,28 +1372,102 @@ void bob::ip::optflow::HornAndSchunckFlow::evalEc2
   bob::core::array::assertSameShape(u, error);
   bob::core::array::assertSameShape(u, m_u);
 
-  laplacian_avg_hs_opencv(u, m_u);
-  laplacian_avg_hs_opencv(v, m_u);
+  L::apply(u, m_u);
+  L::apply(v, m_u);
   error = blitz::pow2(m_u - u) + blitz::pow2(m_v - v);
 
 }
 
-void bob::ip::optflow::HornAndSchunckFlow::evalEb
-(const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
- const blitz::Array<double,2>& i3, const blitz::Array<double,2>& u,
+template <typename G, typename L>
+void bob::ip::optflow::HornAndSchunckSolver<G,L>::evalEb
+(const bob::ip::optflow::Frames& frames, const blitz::Array<double,2>& u,
  const blitz::Array<double,2>& v, blitz::Array<double,2>& error) const {
 
-  bob::core::array::assertSameShape(i1, i2);
-  bob::core::array::assertSameShape(i2, i3);
-  bob::core::array::assertSameShape(u, v);
+  check(frames, u, v);
   bob::core::array::assertSameShape(u, error);
-  bob::core::array::assertSameShape(error, m_u);
 
-  m_gradient(i1, i2, i3, m_ex, m_ey, m_et);
+  evaluate_gradient(m_gradient, frames, m_ex, m_ey, m_et);
   error = m_ex*u + m_ey*v + m_et;
 
 }
 
+bob::ip::optflow::VanillaHornAndSchunckFlow::VanillaHornAndSchunckFlow
+(const blitz::TinyVector<int,2>& shape) :
+  HornAndSchunckSolver(shape, "VanillaFlow")
+{
+}
+
+bob::ip::optflow::VanillaHornAndSchunckFlow::~VanillaHornAndSchunckFlow() { }
+
+bob::ip::optflow::HornAndSchunckFlow::HornAndSchunckFlow
+(const blitz::TinyVector<int,2>& shape) :
+  HornAndSchunckSolver(shape, "Flow")
+{
+}
+
+bob::ip::optflow::HornAndSchunckFlow::~HornAndSchunckFlow() { }
+
+/**
+ * Creates a solver with the given gradient and the named Laplacian
+ */
+template <typename G>
+static bob::ip::optflow::FlowSolver* create_solver
+(const std::string& laplacian, const blitz::TinyVector<int,2>& shape) {
+  if (laplacian == "hs")
+    return new bob::ip::optflow::HornAndSchunckSolver<G,
+      bob::ip::optflow::HornAndSchunckLaplacian>(shape);
+  if (laplacian == "opencv")
+    return new bob::ip::optflow::HornAndSchunckSolver<G,
+      bob::ip::optflow::OpenCVLaplacian>(shape);
+  boost::format m("unknown Laplacian `%s' - choose between `hs' and `opencv'");
+  m % laplacian;
+  throw std::runtime_error(m.str());
+}
+
+bob::ip::optflow::FlowSolver* bob::ip::optflow::createSolver
+(const std::string& gradient, const std::string& laplacian,
+ const blitz::TinyVector<int,2>& shape) {
+  if (gradient == "hs")
+    return create_solver<bob::ip::optflow::HornAndSchunckGradient>(laplacian,
+        shape);
+  if (gradient == "sobel")
+    return create_solver<bob::ip::optflow::SobelGradient>(laplacian, shape);
+  if (gradient == "prewitt")
+    return create_solver<bob::ip::optflow::PrewittGradient>(laplacian, shape);
+  if (gradient == "isotropic")
+    return create_solver<bob::ip::optflow::IsotropicGradient>(laplacian,
+        shape);
+  boost::format m("unknown gradient `%s' - choose between `hs', `sobel', `prewitt' and `isotropic'");
+  m % gradient;
+  throw std::runtime_error(m.str());
+}
+
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::HornAndSchunckGradient,
+  bob::ip::optflow::HornAndSchunckLaplacian>;
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::HornAndSchunckGradient,
+  bob::ip::optflow::OpenCVLaplacian>;
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::SobelGradient,
+  bob::ip::optflow::HornAndSchunckLaplacian>;
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::SobelGradient,
+  bob::ip::optflow::OpenCVLaplacian>;
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::PrewittGradient,
+  bob::ip::optflow::HornAndSchunckLaplacian>;
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::PrewittGradient,
+  bob::ip::optflow::OpenCVLaplacian>;
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::IsotropicGradient,
+  bob::ip::optflow::HornAndSchunckLaplacian>;
+template class bob::ip::optflow::HornAndSchunckSolver<
+  bob::ip::optflow::IsotropicGradient,
+  bob::ip::optflow::OpenCVLaplacian>;
+
+
 void bob::ip::optflow::flowError (const blitz::Array<double,2>& i1,
     const blitz::Array<double,2>& i2, const blitz::Array<double,2>& u,
     const blitz::Array<double,2>& v, blitz::Array<double,2>& error) {
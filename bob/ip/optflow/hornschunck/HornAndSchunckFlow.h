@@ -12,6 +12,8 @@
 
 #include <cstdlib>
 #include <stdint.h>
+#include <string>
+#include <vector>
 #include <blitz/array.h>
 #include "SpatioTemporalGradient.h"
 
@@ -56,6 +58,712 @@ namespace bob { namespace ip { namespace optflow {
   void laplacian_avg_hs(const blitz::Array<double,2>& input,
       blitz::Array<double,2>& output);
 
+  /**
+   * Smoothness stencil of the Horn & Schunck paper, as a policy for
+   * HornAndSchunckSolver: apply() averages the flow with laplacian_avg_hs()
+   */
+  struct HornAndSchunckLaplacian {
+    static inline void apply(const blitz::Array<double,2>& input,
+        blitz::Array<double,2>& output) {
+      laplacian_avg_hs(input, output);
+    }
+  };
+
+  /**
+   * Smoothness stencil of OpenCV, as a policy for HornAndSchunckSolver:
+   * apply() averages the flow with laplacian_avg_hs_opencv()
+   */
+  struct OpenCVLaplacian {
+    static inline void apply(const blitz::Array<double,2>& input,
+        blitz::Array<double,2>& output) {
+      laplacian_avg_hs_opencv(input, output);
+    }
+  };
+
+  /**
+   * Summary statistics of an estimated flow field, for the whole frame and
+   * for each tile of tile x tile pixels (partial tiles on the right and
+   * bottom borders included). The solvers fill them in the update loop of
+   * their final iteration, so no further pass over u and v is required.
+   *
+   * For a pixel with flow (u, v), the magnitude is sqrt(u^2 + v^2) and the
+   * motion energy is u^2 + v^2. Means are taken over all pixels. The
+   * direction histogram has bins of equal width over the angle atan2(v, u),
+   * starting at -pi, and accumulates the magnitude of every pixel on the bin
+   * of its direction (so static pixels do not count).
+   */
+  struct FlowStatistics {
+
+    /**
+     * Allocates statistics for images with the given shape
+     */
+    FlowStatistics(const blitz::TinyVector<int,2>& shape, int tile,
+        int bins);
+
+    int tile; ///< tile size, in pixels
+    double mean; ///< mean magnitude
+    double max; ///< maximum magnitude
+    double energy; ///< mean motion energy
+    blitz::Array<double,1> histogram; ///< direction histogram, (bins)
+    blitz::Array<double,2> tileMean; ///< per tile, shape of blockShape()
+    blitz::Array<double,2> tileMax; ///< per tile, shape of blockShape()
+    blitz::Array<double,2> tileEnergy; ///< per tile, shape of blockShape()
+    blitz::Array<double,3> tileHistogram; ///< per tile, (tiles_y, tiles_x, bins)
+
+  };
+
+  /**
+   * Statistics of a flow field per label of a label image (e.g., the
+   * segments of a segmentation), for labels 0 to labels-1: pixels with other
+   * labels are ignored. For every label: the number of pixels, the mean flow
+   * (u, v), its covariance (normalized by the number of pixels) and a
+   * histogram counting the pixels of every magnitude sqrt(u^2 + v^2), with
+   * bins of equal width over [0, range) (larger magnitudes count in the
+   * last bin). Labels without pixels have all statistics set to zero.
+   *
+   * Moments are accumulated separately over stripes of 64 rows (more with
+   * many labels, so the partial moments of all stripes stay within 32 MiB),
+   * then merged in order, so results do not depend on how stripes are
+   * shared between threads.
+   */
+  struct LabelStatistics {
+
+    /**
+     * Allocates statistics for the given number of labels
+     */
+    LabelStatistics(int labels, int bins, double range);
+
+    double range; ///< the upper limit of the magnitude histogram
+    blitz::Array<int64_t,1> count; ///< pixels, (labels)
+    blitz::Array<double,2> mean; ///< (labels, 2), u then v
+    blitz::Array<double,3> covariance; ///< (labels, 2, 2)
+    blitz::Array<int64_t,2> histogram; ///< magnitudes, (labels, bins)
+
+  };
+
+  /**
+   * Computes the statistics of the flow (u, v) per label, with stripes of
+   * rows processed in parallel by the given number of threads (0 means one
+   * per core). The statistics must have been allocated already.
+   */
+  void labelStatistics(const blitz::Array<double,2>& u,
+      const blitz::Array<double,2>& v, const blitz::Array<int32_t,2>& labels,
+      LabelStatistics& statistics, size_t threads=1);
+
+  /**
+   * Returns the number of labels of a label image: its largest label plus
+   * one, or 0 if it has no non-negative labels
+   */
+  int countLabels(const blitz::Array<int32_t,2>& labels);
+
+  /**
+   * Histograms of oriented optical flow (HOOF), for action recognition. The
+   * flow field is divided in cells of cell x cell pixels (partial cells on
+   * the right and bottom borders included) and every pixel adds its
+   * magnitude sqrt(u^2 + v^2) to the bin of its direction atan2(v, u) in
+   * the histogram of its cell, with bins of equal width starting at -pi
+   * (static pixels do not count).
+   *
+   * Cell histograms are then grouped in overlapping blocks of block x block
+   * cells, with a stride of one cell, and the histograms of every block are
+   * concatenated (cell rows, then cell columns, then bins) and normalized
+   * to unit L2 norm: each value is divided by sqrt(||h||^2 + epsilon^2), so
+   * blocks with little motion are not amplified.
+   */
+  struct HoofFeatures {
+
+    /**
+     * Allocates features for flow fields with the given shape
+     */
+    HoofFeatures(const blitz::TinyVector<int,2>& shape, int cell, int bins,
+        int block, double epsilon);
+
+    int cell; ///< cell size, in pixels
+    int block; ///< block size, in cells
+    double epsilon; ///< regularizes the block norms
+    blitz::Array<double,3> cells; ///< (cells_y, cells_x, bins)
+    blitz::Array<double,3> blocks; ///< (blocks_y, blocks_x, block*block*bins)
+
+  };
+
+  /**
+   * Computes the HOOF features of the flow (u, v), with rows of cells
+   * processed in parallel by the given number of threads (0 means one per
+   * core). The features must have been allocated already.
+   */
+  void hoof(const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+      HoofFeatures& features, size_t threads=1);
+
+  /**
+   * How the flow vectors of a block are pooled into a single one
+   */
+  typedef enum BlockReduction {
+    BlockMean = 0, ///< mean of u and v, separately
+    BlockMedian ///< median of u and v, separately (mean of the middle two)
+  } BlockReduction;
+
+  /**
+   * A rectangle of pixels: (y, x, height, width), with (y, x) its top-left
+   * corner
+   */
+  typedef blitz::TinyVector<int,4> Region;
+
+  /**
+   * The images the flow is estimated from: 2 (from i1 to i2) or 3 (leading
+   * to i2). Only points to them, so they must outlive it.
+   */
+  struct Frames {
+
+    Frames(const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2):
+      size(2)
+    {
+      image[0] = &i1; image[1] = &i2; image[2] = 0;
+    }
+
+    Frames(const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+        const blitz::Array<double,2>& i3):
+      size(3)
+    {
+      image[0] = &i1; image[1] = &i2; image[2] = &i3;
+    }
+
+    int size; ///< number of images
+    const blitz::Array<double,2>* image[3]; ///< the images, in time order
+
+  };
+
+  /**
+   * The interface of all Horn & Schunck solvers (see
+   * VanillaHornAndSchunckFlow for the method), so the gradient and the
+   * Laplacian may be chosen at run time. Every method taking Frames also
+   * comes in flavours taking the 2 or 3 images directly. Solvers whose
+   * gradient needs another number of images throw.
+   */
+  class FlowSolver {
+
+    public: //api
+
+      /**
+       * Virtual destructor
+       */
+      virtual ~FlowSolver();
+
+      /**
+       * Returns the current shape supported
+       */
+      virtual const blitz::TinyVector<int,2>& getShape() const =0;
+
+      /**
+       * Re-shape internal buffers
+       */
+      virtual void setShape(const blitz::TinyVector<int,2>& shape) =0;
+
+      /**
+       * Gets the standard deviation of the Gaussian smoothing applied to the
+       * input images, or 0 if they are not smoothed
+       */
+      virtual double getSigma() const =0;
+
+      /**
+       * Sets the standard deviation (in pixels) of a Gaussian smoothing
+       * applied to the input images by the gradient, or 0 to disable it
+       */
+      virtual void setSigma(double sigma) =0;
+
+      /**
+       * The number of images the gradient takes: 2 or 3
+       */
+      virtual int getFrames() const =0;
+
+      /**
+       * Calculates the square of the smoothness error (Ec^2) by using the
+       * formula described in the paper:
+       *
+       * Ec^2 = (u_bar - u)^2 + (v_bar - v)^2
+       *
+       * Sets the input matrix with the discrete values.
+       */
+      virtual void evalEc2 (const blitz::Array<double,2>& u,
+          const blitz::Array<double,2>& v,
+          blitz::Array<double,2>& error) const =0;
+
+      /**
+       * Calculates the brightness error (Eb) as defined in the paper:
+       *
+       * Eb = (Ex*u + Ey*v + Et)
+       *
+       * Sets the input matrix with the discrete values
+       */
+      virtual void evalEb (const Frames& frames,
+          const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+          blitz::Array<double,2>& error) const =0;
+
+      inline void evalEb (const blitz::Array<double,2>& i1,
+          const blitz::Array<double,2>& i2, const blitz::Array<double,2>& u,
+          const blitz::Array<double,2>& v, blitz::Array<double,2>& error) const {
+        evalEb(Frames(i1, i2), u, v, error);
+      }
+
+      inline void evalEb (const blitz::Array<double,2>& i1,
+          const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
+          const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+          blitz::Array<double,2>& error) const {
+        evalEb(Frames(i1, i2, i3), u, v, error);
+      }
+
+      /**
+       * Call this to evaluate the flow
+       */
+      virtual void operator() (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0) const =0;
+
+      inline void operator() (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const {
+        operator()(alpha, iterations, Frames(i1, i2), u0, v0);
+      }
+
+      inline void operator() (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0) const {
+        operator()(alpha, iterations, Frames(i1, i2, i3), u0, v0);
+      }
+
+      /**
+       * Evaluates the flow like operator(), from gradients evaluated
+       * beforehand in integers (see IntegerGradient). The gradients of the
+       * images are scale times the given ones, a factor folded into the
+       * regularization (alpha/scale), so the flow is that of the scaled
+       * gradients. The gradient of the solver, and its smoothing, are not
+       * used.
+       */
+      virtual void estimateGradients (double alpha, size_t iterations,
+          const blitz::Array<int16_t,2>& ex, const blitz::Array<int16_t,2>& ey,
+          const blitz::Array<int16_t,2>& et, double scale,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const =0;
+
+      /**
+       * Evaluates the flow like operator(), while keeping track of where in
+       * the image the estimate keeps changing. The image is divided in
+       * blocks of block x block pixels. For every block, last is set to the
+       * last iteration (counting from 1) in which the update magnitude
+       * sqrt(du^2 + dv^2) of any of its pixels exceeded the threshold (or 0
+       * if it never did) and magnitude to the largest update magnitude of
+       * the final iteration. Both must have shape (ceil(height/block),
+       * ceil(width/block)).
+       */
+      virtual void estimateConvergence (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, double threshold, int block,
+          blitz::Array<int32_t,2>& last,
+          blitz::Array<double,2>& magnitude) const =0;
+
+      inline void estimateConvergence (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          double threshold, int block, blitz::Array<int32_t,2>& last,
+          blitz::Array<double,2>& magnitude) const {
+        estimateConvergence(alpha, iterations, Frames(i1, i2), u0, v0,
+            threshold, block, last, magnitude);
+      }
+
+      inline void estimateConvergence (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          double threshold, int block, blitz::Array<int32_t,2>& last,
+          blitz::Array<double,2>& magnitude) const {
+        estimateConvergence(alpha, iterations, Frames(i1, i2, i3), u0, v0,
+            threshold, block, last, magnitude);
+      }
+
+      /**
+       * Evaluates the flow like operator(), computing summary statistics of
+       * the result while doing so. The statistics must have been allocated
+       * for the shape of this solver.
+       */
+      virtual void estimateStatistics (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, FlowStatistics& statistics) const =0;
+
+      inline void estimateStatistics (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          FlowStatistics& statistics) const {
+        estimateStatistics(alpha, iterations, Frames(i1, i2), u0, v0,
+            statistics);
+      }
+
+      inline void estimateStatistics (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          FlowStatistics& statistics) const {
+        estimateStatistics(alpha, iterations, Frames(i1, i2, i3), u0, v0,
+            statistics);
+      }
+
+      /**
+       * Evaluates the flow like operator(), computing its statistics per
+       * label of a label image (with the solver shape) while doing so. The
+       * statistics must have been allocated already.
+       */
+      virtual void estimateLabelStatistics (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, const blitz::Array<int32_t,2>& labels,
+          LabelStatistics& statistics) const =0;
+
+      inline void estimateLabelStatistics (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          const blitz::Array<int32_t,2>& labels,
+          LabelStatistics& statistics) const {
+        estimateLabelStatistics(alpha, iterations, Frames(i1, i2), u0, v0,
+            labels, statistics);
+      }
+
+      inline void estimateLabelStatistics (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          const blitz::Array<int32_t,2>& labels,
+          LabelStatistics& statistics) const {
+        estimateLabelStatistics(alpha, iterations, Frames(i1, i2, i3), u0, v0,
+            labels, statistics);
+      }
+
+      /**
+       * Evaluates the flow like operator(), computing its HOOF features
+       * while doing so. The features must have been allocated already, for
+       * the solver shape.
+       */
+      virtual void estimateHoof (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, HoofFeatures& features) const =0;
+
+      inline void estimateHoof (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          HoofFeatures& features) const {
+        estimateHoof(alpha, iterations, Frames(i1, i2), u0, v0, features);
+      }
+
+      inline void estimateHoof (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          HoofFeatures& features) const {
+        estimateHoof(alpha, iterations, Frames(i1, i2, i3), u0, v0, features);
+      }
+
+      /**
+       * Evaluates the flow like operator(), thresholding its magnitude in
+       * the update loop of the final iteration. A pixel is moving if
+       * sqrt(u^2 + v^2) > threshold. If packed is false, mask is set to 1
+       * for moving pixels and 0 otherwise, and must have the solver shape.
+       * Otherwise, each row of the mask is packed in bits, most significant
+       * bit first (as numpy.packbits(mask, axis=1) would), and mask must
+       * have the shape returned by maskShape().
+       */
+      virtual void estimateMask (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, double threshold, bool packed,
+          blitz::Array<uint8_t,2>& mask) const =0;
+
+      inline void estimateMask (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          double threshold, bool packed, blitz::Array<uint8_t,2>& mask) const {
+        estimateMask(alpha, iterations, Frames(i1, i2), u0, v0, threshold,
+            packed, mask);
+      }
+
+      inline void estimateMask (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          double threshold, bool packed, blitz::Array<uint8_t,2>& mask) const {
+        estimateMask(alpha, iterations, Frames(i1, i2, i3), u0, v0, threshold,
+            packed, mask);
+      }
+
+      /**
+       * Like the above, but estimates the flow from zero on internal buffers
+       * that are allocated once, for callers that only need the mask
+       */
+      virtual void estimateMask (double alpha, size_t iterations,
+          const Frames& frames, double threshold, bool packed,
+          blitz::Array<uint8_t,2>& mask) const =0;
+
+      inline void estimateMask (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          double threshold, bool packed, blitz::Array<uint8_t,2>& mask) const {
+        estimateMask(alpha, iterations, Frames(i1, i2), threshold, packed,
+            mask);
+      }
+
+      inline void estimateMask (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          double threshold, bool packed, blitz::Array<uint8_t,2>& mask) const {
+        estimateMask(alpha, iterations, Frames(i1, i2, i3), threshold, packed,
+            mask);
+      }
+
+      /**
+       * Evaluates the flow like operator(), pooling it over blocks of block x
+       * block pixels (partial blocks on the right and bottom borders
+       * included) in the update loop of the final iteration. bu and bv
+       * should have the shape returned by blockShape().
+       */
+      virtual void estimateBlocks (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, int block, BlockReduction reduction,
+          blitz::Array<double,2>& bu, blitz::Array<double,2>& bv) const =0;
+
+      inline void estimateBlocks (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          int block, BlockReduction reduction, blitz::Array<double,2>& bu,
+          blitz::Array<double,2>& bv) const {
+        estimateBlocks(alpha, iterations, Frames(i1, i2), u0, v0, block,
+            reduction, bu, bv);
+      }
+
+      inline void estimateBlocks (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          int block, BlockReduction reduction, blitz::Array<double,2>& bu,
+          blitz::Array<double,2>& bv) const {
+        estimateBlocks(alpha, iterations, Frames(i1, i2, i3), u0, v0, block,
+            reduction, bu, bv);
+      }
+
+      /**
+       * Like the above, but estimates the flow from zero on internal buffers
+       * that are allocated once, for callers that only need the blocks
+       */
+      virtual void estimateBlocks (double alpha, size_t iterations,
+          const Frames& frames, int block, BlockReduction reduction,
+          blitz::Array<double,2>& bu, blitz::Array<double,2>& bv) const =0;
+
+      inline void estimateBlocks (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          int block, BlockReduction reduction, blitz::Array<double,2>& bu,
+          blitz::Array<double,2>& bv) const {
+        estimateBlocks(alpha, iterations, Frames(i1, i2), block, reduction,
+            bu, bv);
+      }
+
+      inline void estimateBlocks (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          int block, BlockReduction reduction, blitz::Array<double,2>& bu,
+          blitz::Array<double,2>& bv) const {
+        estimateBlocks(alpha, iterations, Frames(i1, i2, i3), block,
+            reduction, bu, bv);
+      }
+
+      /**
+       * Re-estimates the flow in the given regions only, for sequences in
+       * which little changes between frames. u0 and v0 should hold the
+       * previous estimates. Every region, grown by halo pixels on each side
+       * and clipped to the image, is updated like operator() would, while
+       * the flow around it is kept as the boundary condition. Gradients are
+       * only evaluated around the regions, so the cost is proportional to
+       * their area rather than to the image size. Regions are processed in
+       * order. With a single region covering the image, the results are the
+       * same as operator()'s. With smoothing (see setSigma()), gradients are
+       * evaluated on the regions grown by 4 sigma, so they may differ
+       * slightly from the ones on the whole image.
+       */
+      virtual void estimateRegions (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, const std::vector<Region>& regions,
+          int halo) const =0;
+
+      inline void estimateRegions (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          const std::vector<Region>& regions, int halo) const {
+        estimateRegions(alpha, iterations, Frames(i1, i2), u0, v0, regions,
+            halo);
+      }
+
+      inline void estimateRegions (double alpha, size_t iterations,
+          const blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
+          const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0,
+          const std::vector<Region>& regions, int halo) const {
+        estimateRegions(alpha, iterations, Frames(i1, i2, i3), u0, v0,
+            regions, halo);
+      }
+
+      /**
+       * Estimates the flow on a tile of the image only, as one of the tiles
+       * of tileRegions(). The tile, grown by halo pixels on each side and
+       * clipped to the image, is solved like operator() would, starting from
+       * u_init and v_init, with the flow around it kept as the boundary
+       * condition. Only the tile is written to u0 and v0. As this uses no
+       * buffer of the solver, the tiles of an image may be estimated by
+       * several threads at the same time, as long as u_init and v_init are
+       * not u0 and v0. Boundary effects travel a pixel per iteration, so
+       * with a halo of at least iterations pixels, the flow on the tile is
+       * the same as operator()'s (gradients with smoothing aside, as for
+       * estimateRegions()).
+       */
+      virtual void estimateTile (double alpha, size_t iterations,
+          const Frames& frames, const blitz::Array<double,2>& u_init,
+          const blitz::Array<double,2>& v_init, const Region& tile,
+          int halo, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0) const =0;
+
+  };
+
+  /**
+   * The Horn & Schunck solver, for any gradient and Laplacian. The gradient
+   * is one of the classes on SpatioTemporalGradient.h that can be built from
+   * the image shape only (HornAndSchunckGradient, SobelGradient,
+   * PrewittGradient or IsotropicGradient): forward gradients take 2 images,
+   * central ones 3. The Laplacian is a policy like HornAndSchunckLaplacian
+   * or OpenCVLaplacian. Both are resolved at compile time, so the iterations
+   * run without indirect calls. All 8 combinations are instantiated on
+   * HornAndSchunckFlow.cpp.
+   */
+  template <typename Gradient, typename Laplacian>
+  class HornAndSchunckSolver: public FlowSolver {
+
+    public: //api
+
+      /**
+       * Constructor, specify shape of images to be treated and the name of
+       * the solver on traces (see Trace.h)
+       */
+      HornAndSchunckSolver(const blitz::TinyVector<int,2>& shape,
+          const std::string& name="Solver");
+
+      /**
+       * Virtual destructor
+       */
+      virtual ~HornAndSchunckSolver();
+
+      virtual const blitz::TinyVector<int,2>& getShape() const {
+        return m_ex.shape();
+      }
+
+      virtual void setShape(const blitz::TinyVector<int,2>& shape);
+
+      virtual double getSigma() const { return m_gradient.getSigma(); }
+
+      virtual void setSigma(double sigma) { m_gradient.setSigma(sigma); }
+
+      virtual int getFrames() const;
+
+      using FlowSolver::evalEb;
+      using FlowSolver::operator();
+      using FlowSolver::estimateConvergence;
+      using FlowSolver::estimateStatistics;
+      using FlowSolver::estimateLabelStatistics;
+      using FlowSolver::estimateHoof;
+      using FlowSolver::estimateMask;
+      using FlowSolver::estimateBlocks;
+      using FlowSolver::estimateRegions;
+
+      virtual void evalEc2 (const blitz::Array<double,2>& u,
+          const blitz::Array<double,2>& v, blitz::Array<double,2>& error) const;
+
+      virtual void evalEb (const Frames& frames,
+          const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+          blitz::Array<double,2>& error) const;
+
+      virtual void operator() (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0) const;
+
+      virtual void estimateGradients (double alpha, size_t iterations,
+          const blitz::Array<int16_t,2>& ex, const blitz::Array<int16_t,2>& ey,
+          const blitz::Array<int16_t,2>& et, double scale,
+          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const;
+
+      virtual void estimateConvergence (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, double threshold, int block,
+          blitz::Array<int32_t,2>& last,
+          blitz::Array<double,2>& magnitude) const;
+
+      virtual void estimateStatistics (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, FlowStatistics& statistics) const;
+
+      virtual void estimateLabelStatistics (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, const blitz::Array<int32_t,2>& labels,
+          LabelStatistics& statistics) const;
+
+      virtual void estimateHoof (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, HoofFeatures& features) const;
+
+      virtual void estimateMask (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, double threshold, bool packed,
+          blitz::Array<uint8_t,2>& mask) const;
+
+      virtual void estimateMask (double alpha, size_t iterations,
+          const Frames& frames, double threshold, bool packed,
+          blitz::Array<uint8_t,2>& mask) const;
+
+      virtual void estimateBlocks (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, int block, BlockReduction reduction,
+          blitz::Array<double,2>& bu, blitz::Array<double,2>& bv) const;
+
+      virtual void estimateBlocks (double alpha, size_t iterations,
+          const Frames& frames, int block, BlockReduction reduction,
+          blitz::Array<double,2>& bu, blitz::Array<double,2>& bv) const;
+
+      virtual void estimateRegions (double alpha, size_t iterations,
+          const Frames& frames, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0, const std::vector<Region>& regions,
+          int halo) const;
+
+      virtual void estimateTile (double alpha, size_t iterations,
+          const Frames& frames, const blitz::Array<double,2>& u_init,
+          const blitz::Array<double,2>& v_init, const Region& tile,
+          int halo, blitz::Array<double,2>& u0,
+          blitz::Array<double,2>& v0) const;
+
+    private: //helpers
+
+      /**
+       * Checks the number and the shapes of the images and of the flow
+       */
+      void check(const Frames& frames, const blitz::Array<double,2>& u0,
+          const blitz::Array<double,2>& v0) const;
+
+      /**
+       * The trace span name of a method, or 0 if tracing is off
+       */
+      const char* span(const char* method) const;
+
+    private: //representation
+
+      std::string m_name; ///< name on traces
+      Gradient m_gradient; ///< Gradient operator
+      mutable blitz::Array<double,2> m_ex; ///< Ex buffer
+      mutable blitz::Array<double,2> m_ey; ///< Ey buffer
+      mutable blitz::Array<double,2> m_et; ///< Et buffer
+      mutable blitz::Array<double,2> m_u; ///< U (x velocity) buffer
+      mutable blitz::Array<double,2> m_v; ///< V (y velocity) buffer
+      mutable blitz::Array<double, 2> m_cterm; ///< common term buffer
+      mutable blitz::Array<double,2> m_u0; ///< flow buffer, when not returned
+      mutable blitz::Array<double,2> m_v0; ///< flow buffer, when not returned
+
+  };
+
   /**
    * This can calculate the Optical Flow between two sequences of images (i1,
    * the starting image and i2, the final image). It does this using the
@@ -113,7 +821,8 @@ namespace bob { namespace ip { namespace optflow {
    * Calling it estimates u0 and v0 based on their initial state. If you want
    * to start from scratch, just set u0 and v0 to 0.
    */
-  class VanillaHornAndSchunckFlow {
+  class VanillaHornAndSchunckFlow:
+    public HornAndSchunckSolver<HornAndSchunckGradient, HornAndSchunckLaplacian> {
 
     public: //api
 
@@ -127,57 +836,6 @@ namespace bob { namespace ip { namespace optflow {
        */
       virtual ~VanillaHornAndSchunckFlow();
 
-      /**
-       * Returns the current shape supported
-       */
-      inline const blitz::TinyVector<int,2>& getShape() const {
-        return m_ex.shape();
-      }
-
-      /**
-       * Re-shape internal buffers
-       */
-      void setShape(const blitz::TinyVector<int,2>& shape);
-
-      /**
-       * Calculates the square of the smoothness error (Ec^2) by using the
-       * formula described in the paper:
-       *
-       * Ec^2 = (u_bar - u)^2 + (v_bar - v)^2
-       *
-       * Sets the input matrix with the discrete values.
-       */
-      void evalEc2 (const blitz::Array<double,2>& u,
-          const blitz::Array<double,2>& v, blitz::Array<double,2>& error) const;
-
-      /**
-       * Calculates the brightness error (Eb) as defined in the paper:
-       *
-       * Eb = (Ex*u + Ey*v + Et)
-       *
-       * Sets the input matrix with the discrete values
-       */
-      void evalEb (const blitz::Array<double,2>& i1,
-          const blitz::Array<double,2>& i2, const blitz::Array<double,2>& u,
-          const blitz::Array<double,2>& v, blitz::Array<double,2>& error) const;
-
-      /**
-       * Call this to evaluate the flow
-       */
-      void operator() (double alpha, size_t iterations, const
-          blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
-          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const;
-
-    private: //representation
-
-      bob::ip::optflow::HornAndSchunckGradient m_gradient; ///< Gradient operator
-      mutable blitz::Array<double,2> m_ex; ///< Ex buffer
-      mutable blitz::Array<double,2> m_ey; ///< Ey buffer
-      mutable blitz::Array<double,2> m_et; ///< Et buffer
-      mutable blitz::Array<double,2> m_u; ///< U (x velocity) buffer
-      mutable blitz::Array<double,2> m_v; ///< V (y velocity) buffer
-      mutable blitz::Array<double, 2> m_cterm; ///< common term buffer
-
   };
 
   /**
@@ -186,7 +844,8 @@ namespace bob { namespace ip { namespace optflow {
    * classical method. The Laplacian operator is also replaced with a more
    * common method.
    */
-  class HornAndSchunckFlow {
+  class HornAndSchunckFlow:
+    public HornAndSchunckSolver<SobelGradient, OpenCVLaplacian> {
 
     public: //api
 
@@ -200,61 +859,17 @@ namespace bob { namespace ip { namespace optflow {
        */
       virtual ~HornAndSchunckFlow();
 
-      /**
-       * Returns the current shape supported
-       */
-      inline const blitz::TinyVector<int,2>& getShape() const {
-        return m_ex.shape();
-      }
-
-      /**
-       * Re-shape internal buffers
-       */
-      void setShape(const blitz::TinyVector<int,2>& shape);
-
-      /**
-       * Calculates the square of the smoothness error (Ec^2) by using the
-       * formula described in the paper:
-       *
-       * Ec^2 = (u_bar - u)^2 + (v_bar - v)^2
-       *
-       * Sets the input matrix with the discrete values.
-       */
-      void evalEc2 (const blitz::Array<double,2>& u,
-          const blitz::Array<double,2>& v, blitz::Array<double,2>& error) const;
-
-      /**
-       * Calculates the brightness error (Eb) as defined in the paper:
-       *
-       * Eb = (Ex*u + Ey*v + Et)
-       *
-       * Sets the input matrix with the discrete values
-       */
-      void evalEb (const blitz::Array<double,2>& i1,
-          const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
-          const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
-          blitz::Array<double,2>& error) const;
-
-      /**
-       * Call this to evaluate the flow
-       */
-      void operator() (double alpha, size_t iterations, const
-          blitz::Array<double,2>& i1, const blitz::Array<double,2>& i2,
-          const blitz::Array<double,2>& i3,
-          blitz::Array<double,2>& u0, blitz::Array<double,2>& v0) const;
-
-    private: //representation
-
-      bob::ip::optflow::SobelGradient m_gradient; ///< Gradient operator
-      mutable blitz::Array<double,2> m_ex; ///< Ex buffer
-      mutable blitz::Array<double,2> m_ey; ///< Ey buffer
-      mutable blitz::Array<double,2> m_et; ///< Et buffer
-      mutable blitz::Array<double,2> m_u; ///< U (x velocity) buffer
-      mutable blitz::Array<double,2> m_v; ///< V (y velocity) buffer
-      mutable blitz::Array<double, 2> m_cterm; ///< common term buffer
-
   };
 
+  /**
+   * Creates a solver with the given gradient ("hs" for
+   * HornAndSchunckGradient, "sobel", "prewitt" or "isotropic") and
+   * Laplacian ("hs" for HornAndSchunckLaplacian or "opencv" for
+   * OpenCVLaplacian). The caller owns the returned solver.
+   */
+  FlowSolver* createSolver(const std::string& gradient,
+      const std::string& laplacian, const blitz::TinyVector<int,2>& shape);
+
   /**
    * Computes the generalized flow error.
    *
@@ -264,6 +879,59 @@ namespace bob { namespace ip { namespace optflow {
       const blitz::Array<double,2>& i2, const blitz::Array<double,2>& u,
       const blitz::Array<double,2>& v, blitz::Array<double,2>& error);
 
+  /**
+   * Returns the shape of the per-block outputs for images with the given
+   * shape, when divided in blocks of block x block pixels. Partial blocks on
+   * the right and bottom borders are counted.
+   */
+  blitz::TinyVector<int,2> blockShape(const blitz::TinyVector<int,2>& shape,
+      int block);
+
+  /**
+   * Finds the regions that changed between two images, for
+   * estimateRegions(). The image is divided in blocks of block x block
+   * pixels (partial blocks on the right and bottom borders included) and
+   * blocks in which any pixel changed by more than threshold are marked.
+   * Every run of marked blocks along a row of blocks makes a region, which
+   * grows down over the following rows of blocks with the same run. Regions
+   * are clipped to the image and appended to regions, top to bottom.
+   */
+  void changedRegions(const blitz::Array<double,2>& i1,
+      const blitz::Array<double,2>& i2, double threshold, int block,
+      std::vector<Region>& regions);
+
+  /**
+   * Like the above, marking blocks that changed between i1 and i2 or
+   * between i2 and i3
+   */
+  void changedRegions(const blitz::Array<double,2>& i1,
+      const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
+      double threshold, int block, std::vector<Region>& regions);
+
+  /**
+   * Splits an image of the given shape in tiles of tile x tile pixels
+   * (partial tiles on the right and bottom borders included), for
+   * FlowSolver::estimateTile(). Tiles are appended to tiles in row-major
+   * order.
+   */
+  void tileRegions(const blitz::TinyVector<int,2>& shape, int tile,
+      std::vector<Region>& tiles);
+
+  /**
+   * Returns the shape of motion masks for images with the given shape: the
+   * same shape, or rows of ceil(width/8) bytes if the mask is packed in bits
+   */
+  blitz::TinyVector<int,2> maskShape(const blitz::TinyVector<int,2>& shape,
+      bool packed);
+
+  /**
+   * Removes moving regions thinner than 3 pixels from a motion mask (with
+   * values 0 or 1, not packed), with a morphological opening: an erosion,
+   * then a dilation, with a 3x3 square. Pixels outside the image are
+   * ignored.
+   */
+  void openMask(blitz::Array<uint8_t,2>& mask);
+
 }}}
 
 #endif /* BOB_IP_HORNANDSCHUNCKFLOW_H */
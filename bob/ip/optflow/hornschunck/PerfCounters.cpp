@@ -0,0 +1,150 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:02:07 2026 +0000
+ *
+ * @brief Implementation of hardware performance counters on Linux
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <vector>
+
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const uint64_t EVENT_CONFIG[] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_REFERENCES,
+  PERF_COUNT_HW_CACHE_MISSES,
+};
+
+/**
+ * Opens a counter for the calling thread on any CPU, initially disabled.
+ * Only user-space events are counted, so that it works with the default
+ * kernel.perf_event_paranoid settings.
+ */
+static int open_counter(uint64_t config) {
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+    PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+bob::ip::optflow::PerfCounters::PerfCounters():
+  m_seconds(0.)
+{
+  for (int e=0; e<NumberOfEvents; ++e) {
+#ifdef __linux__
+    m_fd[e] = open_counter(EVENT_CONFIG[e]);
+#else
+    m_fd[e] = -1;
+#endif
+    m_value[e] = -1;
+  }
+}
+
+bob::ip::optflow::PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (int e=0; e<NumberOfEvents; ++e) if (m_fd[e] >= 0) close(m_fd[e]);
+#endif
+}
+
+void bob::ip::optflow::PerfCounters::start() {
+#ifdef __linux__
+  for (int e=0; e<NumberOfEvents; ++e) {
+    if (m_fd[e] < 0) continue;
+    ioctl(m_fd[e], PERF_EVENT_IOC_RESET, 0);
+    ioctl(m_fd[e], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+  m_start = std::chrono::steady_clock::now();
+}
+
+void bob::ip::optflow::PerfCounters::stop() {
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  m_seconds = std::chrono::duration<double>(end - m_start).count();
+  for (int e=0; e<NumberOfEvents; ++e) {
+    m_value[e] = -1;
+#ifdef __linux__
+    if (m_fd[e] < 0) continue;
+    ioctl(m_fd[e], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t data[3]; //value, time enabled, time running
+    if (read(m_fd[e], data, sizeof(data)) != sizeof(data)) continue;
+    if (data[2] == 0) continue; //never scheduled
+    double scale = (data[2] < data[1])? double(data[1]) / data[2] : 1.;
+    m_value[e] = static_cast<int64_t>(data[0] * scale);
+#endif
+  }
+}
+
+const char* bob::ip::optflow::PerfCounters::name(Event e) {
+  static const char* names[] = {
+    "cycles",
+    "instructions",
+    "cache_references",
+    "cache_misses",
+  };
+  return names[e];
+}
+
+double bob::ip::optflow::peakBandwidth(size_t elements, size_t repeat) {
+  std::vector<double> a(elements, 0.), b(elements, 1.), c(elements, 2.);
+  const double scalar = 3.;
+  double best = 0.;
+  for (size_t r=0; r<repeat; ++r) {
+    std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    for (size_t k=0; k<elements; ++k) a[k] = b[k] + scalar*c[k];
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    if (seconds > 0 && 24. * elements / seconds > best)
+      best = 24. * elements / seconds;
+    std::swap(a, b); //the result is used, so the loop is not optimized out
+  }
+  return best;
+}
+
+/**
+ * Enough independent chains to hide the latency of the floating-point units
+ * and to fill all vector lanes
+ */
+static const int CHAINS = 32;
+
+double bob::ip::optflow::peakFlops(size_t repeat) {
+  volatile double va = 0.999999, vb = 1e-9; //unknown at compile time
+  const double a = va, b = vb;
+  const size_t steps = size_t(1) << 22;
+  double best = 0.;
+  double acc[CHAINS];
+  for (int k=0; k<CHAINS; ++k) acc[k] = 1e-3 * k;
+  for (size_t r=0; r<repeat; ++r) {
+    std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    for (size_t i=0; i<steps; ++i)
+      for (int k=0; k<CHAINS; ++k) acc[k] = acc[k]*a + b;
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    if (seconds > 0 && 2. * CHAINS * steps / seconds > best)
+      best = 2. * CHAINS * steps / seconds;
+  }
+  //keeps the chains alive
+  double sum = 0.;
+  for (int k=0; k<CHAINS; ++k) sum += acc[k];
+  va = sum;
+  return best;
+}
@@ -0,0 +1,122 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:02:07 2026 +0000
+ *
+ * @brief Reads hardware performance counters around a section of code
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BOB_IP_OPTFLOW_PERFCOUNTERS_H
+#define BOB_IP_OPTFLOW_PERFCOUNTERS_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <chrono>
+
+namespace bob { namespace ip { namespace optflow {
+
+  /**
+   * Counts hardware events (cycles, instructions and last-level cache
+   * traffic) for the calling thread between start() and stop(), using the
+   * Linux perf_event_open() interface. The wall-clock time is always
+   * measured.
+   *
+   * Counters that cannot be opened (other operating systems, virtual
+   * machines without a PMU or a restrictive kernel.perf_event_paranoid) are
+   * reported as unavailable, with value() returning -1, so measurements
+   * degrade gracefully to wall-clock time only.
+   */
+  class PerfCounters {
+
+    public: //api
+
+      /**
+       * The events counted
+       */
+      typedef enum Event {
+        Cycles = 0,
+        Instructions,
+        CacheReferences, ///< last-level cache references
+        CacheMisses, ///< last-level cache misses
+        NumberOfEvents
+      } Event;
+
+      /**
+       * Opens all counters this host supports, initially stopped
+       */
+      PerfCounters();
+
+      /**
+       * Virtual destructor, closes all counters
+       */
+      virtual ~PerfCounters();
+
+      /**
+       * Tells if a given event can be counted on this host
+       */
+      inline bool available(Event e) const { return m_fd[e] >= 0; }
+
+      /**
+       * Resets and starts all counters
+       */
+      void start();
+
+      /**
+       * Stops all counters and reads their values
+       */
+      void stop();
+
+      /**
+       * The value of a counter, between the last calls to start() and stop(),
+       * or -1 if the event cannot be counted. Values are scaled if the kernel
+       * had to multiplex the counters.
+       */
+      inline int64_t value(Event e) const { return m_value[e]; }
+
+      /**
+       * The wall-clock time between the last calls to start() and stop(), in
+       * seconds
+       */
+      inline double seconds() const { return m_seconds; }
+
+      /**
+       * The name of an event
+       */
+      static const char* name(Event e);
+
+    private: //not copiable, owns file descriptors
+
+      PerfCounters(const PerfCounters&);
+      PerfCounters& operator= (const PerfCounters&);
+
+    private: //representation
+
+      int m_fd[NumberOfEvents]; ///< counter file descriptors (-1 if closed)
+      int64_t m_value[NumberOfEvents]; ///< values read on stop()
+      double m_seconds; ///< wall-clock time read on stop()
+      std::chrono::steady_clock::time_point m_start; ///< set on start()
+
+  };
+
+  /**
+   * Measures the memory bandwidth sustained by the calling thread, in bytes
+   * per second, with a STREAM-like triad (a = b + s*c) over three arrays of
+   * the given number of elements each, which should not fit in cache. The
+   * best of the given number of repetitions is returned. As in STREAM, 24
+   * bytes are counted per element (write-allocate traffic is not).
+   */
+  double peakBandwidth(size_t elements=size_t(1)<<22, size_t repeat=5);
+
+  /**
+   * Measures the double-precision floating-point throughput of the calling
+   * thread, in operations per second, with many independent multiply-add
+   * chains. It reflects the instruction set this package was compiled for,
+   * which is also the one the kernels of this package run with. The best of
+   * the given number of repetitions is returned.
+   */
+  double peakFlops(size_t repeat=5);
+
+}}}
+
+#endif /* BOB_IP_OPTFLOW_PERFCOUNTERS_H */
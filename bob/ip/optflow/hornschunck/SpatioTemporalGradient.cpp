@@ -10,11 +10,18 @@
  */
 
 #include <cmath>
+#include <vector>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <boost/format.hpp>
 #include <bob.sp/extrapolate.h>
 #include <bob.sp/conv.h>
 #include <bob.core/assert.h>
 
 #include "SpatioTemporalGradient.h"
+#include "Trace.h"
 
 static inline void fastconv(const blitz::Array<double,2>& image,
     const blitz::Array<double,1>& kernel,
@@ -24,13 +31,220 @@ static inline void fastconv(const blitz::Array<double,2>& image,
   bob::sp::convSep(imageExtra, kernel, result, dimension, bob::sp::Conv::Valid);
 }
 
+void bob::ip::optflow::recursiveGaussian
+(const blitz::Array<double,2>& input, blitz::Array<double,2>& output,
+ double sigma) {
+
+  bob::core::array::assertSameShape(input, output);
+  if (sigma < 0.5) {
+    boost::format m("the recursive Gaussian requires a standard deviation of at least 0.5 pixels, but you set it to %g");
+    m % sigma;
+    throw std::runtime_error(m.str());
+  }
+
+  // Coefficients, from equations 11b and 8c of the paper
+  const double q = (sigma >= 2.5) ? (0.98711*sigma - 0.96330) :
+    (3.97156 - 4.14554*std::sqrt(1. - 0.26891*sigma));
+  const double q2 = q*q;
+  const double q3 = q2*q;
+  const double b0 = 1.57825 + 2.44413*q + 1.4281*q2 + 0.422205*q3;
+  const double b1 = (2.44413*q + 2.85619*q2 + 1.26661*q3) / b0;
+  const double b2 = -(1.4281*q2 + 1.26661*q3) / b0;
+  const double b3 = 0.422205*q3 / b0;
+  const double B = 1. - (b1 + b2 + b3);
+
+  const int height = input.extent(0);
+  const int width = input.extent(1);
+
+  // Along rows, starting each pass on the steady state of its border
+  for (int y=0; y<height; ++y) {
+    double w1 = input(y,0), w2 = w1, w3 = w1;
+    for (int x=0; x<width; ++x) {
+      const double w = B*input(y,x) + b1*w1 + b2*w2 + b3*w3;
+      output(y,x) = w;
+      w3 = w2; w2 = w1; w1 = w;
+    }
+    w2 = w3 = w1;
+    for (int x=width-1; x>=0; --x) {
+      const double w = B*output(y,x) + b1*w1 + b2*w2 + b3*w3;
+      output(y,x) = w;
+      w3 = w2; w2 = w1; w1 = w;
+    }
+  }
+
+  // Along columns, a row at a time, so memory is read in order
+  std::vector<double> border(width);
+  for (int x=0; x<width; ++x) border[x] = output(0,x);
+  for (int y=0; y<height; ++y) {
+    for (int x=0; x<width; ++x) {
+      const double w1 = y > 0 ? output(y-1,x) : border[x];
+      const double w2 = y > 1 ? output(y-2,x) : border[x];
+      const double w3 = y > 2 ? output(y-3,x) : border[x];
+      output(y,x) = B*output(y,x) + b1*w1 + b2*w2 + b3*w3;
+    }
+  }
+  for (int x=0; x<width; ++x) border[x] = output(height-1,x);
+  for (int y=height-1; y>=0; --y) {
+    for (int x=0; x<width; ++x) {
+      const double w1 = y < height-1 ? output(y+1,x) : border[x];
+      const double w2 = y < height-2 ? output(y+2,x) : border[x];
+      const double w3 = y < height-3 ? output(y+3,x) : border[x];
+      output(y,x) = B*output(y,x) + b1*w1 + b2*w2 + b3*w3;
+    }
+  }
+
+}
+
+/**
+ * Checks a standard deviation for the pre-smoothing of gradients
+ */
+static void check_sigma(double sigma) {
+  if (sigma != 0. && sigma < 0.5) {
+    boost::format m("the standard deviation of the smoothing should be 0 (disabled) or at least 0.5 pixels, but you set it to %g");
+    m % sigma;
+    throw std::runtime_error(m.str());
+  }
+}
+
+/**
+ * Checks a set of gradient channels to evaluate
+ */
+static void check_channels(int channels) {
+  if (channels <= 0 || (channels & ~bob::ip::optflow::GradientAll)) {
+    boost::format m("gradient channels should be a non-empty combination of GradientX (1), GradientY (2) and GradientT (4), but you set them to %d");
+    m % channels;
+    throw std::runtime_error(m.str());
+  }
+}
+
+typedef std::vector<blitz::Array<double,2> > slices_t;
+
+/**
+ * Returns views to every frame of a stack. Views are made before threads
+ * start, as blitz does not count references to shared data atomically.
+ */
+static slices_t slice(const blitz::Array<double,3>& stack) {
+  slices_t retval;
+  for (int t=0; t<stack.extent(0); ++t)
+    retval.push_back(stack(t, blitz::Range::all(), blitz::Range::all()));
+  return retval;
+}
+
+/**
+ * Adds the contribution of a filtered frame to every gradient in [first,
+ * last) it takes part in. With n-term kernels, gradient t combines frames t
+ * to t+n-1, frame t+k being weighted by kernel(n-1-k). Frames must come in
+ * order, so every gradient is summed in the same order as the 2D
+ * operators do.
+ */
+static void accumulate(const blitz::Array<double,2>& filtered,
+    const blitz::Array<double,1>& kernel, int frame, int first, int last,
+    slices_t& output) {
+  const int n = kernel.extent(0);
+  for (int t=std::max(first, frame-n+1); t<std::min(last, frame+1); ++t) {
+    const int k = frame - t;
+    if (k == 0) output[t] = kernel(n-1-k) * filtered;
+    else output[t] += kernel(n-1-k) * filtered;
+  }
+}
+
+/**
+ * Evaluates the gradients [first, last) of a stack of frames, filtering each
+ * frame they depend on once. Frames (smoothed, if sigma is set) and kernels
+ * are first copied, so that convolutions only reference memory owned by this
+ * chunk, and chunks may be evaluated in parallel.
+ */
+static void volume_chunk(const blitz::Array<double,1>& diff,
+    const blitz::Array<double,1>& avg, double sigma, const slices_t& frames,
+    int first, int last, slices_t& Ex, slices_t& Ey, slices_t& Et) {
+  const blitz::Array<double,1> diff_kernel(diff.copy());
+  const blitz::Array<double,1> avg_kernel(avg.copy());
+  const int n = diff_kernel.extent(0);
+  const blitz::TinyVector<int,2> shape = frames[0].shape();
+  blitz::Array<double,2> frame(shape);
+  blitz::Array<double,2> buffer(shape);
+  blitz::Array<double,2> filtered(shape);
+  for (int f=first; f<last+n-1; ++f) {
+    if (sigma > 0.) bob::ip::optflow::recursiveGaussian(frames[f], frame, sigma);
+    else frame = frames[f];
+
+    fastconv(frame, diff_kernel, buffer, 1); // Buffer =  DK * frame
+    fastconv(buffer, avg_kernel, filtered, 0); // Filtered = AK^T * Buffer
+    accumulate(filtered, avg_kernel, f, first, last, Ex);
+
+    fastconv(frame, diff_kernel, buffer, 0); // Buffer =  DK^T * frame
+    fastconv(buffer, avg_kernel, filtered, 1); // Filtered = AK * Buffer
+    accumulate(filtered, avg_kernel, f, first, last, Ey);
+
+    fastconv(frame, avg_kernel, buffer, 1); // Buffer =  AK * frame
+    fastconv(buffer, avg_kernel, filtered, 0); // Filtered = AK^T * Buffer
+    accumulate(filtered, diff_kernel, f, first, last, Et);
+  }
+}
+
+/**
+ * Evaluates the gradients of a stack of frames, splitting the time axis in
+ * chunks evaluated by separate threads
+ */
+static void volume_gradient(const blitz::Array<double,1>& diff_kernel,
+    const blitz::Array<double,1>& avg_kernel, double sigma,
+    const blitz::TinyVector<int,2>& shape,
+    const blitz::Array<double,3>& frames, blitz::Array<double,3>& Ex,
+    blitz::Array<double,3>& Ey, blitz::Array<double,3>& Et, size_t threads) {
+
+  const int n = diff_kernel.extent(0);
+  if (frames.extent(0) < n) {
+    boost::format m("a stack of at least %d frames is required, but you passed %d");
+    m % n % frames.extent(0);
+    throw std::runtime_error(m.str());
+  }
+  const int outputs = frames.extent(0) - n + 1;
+  bob::core::array::assertSameDimensionLength(frames.extent(1), shape(0));
+  bob::core::array::assertSameDimensionLength(frames.extent(2), shape(1));
+  blitz::TinyVector<int,3> output_shape(outputs, shape(0), shape(1));
+  bob::core::array::assertSameShape(Ex, output_shape);
+  bob::core::array::assertSameShape(Ey, output_shape);
+  bob::core::array::assertSameShape(Et, output_shape);
+
+  const slices_t in = slice(frames);
+  slices_t ex = slice(Ex);
+  slices_t ey = slice(Ey);
+  slices_t et = slice(Et);
+
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  const int chunks = std::min<int>(threads, outputs);
+  if (chunks == 1) {
+    volume_chunk(diff_kernel, avg_kernel, sigma, in, 0, outputs, ex, ey, et);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(chunks);
+  std::vector<std::thread> workers;
+  for (int c=0; c<chunks; ++c) {
+    const int first = (c * outputs) / chunks;
+    const int last = ((c + 1) * outputs) / chunks;
+    workers.push_back(std::thread([&, c, first, last]() {
+          try {
+            volume_chunk(diff_kernel, avg_kernel, sigma, in, first, last,
+              ex, ey, et);
+          }
+          catch (...) {
+            errors[c] = std::current_exception();
+          }
+          }));
+  }
+  for (auto& w: workers) w.join();
+  for (auto& e: errors) if (e) std::rethrow_exception(e);
+}
+
 bob::ip::optflow::ForwardGradient::ForwardGradient(const blitz::Array<double,1>& diff_kernel,
     const blitz::Array<double,1>& avg_kernel,
     const blitz::TinyVector<int,2>& shape) :
   m_diff_kernel(diff_kernel.copy()),
   m_avg_kernel(avg_kernel.copy()),
   m_buffer1(shape),
-  m_buffer2(shape)
+  m_buffer2(shape),
+  m_sigma(0.)
 {
   blitz::TinyVector<int,1> required_shape(2);
   bob::core::array::assertSameShape(m_diff_kernel, required_shape);
@@ -41,8 +255,10 @@ bob::ip::optflow::ForwardGradient::ForwardGradient(const bob::ip::optflow::Forwa
   m_diff_kernel(other.m_diff_kernel.copy()),
   m_avg_kernel(other.m_avg_kernel.copy()),
   m_buffer1(other.m_buffer1.shape()),
-  m_buffer2(other.m_buffer2.shape())
+  m_buffer2(other.m_buffer2.shape()),
+  m_sigma(0.)
 {
+  setSigma(other.m_sigma);
 }
 
 bob::ip::optflow::ForwardGradient::~ForwardGradient() { }
@@ -52,12 +268,31 @@ bob::ip::optflow::ForwardGradient& bob::ip::optflow::ForwardGradient::operator=
   m_avg_kernel.reference(other.m_avg_kernel.copy());
   m_buffer1.resize(other.m_buffer1.shape());
   m_buffer2.resize(other.m_buffer2.shape());
+  setSigma(other.m_sigma);
   return *this;
 }
 
 void bob::ip::optflow::ForwardGradient::setShape(const blitz::TinyVector<int,2>& shape) {
   m_buffer1.resize(shape);
   m_buffer2.resize(shape);
+  if (m_sigma > 0.) {
+    m_smooth1.resize(shape);
+    m_smooth2.resize(shape);
+  }
+}
+
+void bob::ip::optflow::ForwardGradient::setSigma(double sigma) {
+  check_sigma(sigma);
+  m_sigma = sigma;
+  //smoothing buffers are only kept while smoothing is on
+  if (m_sigma > 0.) {
+    m_smooth1.resize(m_buffer1.shape());
+    m_smooth2.resize(m_buffer1.shape());
+  }
+  else {
+    m_smooth1.free();
+    m_smooth2.free();
+  }
 }
 
 void bob::ip::optflow::ForwardGradient::setDiffKernel(const blitz::Array<double,1>& k) {
@@ -70,16 +305,34 @@ void bob::ip::optflow::ForwardGradient::setAvgKernel(const blitz::Array<double,1
   m_avg_kernel.reference(k.copy());
 }
 
-void bob::ip::optflow::ForwardGradient::operator()(const blitz::Array<double,2>& i1,
-    const blitz::Array<double,2>& i2, blitz::Array<double,2>& Ex,
+void bob::ip::optflow::ForwardGradient::operator()(const blitz::Array<double,2>& image1,
+    const blitz::Array<double,2>& image2, blitz::Array<double,2>& Ex,
     blitz::Array<double,2>& Ey, blitz::Array<double,2>& Et) const {
+  evaluateChannels(image1, image2, Ex, Ey, Et, GradientAll);
+}
 
-  // all arrays have to have the same shape
-  bob::core::array::assertSameShape(i1, i2);
-  bob::core::array::assertSameShape(Ex, Ey);
-  bob::core::array::assertSameShape(Ey, Et);
-  bob::core::array::assertSameShape(i1, Ex);
-  bob::core::array::assertSameShape(m_buffer1, i1);
+void bob::ip::optflow::ForwardGradient::evaluateChannels
+(const blitz::Array<double,2>& image1, const blitz::Array<double,2>& image2,
+ blitz::Array<double,2>& Ex, blitz::Array<double,2>& Ey,
+ blitz::Array<double,2>& Et, int channels) const {
+
+  bob::ip::optflow::trace::Span span("ForwardGradient");
+
+  // all arrays evaluated have to have the same shape
+  check_channels(channels);
+  bob::core::array::assertSameShape(image1, image2);
+  bob::core::array::assertSameShape(m_buffer1, image1);
+  if (channels & GradientX) bob::core::array::assertSameShape(image1, Ex);
+  if (channels & GradientY) bob::core::array::assertSameShape(image1, Ey);
+  if (channels & GradientT) bob::core::array::assertSameShape(image1, Et);
+
+  // Optional pre-smoothing, straight into buffers owned by this object
+  const blitz::Array<double,2>& i1 = m_sigma > 0. ? m_smooth1 : image1;
+  const blitz::Array<double,2>& i2 = m_sigma > 0. ? m_smooth2 : image2;
+  if (m_sigma > 0.) {
+    bob::ip::optflow::recursiveGaussian(image1, m_smooth1, m_sigma);
+    bob::ip::optflow::recursiveGaussian(image2, m_smooth2, m_sigma);
+  }
 
   // Notation:
   // DK - difference kernel
@@ -88,34 +341,50 @@ void bob::ip::optflow::ForwardGradient::operator()(const blitz::Array<double,2>&
   // A * B - A convolved with B (A is mirrored)
 
   // Differentiation along the X direction (extent 1) => Ex matrix
-  fastconv(i1, m_diff_kernel, Ex, 1); // Ex =  DK * i1
-  fastconv(Ex, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Ex
+  if (channels & GradientX) {
+    fastconv(i1, m_diff_kernel, Ex, 1); // Ex =  DK * i1
+    fastconv(Ex, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Ex
 
-  fastconv(i2, m_diff_kernel, Ex, 1); // Ex = DK * i2
-  fastconv(Ex, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Ex
+    fastconv(i2, m_diff_kernel, Ex, 1); // Ex = DK * i2
+    fastconv(Ex, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Ex
 
-  // The averaging operation along the t coordinate is performed by hand
-  Ex = (m_avg_kernel(1) * m_buffer1) + (m_avg_kernel(0) * m_buffer2);
+    // The averaging operation along the t coordinate is performed by hand
+    Ex = (m_avg_kernel(1) * m_buffer1) + (m_avg_kernel(0) * m_buffer2);
+  }
 
   // Differentiation along the Y direction (extent 0) => Ey matrix
-  fastconv(i1, m_diff_kernel, Ey, 0); // Ey =  DK^T * i1
-  fastconv(Ey, m_avg_kernel, m_buffer1, 1); // Buffer1 = AK * Ey
+  if (channels & GradientY) {
+    fastconv(i1, m_diff_kernel, Ey, 0); // Ey =  DK^T * i1
+    fastconv(Ey, m_avg_kernel, m_buffer1, 1); // Buffer1 = AK * Ey
 
-  fastconv(i2, m_diff_kernel, Ey, 0); // Ey =  DK^T * i2
-  fastconv(Ey, m_avg_kernel, m_buffer2, 1); // Buffer2 = AK * Ey
+    fastconv(i2, m_diff_kernel, Ey, 0); // Ey =  DK^T * i2
+    fastconv(Ey, m_avg_kernel, m_buffer2, 1); // Buffer2 = AK * Ey
 
-  // The averaging operation along the t coordinate is performed by hand
-  Ey = (m_avg_kernel(1) * m_buffer1) + (m_avg_kernel(0) * m_buffer2);
+    // The averaging operation along the t coordinate is performed by hand
+    Ey = (m_avg_kernel(1) * m_buffer1) + (m_avg_kernel(0) * m_buffer2);
+  }
 
   // Differentiation along the T direction i1 -> i2 => Et matrix
-  fastconv(i1, m_avg_kernel, Et, 1); // Et =  AK * i1
-  fastconv(Et, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Et
+  if (channels & GradientT) {
+    fastconv(i1, m_avg_kernel, Et, 1); // Et =  AK * i1
+    fastconv(Et, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Et
+
+    fastconv(i2, m_avg_kernel, Et, 1); // Et =  AK * i2
+    fastconv(Et, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Et
+
+    // The difference operation along the t coordinate is performed by hand
+    Et = (m_diff_kernel(1) * m_buffer1) + (m_diff_kernel(0) * m_buffer2);
+  }
+}
+
+void bob::ip::optflow::ForwardGradient::operator()(const blitz::Array<double,3>& frames,
+    blitz::Array<double,3>& Ex, blitz::Array<double,3>& Ey,
+    blitz::Array<double,3>& Et, size_t threads) const {
 
-  fastconv(i2, m_avg_kernel, Et, 1); // Et =  AK * i2
-  fastconv(Et, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Et
+  bob::ip::optflow::trace::Span span("ForwardGradient.volume");
 
-  // The difference operation along the t coordinate is performed by hand
-  Et = (m_diff_kernel(1) * m_buffer1) + (m_diff_kernel(0) * m_buffer2);
+  volume_gradient(m_diff_kernel, m_avg_kernel, m_sigma, m_buffer1.shape(),
+      frames, Ex, Ey, Et, threads);
 }
 
 static const double HS_DIFF_KERNEL_DATA[] = {+1/4., -1/4.};
@@ -137,7 +406,8 @@ bob::ip::optflow::CentralGradient::CentralGradient(const blitz::Array<double,1>&
   m_avg_kernel(avg_kernel.copy()),
   m_buffer1(shape),
   m_buffer2(shape),
-  m_buffer3(shape)
+  m_buffer3(shape),
+  m_sigma(0.)
 {
   blitz::TinyVector<int,1> required_shape(3);
   bob::core::array::assertSameShape(m_diff_kernel, required_shape);
@@ -149,8 +419,10 @@ bob::ip::optflow::CentralGradient::CentralGradient(const bob::ip::optflow::Centr
   m_avg_kernel(other.m_avg_kernel.copy()),
   m_buffer1(other.m_buffer1.shape()),
   m_buffer2(other.m_buffer2.shape()),
-  m_buffer3(other.m_buffer3.shape())
+  m_buffer3(other.m_buffer3.shape()),
+  m_sigma(0.)
 {
+  setSigma(other.m_sigma);
 }
 
 bob::ip::optflow::CentralGradient::~CentralGradient() { }
@@ -161,6 +433,7 @@ bob::ip::optflow::CentralGradient& bob::ip::optflow::CentralGradient::operator=
   m_buffer1.resize(other.m_buffer1.shape());
   m_buffer2.resize(other.m_buffer2.shape());
   m_buffer3.resize(other.m_buffer3.shape());
+  setSigma(other.m_sigma);
   return *this;
 }
 
@@ -168,6 +441,27 @@ void bob::ip::optflow::CentralGradient::setShape(const blitz::TinyVector<int,2>&
   m_buffer1.resize(shape);
   m_buffer2.resize(shape);
   m_buffer3.resize(shape);
+  if (m_sigma > 0.) {
+    m_smooth1.resize(shape);
+    m_smooth2.resize(shape);
+    m_smooth3.resize(shape);
+  }
+}
+
+void bob::ip::optflow::CentralGradient::setSigma(double sigma) {
+  check_sigma(sigma);
+  m_sigma = sigma;
+  //smoothing buffers are only kept while smoothing is on
+  if (m_sigma > 0.) {
+    m_smooth1.resize(m_buffer1.shape());
+    m_smooth2.resize(m_buffer1.shape());
+    m_smooth3.resize(m_buffer1.shape());
+  }
+  else {
+    m_smooth1.free();
+    m_smooth2.free();
+    m_smooth3.free();
+  }
 }
 
 void bob::ip::optflow::CentralGradient::setDiffKernel(const blitz::Array<double,1>& k) {
@@ -180,18 +474,39 @@ void bob::ip::optflow::CentralGradient::setAvgKernel(const blitz::Array<double,1
   m_avg_kernel.reference(k.copy());
 }
 
-void bob::ip::optflow::CentralGradient::operator() (const blitz::Array<double,2>& i1,
-    const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
+void bob::ip::optflow::CentralGradient::operator() (const blitz::Array<double,2>& image1,
+    const blitz::Array<double,2>& image2, const blitz::Array<double,2>& image3,
     blitz::Array<double,2>& Ex, blitz::Array<double,2>& Ey,
     blitz::Array<double,2>& Et) const {
+  evaluateChannels(image1, image2, image3, Ex, Ey, Et, GradientAll);
+}
 
-  // all arrays have to have the same shape
-  bob::core::array::assertSameShape(i1, i2);
-  bob::core::array::assertSameShape(i2, i3);
-  bob::core::array::assertSameShape(Ex, Ey);
-  bob::core::array::assertSameShape(Ey, Et);
-  bob::core::array::assertSameShape(i1, Ex);
-  bob::core::array::assertSameShape(m_buffer1, i1);
+void bob::ip::optflow::CentralGradient::evaluateChannels
+(const blitz::Array<double,2>& image1, const blitz::Array<double,2>& image2,
+ const blitz::Array<double,2>& image3, blitz::Array<double,2>& Ex,
+ blitz::Array<double,2>& Ey, blitz::Array<double,2>& Et,
+ int channels) const {
+
+  bob::ip::optflow::trace::Span span("CentralGradient");
+
+  // all arrays evaluated have to have the same shape
+  check_channels(channels);
+  bob::core::array::assertSameShape(image1, image2);
+  bob::core::array::assertSameShape(image2, image3);
+  bob::core::array::assertSameShape(m_buffer1, image1);
+  if (channels & GradientX) bob::core::array::assertSameShape(image1, Ex);
+  if (channels & GradientY) bob::core::array::assertSameShape(image1, Ey);
+  if (channels & GradientT) bob::core::array::assertSameShape(image1, Et);
+
+  // Optional pre-smoothing, straight into buffers owned by this object
+  const blitz::Array<double,2>& i1 = m_sigma > 0. ? m_smooth1 : image1;
+  const blitz::Array<double,2>& i2 = m_sigma > 0. ? m_smooth2 : image2;
+  const blitz::Array<double,2>& i3 = m_sigma > 0. ? m_smooth3 : image3;
+  if (m_sigma > 0.) {
+    bob::ip::optflow::recursiveGaussian(image1, m_smooth1, m_sigma);
+    bob::ip::optflow::recursiveGaussian(image2, m_smooth2, m_sigma);
+    bob::ip::optflow::recursiveGaussian(image3, m_smooth3, m_sigma);
+  }
 
   // Notation:
   // DK - difference kernel
@@ -200,46 +515,62 @@ void bob::ip::optflow::CentralGradient::operator() (const blitz::Array<double,2>
   // A * B - A convolved with B (A is mirrored)
 
   // Differentiation along the X direction (extent 1) => Ex matrix
-  fastconv(i1, m_diff_kernel, Ex, 1); // Ex =  DK * i1
-  fastconv(Ex, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Ex
+  if (channels & GradientX) {
+    fastconv(i1, m_diff_kernel, Ex, 1); // Ex =  DK * i1
+    fastconv(Ex, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Ex
 
-  fastconv(i2, m_diff_kernel, Ex, 1); // Ex = DK * i2
-  fastconv(Ex, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Ex
+    fastconv(i2, m_diff_kernel, Ex, 1); // Ex = DK * i2
+    fastconv(Ex, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Ex
 
-  fastconv(i3, m_diff_kernel, Ex, 1); // Ex = DK * i3
-  fastconv(Ex, m_avg_kernel, m_buffer3, 0); // Buffer3 = AK^T * Ex
+    fastconv(i3, m_diff_kernel, Ex, 1); // Ex = DK * i3
+    fastconv(Ex, m_avg_kernel, m_buffer3, 0); // Buffer3 = AK^T * Ex
 
-  // The averaging operation along the t coordinate is performed by hand
-  Ex = (m_avg_kernel(2) * m_buffer1) + (m_avg_kernel(1) * m_buffer2) +
-    (m_avg_kernel(0) * m_buffer3);
+    // The averaging operation along the t coordinate is performed by hand
+    Ex = (m_avg_kernel(2) * m_buffer1) + (m_avg_kernel(1) * m_buffer2) +
+      (m_avg_kernel(0) * m_buffer3);
+  }
 
   // Differentiation along the Y direction (extent 0) => Ey matrix
-  fastconv(i1, m_diff_kernel, Ey, 0); // Ey =  DK^T * i1
-  fastconv(Ey, m_avg_kernel, m_buffer1, 1); // Buffer1 = AK * Ey
+  if (channels & GradientY) {
+    fastconv(i1, m_diff_kernel, Ey, 0); // Ey =  DK^T * i1
+    fastconv(Ey, m_avg_kernel, m_buffer1, 1); // Buffer1 = AK * Ey
 
-  fastconv(i2, m_diff_kernel, Ey, 0); // Ey =  DK^T * i2
-  fastconv(Ey, m_avg_kernel, m_buffer2, 1); // Buffer2 = AK * Ey
+    fastconv(i2, m_diff_kernel, Ey, 0); // Ey =  DK^T * i2
+    fastconv(Ey, m_avg_kernel, m_buffer2, 1); // Buffer2 = AK * Ey
 
-  fastconv(i3, m_diff_kernel, Ey, 0); // Ey =  DK^T * i3
-  fastconv(Ey, m_avg_kernel, m_buffer3, 1); // Buffer3 = AK * Ey
+    fastconv(i3, m_diff_kernel, Ey, 0); // Ey =  DK^T * i3
+    fastconv(Ey, m_avg_kernel, m_buffer3, 1); // Buffer3 = AK * Ey
 
-  // The averaging operation along the t coordinate is performed by hand
-  Ey = (m_avg_kernel(2) * m_buffer1) + (m_avg_kernel(1) * m_buffer2) +
-    (m_avg_kernel(0) * m_buffer3);
+    // The averaging operation along the t coordinate is performed by hand
+    Ey = (m_avg_kernel(2) * m_buffer1) + (m_avg_kernel(1) * m_buffer2) +
+      (m_avg_kernel(0) * m_buffer3);
+  }
 
   // Differentiation along the T direction i1 -> i2 => Et matrix
-  fastconv(i1, m_avg_kernel, Et, 1); // Et =  AK * i1
-  fastconv(Et, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Et
+  if (channels & GradientT) {
+    fastconv(i1, m_avg_kernel, Et, 1); // Et =  AK * i1
+    fastconv(Et, m_avg_kernel, m_buffer1, 0); // Buffer1 = AK^T * Et
+
+    fastconv(i2, m_avg_kernel, Et, 1); // Et =  AK * i2
+    fastconv(Et, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Et
+
+    fastconv(i3, m_avg_kernel, Et, 1); // Et =  AK * i3
+    fastconv(Et, m_avg_kernel, m_buffer3, 0); // Buffer3 = AK^T * Et
+
+    // The difference operation along the t coordinate is performed by hand
+    Et = (m_diff_kernel(2) * m_buffer1) + (m_diff_kernel(1) * m_buffer2) +
+      (m_diff_kernel(0) * m_buffer3);
+  }
+}
 
-  fastconv(i2, m_avg_kernel, Et, 1); // Et =  AK * i2
-  fastconv(Et, m_avg_kernel, m_buffer2, 0); // Buffer2 = AK^T * Et
+void bob::ip::optflow::CentralGradient::operator() (const blitz::Array<double,3>& frames,
+    blitz::Array<double,3>& Ex, blitz::Array<double,3>& Ey,
+    blitz::Array<double,3>& Et, size_t threads) const {
 
-  fastconv(i3, m_avg_kernel, Et, 1); // Et =  AK * i3
-  fastconv(Et, m_avg_kernel, m_buffer3, 0); // Buffer3 = AK^T * Et
+  bob::ip::optflow::trace::Span span("CentralGradient.volume");
 
-  // The difference operation along the t coordinate is performed by hand
-  Et = (m_diff_kernel(2) * m_buffer1) + (m_diff_kernel(1) * m_buffer2) +
-    (m_diff_kernel(0) * m_buffer3);
+  volume_gradient(m_diff_kernel, m_avg_kernel, m_sigma, m_buffer1.shape(),
+      frames, Ex, Ey, Et, threads);
 }
 
 static const double SOBEL_DIFF_KERNEL_DATA[] = {+1., 0., -1.};
@@ -277,3 +608,152 @@ bob::ip::optflow::IsotropicGradient::IsotropicGradient(const blitz::TinyVector<i
 }
 
 bob::ip::optflow::IsotropicGradient::~IsotropicGradient() { }
+
+/**
+ * Averaging weights of the integer kernels, in space and time (only the
+ * first two for Horn & Schunck)
+ */
+static const int16_t INTEGER_WEIGHTS[][3] = {{1, 1, 0}, {1, 2, 1}, {1, 1, 1}};
+
+bob::ip::optflow::IntegerGradient::IntegerGradient
+(bob::ip::optflow::IntegerKernel kernel,
+ const blitz::TinyVector<int,2>& shape):
+  m_kernel(kernel)
+{
+  if (kernel < IntegerHornAndSchunck || kernel > IntegerPrewitt) {
+    boost::format m("integer gradient kernels are 0 (Horn & Schunck), 1 (Sobel) or 2 (Prewitt), but you set %d");
+    m % kernel;
+    throw std::runtime_error(m.str());
+  }
+  setShape(shape);
+}
+
+void bob::ip::optflow::IntegerGradient::setShape
+(const blitz::TinyVector<int,2>& shape) {
+  if (shape(0) < 1 || shape(1) < 1) {
+    boost::format m("frames should have at least 1 pixel on each dimension, but you set their shape to (%d, %d)");
+    m % shape(0) % shape(1);
+    throw std::runtime_error(m.str());
+  }
+  m_shape = shape;
+  const size_t frame = shape(0) * shape(1);
+  m_pad.resize(shape(1) + 2);
+  m_diff.resize(getFrames() * frame);
+  m_avg.resize(getFrames() * frame);
+  m_row.resize(3 * shape(1));
+}
+
+int bob::ip::optflow::IntegerGradient::getFrames() const {
+  return m_kernel == IntegerHornAndSchunck ? 2 : 3;
+}
+
+double bob::ip::optflow::IntegerGradient::getScale() const {
+  return m_kernel == IntegerHornAndSchunck ? 0.25 : 1.;
+}
+
+void bob::ip::optflow::IntegerGradient::operator()
+(const blitz::Array<uint8_t,2>& i1, const blitz::Array<uint8_t,2>& i2,
+ blitz::Array<int16_t,2>& Ex, blitz::Array<int16_t,2>& Ey,
+ blitz::Array<int16_t,2>& Et) const {
+  const blitz::Array<uint8_t,2>* frames[] = {&i1, &i2};
+  evaluate(frames, 2, Ex, Ey, Et);
+}
+
+void bob::ip::optflow::IntegerGradient::operator()
+(const blitz::Array<uint8_t,2>& i1, const blitz::Array<uint8_t,2>& i2,
+ const blitz::Array<uint8_t,2>& i3, blitz::Array<int16_t,2>& Ex,
+ blitz::Array<int16_t,2>& Ey, blitz::Array<int16_t,2>& Et) const {
+  const blitz::Array<uint8_t,2>* frames[] = {&i1, &i2, &i3};
+  evaluate(frames, 3, Ex, Ey, Et);
+}
+
+void bob::ip::optflow::IntegerGradient::evaluate
+(const blitz::Array<uint8_t,2>* const* frames, int n,
+ blitz::Array<int16_t,2>& Ex, blitz::Array<int16_t,2>& Ey,
+ blitz::Array<int16_t,2>& Et) const {
+
+  bob::ip::optflow::trace::Span span("IntegerGradient");
+
+  if (n != getFrames()) {
+    boost::format m("this integer gradient takes %d frames, but you gave %d");
+    m % getFrames() % n;
+    throw std::runtime_error(m.str());
+  }
+  for (int f=0; f<n; ++f)
+    bob::core::array::assertSameShape(*frames[f], m_shape);
+  bob::core::array::assertSameShape(Ex, m_shape);
+  bob::core::array::assertSameShape(Ey, m_shape);
+  bob::core::array::assertSameShape(Et, m_shape);
+
+  // Borders replicate the pixels on the edges, as the floating-point
+  // operators do. Central kernels need a pixel on the left, too.
+  const int height = m_shape(0);
+  const int width = m_shape(1);
+  const int left = n - 2;
+  const int16_t* w = INTEGER_WEIGHTS[m_kernel];
+  const int16_t c = w[1];
+  int16_t* pad = m_pad.data();
+
+  // Differences and averages along rows, of every frame
+  for (int f=0; f<n; ++f) {
+    const blitz::Array<uint8_t,2>& frame = *frames[f];
+    for (int y=0; y<height; ++y) {
+      for (int x=0; x<width; ++x) pad[left+x] = frame(y,x);
+      pad[0] = pad[left];
+      pad[left+width] = pad[left+width-1];
+      int16_t* d = &m_diff[(f*height + y)*width];
+      int16_t* a = &m_avg[(f*height + y)*width];
+      if (n == 2) {
+        for (int x=0; x<width; ++x) {
+          d[x] = pad[x+1] - pad[x];
+          a[x] = pad[x] + pad[x+1];
+        }
+      }
+      else {
+        for (int x=0; x<width; ++x) {
+          d[x] = pad[x+2] - pad[x];
+          a[x] = pad[x] + c*pad[x+1] + pad[x+2];
+        }
+      }
+    }
+  }
+
+  // Along columns, adding every frame with its weight along time
+  int16_t* ex = m_row.data();
+  int16_t* ey = ex + width;
+  int16_t* et = ey + width;
+  for (int y=0; y<height; ++y) {
+    std::fill(m_row.begin(), m_row.end(), 0);
+    const int up = std::max(y-1, 0) - y;
+    const int down = std::min(y+1, height-1) - y;
+    for (int f=0; f<n; ++f) {
+      const int16_t wf = w[f];
+      const int16_t tf = (f == 0) ? -1 : (f == n-1 ? 1 : 0);
+      const int16_t* d = &m_diff[(f*height + y)*width];
+      const int16_t* a = &m_avg[(f*height + y)*width];
+      const int16_t* d0 = d + up*width;
+      const int16_t* a0 = a + up*width;
+      const int16_t* d2 = d + down*width;
+      const int16_t* a2 = a + down*width;
+      if (n == 2) {
+        for (int x=0; x<width; ++x) {
+          ex[x] += wf * (d[x] + d2[x]);
+          ey[x] += wf * (a2[x] - a[x]);
+          et[x] += tf * (a[x] + a2[x]);
+        }
+      }
+      else {
+        for (int x=0; x<width; ++x) {
+          ex[x] += wf * (d0[x] + c*d[x] + d2[x]);
+          ey[x] += wf * (a2[x] - a0[x]);
+          et[x] += tf * (a0[x] + c*a[x] + a2[x]);
+        }
+      }
+    }
+    for (int x=0; x<width; ++x) {
+      Ex(y,x) = ex[x];
+      Ey(y,x) = ey[x];
+      Et(y,x) = et[x];
+    }
+  }
+}
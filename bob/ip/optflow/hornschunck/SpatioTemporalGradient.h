@@ -10,10 +10,35 @@
 #ifndef BOB_IP_SPATIOTEMPORALGRADIENT_H
 #define BOB_IP_SPATIOTEMPORALGRADIENT_H
 
+#include <stdint.h>
+#include <vector>
 #include <blitz/array.h>
 
 namespace bob { namespace ip { namespace optflow {
 
+  /**
+   * Smooths an image with a Gaussian of the given standard deviation (at
+   * least 0.5 pixels), using the recursive filter of Young & van Vliet
+   * ("Recursive implementation of the Gaussian filter", Signal Processing,
+   * Vol. 44, No. 2, pp. 139-151, 1995): a causal and an anti-causal pass of
+   * a 3rd order filter along each dimension. The cost per pixel does not
+   * depend on sigma. Borders are extended by replicating the pixels on the
+   * edges. The input and output arrays may be the same.
+   */
+  void recursiveGaussian(const blitz::Array<double,2>& input,
+      blitz::Array<double,2>& output, double sigma);
+
+  /**
+   * The channels of a spatio-temporal gradient. They may be or-ed together,
+   * to evaluate some of them only.
+   */
+  typedef enum GradientChannel {
+    GradientX = 1, ///< Ex, the derivative along the horizontal direction
+    GradientY = 2, ///< Ey, the derivative along the vertical direction
+    GradientT = 4, ///< Et, the derivative along time
+    GradientAll = 7 ///< Ex, Ey and Et
+  } GradientChannel;
+
   /**
    * This class computes the spatio-temporal gradient using a 2-term
    * approximation composed of 2 separable kernels (one for the diference term
@@ -96,6 +121,19 @@ namespace bob { namespace ip { namespace optflow {
        */
       void setAvgKernel(const blitz::Array<double,1>& k);
 
+      /**
+       * Gets the standard deviation of the Gaussian smoothing applied to the
+       * input images, or 0 if they are not smoothed
+       */
+      inline double getSigma() const { return m_sigma; }
+
+      /**
+       * Sets the standard deviation (in pixels) of a Gaussian smoothing
+       * applied to the input images before differentiation (see
+       * recursiveGaussian()), or 0 to disable it
+       */
+      void setSigma(double sigma);
+
       /**
        * Call this to run the gradient operator and return Ex, Ey and Et - the
        * spatio temporal gradients for the image pair i1, i2
@@ -104,12 +142,39 @@ namespace bob { namespace ip { namespace optflow {
         const blitz::Array<double,2>& i2, blitz::Array<double,2>& Ex,
         blitz::Array<double,2>& Ey, blitz::Array<double,2>& Et) const;
 
+      /**
+       * Evaluates only the channels set on channels (GradientChannel's or-ed
+       * together), skipping the convolutions of the others. The arrays of
+       * the other channels are neither checked nor touched, so they may be
+       * empty. Evaluated channels are the same as with operator().
+       */
+      void evaluateChannels(const blitz::Array<double,2>& i1,
+        const blitz::Array<double,2>& i2, blitz::Array<double,2>& Ex,
+        blitz::Array<double,2>& Ey, blitz::Array<double,2>& Et,
+        int channels) const;
+
+      /**
+       * Evaluates Ex, Ey and Et for every pair of consecutive frames on a
+       * stack (frames x height x width), into volumes with one frame less.
+       * Each frame is filtered once and its contribution is added to every
+       * gradient it takes part in, with the same results as calling the
+       * above for each pair. The time axis is split in chunks processed in
+       * parallel by the given number of threads (0 means one per core);
+       * frames on the boundaries of chunks are filtered by both.
+       */
+      void operator()(const blitz::Array<double,3>& frames,
+        blitz::Array<double,3>& Ex, blitz::Array<double,3>& Ey,
+        blitz::Array<double,3>& Et, size_t threads=1) const;
+
     private: //representation
 
       blitz::Array<double,1> m_diff_kernel;
       blitz::Array<double,1> m_avg_kernel;
       mutable blitz::Array<double,2> m_buffer1;
       mutable blitz::Array<double,2> m_buffer2;
+      double m_sigma;
+      mutable blitz::Array<double,2> m_smooth1; ///< smoothed i1
+      mutable blitz::Array<double,2> m_smooth2; ///< smoothed i2
 
   };
 
@@ -228,6 +293,19 @@ namespace bob { namespace ip { namespace optflow {
        */
       void setAvgKernel(const blitz::Array<double,1>& k);
 
+      /**
+       * Gets the standard deviation of the Gaussian smoothing applied to the
+       * input images, or 0 if they are not smoothed
+       */
+      inline double getSigma() const { return m_sigma; }
+
+      /**
+       * Sets the standard deviation (in pixels) of a Gaussian smoothing
+       * applied to the input images before differentiation (see
+       * recursiveGaussian()), or 0 to disable it
+       */
+      void setSigma(double sigma);
+
       /**
        * Call this to run the gradient operator.
        */
@@ -236,6 +314,24 @@ namespace bob { namespace ip { namespace optflow {
           blitz::Array<double,2>& Ex, blitz::Array<double,2>& Ey,
           blitz::Array<double,2>& Et) const;
 
+      /**
+       * Evaluates only the channels set on channels. See
+       * ForwardGradient::evaluateChannels() for details.
+       */
+      void evaluateChannels(const blitz::Array<double,2>& i1,
+          const blitz::Array<double,2>& i2, const blitz::Array<double,2>& i3,
+          blitz::Array<double,2>& Ex, blitz::Array<double,2>& Ey,
+          blitz::Array<double,2>& Et, int channels) const;
+
+      /**
+       * Evaluates Ex, Ey and Et for every triplet of consecutive frames on a
+       * stack (frames x height x width), into volumes with two frames less.
+       * See ForwardGradient for details.
+       */
+      void operator() (const blitz::Array<double,3>& frames,
+          blitz::Array<double,3>& Ex, blitz::Array<double,3>& Ey,
+          blitz::Array<double,3>& Et, size_t threads=1) const;
+
     private: //representation
 
       blitz::Array<double,1> m_diff_kernel;
@@ -243,6 +339,10 @@ namespace bob { namespace ip { namespace optflow {
       mutable blitz::Array<double,2> m_buffer1;
       mutable blitz::Array<double,2> m_buffer2;
       mutable blitz::Array<double,2> m_buffer3;
+      double m_sigma;
+      mutable blitz::Array<double,2> m_smooth1; ///< smoothed i1
+      mutable blitz::Array<double,2> m_smooth2; ///< smoothed i2
+      mutable blitz::Array<double,2> m_smooth3; ///< smoothed i3
 
   };
 
@@ -337,6 +437,92 @@ namespace bob { namespace ip { namespace optflow {
 
   };
 
+  /**
+   * The gradients with integer kernels, which IntegerGradient evaluates
+   * exactly on 8-bit frames
+   */
+  typedef enum IntegerKernel {
+    IntegerHornAndSchunck = 0, ///< as HornAndSchunckGradient (2 frames)
+    IntegerSobel, ///< as SobelGradient (3 frames)
+    IntegerPrewitt ///< as PrewittGradient (3 frames)
+  } IntegerKernel;
+
+  /**
+   * Evaluates the Horn & Schunck, Sobel or Prewitt gradients of 8-bit
+   * frames exactly, in 16-bit integer arithmetic. With the same borders as
+   * the floating-point operators, the gradients they return are getScale()
+   * times the integer ones: 1/4 for Horn & Schunck, 1 for the others. All
+   * intermediates and results fit 16 bits (at most 4080 in magnitude, for
+   * Sobel).
+   *
+   * Every frame is filtered along rows, then along columns, over contiguous
+   * 16-bit buffers, and its contribution is added to the outputs with its
+   * weight along time.
+   */
+  class IntegerGradient {
+
+    public: //api
+
+      /**
+       * Constructor, with the kernel and the shape of the frames
+       */
+      IntegerGradient(IntegerKernel kernel,
+          const blitz::TinyVector<int,2>& shape);
+
+      inline IntegerKernel getKernel() const { return m_kernel; }
+
+      inline const blitz::TinyVector<int,2>& getShape() const {
+        return m_shape;
+      }
+
+      /**
+       * Re-shape internal buffers
+       */
+      void setShape(const blitz::TinyVector<int,2>& shape);
+
+      /**
+       * The number of frames the kernel takes: 2 or 3
+       */
+      int getFrames() const;
+
+      /**
+       * The factor from the integer gradients to those of the
+       * floating-point operators
+       */
+      double getScale() const;
+
+      /**
+       * Evaluates the gradients of 2 frames (Horn & Schunck only)
+       */
+      void operator()(const blitz::Array<uint8_t,2>& i1,
+          const blitz::Array<uint8_t,2>& i2, blitz::Array<int16_t,2>& Ex,
+          blitz::Array<int16_t,2>& Ey, blitz::Array<int16_t,2>& Et) const;
+
+      /**
+       * Evaluates the gradients of 3 frames (Sobel and Prewitt only)
+       */
+      void operator()(const blitz::Array<uint8_t,2>& i1,
+          const blitz::Array<uint8_t,2>& i2, const blitz::Array<uint8_t,2>& i3,
+          blitz::Array<int16_t,2>& Ex, blitz::Array<int16_t,2>& Ey,
+          blitz::Array<int16_t,2>& Et) const;
+
+    private: //helpers
+
+      void evaluate(const blitz::Array<uint8_t,2>* const* frames, int n,
+          blitz::Array<int16_t,2>& Ex, blitz::Array<int16_t,2>& Ey,
+          blitz::Array<int16_t,2>& Et) const;
+
+    private: //representation
+
+      IntegerKernel m_kernel;
+      blitz::TinyVector<int,2> m_shape;
+      mutable std::vector<int16_t> m_pad; ///< a row, with its borders
+      mutable std::vector<int16_t> m_diff; ///< differences along rows
+      mutable std::vector<int16_t> m_avg; ///< averages along rows
+      mutable std::vector<int16_t> m_row; ///< a row of Ex, Ey and Et
+
+  };
+
 }}}
 
 #endif /* BOB_IP_SPATIOTEMPORALGRADIENT_H */
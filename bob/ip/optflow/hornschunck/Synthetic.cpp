@@ -0,0 +1,236 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:53:32 2026 +0000
+ *
+ * @brief Implements the generation of synthetic image sequences under known
+ * motion
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <cmath>
+#include <thread>
+#include <random>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <boost/format.hpp>
+#include <bob.core/assert.h>
+
+#include "Synthetic.h"
+#include "Trace.h"
+
+/**
+ * Sinusoids summed into the texture
+ */
+static const int COMPONENTS = 12;
+
+/**
+ * Offset, in pixels, between the textures of consecutive patches
+ */
+static const double PATCH_OFFSET = 1000.;
+
+/**
+ * An affine map of image coordinates: (x, y) -> (a*x + b*y + c, d*x + e*y +
+ * f)
+ */
+struct Affine {
+
+  double a, b, c, d, e, f;
+
+  /**
+   * Applies this map after another one
+   */
+  Affine after(const Affine& o) const {
+    return {a*o.a + b*o.d, a*o.b + b*o.e, a*o.c + b*o.f + c,
+      d*o.a + e*o.d, d*o.b + e*o.e, d*o.c + e*o.f + f};
+  }
+
+};
+
+/**
+ * The motion of the background between consecutive frames, or its inverse
+ */
+static Affine step(const blitz::TinyVector<int,2>& shape, double u, double v,
+    double rotation, double zoom, bool inverse) {
+  const double cx = (shape(1) - 1) / 2.;
+  const double cy = (shape(0) - 1) / 2.;
+  const double cs = std::cos(rotation);
+  const double sn = std::sin(rotation);
+  if (!inverse) {
+    //c + M*(p - c) + t, with M = zoom * R(rotation)
+    const double a = zoom*cs, b = -zoom*sn, d = zoom*sn, e = zoom*cs;
+    return {a, b, cx - a*cx - b*cy + u, d, e, cy - d*cx - e*cy + v};
+  }
+  //c + M^-1*(q - c - t)
+  const double a = cs/zoom, b = sn/zoom, d = -sn/zoom, e = cs/zoom;
+  const double tx = cx + u, ty = cy + v;
+  return {a, b, cx - a*tx - b*ty, d, e, cy - d*tx - e*ty};
+}
+
+/**
+ * Splits the rows of an image in chunks processed by separate threads
+ */
+template <typename F>
+static void for_rows(int height, size_t threads, F rows) {
+
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  const int chunks = std::min<int>(threads, height);
+  if (chunks <= 1) {
+    rows(0, height);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(chunks);
+  std::vector<std::thread> workers;
+  for (int c=0; c<chunks; ++c) {
+    const int first = (c * height) / chunks;
+    const int last = ((c + 1) * height) / chunks;
+    workers.push_back(std::thread([&, c, first, last]() {
+          try {
+            rows(first, last);
+          }
+          catch (...) {
+            errors[c] = std::current_exception();
+          }
+          }));
+  }
+  for (auto& w: workers) w.join();
+  for (auto& e: errors) if (e) std::rethrow_exception(e);
+}
+
+/**
+ * Returns the topmost patch covering the pixel (y, x) on the given frame, or
+ * 0 for the background
+ */
+static const double* patch_at(const std::vector<double>& patches,
+    size_t frame, int y, int x) {
+  for (size_t i=patches.size(); i>0; i-=5) {
+    const double* p = &patches[i-5];
+    const double dy = y - (p[0] + frame*p[4]);
+    const double dx = x - (p[1] + frame*p[3]);
+    if (dy*dy + dx*dx <= p[2]*p[2]) return p;
+  }
+  return 0;
+}
+
+bob::ip::optflow::SyntheticSequence::SyntheticSequence
+(const blitz::TinyVector<int,2>& shape, size_t seed):
+  m_shape(shape),
+  m_u(0.),
+  m_v(0.),
+  m_rotation(0.),
+  m_zoom(1.)
+{
+  if (shape(0) < 1 || shape(1) < 1) {
+    boost::format m("synthetic images should have at least 1 pixel on each dimension, but you set their shape to (%d, %d)");
+    m % shape(0) % shape(1);
+    throw std::runtime_error(m.str());
+  }
+
+  //draws from the generator directly, as distributions are not portable
+  std::mt19937 rng(seed);
+  auto uniform = [&rng](double low, double high) {
+    return low + (high - low) * (rng() / 4294967296.);
+  };
+  double total = 0.;
+  for (int k=0; k<COMPONENTS; ++k) {
+    const double angle = uniform(0., 2*M_PI);
+    const double frequency = 2*M_PI / uniform(4., 24.);
+    m_fx.push_back(frequency * std::cos(angle));
+    m_fy.push_back(frequency * std::sin(angle));
+    m_phase.push_back(uniform(0., 2*M_PI));
+    m_amplitude.push_back(uniform(0.5, 1.));
+    total += m_amplitude.back();
+  }
+  //keeps values within [0, 255]
+  for (auto& a: m_amplitude) a *= 127.5 / total;
+}
+
+void bob::ip::optflow::SyntheticSequence::setMotion(double u, double v,
+    double rotation, double zoom) {
+  if (!(zoom > 0.)) {
+    boost::format m("the zoom factor should be positive, but you set it to %g");
+    m % zoom;
+    throw std::runtime_error(m.str());
+  }
+  m_u = u;
+  m_v = v;
+  m_rotation = rotation;
+  m_zoom = zoom;
+}
+
+void bob::ip::optflow::SyntheticSequence::addPatch(double y, double x,
+    double radius, double u, double v) {
+  if (!(radius >= 0.)) {
+    boost::format m("the radius of patches should be non-negative, but you set it to %g");
+    m % radius;
+    throw std::runtime_error(m.str());
+  }
+  const double patch[] = {y, x, radius, u, v};
+  m_patches.insert(m_patches.end(), patch, patch+5);
+}
+
+void bob::ip::optflow::SyntheticSequence::image(size_t frame,
+    blitz::Array<double,2>& image, size_t threads) const {
+
+  bob::core::array::assertSameShape(image, m_shape);
+  bob::ip::optflow::trace::Span span("synthetic_image");
+
+  //where the pixels of this frame come from, on the first one
+  const Affine back = step(m_shape, m_u, m_v, m_rotation, m_zoom, true);
+  Affine source = {1., 0., 0., 0., 1., 0.};
+  for (size_t k=0; k<frame; ++k) source = back.after(source);
+
+  auto texture = [this](double y, double x) {
+    double value = 127.5;
+    for (int k=0; k<COMPONENTS; ++k)
+      value += m_amplitude[k] * std::sin(m_fx[k]*x + m_fy[k]*y + m_phase[k]);
+    return value;
+  };
+
+  for_rows(m_shape(0), threads, [&](int first, int last) {
+      for (int y=first; y<last; ++y) {
+        for (int x=0; x<m_shape(1); ++x) {
+          const double* p = patch_at(m_patches, frame, y, x);
+          if (p) {
+            const double offset = PATCH_OFFSET * ((p - m_patches.data())/5 + 1);
+            image(y,x) = texture(y - frame*p[4] + offset,
+                x - frame*p[3] + offset);
+          }
+          else {
+            image(y,x) = texture(source.d*x + source.e*y + source.f,
+                source.a*x + source.b*y + source.c);
+          }
+        }
+      }
+  });
+}
+
+void bob::ip::optflow::SyntheticSequence::flow(size_t frame,
+    blitz::Array<double,2>& u, blitz::Array<double,2>& v,
+    size_t threads) const {
+
+  bob::core::array::assertSameShape(u, m_shape);
+  bob::core::array::assertSameShape(v, m_shape);
+  bob::ip::optflow::trace::Span span("synthetic_flow");
+
+  //the background moves the same way on every frame
+  const Affine forward = step(m_shape, m_u, m_v, m_rotation, m_zoom, false);
+
+  for_rows(m_shape(0), threads, [&](int first, int last) {
+      for (int y=first; y<last; ++y) {
+        for (int x=0; x<m_shape(1); ++x) {
+          const double* p = patch_at(m_patches, frame, y, x);
+          if (p) {
+            u(y,x) = p[3];
+            v(y,x) = p[4];
+          }
+          else {
+            u(y,x) = forward.a*x + forward.b*y + forward.c - x;
+            v(y,x) = forward.d*x + forward.e*y + forward.f - y;
+          }
+        }
+      }
+  });
+}
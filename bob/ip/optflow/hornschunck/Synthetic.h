@@ -0,0 +1,92 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:53:32 2026 +0000
+ *
+ * @brief Synthetic image sequences under known motion, with their exact
+ * ground-truth flow
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BOB_IP_OPTFLOW_SYNTHETIC_H
+#define BOB_IP_OPTFLOW_SYNTHETIC_H
+
+#include <cstdlib>
+#include <vector>
+#include <blitz/array.h>
+
+namespace bob { namespace ip { namespace optflow {
+
+  /**
+   * Generates sequences of textured images of any size and length under a
+   * parametric motion, together with their exact flow, for benchmarks and
+   * accuracy tests.
+   *
+   * The texture is a sum of sinusoids of random orientations, wavelengths
+   * (4 to 24 pixels) and phases, drawn from the seed, with values in
+   * [0, 255]. It is evaluated analytically at the sub-pixel position every
+   * pixel comes from, so images are never interpolated and the flow is
+   * exact. Between consecutive frames, the background moves by a similarity
+   * transform around the image centre: a zoom (scale factor), a rotation
+   * (radians, from the x axis towards the y axis) and a translation (u, v),
+   * in that order. Patches are discs with a texture of their own, moving
+   * by constant translations over the background (later patches on top).
+   *
+   * The flow of frame k goes from frame k to frame k+1, with the convention
+   * of the solvers: the pixel (y, x) of frame k moves to (y+v, x+u) of frame
+   * k+1. Rows are generated in parallel, by the given number of threads (0
+   * means one per core), with the same results whatever the number.
+   */
+  class SyntheticSequence {
+
+    public: //api
+
+      /**
+       * Creates a sequence of images with the given shape, without motion
+       */
+      SyntheticSequence(const blitz::TinyVector<int,2>& shape,
+          size_t seed=0);
+
+      /**
+       * Sets the motion of the background, between consecutive frames
+       */
+      void setMotion(double u, double v, double rotation=0., double zoom=1.);
+
+      /**
+       * Adds a disc with the given centre (on the first frame) and radius,
+       * moving by (u, v) between consecutive frames
+       */
+      void addPatch(double y, double x, double radius, double u, double v);
+
+      /**
+       * Generates the given frame
+       */
+      void image(size_t frame, blitz::Array<double,2>& image,
+          size_t threads=1) const;
+
+      /**
+       * Generates the exact flow from the given frame to the next one
+       */
+      void flow(size_t frame, blitz::Array<double,2>& u,
+          blitz::Array<double,2>& v, size_t threads=1) const;
+
+      inline const blitz::TinyVector<int,2>& getShape() const { return m_shape; }
+
+    private: //representation
+
+      blitz::TinyVector<int,2> m_shape;
+      double m_u; ///< background translation, horizontal
+      double m_v; ///< background translation, vertical
+      double m_rotation; ///< background rotation, in radians
+      double m_zoom; ///< background scale factor
+      std::vector<double> m_fx; ///< texture frequencies, horizontal
+      std::vector<double> m_fy; ///< texture frequencies, vertical
+      std::vector<double> m_phase; ///< texture phases
+      std::vector<double> m_amplitude; ///< texture amplitudes, normalized
+      std::vector<double> m_patches; ///< y, x, radius, u, v of every patch
+
+  };
+
+}}}
+
+#endif /* BOB_IP_OPTFLOW_SYNTHETIC_H */
@@ -0,0 +1,240 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:04:36 2026 +0000
+ *
+ * @brief Implementation of the span recorder and the Chrome trace exporter
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <unistd.h>
+
+#include "Trace.h"
+
+std::atomic<bool> bob::ip::optflow::trace::s_enabled(false);
+
+/**
+ * Spans recorded by a single thread. Only the owning thread writes events;
+ * the number of valid events is published with release semantics, so the
+ * exporter can read a consistent prefix at any time.
+ */
+struct ThreadBuffer {
+
+  static const size_t CAPACITY = 1 << 16;
+
+  struct Event {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  explicit ThreadBuffer(int id): tid(id), size(0), events(CAPACITY) { }
+
+  int tid;
+  std::atomic<size_t> size;
+  std::vector<Event> events;
+
+};
+
+/**
+ * The spans of a thread that exited, moved out of its buffer
+ */
+struct Retired {
+  int tid;
+  std::vector<ThreadBuffer::Event> events;
+};
+
+/**
+ * How many spans of exited threads are kept, at most, until the trace is
+ * cleared
+ */
+static const size_t RETIRED_CAPACITY = 16 * ThreadBuffer::CAPACITY;
+
+static std::mutex s_mutex; ///< protects the containers below
+static std::vector<ThreadBuffer*> s_buffers; ///< all buffers, with their spans
+static std::vector<ThreadBuffer*> s_free; ///< emptied buffers of exited threads
+static std::vector<Retired> s_retired; ///< spans of exited threads
+static size_t s_retired_events = 0; ///< spans on s_retired
+static int s_tids = 0; ///< thread ids handed out so far
+static std::set<std::string> s_names; ///< interned names
+static std::atomic<uint64_t> s_dropped(0);
+static const std::chrono::steady_clock::time_point s_epoch =
+  std::chrono::steady_clock::now();
+
+/**
+ * Hands the buffer of a thread back when the thread exits, so the next
+ * thread to record reuses it instead of allocating a new one. Threads come
+ * and go with every parallel call, so buffers are bounded by the threads
+ * recording at the same time. The spans of the thread are moved aside
+ * first, so the next thread starts from an empty buffer.
+ */
+struct BufferOwner {
+
+  BufferOwner(): buffer(0) { }
+
+  ~BufferOwner() {
+    if (!buffer) return;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const size_t size = buffer->size.load(std::memory_order_acquire);
+    const size_t kept = std::min(size, RETIRED_CAPACITY - s_retired_events);
+    if (kept) {
+      Retired r;
+      r.tid = buffer->tid;
+      r.events.assign(buffer->events.begin(), buffer->events.begin() + kept);
+      s_retired.push_back(r);
+      s_retired_events += kept;
+    }
+    s_dropped.fetch_add(size - kept, std::memory_order_relaxed);
+    buffer->size.store(0, std::memory_order_release);
+    s_free.push_back(buffer);
+  }
+
+  ThreadBuffer* buffer;
+
+};
+
+static thread_local ThreadBuffer* t_buffer = 0;
+static thread_local BufferOwner t_owner;
+
+/**
+ * Returns the buffer of the calling thread, taking one on first use. Every
+ * thread gets an id of its own, even on a reused buffer.
+ */
+static ThreadBuffer* buffer() {
+  if (!t_buffer) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_free.empty()) {
+      t_buffer = new ThreadBuffer(++s_tids);
+      s_buffers.push_back(t_buffer);
+    }
+    else {
+      t_buffer = s_free.back();
+      s_free.pop_back();
+      t_buffer->tid = ++s_tids;
+    }
+    t_owner.buffer = t_buffer;
+  }
+  return t_buffer;
+}
+
+void bob::ip::optflow::trace::enable(bool on) {
+  s_enabled.store(on, std::memory_order_relaxed);
+}
+
+uint64_t bob::ip::optflow::trace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - s_epoch).count();
+}
+
+void bob::ip::optflow::trace::record(const char* name, uint64_t begin,
+    uint64_t end) {
+  ThreadBuffer* b = buffer();
+  size_t size = b->size.load(std::memory_order_relaxed);
+  if (size == ThreadBuffer::CAPACITY) {
+    s_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ThreadBuffer::Event& e = b->events[size];
+  e.name = name;
+  e.begin = begin;
+  e.end = end;
+  b->size.store(size + 1, std::memory_order_release);
+}
+
+const char* bob::ip::optflow::trace::intern(const std::string& name) {
+  std::lock_guard<std::mutex> lock(s_mutex);
+  return s_names.insert(name).first->c_str();
+}
+
+void bob::ip::optflow::trace::clear() {
+  std::lock_guard<std::mutex> lock(s_mutex);
+  for (size_t k=0; k<s_buffers.size(); ++k)
+    s_buffers[k]->size.store(0, std::memory_order_release);
+  s_retired.clear();
+  s_retired_events = 0;
+  s_dropped.store(0, std::memory_order_relaxed);
+}
+
+uint64_t bob::ip::optflow::trace::dropped() {
+  return s_dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * Appends a JSON string literal, escaping as required
+ */
+static void append_string(std::string& out, const char* s) {
+  out += '"';
+  for (; *s; ++s) {
+    switch (*s) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(*s) < 0x20) {
+          char tmp[8];
+          std::snprintf(tmp, sizeof(tmp), "\\u%04x", *s);
+          out += tmp;
+        }
+        else out += *s;
+    }
+  }
+  out += '"';
+}
+
+/**
+ * Appends the spans of a thread, after its name
+ */
+static void append_thread(std::string& out, bool& first, long pid, int tid,
+    const ThreadBuffer::Event* events, size_t size) {
+
+  if (!size) return;
+  char tmp[128];
+
+  std::snprintf(tmp, sizeof(tmp), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", first? "" : ",", pid, tid, tid);
+  out += tmp;
+  first = false;
+
+  for (size_t i=0; i<size; ++i) {
+    const ThreadBuffer::Event& e = events[i];
+    out += ",{\"name\":";
+    append_string(out, e.name);
+    //timestamps are in microseconds
+    std::snprintf(tmp, sizeof(tmp), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%d}", e.begin / 1e3, (e.end - e.begin) / 1e3, pid, tid);
+    out += tmp;
+  }
+
+}
+
+std::string bob::ip::optflow::trace::json() {
+
+  std::lock_guard<std::mutex> lock(s_mutex);
+
+  const long pid = getpid();
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  char tmp[128];
+
+  for (size_t k=0; k<s_retired.size(); ++k)
+    append_thread(out, first, pid, s_retired[k].tid,
+        s_retired[k].events.data(), s_retired[k].events.size());
+
+  for (size_t k=0; k<s_buffers.size(); ++k) {
+    const ThreadBuffer& b = *s_buffers[k];
+    append_thread(out, first, pid, b.tid, b.events.data(),
+        b.size.load(std::memory_order_acquire));
+  }
+
+  //spans lost to full buffers, so an incomplete timeline is not misread
+  std::snprintf(tmp, sizeof(tmp), "],\"otherData\":{\"dropped\":%llu}}",
+      static_cast<unsigned long long>(dropped()));
+  out += tmp;
+  return out;
+
+}
@@ -0,0 +1,107 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:04:36 2026 +0000
+ *
+ * @brief Records timed spans and exports them as Chrome trace events
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BOB_IP_OPTFLOW_TRACE_H
+#define BOB_IP_OPTFLOW_TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+namespace bob { namespace ip { namespace optflow { namespace trace {
+
+  /**
+   * Tracing is off by default. While it is off, creating a Span costs a
+   * single relaxed atomic load.
+   */
+  extern std::atomic<bool> s_enabled;
+
+  /**
+   * Tells if spans are being recorded
+   */
+  inline bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * Switches recording on or off, at any time and from any thread
+   */
+  void enable(bool on);
+
+  /**
+   * Nanoseconds elapsed on a monotonic clock, since the module was loaded
+   */
+  uint64_t now();
+
+  /**
+   * Records a span on the buffer of the calling thread. Each thread owns its
+   * buffer, so recording takes no lock. When a thread exits, its spans are
+   * moved aside for json() and its emptied buffer passes on to the next
+   * thread that records, under a new thread id. Once a buffer is full,
+   * further spans of its thread are dropped (and counted), as are spans of
+   * exited threads beyond 16 buffers' worth. The name must remain valid
+   * until the trace is cleared: use a string literal or intern().
+   */
+  void record(const char* name, uint64_t begin, uint64_t end);
+
+  /**
+   * Returns a copy of the given name that remains valid for the lifetime of
+   * the process. Use it for dynamically built names.
+   */
+  const char* intern(const std::string& name);
+
+  /**
+   * Discards all recorded spans. Call it when no thread is recording.
+   */
+  void clear();
+
+  /**
+   * The number of spans dropped because a thread buffer, or the spans kept
+   * from exited threads, was full
+   */
+  uint64_t dropped();
+
+  /**
+   * Returns all spans recorded so far in the Chrome trace event format
+   * (JSON), which can be loaded in chrome://tracing or Perfetto. Spans
+   * recorded concurrently with this call may or may not be included.
+   */
+  std::string json();
+
+  /**
+   * Records the time between its construction and its destruction, if
+   * tracing was enabled at construction time.
+   */
+  class Span {
+
+    public: //api
+
+      explicit Span(const char* name):
+        m_name(enabled()? name : 0),
+        m_begin(m_name? now() : 0)
+      {
+      }
+
+      ~Span() {
+        if (m_name) record(m_name, m_begin, now());
+      }
+
+    private: //not copiable
+
+      Span(const Span&);
+      Span& operator= (const Span&);
+
+    private: //representation
+
+      const char* m_name;
+      uint64_t m_begin;
+
+  };
+
+}}}}
+
+#endif /* BOB_IP_OPTFLOW_TRACE_H */
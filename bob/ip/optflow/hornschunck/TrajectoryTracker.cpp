@@ -0,0 +1,205 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:45:12 2026 +0000
+ *
+ * @brief Implements the tracking of points along sequences of flow fields
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <cmath>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <boost/format.hpp>
+#include <bob.core/assert.h>
+
+#include "TrajectoryTracker.h"
+#include "Trace.h"
+
+/**
+ * The fewest points advanced by each thread, below which starting threads
+ * costs more than it saves
+ */
+static const size_t MIN_POINTS_PER_THREAD = 1024;
+
+/**
+ * Samples a flow field bilinearly at (y, x), which should be within the
+ * image
+ */
+static inline double sample(const blitz::Array<double,2>& flow, double y,
+    double x) {
+  const int height = flow.extent(0);
+  const int width = flow.extent(1);
+  const int y0 = std::min(static_cast<int>(y), std::max(height-2, 0));
+  const int x0 = std::min(static_cast<int>(x), std::max(width-2, 0));
+  const int y1 = std::min(y0+1, height-1);
+  const int x1 = std::min(x0+1, width-1);
+  const double ay = y - y0;
+  const double ax = x - x0;
+  return (1.-ay)*((1.-ax)*flow(y0,x0) + ax*flow(y0,x1)) +
+    ay*((1.-ax)*flow(y1,x0) + ax*flow(y1,x1));
+}
+
+static inline bool inside(double y, double x,
+    const blitz::TinyVector<int,2>& shape) {
+  //false for NaNs as well
+  return y >= 0. && y <= shape(0)-1 && x >= 0. && x <= shape(1)-1;
+}
+
+static void check_threshold(double threshold) {
+  if (!(threshold >= 0.)) {
+    boost::format m("forward-backward threshold should be non-negative, but you set it to %g");
+    m % threshold;
+    throw std::runtime_error(m.str());
+  }
+}
+
+bob::ip::optflow::TrajectoryTracker::TrajectoryTracker
+(const blitz::TinyVector<int,2>& shape, double threshold, size_t threads):
+  m_shape(shape),
+  m_threshold(threshold),
+  m_threads(threads)
+{
+  check_threshold(threshold);
+}
+
+void bob::ip::optflow::TrajectoryTracker::setThreshold(double threshold) {
+  check_threshold(threshold);
+  m_threshold = threshold;
+}
+
+size_t bob::ip::optflow::TrajectoryTracker::add
+(const blitz::Array<double,2>& points) {
+  if (points.extent(1) != 2) {
+    boost::format m("points should be given as an array of (y, x) positions, with 2 columns, but it has %d");
+    m % points.extent(1);
+    throw std::runtime_error(m.str());
+  }
+  const size_t first = size();
+  for (int k=0; k<points.extent(0); ++k) {
+    m_y.push_back(points(k,0));
+    m_x.push_back(points(k,1));
+    m_tracked.push_back(inside(points(k,0), points(k,1), m_shape));
+    m_length.push_back(0);
+  }
+  return first;
+}
+
+void bob::ip::optflow::TrajectoryTracker::clear() {
+  m_y.clear();
+  m_x.clear();
+  m_tracked.clear();
+  m_length.clear();
+}
+
+size_t bob::ip::optflow::TrajectoryTracker::tracked() const {
+  return std::count(m_tracked.begin(), m_tracked.end(), 1);
+}
+
+void bob::ip::optflow::TrajectoryTracker::step
+(const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+ const blitz::Array<double,2>* backward_u,
+ const blitz::Array<double,2>* backward_v) {
+
+  const double t2 = m_threshold * m_threshold;
+
+  // every point is independent of the others
+  auto advance_points = [&](size_t first, size_t last) {
+    for (size_t k=first; k<last; ++k) {
+      if (!m_tracked[k]) continue;
+      const double y = m_y[k];
+      const double x = m_x[k];
+      const double ny = y + sample(v, y, x);
+      const double nx = x + sample(u, y, x);
+      if (!inside(ny, nx, m_shape)) {
+        m_tracked[k] = 0;
+        continue;
+      }
+      if (backward_u) {
+        const double dy = ny + sample(*backward_v, ny, nx) - y;
+        const double dx = nx + sample(*backward_u, ny, nx) - x;
+        if (!(dy*dy + dx*dx <= t2)) {
+          m_tracked[k] = 0;
+          continue;
+        }
+      }
+      m_y[k] = ny;
+      m_x[k] = nx;
+      ++m_length[k];
+    }
+  };
+
+  const size_t points = size();
+  size_t threads = m_threads;
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t chunks = std::min(threads,
+      (points + MIN_POINTS_PER_THREAD - 1) / MIN_POINTS_PER_THREAD);
+  if (chunks <= 1) {
+    advance_points(0, points);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(chunks);
+  std::vector<std::thread> workers;
+  for (size_t c=0; c<chunks; ++c) {
+    const size_t first = (c * points) / chunks;
+    const size_t last = ((c + 1) * points) / chunks;
+    workers.push_back(std::thread([&, c, first, last]() {
+          try {
+            advance_points(first, last);
+          }
+          catch (...) {
+            errors[c] = std::current_exception();
+          }
+          }));
+  }
+  for (auto& w: workers) w.join();
+  for (auto& e: errors) if (e) std::rethrow_exception(e);
+
+}
+
+void bob::ip::optflow::TrajectoryTracker::advance
+(const blitz::Array<double,2>& u, const blitz::Array<double,2>& v) {
+  bob::core::array::assertSameShape(u, m_shape);
+  bob::core::array::assertSameShape(v, m_shape);
+  bob::ip::optflow::trace::Span span("track");
+  step(u, v, 0, 0);
+}
+
+void bob::ip::optflow::TrajectoryTracker::advance
+(const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+ const blitz::Array<double,2>& backward_u,
+ const blitz::Array<double,2>& backward_v) {
+  bob::core::array::assertSameShape(u, m_shape);
+  bob::core::array::assertSameShape(v, m_shape);
+  bob::core::array::assertSameShape(backward_u, m_shape);
+  bob::core::array::assertSameShape(backward_v, m_shape);
+  bob::ip::optflow::trace::Span span("track");
+  step(u, v, &backward_u, &backward_v);
+}
+
+void bob::ip::optflow::TrajectoryTracker::advance
+(const blitz::Array<double,3>& u, const blitz::Array<double,3>& v) {
+  bob::core::array::assertSameShape(u, v);
+  for (int k=0; k<u.extent(0); ++k) {
+    advance(u(k, blitz::Range::all(), blitz::Range::all()),
+        v(k, blitz::Range::all(), blitz::Range::all()));
+  }
+}
+
+void bob::ip::optflow::TrajectoryTracker::advance
+(const blitz::Array<double,3>& u, const blitz::Array<double,3>& v,
+ const blitz::Array<double,3>& backward_u,
+ const blitz::Array<double,3>& backward_v) {
+  bob::core::array::assertSameShape(u, v);
+  bob::core::array::assertSameShape(u, backward_u);
+  bob::core::array::assertSameShape(u, backward_v);
+  for (int k=0; k<u.extent(0); ++k) {
+    advance(u(k, blitz::Range::all(), blitz::Range::all()),
+        v(k, blitz::Range::all(), blitz::Range::all()),
+        backward_u(k, blitz::Range::all(), blitz::Range::all()),
+        backward_v(k, blitz::Range::all(), blitz::Range::all()));
+  }
+}
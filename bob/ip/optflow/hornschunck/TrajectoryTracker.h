@@ -0,0 +1,134 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:45:12 2026 +0000
+ *
+ * @brief Tracks points along sequences of flow fields, into long-range
+ * trajectories
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BOB_IP_OPTFLOW_TRAJECTORYTRACKER_H
+#define BOB_IP_OPTFLOW_TRAJECTORYTRACKER_H
+
+#include <cstdlib>
+#include <stdint.h>
+#include <vector>
+#include <blitz/array.h>
+
+namespace bob { namespace ip { namespace optflow {
+
+  /**
+   * Advances a set of points by the flow fields estimated between
+   * consecutive frames, sampling them bilinearly at the (sub-pixel)
+   * position of every point. Points are stored as a structure of arrays:
+   * their positions (y, x), if they are still tracked and for how many
+   * frames they were.
+   *
+   * A point stops being tracked when it leaves the image, when the flow at
+   * its position is not finite or, if backward flows are given, when
+   * following the backward flow from its new position does not bring it
+   * back within threshold pixels of where it was (forward-backward check).
+   * Points that are not tracked keep their last position.
+   *
+   * Points are advanced in parallel, by the given number of threads (0
+   * means one per core), with the same results whatever the number.
+   */
+  class TrajectoryTracker {
+
+    public: //api
+
+      /**
+       * Creates a tracker without points, for flow fields with the given
+       * shape
+       */
+      TrajectoryTracker(const blitz::TinyVector<int,2>& shape,
+          double threshold=1., size_t threads=1);
+
+      /**
+       * Adds points (a points x 2 array of (y, x) positions), returning the
+       * index of the first one. Points outside the image, or not finite,
+       * are added as not tracked.
+       */
+      size_t add(const blitz::Array<double,2>& points);
+
+      /**
+       * Advances all tracked points by one flow field
+       */
+      void advance(const blitz::Array<double,2>& u,
+          const blitz::Array<double,2>& v);
+
+      /**
+       * Advances all tracked points by one flow field, dropping those that
+       * fail the forward-backward check with the flow field estimated in the
+       * opposite direction (from the next frame to the current one)
+       */
+      void advance(const blitz::Array<double,2>& u,
+          const blitz::Array<double,2>& v,
+          const blitz::Array<double,2>& backward_u,
+          const blitz::Array<double,2>& backward_v);
+
+      /**
+       * Advances all tracked points by a sequence of flow fields (frames x
+       * height x width), one after the other
+       */
+      void advance(const blitz::Array<double,3>& u,
+          const blitz::Array<double,3>& v);
+
+      /**
+       * Like the above, with the forward-backward check on every step
+       */
+      void advance(const blitz::Array<double,3>& u,
+          const blitz::Array<double,3>& v,
+          const blitz::Array<double,3>& backward_u,
+          const blitz::Array<double,3>& backward_v);
+
+      /**
+       * Removes all points
+       */
+      void clear();
+
+      /**
+       * The number of points, tracked or not
+       */
+      inline size_t size() const { return m_y.size(); }
+
+      /**
+       * The number of points still tracked
+       */
+      size_t tracked() const;
+
+      inline const std::vector<double>& getY() const { return m_y; }
+      inline const std::vector<double>& getX() const { return m_x; }
+      inline const std::vector<uint8_t>& getTracked() const { return m_tracked; }
+      inline const std::vector<int32_t>& getLength() const { return m_length; }
+
+      inline const blitz::TinyVector<int,2>& getShape() const { return m_shape; }
+      inline double getThreshold() const { return m_threshold; }
+      void setThreshold(double threshold);
+      inline size_t getThreads() const { return m_threads; }
+      inline void setThreads(size_t threads) { m_threads = threads; }
+
+    private: //helpers
+
+      void step(const blitz::Array<double,2>& u,
+          const blitz::Array<double,2>& v,
+          const blitz::Array<double,2>* backward_u,
+          const blitz::Array<double,2>* backward_v);
+
+    private: //representation
+
+      blitz::TinyVector<int,2> m_shape;
+      double m_threshold;
+      size_t m_threads;
+
+      std::vector<double> m_y; ///< rows of all points
+      std::vector<double> m_x; ///< columns of all points
+      std::vector<uint8_t> m_tracked; ///< 1 while points are tracked
+      std::vector<int32_t> m_length; ///< flow fields each point followed
+
+  };
+
+}}}
+
+#endif /* BOB_IP_OPTFLOW_TRAJECTORYTRACKER_H */
@@ -0,0 +1,201 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:42:49 2026 +0000
+ *
+ * @brief Implements the bilinear warping of images by flow fields
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <bob.core/assert.h>
+
+#include "Warp.h"
+#include "Trace.h"
+
+/**
+ * Border policies: limit() brings a sampling coordinate within the range
+ * the policy handles, which also keeps it representable as an int, and
+ * index() maps an integer coordinate into the image, returning false if
+ * the sample is zero
+ */
+struct ClampBorder {
+  static inline double limit(double c, int n) {
+    return std::min(std::max(c, -1.), static_cast<double>(n));
+  }
+  static inline bool index(int& k, int n) {
+    k = std::min(std::max(k, 0), n-1);
+    return true;
+  }
+};
+
+struct ZeroBorder {
+  static inline double limit(double c, int n) {
+    return ClampBorder::limit(c, n);
+  }
+  static inline bool index(int& k, int n) {
+    return k >= 0 && k < n;
+  }
+};
+
+struct MirrorBorder {
+  static inline double limit(double c, int n) {
+    const double period = 2.*n;
+    double m = c - period*std::floor(c/period);
+    //rounding leaves tiny negative c below 0 (if c/period underflows) or on
+    //period itself: both are the image origin, modulo the period
+    if (!(m > 0.) || m >= period) m = 0.;
+    return m; //in [0, 2n)
+  }
+  static inline bool index(int& k, int n) {
+    if (k >= 2*n) k -= 2*n;
+    if (k >= n) k = 2*n - 1 - k;
+    return true;
+  }
+};
+
+template <typename T> static inline T round_to(double value);
+
+template <> inline double round_to<double>(double value) {
+  return value;
+}
+
+template <> inline uint8_t round_to<uint8_t>(double value) {
+  return static_cast<uint8_t>(std::min(std::max(std::floor(value + 0.5), 0.),
+        255.));
+}
+
+/**
+ * Warps the rows [first, last) of an image
+ */
+template <typename B, typename T>
+static void warp_rows(const blitz::Array<T,2>& image,
+    const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+    blitz::Array<T,2>& output, int first, int last) {
+
+  const int height = image.extent(0);
+  const int width = image.extent(1);
+  const T* data = image.data();
+  const int s0 = image.stride(0);
+  const int s1 = image.stride(1);
+  std::vector<double> sx(width), sy(width);
+
+  for (int y=first; y<last; ++y) {
+
+    // sampling coordinates: contiguous and independent per pixel, so
+    // compilers vectorize them
+    const double* ur = &u(y,0);
+    const double* vr = &v(y,0);
+    const int us = u.stride(1);
+    const int vs = v.stride(1);
+    for (int x=0; x<width; ++x) {
+      sx[x] = x + ur[x*us];
+      sy[x] = y + vr[x*vs];
+    }
+
+    T* out = &output(y,0);
+    const int os = output.stride(1);
+    for (int x=0; x<width; ++x) {
+      if (!std::isfinite(sx[x]) || !std::isfinite(sy[x])) {
+        out[x*os] = 0;
+        continue;
+      }
+      const double cx = B::limit(sx[x], width);
+      const double cy = B::limit(sy[x], height);
+      const double fx = std::floor(cx);
+      const double fy = std::floor(cy);
+      const double ax = cx - fx;
+      const double ay = cy - fy;
+      int x0 = static_cast<int>(fx), x1 = x0 + 1;
+      int y0 = static_cast<int>(fy), y1 = y0 + 1;
+      const bool vx0 = B::index(x0, width), vx1 = B::index(x1, width);
+      const bool vy0 = B::index(y0, height), vy1 = B::index(y1, height);
+      const double p00 = (vy0 && vx0) ? data[y0*s0 + x0*s1] : 0.;
+      const double p01 = (vy0 && vx1) ? data[y0*s0 + x1*s1] : 0.;
+      const double p10 = (vy1 && vx0) ? data[y1*s0 + x0*s1] : 0.;
+      const double p11 = (vy1 && vx1) ? data[y1*s0 + x1*s1] : 0.;
+      out[x*os] = round_to<T>((1.-ay)*((1.-ax)*p00 + ax*p01) +
+          ay*((1.-ax)*p10 + ax*p11));
+    }
+
+  }
+
+}
+
+/**
+ * Splits the rows of the image in chunks warped by separate threads
+ */
+template <typename B, typename T>
+static void warp_threads(const blitz::Array<T,2>& image,
+    const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+    blitz::Array<T,2>& output, size_t threads) {
+
+  const int height = image.extent(0);
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  const int chunks = std::min<int>(threads, height);
+  if (chunks <= 1) {
+    warp_rows<B>(image, u, v, output, 0, height);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(chunks);
+  std::vector<std::thread> workers;
+  for (int c=0; c<chunks; ++c) {
+    const int first = (c * height) / chunks;
+    const int last = ((c + 1) * height) / chunks;
+    workers.push_back(std::thread([&, c, first, last]() {
+          try {
+            warp_rows<B>(image, u, v, output, first, last);
+          }
+          catch (...) {
+            errors[c] = std::current_exception();
+          }
+          }));
+  }
+  for (auto& w: workers) w.join();
+  for (auto& e: errors) if (e) std::rethrow_exception(e);
+}
+
+template <typename T>
+static void warp_image(const blitz::Array<T,2>& image,
+    const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+    blitz::Array<T,2>& output, bob::ip::optflow::WarpBorder border,
+    size_t threads) {
+
+  bob::core::array::assertSameShape(image, u);
+  bob::core::array::assertSameShape(u, v);
+  bob::core::array::assertSameShape(image, output);
+  if (!image.size()) return;
+
+  bob::ip::optflow::trace::Span span("warp");
+
+  switch (border) {
+    case bob::ip::optflow::WarpZero:
+      warp_threads<ZeroBorder>(image, u, v, output, threads);
+      break;
+    case bob::ip::optflow::WarpMirror:
+      warp_threads<MirrorBorder>(image, u, v, output, threads);
+      break;
+    default:
+      warp_threads<ClampBorder>(image, u, v, output, threads);
+  }
+
+}
+
+void bob::ip::optflow::warp(const blitz::Array<double,2>& image,
+    const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+    blitz::Array<double,2>& output, bob::ip::optflow::WarpBorder border,
+    size_t threads) {
+  warp_image(image, u, v, output, border, threads);
+}
+
+void bob::ip::optflow::warp(const blitz::Array<uint8_t,2>& image,
+    const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+    blitz::Array<uint8_t,2>& output, bob::ip::optflow::WarpBorder border,
+    size_t threads) {
+  warp_image(image, u, v, output, border, threads);
+}
@@ -0,0 +1,55 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:42:49 2026 +0000
+ *
+ * @brief Bilinear warping of images by flow fields
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef BOB_IP_OPTFLOW_WARP_H
+#define BOB_IP_OPTFLOW_WARP_H
+
+#include <cstdlib>
+#include <stdint.h>
+#include <blitz/array.h>
+
+namespace bob { namespace ip { namespace optflow {
+
+  /**
+   * How pixels beyond the borders of an image are sampled while warping
+   */
+  typedef enum WarpBorder {
+    WarpClamp = 0, ///< the nearest border pixel
+    WarpZero, ///< zero
+    WarpMirror ///< the image mirrored on its borders (dcba|abcd|dcba)
+  } WarpBorder;
+
+  /**
+   * Warps an image by a flow field, sampling it bilinearly:
+   *
+   * output(y,x) = image(y+v(y,x), x+u(y,x))
+   *
+   * With the flow estimated from i1 to i2, warping i2 compensates its
+   * motion, giving back an estimate of i1. Flow vectors that are not finite
+   * give 0. Rows are split in chunks processed in parallel by the given
+   * number of threads (0 means one per core). All arrays should have the
+   * same shape, and output should not overlap image.
+   */
+  void warp(const blitz::Array<double,2>& image,
+      const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+      blitz::Array<double,2>& output, WarpBorder border=WarpClamp,
+      size_t threads=1);
+
+  /**
+   * Like the above, for 8-bit images, rounding the samples to the nearest
+   * integer
+   */
+  void warp(const blitz::Array<uint8_t,2>& image,
+      const blitz::Array<double,2>& u, const blitz::Array<double,2>& v,
+      blitz::Array<uint8_t,2>& output, WarpBorder border=WarpClamp,
+      size_t threads=1);
+
+}}}
+
+#endif /* BOB_IP_OPTFLOW_WARP_H */
@@ -0,0 +1,716 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:09:40 2026 +0000
+ *
+ * @brief Bindings for the flow archive writer and reader
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <bob.blitz/cppapi.h>
+#include <bob.blitz/cleanup.h>
+#include <bob.extension/documentation.h>
+#include <structmember.h>
+
+#include <string>
+
+#include "FlowArchive.h"
+
+int PyBobIpOptflow_InputConverter(PyObject* o, PyBlitzArrayObject** a);
+
+static int check_plane(PyBlitzArrayObject* a, const char* name,
+    const blitz::TinyVector<int,2>& shape) {
+
+  if (a->type_num != NPY_FLOAT64 || a->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "flow archives only support 2D 64-bit float arrays for `%s' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", name, a->ndim, PyBlitzArray_TypenumAsString(a->type_num));
+    return 0;
+  }
+
+  if (a->shape[0] != shape(0) || a->shape[1] != shape(1)) {
+    PyErr_Format(PyExc_RuntimeError, "flow archive has shape = (%d, %d) which differs from that of `%s' = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", shape(0), shape(1), name, a->shape[0], a->shape[1]);
+    return 0;
+  }
+
+  return 1;
+
+}
+
+/*********************************************
+ * Implementation of FlowArchiveWriter class *
+ *********************************************/
+
+#define CLASS_NAME "FlowArchiveWriter"
+
+static auto s_writer = bob::extension::ClassDoc(
+    BOB_EXT_MODULE_PREFIX "." CLASS_NAME,
+
+    "Writes a sequence of flow fields to a compressed, indexed archive.",
+
+    "Every frame (the ``u`` and ``v`` planes) is stored in its own chunk, "
+    "and an index of all chunks is written at the end of the file, so "
+    ":py:class:`FlowArchiveReader` can decode any frame without reading the "
+    "others. Optionally, values are quantized to multiples of ``step`` "
+    "pixels and saturated to the int16 range (e.g., a step of ``1./64`` "
+    "keeps 1/64 pixel precision within +/-512 pixels); otherwise they are "
+    "stored bit-exact; :py:attr:`saturated` counts the values that did not "
+    "fit. Keyframes are coded on their own and the frames in between are "
+    "coded as differences to the previous frame or, with ``prediction="
+    "'keyframe'``, to the last keyframe. All chunks are deflated with zlib."
+    "\n\n"
+    "Reading a keyframe decodes a single chunk. Reading another frame "
+    "decodes, at most, all chunks since the last keyframe (``keyframe`` "
+    "chunks) when predicting from the previous frame, or 2 chunks when "
+    "predicting from the keyframe, at the cost of larger archives.\n"
+    "\n"
+    "Frames passed to :py:meth:`write` are copied and queued, while a "
+    "background thread encodes and writes them to disk, so solvers can keep "
+    "running. Call :py:meth:`close` when done: the archive is only readable "
+    "once its index was written."
+    )
+    .add_constructor(
+        bob::extension::FunctionDoc(
+          CLASS_NAME,
+          "Creates a new archive, overwriting any existing file."
+          )
+        .add_prototype("filename, (height, width), [step], [keyframe], [level], [queue], [prediction]", "")
+        .add_parameter("filename", "str", "The path of the archive to create")
+        .add_parameter("(height, width)", "tuple", "The shape of every flow field to be stored")
+        .add_parameter("step", "float", "The quantization step, in pixels, or ``0.`` (the default) to store values losslessly")
+        .add_parameter("keyframe", "int", "Every how many frames a keyframe is stored (defaults to 8). Use ``1`` to code every frame on its own.")
+        .add_parameter("level", "int", "The zlib compression level, between 0 and 9 (defaults to 6)")
+        .add_parameter("queue", "int", "How many frames may wait to be written before :py:meth:`write` blocks (defaults to 4)")
+        .add_parameter("prediction", "str", "What the frames between keyframes are coded against: ``'previous'`` (the default) or ``'keyframe'``")
+        )
+    ;
+
+typedef struct {
+  PyObject_HEAD
+  bob::ip::optflow::FlowArchiveWriter* cxx;
+} PyBobIpOptflowFlowArchiveWriterObject;
+
+
+static int PyBobIpOptflowFlowArchiveWriter_init
+(PyBobIpOptflowFlowArchiveWriterObject* self, PyObject* args, PyObject* kwds) {
+
+  /* Parses input arguments in a single shot */
+  static const char* const_kwlist[] = {"filename", "shape", "step",
+    "keyframe", "level", "queue", "prediction", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  const char* filename = 0;
+  Py_ssize_t height, width;
+  double step = 0.;
+  Py_ssize_t keyframe = 8;
+  int level = 6;
+  Py_ssize_t queue = 4;
+  const char* prediction = "previous";
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s(nn)|dnins", kwlist,
+        &filename, &height, &width, &step, &keyframe, &level, &queue,
+        &prediction))
+    return -1;
+
+  if (keyframe < 1 || queue < 1) {
+    PyErr_Format(PyExc_ValueError, "`keyframe' and `queue' should be at least 1, but you set them to %" PY_FORMAT_SIZE_T "d and %" PY_FORMAT_SIZE_T "d", keyframe, queue);
+    return -1;
+  }
+
+  bob::ip::optflow::FlowPrediction prediction_;
+  if (std::string(prediction) == "previous") prediction_ = bob::ip::optflow::PredictPrevious;
+  else if (std::string(prediction) == "keyframe") prediction_ = bob::ip::optflow::PredictKeyframe;
+  else {
+    PyErr_Format(PyExc_ValueError, "`prediction' should be either 'previous' or 'keyframe', but you set it to '%s'", prediction);
+    return -1;
+  }
+
+  try {
+    blitz::TinyVector<int,2> shape;
+    shape(0) = height; shape(1) = width;
+    self->cxx = new bob::ip::optflow::FlowArchiveWriter(filename, shape,
+        step, keyframe, level, queue, prediction_);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot create new object of type `%s' - unknown exception thrown", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static void PyBobIpOptflowFlowArchiveWriter_delete
+(PyBobIpOptflowFlowArchiveWriterObject* self) {
+
+  //waits for queued frames, which does not require the GIL
+  Py_BEGIN_ALLOW_THREADS
+  delete self->cxx;
+  Py_END_ALLOW_THREADS
+  Py_TYPE(self)->tp_free((PyObject*)self);
+
+}
+
+static auto s_writer_shape = bob::extension::VariableDoc(
+    "shape",
+    "tuple",
+    "The shape of the flow fields on this archive: ``(height, width)``"
+    );
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_getShape
+(PyBobIpOptflowFlowArchiveWriterObject* self, void* /*closure*/) {
+  auto shape = self->cxx->getShape();
+  return Py_BuildValue("nn", (Py_ssize_t)shape(0), (Py_ssize_t)shape(1));
+}
+
+static auto s_writer_step = bob::extension::VariableDoc(
+    "step",
+    "float",
+    "The quantization step, in pixels, or ``0.`` if values are stored losslessly"
+    );
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_getStep
+(PyBobIpOptflowFlowArchiveWriterObject* self, void* /*closure*/) {
+  return PyFloat_FromDouble(self->cxx->getStep());
+}
+
+static auto s_writer_keyframe = bob::extension::VariableDoc(
+    "keyframe",
+    "int",
+    "Every how many frames a keyframe is stored"
+    );
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_getKeyframe
+(PyBobIpOptflowFlowArchiveWriterObject* self, void* /*closure*/) {
+  return Py_BuildValue("n", (Py_ssize_t)self->cxx->getKeyframe());
+}
+
+static auto s_writer_prediction = bob::extension::VariableDoc(
+    "prediction",
+    "str",
+    "What the frames between keyframes are coded against: ``'previous'`` or ``'keyframe'``"
+    );
+
+static PyObject* prediction_name(bob::ip::optflow::FlowPrediction prediction) {
+  return Py_BuildValue("s",
+      prediction == bob::ip::optflow::PredictKeyframe ? "keyframe" : "previous");
+}
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_getPrediction
+(PyBobIpOptflowFlowArchiveWriterObject* self, void* /*closure*/) {
+  return prediction_name(self->cxx->getPrediction());
+}
+
+static auto s_writer_saturated = bob::extension::VariableDoc(
+    "saturated",
+    "int",
+    "The number of values saturated to the int16 range by quantization, in the frames encoded so far (all frames written, once :py:meth:`close` returned)",
+    "Saturated values are stored as the largest (or smallest) multiple of ``step`` that fits, so a non-zero count means ``step`` is too small for the flow."
+    );
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_getSaturated
+(PyBobIpOptflowFlowArchiveWriterObject* self, void* /*closure*/) {
+  return Py_BuildValue("K", (unsigned long long)self->cxx->getSaturated());
+}
+
+static PyGetSetDef PyBobIpOptflowFlowArchiveWriter_getseters[] = {
+    {
+      s_writer_shape.name(),
+      (getter)PyBobIpOptflowFlowArchiveWriter_getShape,
+      0,
+      s_writer_shape.doc(),
+      0
+    },
+    {
+      s_writer_step.name(),
+      (getter)PyBobIpOptflowFlowArchiveWriter_getStep,
+      0,
+      s_writer_step.doc(),
+      0
+    },
+    {
+      s_writer_keyframe.name(),
+      (getter)PyBobIpOptflowFlowArchiveWriter_getKeyframe,
+      0,
+      s_writer_keyframe.doc(),
+      0
+    },
+    {
+      s_writer_prediction.name(),
+      (getter)PyBobIpOptflowFlowArchiveWriter_getPrediction,
+      0,
+      s_writer_prediction.doc(),
+      0
+    },
+    {
+      s_writer_saturated.name(),
+      (getter)PyBobIpOptflowFlowArchiveWriter_getSaturated,
+      0,
+      s_writer_saturated.doc(),
+      0
+    },
+    {0}  /* Sentinel */
+};
+
+static auto s_write = bob::extension::FunctionDoc(
+    "write",
+    "Appends a flow field to the archive",
+    "The flow is copied and queued for the background writer; this call "
+    "only blocks (with the GIL released) if the queue is full. Errors found "
+    "while encoding or writing previous frames are raised here or on "
+    ":py:meth:`close`."
+    )
+    .add_prototype("u, v", "None")
+    .add_parameter("u, v", "array-like (2D, float64)", "The flow in the horizontal and vertical directions, with the archive shape")
+    ;
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_write
+(PyBobIpOptflowFlowArchiveWriterObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"u", "v", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&", kwlist,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+
+  if (!check_plane(u, "u", self->cxx->getShape())) return 0;
+  if (!check_plane(v, "v", self->cxx->getShape())) return 0;
+
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    self->cxx->write(*bz_u, *bz_v);
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot write to flow archive: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  Py_RETURN_NONE;
+
+}
+
+static auto s_close = bob::extension::FunctionDoc(
+    "close",
+    "Writes all queued frames and the index, then closes the file",
+    "Further calls have no effect. This is also done when the object is "
+    "deleted, but errors are then ignored."
+    )
+    .add_prototype("", "None")
+    ;
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_close
+(PyBobIpOptflowFlowArchiveWriterObject* self) {
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    self->cxx->close();
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot close flow archive: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  Py_RETURN_NONE;
+
+}
+
+static PyMethodDef PyBobIpOptflowFlowArchiveWriter_methods[] = {
+  {
+    s_write.name(),
+    (PyCFunction)PyBobIpOptflowFlowArchiveWriter_write,
+    METH_VARARGS|METH_KEYWORDS,
+    s_write.doc()
+  },
+  {
+    s_close.name(),
+    (PyCFunction)PyBobIpOptflowFlowArchiveWriter_close,
+    METH_NOARGS,
+    s_close.doc()
+  },
+  {0} /* Sentinel */
+};
+
+static Py_ssize_t PyBobIpOptflowFlowArchiveWriter_len
+(PyBobIpOptflowFlowArchiveWriterObject* self) {
+  return self->cxx->size();
+}
+
+static PySequenceMethods PyBobIpOptflowFlowArchiveWriter_sequence = {
+    (lenfunc)PyBobIpOptflowFlowArchiveWriter_len,
+    0, /* concat */
+    0, /* repeat */
+    0, /* item */
+    0, /* slice */
+    0, /* ass_item */
+    0, /* ass_slice */
+    0, /* contains */
+    0, /* inplace_concat */
+    0, /* inplace_repeat */
+};
+
+static PyObject* PyBobIpOptflowFlowArchiveWriter_new
+(PyTypeObject* type, PyObject*, PyObject*) {
+
+  /* Allocates the python object itself */
+  PyBobIpOptflowFlowArchiveWriterObject* self =
+    (PyBobIpOptflowFlowArchiveWriterObject*)type->tp_alloc(type, 0);
+
+  self->cxx = 0;
+
+  return reinterpret_cast<PyObject*>(self);
+
+}
+
+PyTypeObject PyBobIpOptflowFlowArchiveWriter_Type = {
+    PyVarObject_HEAD_INIT(0, 0)
+    s_writer.name(),                                    /* tp_name */
+    sizeof(PyBobIpOptflowFlowArchiveWriterObject),      /* tp_basicsize */
+    0,                                                  /* tp_itemsize */
+    (destructor)PyBobIpOptflowFlowArchiveWriter_delete, /* tp_dealloc */
+    0,                                                  /* tp_print */
+    0,                                                  /* tp_getattr */
+    0,                                                  /* tp_setattr */
+    0,                                                  /* tp_compare */
+    0,                                                  /* tp_repr */
+    0,                                                  /* tp_as_number */
+    &PyBobIpOptflowFlowArchiveWriter_sequence,          /* tp_as_sequence */
+    0,                                                  /* tp_as_mapping */
+    0,                                                  /* tp_hash */
+    0,                                                  /* tp_call */
+    0,                                                  /* tp_str */
+    0,                                                  /* tp_getattro */
+    0,                                                  /* tp_setattro */
+    0,                                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,           /* tp_flags */
+    s_writer.doc(),                                     /* tp_doc */
+    0,                                                  /* tp_traverse */
+    0,                                                  /* tp_clear */
+    0,                                                  /* tp_richcompare */
+    0,                                                  /* tp_weaklistoffset */
+    0,                                                  /* tp_iter */
+    0,                                                  /* tp_iternext */
+    PyBobIpOptflowFlowArchiveWriter_methods,            /* tp_methods */
+    0,                                                  /* tp_members */
+    PyBobIpOptflowFlowArchiveWriter_getseters,          /* tp_getset */
+    0,                                                  /* tp_base */
+    0,                                                  /* tp_dict */
+    0,                                                  /* tp_descr_get */
+    0,                                                  /* tp_descr_set */
+    0,                                                  /* tp_dictoffset */
+    (initproc)PyBobIpOptflowFlowArchiveWriter_init,     /* tp_init */
+    0,                                                  /* tp_alloc */
+    PyBobIpOptflowFlowArchiveWriter_new,                /* tp_new */
+};
+
+#undef CLASS_NAME
+
+/*********************************************
+ * Implementation of FlowArchiveReader class *
+ *********************************************/
+
+#define CLASS_NAME "FlowArchiveReader"
+
+static auto s_reader = bob::extension::ClassDoc(
+    BOB_EXT_MODULE_PREFIX "." CLASS_NAME,
+
+    "Reads flow fields from an archive, in any order.",
+
+    "The archive must have been written and closed by "
+    ":py:class:`FlowArchiveWriter`. Frames are accessed with "
+    ":py:meth:`read` or by indexing (``reader[k]``), and ``len(reader)`` "
+    "gives the number of frames. Reading the frames in sequence decodes "
+    "every chunk once. A frame that is not a keyframe is decoded from the "
+    "last keyframe before it: through all frames in between, unless the "
+    "frame preceding it was the last one read, or directly if the archive "
+    "was written with ``prediction='keyframe'``."
+    )
+    .add_constructor(
+        bob::extension::FunctionDoc(
+          CLASS_NAME,
+          "Opens an existing archive and loads its index."
+          )
+        .add_prototype("filename", "")
+        .add_parameter("filename", "str", "The path of the archive to read")
+        )
+    ;
+
+typedef struct {
+  PyObject_HEAD
+  bob::ip::optflow::FlowArchiveReader* cxx;
+} PyBobIpOptflowFlowArchiveReaderObject;
+
+
+static int PyBobIpOptflowFlowArchiveReader_init
+(PyBobIpOptflowFlowArchiveReaderObject* self, PyObject* args, PyObject* kwds) {
+
+  /* Parses input arguments in a single shot */
+  static const char* const_kwlist[] = {"filename", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  const char* filename = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &filename))
+    return -1;
+
+  try {
+    self->cxx = new bob::ip::optflow::FlowArchiveReader(filename);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot create new object of type `%s' - unknown exception thrown", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static void PyBobIpOptflowFlowArchiveReader_delete
+(PyBobIpOptflowFlowArchiveReaderObject* self) {
+
+  delete self->cxx;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+
+}
+
+static PyObject* PyBobIpOptflowFlowArchiveReader_getShape
+(PyBobIpOptflowFlowArchiveReaderObject* self, void* /*closure*/) {
+  auto shape = self->cxx->getShape();
+  return Py_BuildValue("nn", (Py_ssize_t)shape(0), (Py_ssize_t)shape(1));
+}
+
+static PyObject* PyBobIpOptflowFlowArchiveReader_getStep
+(PyBobIpOptflowFlowArchiveReaderObject* self, void* /*closure*/) {
+  return PyFloat_FromDouble(self->cxx->getStep());
+}
+
+static PyObject* PyBobIpOptflowFlowArchiveReader_getKeyframe
+(PyBobIpOptflowFlowArchiveReaderObject* self, void* /*closure*/) {
+  return Py_BuildValue("n", (Py_ssize_t)self->cxx->getKeyframe());
+}
+
+static PyObject* PyBobIpOptflowFlowArchiveReader_getPrediction
+(PyBobIpOptflowFlowArchiveReaderObject* self, void* /*closure*/) {
+  return prediction_name(self->cxx->getPrediction());
+}
+
+static PyGetSetDef PyBobIpOptflowFlowArchiveReader_getseters[] = {
+    {
+      s_writer_shape.name(),
+      (getter)PyBobIpOptflowFlowArchiveReader_getShape,
+      0,
+      s_writer_shape.doc(),
+      0
+    },
+    {
+      s_writer_step.name(),
+      (getter)PyBobIpOptflowFlowArchiveReader_getStep,
+      0,
+      s_writer_step.doc(),
+      0
+    },
+    {
+      s_writer_keyframe.name(),
+      (getter)PyBobIpOptflowFlowArchiveReader_getKeyframe,
+      0,
+      s_writer_keyframe.doc(),
+      0
+    },
+    {
+      s_writer_prediction.name(),
+      (getter)PyBobIpOptflowFlowArchiveReader_getPrediction,
+      0,
+      s_writer_prediction.doc(),
+      0
+    },
+    {0}  /* Sentinel */
+};
+
+/**
+ * Decodes a frame into newly allocated arrays, returned as a tuple
+ */
+static PyObject* read_frame(PyBobIpOptflowFlowArchiveReaderObject* self,
+    Py_ssize_t index) {
+
+  if (index < 0 || index >= (Py_ssize_t)self->cxx->size()) {
+    PyErr_Format(PyExc_IndexError, "cannot read frame %" PY_FORMAT_SIZE_T "d from a flow archive with %" PY_FORMAT_SIZE_T "d frame(s)", index, (Py_ssize_t)self->cxx->size());
+    return 0;
+  }
+
+  auto shape = self->cxx->getShape();
+  Py_ssize_t pyshape[2] = {shape(0), shape(1)};
+  auto u = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, pyshape);
+  if (!u) return 0;
+  auto u_ = make_safe(u);
+  auto v = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, pyshape);
+  if (!v) return 0;
+  auto v_ = make_safe(v);
+
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    self->cxx->read(index, *bz_u, *bz_v);
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot read from flow archive: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return Py_BuildValue("(NN)",
+      PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+      PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v))
+      );
+
+}
+
+static auto s_read = bob::extension::FunctionDoc(
+    "read",
+    "Decodes a frame of the archive",
+    "Equivalent to ``reader[index]``. The GIL is released while decoding."
+    )
+    .add_prototype("index", "u, v")
+    .add_parameter("index", "int", "The frame to read, counting from 0")
+    .add_return("u, v", "array (2D, float64)", "The flow in the horizontal and vertical directions")
+    ;
+
+static PyObject* PyBobIpOptflowFlowArchiveReader_read
+(PyBobIpOptflowFlowArchiveReaderObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"index", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t index = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "n", kwlist, &index)) return 0;
+
+  return read_frame(self, index);
+
+}
+
+static PyMethodDef PyBobIpOptflowFlowArchiveReader_methods[] = {
+  {
+    s_read.name(),
+    (PyCFunction)PyBobIpOptflowFlowArchiveReader_read,
+    METH_VARARGS|METH_KEYWORDS,
+    s_read.doc()
+  },
+  {0} /* Sentinel */
+};
+
+static Py_ssize_t PyBobIpOptflowFlowArchiveReader_len
+(PyBobIpOptflowFlowArchiveReaderObject* self) {
+  return self->cxx->size();
+}
+
+static PySequenceMethods PyBobIpOptflowFlowArchiveReader_sequence = {
+    (lenfunc)PyBobIpOptflowFlowArchiveReader_len,
+    0, /* concat */
+    0, /* repeat */
+    (ssizeargfunc)read_frame, /* item (negative indexes are adjusted) */
+    0, /* slice */
+    0, /* ass_item */
+    0, /* ass_slice */
+    0, /* contains */
+    0, /* inplace_concat */
+    0, /* inplace_repeat */
+};
+
+static PyObject* PyBobIpOptflowFlowArchiveReader_new
+(PyTypeObject* type, PyObject*, PyObject*) {
+
+  /* Allocates the python object itself */
+  PyBobIpOptflowFlowArchiveReaderObject* self =
+    (PyBobIpOptflowFlowArchiveReaderObject*)type->tp_alloc(type, 0);
+
+  self->cxx = 0;
+
+  return reinterpret_cast<PyObject*>(self);
+
+}
+
+PyTypeObject PyBobIpOptflowFlowArchiveReader_Type = {
+    PyVarObject_HEAD_INIT(0, 0)
+    s_reader.name(),                                    /* tp_name */
+    sizeof(PyBobIpOptflowFlowArchiveReaderObject),      /* tp_basicsize */
+    0,                                                  /* tp_itemsize */
+    (destructor)PyBobIpOptflowFlowArchiveReader_delete, /* tp_dealloc */
+    0,                                                  /* tp_print */
+    0,                                                  /* tp_getattr */
+    0,                                                  /* tp_setattr */
+    0,                                                  /* tp_compare */
+    0,                                                  /* tp_repr */
+    0,                                                  /* tp_as_number */
+    &PyBobIpOptflowFlowArchiveReader_sequence,          /* tp_as_sequence */
+    0,                                                  /* tp_as_mapping */
+    0,                                                  /* tp_hash */
+    0,                                                  /* tp_call */
+    0,                                                  /* tp_str */
+    0,                                                  /* tp_getattro */
+    0,                                                  /* tp_setattro */
+    0,                                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,           /* tp_flags */
+    s_reader.doc(),                                     /* tp_doc */
+    0,                                                  /* tp_traverse */
+    0,                                                  /* tp_clear */
+    0,                                                  /* tp_richcompare */
+    0,                                                  /* tp_weaklistoffset */
+    0,                                                  /* tp_iter */
+    0,                                                  /* tp_iternext */
+    PyBobIpOptflowFlowArchiveReader_methods,            /* tp_methods */
+    0,                                                  /* tp_members */
+    PyBobIpOptflowFlowArchiveReader_getseters,          /* tp_getset */
+    0,                                                  /* tp_base */
+    0,                                                  /* tp_dict */
+    0,                                                  /* tp_descr_get */
+    0,                                                  /* tp_descr_set */
+    0,                                                  /* tp_dictoffset */
+    (initproc)PyBobIpOptflowFlowArchiveReader_init,     /* tp_init */
+    0,                                                  /* tp_alloc */
+    PyBobIpOptflowFlowArchiveReader_new,                /* tp_new */
+};
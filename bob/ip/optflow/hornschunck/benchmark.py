@@ -0,0 +1,409 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:02:07 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Benchmarks the gradient, Laplacian and flow kernels of this package.
+
+Every kernel is run on synthetic frames of the requested sizes, generated
+natively (see :py:func:`synthetic_sequence`). Besides the wall-clock time,
+hardware performance counters are read around each kernel (on Linux, through
+``perf_event_open``), from which the instructions per cycle (IPC) and the
+bandwidth achieved to main memory (last-level cache misses times the cache
+line size) are derived. If counters are not available on this host, only
+timings are reported.
+
+With ``--roofline``, every kernel is also placed on a roofline: analytic
+models of the floating-point operations and bytes moved per pixel give its
+arithmetic intensity, single-thread peaks for memory bandwidth and
+floating-point throughput are measured with built-in microkernels, and the
+report shows how close each kernel comes to the attainable performance
+``min(peak flops, intensity x peak bandwidth)``. The solver iterations and
+the update step (an iteration minus its two Laplacians) are derived from the
+flow timings.
+
+With ``--opencv``, the flow solvers are also compared to OpenCV's Horn &
+Schunck implementation, if it is available on this host: all run the same
+number of iterations on the same (8-bit) frames, and the report shows their
+throughput next to the endpoint difference of every flow field to OpenCV's.
+"""
+
+import sys
+import numpy
+
+from . import HornAndSchunckGradient, SobelGradient, laplacian_avg_hs, \
+    laplacian_avg_hs_opencv, VanillaFlow, Flow, PerfCounters, \
+    peak_bandwidth, peak_flops, synthetic_sequence
+
+CACHE_LINE = 64
+"""Bytes transferred from memory for every last-level cache miss"""
+
+# Analytic models, as (flops, bytes) per pixel, of the kernels as they are
+# implemented: every pass over an image streams its inputs from and its
+# output to memory (8 bytes per value), which is what happens once images no
+# longer fit in cache. Write-allocate traffic is not counted, as in STREAM.
+#
+# Laplacians mirror-extrapolate the input (read + write) and convolve it with
+# a full 3x3 kernel (9 multiplications, 8 additions).
+LAPLACIAN = (17, 32)
+# Separable convolutions with a k-tap kernel: extrapolation (read + write)
+# and the convolution itself (read + write, 2k-1 flops).
+def _sepconv(k): return (2*k - 1, 32)
+# The update computes ``cterm`` (9 flops, reading 5 images and writing 1),
+# then ``u`` and ``v`` (2 flops, reading 3 images and writing 1, each).
+UPDATE = (13, 112)
+ITERATION = (2*LAPLACIAN[0] + UPDATE[0], 2*LAPLACIAN[1] + UPDATE[1])
+# Gradients run 4 (forward, 2 frames) or 6 (central, 3 frames) separable
+# convolutions per component, then combine the frames by hand (2 or 3 images
+# read, 1 written, per component).
+FORWARD_GRADIENT = (12*_sepconv(2)[0] + 3*3, 12*_sepconv(2)[1] + 3*24)
+CENTRAL_GRADIENT = (18*_sepconv(3)[0] + 3*5, 18*_sepconv(3)[1] + 3*32)
+
+
+def models(iterations):
+  """Returns the analytic ``(flops, bytes)`` per pixel for every kernel
+  benchmarked, indexed by kernel name"""
+
+  def solver(gradient):
+    return (gradient[0] + iterations*ITERATION[0],
+        gradient[1] + iterations*ITERATION[1])
+
+  return {
+      'ForwardGradient': FORWARD_GRADIENT,
+      'CentralGradient': CENTRAL_GRADIENT,
+      'laplacian_avg_hs': LAPLACIAN,
+      'laplacian_avg_hs_opencv': LAPLACIAN,
+      'VanillaFlow (%d it.)' % iterations: solver(FORWARD_GRADIENT),
+      'Flow (%d it.)' % iterations: solver(CENTRAL_GRADIENT),
+      'VanillaFlow iteration': ITERATION,
+      'Flow iteration': ITERATION,
+      'VanillaFlow update': UPDATE,
+      'Flow update': UPDATE,
+      }
+
+
+def frames(shape, count, seed=0):
+  """Returns a sequence of smooth, textured frames moving by 1 pixel/frame"""
+
+  images = synthetic_sequence(shape, count, translation=(1., 1.), seed=seed,
+      threads=0)[0]
+  return list(images)
+
+
+def kernels(shape, iterations, alpha=200.):
+  """Returns the kernels to benchmark, as a list of ``(name, callable)``"""
+
+  i1, i2, i3 = frames(shape, 3)
+  ex = numpy.zeros(shape, 'float64')
+  ey = numpy.zeros(shape, 'float64')
+  et = numpy.zeros(shape, 'float64')
+  u = numpy.zeros(shape, 'float64')
+  v = numpy.zeros(shape, 'float64')
+
+  forward = HornAndSchunckGradient(shape)
+  central = SobelGradient(shape)
+  vanilla = VanillaFlow(shape)
+  flow = Flow(shape)
+
+  def run_vanilla():
+    u.fill(0.); v.fill(0.)
+    vanilla.estimate(alpha, iterations, i1, i2, u, v)
+
+  def run_flow():
+    u.fill(0.); v.fill(0.)
+    flow.estimate(alpha, iterations, i1, i2, i3, u, v)
+
+  return [
+      ('ForwardGradient', lambda: forward(i1, i2, ex, ey, et)),
+      ('CentralGradient', lambda: central(i1, i2, i3, ex, ey, et)),
+      ('laplacian_avg_hs', lambda: laplacian_avg_hs(i1)),
+      ('laplacian_avg_hs_opencv', lambda: laplacian_avg_hs_opencv(i1)),
+      ('VanillaFlow (%d it.)' % iterations, run_vanilla),
+      ('Flow (%d it.)' % iterations, run_flow),
+      ]
+
+
+def measure(call, repeat, counters=None):
+  """Runs a call ``repeat`` times (after a warm-up run), returning the
+  averaged counter values per call"""
+
+  call() #warm-up: allocations, page faults, caches
+  if counters is None:
+    counters = PerfCounters()
+  counters.start()
+  for k in range(repeat): call()
+  values = counters.stop()
+  return dict((k, None if v is None else float(v) / repeat)
+      for k, v in values.items())
+
+
+def derived(values, pixels):
+  """Computes derived metrics from measured values (per call)"""
+
+  retval = {
+      'ms': 1e3 * values['seconds'],
+      'mpix/s': pixels / values['seconds'] / 1e6,
+      'ipc': None,
+      'gb/s': None,
+      'miss%': None,
+      }
+  if values['cycles'] and values['instructions'] is not None:
+    retval['ipc'] = values['instructions'] / values['cycles']
+  if values['cache_misses'] is not None:
+    retval['gb/s'] = CACHE_LINE * values['cache_misses'] / values['seconds'] / 1e9
+    if values['cache_references']:
+      retval['miss%'] = 100. * values['cache_misses'] / values['cache_references']
+  return retval
+
+
+def report(shape, results, stream=sys.stdout):
+  """Prints a table with the results for one image size"""
+
+  def fmt(value, spec):
+    return ('%' + spec) % value if value is not None else 'n/a'
+
+  stream.write("\n%d x %d pixels\n" % shape)
+  stream.write("%-28s %10s %10s %6s %8s %6s\n" % \
+      ('kernel', 'ms/call', 'Mpix/s', 'IPC', 'GB/s', 'miss%'))
+  for name, r in results:
+    stream.write("%-28s %10s %10s %6s %8s %6s\n" % (
+      name,
+      fmt(r['ms'], '.3f'),
+      fmt(r['mpix/s'], '.1f'),
+      fmt(r['ipc'], '.2f'),
+      fmt(r['gb/s'], '.2f'),
+      fmt(r['miss%'], '.1f'),
+      ))
+
+
+def peaks():
+  """Measures single-thread peaks, as ``(bytes/s, flops/s)``"""
+
+  return peak_bandwidth(), peak_flops()
+
+
+def roofline(results, iterations, pixels, bandwidth, flops):
+  """Places measured kernels on the roofline
+
+  Adds the achieved ``gflop/s``, the ``attainable`` GFLOP/s, the fraction of
+  it achieved (``roof%``) and what ``bound`` the kernel (``memory`` or
+  ``compute``) to each result. Rows for a solver iteration and for the update
+  step are derived from the flow timings and appended. Kernels whose data
+  stays in cache may exceed 100% of the (memory) roof.
+  """
+
+  model = models(iterations)
+  seconds = dict((name, r['ms'] / 1e3) for name, r in results)
+
+  extra = []
+  for solver, gradient, laplacian in (
+      ('VanillaFlow', 'ForwardGradient', 'laplacian_avg_hs'),
+      ('Flow', 'CentralGradient', 'laplacian_avg_hs_opencv')):
+    if not iterations: continue
+    total = seconds['%s (%d it.)' % (solver, iterations)]
+    iteration = (total - seconds[gradient]) / iterations
+    update = iteration - 2 * seconds[laplacian]
+    for name, t in (('%s iteration' % solver, iteration),
+        ('%s update' % solver, update)):
+      if t <= 0: continue #lost in the noise
+      extra.append((name, {'ms': 1e3 * t, 'mpix/s': pixels / t / 1e6,
+        'ipc': None, 'gb/s': None, 'miss%': None}))
+
+  retval = []
+  for name, r in results + extra:
+    f, b = model[name]
+    intensity = float(f) / b
+    attainable = min(flops, intensity * bandwidth)
+    achieved = f * pixels / (r['ms'] / 1e3)
+    r = dict(r)
+    r.update({
+      'flops/px': f,
+      'bytes/px': b,
+      'intensity': intensity,
+      'gflop/s': achieved / 1e9,
+      'attainable': attainable / 1e9,
+      'roof%': 100. * achieved / attainable,
+      'bound': 'memory' if intensity * bandwidth < flops else 'compute',
+      })
+    retval.append((name, r))
+  return retval
+
+
+def report_roofline(shape, results, stream=sys.stdout):
+  """Prints the position of every kernel on the roofline"""
+
+  stream.write("\nRoofline, %d x %d pixels\n" % shape)
+  stream.write("%-28s %8s %8s %8s %9s %10s %6s %8s\n" % \
+      ('kernel', 'flop/px', 'byte/px', 'flop/B', 'GFLOP/s', 'attainable',
+        'roof%', 'bound'))
+  for name, r in results:
+    stream.write("%-28s %8d %8d %8.3f %9.3f %10.3f %6.1f %8s\n" % (
+      name, r['flops/px'], r['bytes/px'], r['intensity'], r['gflop/s'],
+      r['attainable'], r['roof%'], r['bound']))
+
+
+def opencv_hs():
+  """Returns OpenCV's Horn & Schunck solver, as a callable ``(alpha,
+  iterations, i1, i2) -> (u, v)`` on 8-bit frames, or ``None`` if it is not
+  available. It only exists on the legacy (``cv``) API of OpenCV 2.x."""
+
+  try:
+    import cv
+  except ImportError:
+    try:
+      from cv2 import cv
+    except ImportError:
+      return None
+  if not hasattr(cv, 'CalcOpticalFlowHS'): return None
+
+  def solve(alpha, iterations, i1, i2):
+    u = cv.CreateMat(i1.shape[0], i1.shape[1], cv.CV_32F)
+    cv.SetZero(u)
+    v = cv.CreateMat(i1.shape[0], i1.shape[1], cv.CV_32F)
+    cv.SetZero(v)
+    cv.CalcOpticalFlowHS(cv.fromarray(i1), cv.fromarray(i2), 0, u, v,
+        1./(alpha**2), (cv.CV_TERMCRIT_ITER, iterations, 0))
+    return numpy.array(u, 'float64'), numpy.array(v, 'float64')
+
+  return solve
+
+
+def compare_opencv(shapes, iterations, repeat, alpha=200.,
+    stream=sys.stdout):
+  """Runs the flow solvers and OpenCV's Horn & Schunck on the same frames,
+  returning, for every shape, the derived metrics of each plus the mean and
+  maximum endpoint difference (``epe``, ``epe max``) of its flow to OpenCV's.
+  Returns an empty dictionary if OpenCV is not available.
+
+  VanillaFlow and OpenCV estimate the flow between the first two frames.
+  Flow uses central differences over three frames: its difference also
+  reflects the choice of gradient.
+  """
+
+  solve = opencv_hs()
+  if solve is None:
+    stream.write("OpenCV's Horn & Schunck is not available on this host: skipping the comparison\n")
+    return {}
+
+  counters = PerfCounters()
+
+  retval = {}
+  for shape in shapes:
+    pixels = shape[0] * shape[1]
+
+    # OpenCV only takes 8-bit frames: quantize them for everybody
+    b1, b2, b3 = [numpy.round(k).clip(0, 255).astype('uint8')
+        for k in frames(shape, 3)]
+    i1, i2, i3 = [k.astype('float64') for k in (b1, b2, b3)]
+    u = numpy.zeros(shape, 'float64')
+    v = numpy.zeros(shape, 'float64')
+    vanilla = VanillaFlow(shape)
+    flow = Flow(shape)
+
+    def run_vanilla():
+      u.fill(0.); v.fill(0.)
+      vanilla.estimate(alpha, iterations, i1, i2, u, v)
+      return u, v
+
+    def run_flow():
+      u.fill(0.); v.fill(0.)
+      flow.estimate(alpha, iterations, i1, i2, i3, u, v)
+      return u, v
+
+    def run_opencv():
+      return solve(alpha, iterations, b1, b2)
+
+    ref_u, ref_v = run_opencv()
+
+    results = []
+    for name, call in (('VanillaFlow', run_vanilla), ('Flow', run_flow),
+        ('OpenCV', run_opencv)):
+      r = derived(measure(call, repeat, counters), pixels)
+      fu, fv = call()
+      epe = numpy.hypot(fu - ref_u, fv - ref_v)
+      r['epe'] = epe.mean()
+      r['epe max'] = epe.max()
+      results.append(('%s (%d it.)' % (name, iterations), r))
+
+    report_opencv(shape, results, stream)
+    retval[shape] = results
+
+  return retval
+
+
+def report_opencv(shape, results, stream=sys.stdout):
+  """Prints the comparison to OpenCV for one image size"""
+
+  stream.write("\nComparison to OpenCV, %d x %d pixels\n" % shape)
+  stream.write("%-28s %10s %10s %10s %10s\n" % \
+      ('solver', 'ms/call', 'Mpix/s', 'EPE', 'max EPE'))
+  for name, r in results:
+    stream.write("%-28s %10.3f %10.1f %10.4f %10.4f\n" % (name, r['ms'],
+      r['mpix/s'], r['epe'], r['epe max']))
+
+
+def benchmark(shapes, iterations, repeat, stream=sys.stdout, roof=False):
+  """Runs all kernels on all image shapes, returning the derived metrics
+  in a dictionary indexed by shape. If ``roof`` is set, kernels are also
+  placed on the roofline of this host."""
+
+  counters = PerfCounters()
+  if not counters.available:
+    stream.write("Hardware counters unavailable on this host: reporting timings only\n")
+
+  if roof:
+    bandwidth, flops = peaks()
+    stream.write("Single-thread peaks: %.2f GB/s, %.2f GFLOP/s (ridge at %.3f flop/B)\n" % (bandwidth / 1e9, flops / 1e9, flops / bandwidth))
+
+  retval = {}
+  for shape in shapes:
+    pixels = shape[0] * shape[1]
+    results = [(name, derived(measure(call, repeat, counters), pixels))
+        for name, call in kernels(shape, iterations)]
+    report(shape, results, stream)
+    if roof:
+      results = roofline(results, iterations, pixels, bandwidth, flops)
+      report_roofline(shape, results, stream)
+    retval[shape] = results
+  return retval
+
+
+def main(user_input=None):
+
+  import argparse
+
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+
+  parser.add_argument("-s", "--size", action="append", dest="sizes",
+      metavar='HxW', help="Image size to benchmark, as height x width (may be given multiple times, defaults to 480x640)")
+  parser.add_argument("-i", "--iterations",
+      action="store", dest="iterations", default=20, type=int, metavar='INT',
+      help="Number of iterations for the flow solvers (defaults to %(default)s)")
+  parser.add_argument("-r", "--repeat",
+      action="store", dest="repeat", default=10, type=int, metavar='INT',
+      help="Number of timed calls per kernel (defaults to %(default)s)")
+  parser.add_argument("-R", "--roofline", action="store_true",
+      dest="roofline", default=False,
+      help="Measures the peaks of this host and places every kernel on its roofline")
+  parser.add_argument("-c", "--opencv", action="store_true",
+      dest="opencv", default=False,
+      help="Also compares the flow solvers to OpenCV's Horn & Schunck, if it is available")
+
+  args = parser.parse_args(args=user_input)
+
+  shapes = []
+  for size in (args.sizes or ['480x640']):
+    try:
+      shape = tuple(int(k) for k in size.lower().split('x'))
+      if len(shape) != 2: raise ValueError
+    except ValueError:
+      parser.error("invalid image size `%s' - use HxW, e.g. 480x640" % size)
+    shapes.append(shape)
+
+  benchmark(shapes, args.iterations, args.repeat, roof=args.roofline)
+  if args.opencv: compare_opencv(shapes, args.iterations, args.repeat)
+
+  return 0
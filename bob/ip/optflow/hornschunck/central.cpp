@@ -12,8 +12,12 @@
 #include <bob.extension/documentation.h>
 #include <structmember.h>
 
+#include <string>
+
 #include "SpatioTemporalGradient.h"
 
+int PyBobIpOptflow_InputConverter(PyObject* o, PyBlitzArrayObject** a);
+
 /************************************************
  * Implementation of CentralGradient base class *
  ************************************************/
@@ -62,8 +66,8 @@ static int PyBobIpOptflowCentralGradient_init
   Py_ssize_t height, width;
 
   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&(nn)", kwlist,
-        &PyBlitzArray_Converter, &diff,
-        &PyBlitzArray_Converter, &avg,
+        &PyBobIpOptflow_InputConverter, &diff,
+        &PyBobIpOptflow_InputConverter, &avg,
         &height, &width)) return -1;
 
   //protects acquired resources through this scope
@@ -230,7 +234,48 @@ static int PyBobIpOptflowCentralGradient_setAverage
 
 }
 
+static auto s_sigma = bob::extension::VariableDoc(
+    "sigma",
+    "float",
+    "The standard deviation, in pixels, of a Gaussian smoothing applied to the input images before differentiation, or 0 (the default) for no smoothing",
+    "The smoothing uses the recursive filter of Young & van Vliet, so its cost does not depend on ``sigma``, which should be at least 0.5. Borders are extended by replicating the pixels on the edges."
+    );
+
+static PyObject* PyBobIpOptflowCentralGradient_getSigma
+(PyBobIpOptflowCentralGradientObject* self, void* /*closure*/) {
+  return Py_BuildValue("d", self->cxx->getSigma());
+}
+
+static int PyBobIpOptflowCentralGradient_setSigma
+(PyBobIpOptflowCentralGradientObject* self, PyObject* o, void* /*closure*/) {
+
+  double sigma = PyFloat_AsDouble(o);
+  if (PyErr_Occurred()) return -1;
+
+  try {
+    self->cxx->setSigma(sigma);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_ValueError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `sigma' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
 static PyGetSetDef PyBobIpOptflowCentralGradient_getseters[] = {
+    {
+      s_sigma.name(),
+      (getter)PyBobIpOptflowCentralGradient_getSigma,
+      (setter)PyBobIpOptflowCentralGradient_setSigma,
+      s_sigma.doc(),
+      0
+    },
     {
       s_difference.name(),
       (getter)PyBobIpOptflowCentralGradient_getDifference,
@@ -354,9 +399,9 @@ static PyObject* PyBobIpOptflowCentralGradient_evaluate
   PyBlitzArrayObject* et = 0;
 
   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&O&|O&O&O&", kwlist,
-        &PyBlitzArray_Converter, &image1,
-        &PyBlitzArray_Converter, &image2,
-        &PyBlitzArray_Converter, &image3,
+        &PyBobIpOptflow_InputConverter, &image1,
+        &PyBobIpOptflow_InputConverter, &image2,
+        &PyBobIpOptflow_InputConverter, &image3,
         &PyBlitzArray_OutputConverter, &ex,
         &PyBlitzArray_OutputConverter, &ey,
         &PyBlitzArray_OutputConverter, &et
@@ -494,6 +539,257 @@ static PyObject* PyBobIpOptflowCentralGradient_evaluate
 
 }
 
+static auto s_evaluate_channels = bob::extension::FunctionDoc(
+    "evaluate_channels",
+    "Evaluates some channels of the spatio-temporal gradient from the input image triplet",
+    "Only the convolutions of the requested channels are run, so evaluating ``et`` alone, e.g. to detect changes, costs about a third of :py:meth:`evaluate`. Evaluated channels are the same as those of :py:meth:`evaluate`."
+    )
+    .add_prototype("image1, image2, image3, channels", "gradients")
+    .add_parameter("image1, image2, image3", "array-like (2D, float64)",
+      "Sequence of images to evaluate the gradient from. All images should have the same shape, which should match that of this functor.")
+    .add_parameter("channels", "str", "The channels to evaluate: any of ``'x'``, ``'y'`` and ``'t'``, each at most once, e.g. ``'t'`` or ``'xy'``")
+    .add_return("gradients", "tuple", "The evaluated channels (2D arrays with 64-bit floats and the shape of the input images), in the order given on ``channels``")
+    ;
+
+/**
+ * Parses a string of gradient channels ('x', 'y' or 't'), returning them or-ed
+ * together, or 0 (with an exception set) on errors
+ */
+static int parse_channels(PyObject* self, const char* channels) {
+
+  int retval = 0;
+  for (const char* c=channels; *c; ++c) {
+    int channel = 0;
+    switch (*c) {
+      case 'x': channel = bob::ip::optflow::GradientX; break;
+      case 'y': channel = bob::ip::optflow::GradientY; break;
+      case 't': channel = bob::ip::optflow::GradientT; break;
+      default:
+        PyErr_Format(PyExc_ValueError, "`%s' requires `channels' to be made of 'x', 'y' or 't', but you set it to '%s'", Py_TYPE(self)->tp_name, channels);
+        return 0;
+    }
+    if (retval & channel) {
+      PyErr_Format(PyExc_ValueError, "`%s' requires every channel on `channels' at most once, but you set it to '%s'", Py_TYPE(self)->tp_name, channels);
+      return 0;
+    }
+    retval |= channel;
+  }
+
+  if (!retval) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires at least one channel on `channels'", Py_TYPE(self)->tp_name);
+  }
+
+  return retval;
+
+}
+
+static PyObject* PyBobIpOptflowCentralGradient_evaluateChannels
+(PyBobIpOptflowCentralGradientObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {
+    "image1",
+    "image2",
+    "image3",
+    "channels",
+    0
+    };
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* image1 = 0;
+  PyBlitzArrayObject* image2 = 0;
+  PyBlitzArrayObject* image3 = 0;
+  const char* channels = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&O&s", kwlist,
+        &PyBobIpOptflow_InputConverter, &image1,
+        &PyBobIpOptflow_InputConverter, &image2,
+        &PyBobIpOptflow_InputConverter, &image3,
+        &channels
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto image1_ = make_safe(image1);
+  auto image2_ = make_safe(image2);
+  auto image3_ = make_safe(image3);
+
+  if (image1->type_num != NPY_FLOAT64 || image1->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 64-bit float arrays for input array `image1', but you passed a %" PY_FORMAT_SIZE_T "dD array with type `%s'", Py_TYPE(self)->tp_name, image1->ndim, PyBlitzArray_TypenumAsString(image1->type_num));
+    return 0;
+  }
+
+  if (image2->type_num != NPY_FLOAT64 || image2->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 64-bit float arrays for input array `image2', but you passed a %" PY_FORMAT_SIZE_T "dD array with type `%s'", Py_TYPE(self)->tp_name, image2->ndim, PyBlitzArray_TypenumAsString(image2->type_num));
+    return 0;
+  }
+
+  if (image3->type_num != NPY_FLOAT64 || image3->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 64-bit float arrays for input array `image3', but you passed a %" PY_FORMAT_SIZE_T "dD array with type `%s'", Py_TYPE(self)->tp_name, image3->ndim, PyBlitzArray_TypenumAsString(image3->type_num));
+    return 0;
+  }
+
+  //check all input image dimensions are consistent
+  Py_ssize_t height = self->cxx->getShape()(0);
+  Py_ssize_t width = self->cxx->getShape()(1);
+
+  if (image1->shape[0] != height || image1->shape[1] != width) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' only supports arrays with shape (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) for input array `image1', but `image1''s shape is (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", Py_TYPE(self)->tp_name, height, width, image1->shape[0], image1->shape[1]);
+    return 0;
+  }
+
+  if (image2->shape[0] != height || image2->shape[1] != width) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' only supports arrays with shape (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) for input array `image2', but `image2''s shape is (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", Py_TYPE(self)->tp_name, height, width, image2->shape[0], image2->shape[1]);
+    return 0;
+  }
+
+  if (image3->shape[0] != height || image3->shape[1] != width) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' only supports arrays with shape (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) for input array `image3', but `image3''s shape is (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", Py_TYPE(self)->tp_name, height, width, image3->shape[0], image3->shape[1]);
+    return 0;
+  }
+
+  int channels_ = parse_channels((PyObject*)self, channels);
+  if (!channels_) return 0;
+
+  //allocates the requested channels only, in the order x, y, t
+  const int flags[3] = {bob::ip::optflow::GradientX,
+    bob::ip::optflow::GradientY, bob::ip::optflow::GradientT};
+  PyObject* outputs[3] = {0, 0, 0};
+  blitz::Array<double,2> unused;
+  blitz::Array<double,2>* bz[3] = {&unused, &unused, &unused};
+  for (int k=0; k<3; ++k) {
+    if (!(channels_ & flags[k])) continue;
+    outputs[k] = PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, image1->shape);
+    if (!outputs[k]) return 0;
+    bz[k] = PyBlitzArrayCxx_AsBlitz<double,2>((PyBlitzArrayObject*)outputs[k]);
+  }
+  auto ex_ = make_xsafe(outputs[0]);
+  auto ey_ = make_xsafe(outputs[1]);
+  auto et_ = make_xsafe(outputs[2]);
+
+  /** all basic checks are done, can call the functor now **/
+  try {
+    self->cxx->evaluateChannels(
+        *PyBlitzArrayCxx_AsBlitz<double,2>(image1),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(image2),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(image3),
+        *bz[0], *bz[1], *bz[2], channels_
+        );
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot evaluate gradient: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  //returns the channels in the order they were requested
+  PyObject* retval = PyTuple_New(std::string(channels).size());
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+  for (Py_ssize_t k=0; channels[k]; ++k) {
+    PyObject* a = outputs[channels[k] == 'x' ? 0 : (channels[k] == 'y' ? 1 : 2)];
+    PyObject* wrapped = PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", a));
+    if (!wrapped) return 0;
+    PyTuple_SET_ITEM(retval, k, wrapped);
+  }
+
+  Py_INCREF(retval);
+  return retval;
+
+}
+
+static auto s_evaluate_volume = bob::extension::FunctionDoc(
+    "evaluate_volume",
+    "Evaluates the spatio-temporal gradient for every triplet of consecutive frames on a stack",
+    "Each frame is filtered once and its contribution added to all gradients it takes part in, so a clip costs a single filtering pass per frame, instead of 3 when calling :py:meth:`evaluate` on every triplet. Results are the same as those of :py:meth:`evaluate`. The time axis is split in chunks, evaluated in parallel with the global interpreter lock released. Frames on the boundaries of chunks are filtered by both."
+    )
+    .add_prototype("frames, [threads]", "ex, ey, et")
+    .add_parameter("frames", "array-like (3D, float64)", "The stack of frames, with shape ``(T, height, width)``, where ``T`` is at least 3 and ``(height, width)`` matches the shape of this functor")
+    .add_parameter("threads", "int", "[Default: ``1``] The number of threads evaluating chunks of the stack in parallel, or 0 for one thread per core")
+    .add_return("ex, ey, et", "array (3D, float64)", "The gradients in the horizontal, vertical and time directions (respectively), with shape ``(T-2, height, width)``. Entry ``k`` holds the gradients of frames ``k`` to ``k+2``, w.r.t. frame ``k+1``.")
+    ;
+
+static PyObject* PyBobIpOptflowCentralGradient_evaluateVolume
+(PyBobIpOptflowCentralGradientObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"frames", "threads", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* frames = 0;
+  Py_ssize_t threads = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|n", kwlist,
+        &PyBobIpOptflow_InputConverter, &frames, &threads)) return 0;
+
+  //protects acquired resources through this scope
+  auto frames_ = make_safe(frames);
+
+  if (frames->type_num != NPY_FLOAT64 || frames->ndim != 3) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 3D 64-bit float arrays for input array `frames', but you passed a %" PY_FORMAT_SIZE_T "dD array with type `%s'", Py_TYPE(self)->tp_name, frames->ndim, PyBlitzArray_TypenumAsString(frames->type_num));
+    return 0;
+  }
+
+  Py_ssize_t height = self->cxx->getShape()(0);
+  Py_ssize_t width = self->cxx->getShape()(1);
+
+  if (frames->shape[0] < 3 || frames->shape[1] != height || frames->shape[2] != width) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' only supports stacks of at least 3 frames with shape (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) for input array `frames', but `frames''s shape is (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", Py_TYPE(self)->tp_name, height, width, frames->shape[0], frames->shape[1], frames->shape[2]);
+    return 0;
+  }
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `threads' to be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", Py_TYPE(self)->tp_name, threads);
+    return 0;
+  }
+
+  //allocates ex, ey and et
+  Py_ssize_t shape[3] = {frames->shape[0] - 2, height, width};
+
+  auto ex = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 3, shape);
+  if (!ex) return 0;
+  auto ex_ = make_safe(ex);
+
+  auto ey = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 3, shape);
+  if (!ey) return 0;
+  auto ey_ = make_safe(ey);
+
+  auto et = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 3, shape);
+  if (!et) return 0;
+  auto et_ = make_safe(et);
+
+  /** all basic checks are done, can call the functor now **/
+  auto bz_frames = PyBlitzArrayCxx_AsBlitz<double,3>(frames);
+  auto bz_ex = PyBlitzArrayCxx_AsBlitz<double,3>(ex);
+  auto bz_ey = PyBlitzArrayCxx_AsBlitz<double,3>(ey);
+  auto bz_et = PyBlitzArrayCxx_AsBlitz<double,3>(et);
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    self->cxx->operator()(*bz_frames, *bz_ex, *bz_ey, *bz_et, threads);
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot evaluate gradient: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return Py_BuildValue("(NNN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", ex)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", ey)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", et))
+    );
+
+}
+
 static PyMethodDef PyBobIpOptflowCentralGradient_methods[] = {
   {
     s_evaluate.name(),
@@ -501,6 +797,18 @@ static PyMethodDef PyBobIpOptflowCentralGradient_methods[] = {
     METH_VARARGS|METH_KEYWORDS,
     s_evaluate.doc()
   },
+  {
+    s_evaluate_channels.name(),
+    (PyCFunction)PyBobIpOptflowCentralGradient_evaluateChannels,
+    METH_VARARGS|METH_KEYWORDS,
+    s_evaluate_channels.doc()
+  },
+  {
+    s_evaluate_volume.name(),
+    (PyCFunction)PyBobIpOptflowCentralGradient_evaluateVolume,
+    METH_VARARGS|METH_KEYWORDS,
+    s_evaluate_volume.doc()
+  },
   {0} /* Sentinel */
 };
 
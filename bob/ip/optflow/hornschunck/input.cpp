@@ -0,0 +1,82 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:23:31 2026 +0000
+ *
+ * @brief Zero-copy conversion of DLPack and buffer-protocol inputs
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <bob.blitz/cppapi.h>
+#include <bob.blitz/cleanup.h>
+
+/**
+ * The DLPack device type of CPU memory (kDLCPU)
+ */
+static const int DLPACK_CPU = 1;
+
+/**
+ * Checks DLPack producers hold their data on the CPU, if they tell
+ */
+static bool check_dlpack_device(PyObject* o) {
+
+  if (!PyObject_HasAttrString(o, "__dlpack_device__")) return true;
+
+  auto device = make_safe(PyObject_CallMethod(o, "__dlpack_device__", 0));
+  if (!device) return false;
+
+  int type = 0;
+  int id = 0;
+  if (!PyArg_ParseTuple(device.get(), "ii", &type, &id)) return false;
+
+  if (type != DLPACK_CPU) {
+    PyErr_Format(PyExc_TypeError, "only DLPack tensors on the CPU are supported, but the `%s' you passed is on device type %d (id %d)", Py_TYPE(o)->tp_name, type, id);
+    return false;
+  }
+
+  return true;
+
+}
+
+/**
+ * Converts read-only inputs like PyBlitzArray_Converter(), also accepting
+ * DLPack producers (objects with a ``__dlpack__`` method) and objects
+ * exposing the buffer protocol without a copy. Those are first viewed as
+ * numpy arrays, which keep the producers alive for as long as the view.
+ * Returns a new reference on success.
+ */
+int PyBobIpOptflow_InputConverter(PyObject* o, PyBlitzArrayObject** a) {
+
+  if (PyBlitzArray_Check(o)) return PyBlitzArray_Converter(o, a);
+
+  auto numpy = make_safe(PyImport_ImportModule("numpy"));
+  if (!numpy) return 0;
+  auto ndarray = make_safe(PyObject_GetAttrString(numpy.get(), "ndarray"));
+  if (!ndarray) return 0;
+
+  int is_ndarray = PyObject_IsInstance(o, ndarray.get());
+  if (is_ndarray < 0) return 0;
+  if (is_ndarray) return PyBlitzArray_Converter(o, a);
+
+  PyObject* view = 0;
+
+  if (PyObject_HasAttrString(o, "__dlpack__")) {
+    if (!check_dlpack_device(o)) return 0;
+    if (!PyObject_HasAttrString(numpy.get(), "from_dlpack")) {
+      PyErr_Format(PyExc_TypeError, "DLPack inputs (like the `%s' you passed) require numpy 1.22 or newer", Py_TYPE(o)->tp_name);
+      return 0;
+    }
+    view = PyObject_CallMethod(numpy.get(), "from_dlpack", "O", o);
+  }
+  else if (PyObject_CheckBuffer(o)) {
+    auto memory = make_safe(PyMemoryView_FromObject(o));
+    if (!memory) return 0;
+    view = PyObject_CallMethod(numpy.get(), "asarray", "O", memory.get());
+  }
+  else return PyBlitzArray_Converter(o, a); //sequences and array-likes
+
+  if (!view) return 0;
+  auto view_ = make_safe(view);
+  return PyBlitzArray_Converter(view, a);
+
+}
@@ -14,16 +14,52 @@
 #include <bob.sp/api.h>
 #include <bob.extension/documentation.h>
 
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <system_error>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <climits>
+
 #include "HornAndSchunckFlow.h"
+#include "BlockMatching.h"
+#include "Warp.h"
+#include "Synthetic.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+
+int PyBobIpOptflow_InputConverter(PyObject* o, PyBlitzArrayObject** a);
+
+PyObject* PyBobIpOptflow_RegionsAsList
+(const std::vector<bob::ip::optflow::Region>& regions);
+
+PyObject* PyBobIpOptflowLabelStatistics_AsDict
+(const bob::ip::optflow::LabelStatistics& s);
+
+PyObject* PyBobIpOptflowHoofFeatures_AsDict
+(const bob::ip::optflow::HoofFeatures& f);
+
+bob::ip::optflow::FlowSolver* PyBobIpOptflowSolver_AsCxx(PyObject* o,
+    bool** busy);
 
 extern PyTypeObject PyBobIpOptflowHornAndSchunck_Type;
 extern PyTypeObject PyBobIpOptflowVanillaHornAndSchunck_Type;
+extern PyTypeObject PyBobIpOptflowSolver_Type;
 extern PyTypeObject PyBobIpOptflowForwardGradient_Type;
 extern PyTypeObject PyBobIpOptflowHornAndSchunckGradient_Type;
 extern PyTypeObject PyBobIpOptflowCentralGradient_Type;
 extern PyTypeObject PyBobIpOptflowSobelGradient_Type;
 extern PyTypeObject PyBobIpOptflowPrewittGradient_Type;
 extern PyTypeObject PyBobIpOptflowIsotropicGradient_Type;
+extern PyTypeObject PyBobIpOptflowPerfCounters_Type;
+extern PyTypeObject PyBobIpOptflowFlowArchiveWriter_Type;
+extern PyTypeObject PyBobIpOptflowTracker_Type;
+extern PyTypeObject PyBobIpOptflowFlowArchiveReader_Type;
 
 static auto s_laplacian_avg_hs = bob::extension::FunctionDoc(
     "laplacian_avg_hs",
@@ -72,7 +108,7 @@ PyObject* PyBobIpOptflowHornAndSchunck_LaplacianAverage(
   PyBlitzArrayObject* input = 0;
 
   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist,
-        &PyBlitzArray_Converter, &input)) return 0;
+        &PyBobIpOptflow_InputConverter, &input)) return 0;
 
   //protects acquired resources through this scope
   auto input_ = make_safe(input);
@@ -155,7 +191,7 @@ PyObject* PyBobIpOptflowHornAndSchunck_LaplacianAverageOpenCV(
   PyBlitzArrayObject* input = 0;
 
   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist,
-        &PyBlitzArray_Converter, &input)) return 0;
+        &PyBobIpOptflow_InputConverter, &input)) return 0;
 
   //protects acquired resources through this scope
   auto input_ = make_safe(input);
@@ -191,210 +227,1930 @@ PyObject* PyBobIpOptflowHornAndSchunck_LaplacianAverageOpenCV(
 
 }
 
-static auto s_flow_error = bob::extension::FunctionDoc(
-    "flow_error",
+static auto s_recursive_gaussian = bob::extension::FunctionDoc(
+    "recursive_gaussian",
 
-    "Computes the generalized flow error between two images.",
+    "Smooths the input image with a recursive approximation of a Gaussian.",
 
-    "This function calculates the flow error between a pair of images:\n"
-    "\n"
-    ".. math::\n"
-    "   \n"
-    "   E = i2(x-u,y-v) - i1(x,y))\n"
-    "\n"
+    "Uses the recursive filter of Young & van Vliet (\"Recursive "
+    "implementation of the Gaussian filter\", Signal Processing, 1995): a "
+    "causal and an anti-causal pass of a 3rd order filter along each "
+    "dimension, so the cost does not depend on ``sigma``. Borders are "
+    "extended by replicating the pixels on the edges. This is the smoothing "
+    "applied by gradient and flow estimators when their ``sigma`` is set."
     )
-    .add_prototype("image1, image2, u, v", "E")
-    .add_parameter("image1, image2", "array-like (2D, float64)",
-      "Sequence of images the flow was estimated with")
-    .add_parameter("u, v", "array-like (2D, float64)", "The estimated flows in the horizontal and vertical directions (respectively), which should have dimensions matching those of ``image1`` and ``image2``.")
-    .add_return("E", "array (2D, float)", "The estimated flow error E.")
+    .add_prototype("input, sigma", "output")
+    .add_parameter("input", "array-like (2D, float64)",
+      "The 2D array you'd like to smooth")
+    .add_parameter("sigma", "float", "The standard deviation of the Gaussian, in pixels (at least 0.5)")
+    .add_return("output", "array (2D, float)", "The smoothed ``input``")
     ;
 
-PyObject* PyBobIpOptflowHornAndSchunck_FlowError(PyObject*,
-    PyObject* args, PyObject* kwds) {
+PyObject* PyBobIpOptflowHornAndSchunck_RecursiveGaussian(
+    PyObject*, PyObject* args, PyObject* kwds) {
 
-  static const char* const_kwlist[] = {
-    "image1",
-    "image2",
-    "u",
-    "v",
-    };
+  static const char* const_kwlist[] = {"input", "sigma", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* input = 0;
+  double sigma = 0.;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&d", kwlist,
+        &PyBobIpOptflow_InputConverter, &input, &sigma)) return 0;
+
+  //protects acquired resources through this scope
+  auto input_ = make_safe(input);
+
+  if (input->type_num != NPY_FLOAT64 || input->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `input' array");
+    return 0;
+  }
+
+  if (sigma < 0.5) {
+    PyErr_Format(PyExc_ValueError, "`sigma' should be at least 0.5, but you set it to %g", sigma);
+    return 0;
+  }
+
+  //allocates the output
+  auto output = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64,
+      input->ndim, input->shape);
+  if (!output) return 0;
+  auto output_ = make_safe(output);
+
+  try {
+    bob::ip::optflow::recursiveGaussian(
+        *PyBlitzArrayCxx_AsBlitz<double,2>(input),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(output),
+        sigma
+        );
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_SetString(PyExc_RuntimeError, "cannot apply filter: unknown exception caught");
+    return 0;
+  }
+
+  Py_INCREF(output);
+  return PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(output));
+
+}
+
+static auto s_changed_regions = bob::extension::FunctionDoc(
+    "changed_regions",
+
+    "Finds the regions that changed between consecutive images.",
+
+    "The images are divided in blocks of ``block`` x ``block`` pixels "
+    "(partial blocks on the right and bottom borders included) and blocks "
+    "in which any pixel changed by more than ``threshold`` between "
+    "consecutive images are marked. Every run of marked blocks along a row "
+    "of blocks makes a region, which grows down over the following rows of "
+    "blocks with the same run. These are the regions "
+    ":py:meth:`Flow.estimate_regions` and "
+    ":py:meth:`VanillaFlow.estimate_regions` update, if none are given."
+    )
+    .add_prototype("image1, image2, [image3], [threshold], [block]", "regions")
+    .add_parameter("image1, image2, image3", "array-like (2D, float64)",
+      "The 2 or 3 consecutive images to compare")
+    .add_parameter("threshold", "float", "[Default: ``0.``] The largest change of a pixel value that is ignored")
+    .add_parameter("block", "int", "[Default: ``16``] The side of the square blocks changes are found on")
+    .add_return("regions", "[(int, int, int, int)]", "The regions that changed, as ``(y, x, height, width)`` tuples, clipped to the images, from top to bottom")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_ChangedRegions(
+    PyObject*, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"image1", "image2", "image3",
+    "threshold", "block", 0};
   static char** kwlist = const_cast<char**>(const_kwlist);
 
-  double alpha;
-  Py_ssize_t iterations;
   PyBlitzArrayObject* image1 = 0;
   PyBlitzArrayObject* image2 = 0;
-  PyBlitzArrayObject* u = 0;
-  PyBlitzArrayObject* v = 0;
+  PyBlitzArrayObject* image3 = 0;
+  double threshold = 0.;
+  int block = 16;
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&O&O&", kwlist,
-        &alpha, &iterations,
-        &PyBlitzArray_Converter, &image1,
-        &PyBlitzArray_Converter, &image2,
-        &PyBlitzArray_Converter, &u,
-        &PyBlitzArray_Converter, &v
-        )) return 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|O&di", kwlist,
+        &PyBobIpOptflow_InputConverter, &image1,
+        &PyBobIpOptflow_InputConverter, &image2,
+        &PyBobIpOptflow_InputConverter, &image3,
+        &threshold, &block)) return 0;
 
   //protects acquired resources through this scope
   auto image1_ = make_safe(image1);
   auto image2_ = make_safe(image2);
-  auto u_ = make_safe(u);
-  auto v_ = make_safe(v);
+  auto image3_ = make_xsafe(image3);
 
   if (image1->type_num != NPY_FLOAT64 || image1->ndim != 2) {
-    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `image1' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", image1->ndim, PyBlitzArray_TypenumAsString(image1->type_num));
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `image1' array");
     return 0;
   }
 
   if (image2->type_num != NPY_FLOAT64 || image2->ndim != 2) {
-    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `image2' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", image2->ndim, PyBlitzArray_TypenumAsString(image2->type_num));
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `image2' array");
     return 0;
   }
 
-  if (u->type_num != NPY_FLOAT64 || u->ndim != 2) {
-    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `u' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", u->ndim, PyBlitzArray_TypenumAsString(u->type_num));
+  if (image3 && (image3->type_num != NPY_FLOAT64 || image3->ndim != 2)) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `image3' array");
     return 0;
   }
 
-  if (v->type_num != NPY_FLOAT64 || v->ndim != 2) {
-    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `v' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", v->ndim, PyBlitzArray_TypenumAsString(v->type_num));
+  if (threshold < 0.) {
+    PyErr_Format(PyExc_ValueError, "`threshold' should be non-negative, but you set it to %g", threshold);
     return 0;
   }
 
-  //check all input image dimensions are consistent
-  Py_ssize_t height = image1->shape[0];
-  Py_ssize_t width  = image1->shape[1];
+  if (block < 1) {
+    PyErr_Format(PyExc_ValueError, "`block' should be at least 1, but you set it to %d", block);
+    return 0;
+  }
 
-  if (image2->shape[0] != height || image2->shape[1] != width) {
-    PyErr_Format(PyExc_RuntimeError, "input array `image1' has shape = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) which differs from that of `image2' = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", height, width, image2->shape[0], image2->shape[1]);
+  std::vector<bob::ip::optflow::Region> regions;
+
+  try {
+    if (image3) {
+      bob::ip::optflow::changedRegions(
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image1),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image2),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image3),
+          threshold, block, regions
+          );
+    }
+    else {
+      bob::ip::optflow::changedRegions(
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image1),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image2),
+          threshold, block, regions
+          );
+    }
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_SetString(PyExc_RuntimeError, "cannot find changed regions: unknown exception caught");
     return 0;
   }
 
-  if (u->shape[0] != height || u->shape[1] != width) {
-    PyErr_Format(PyExc_RuntimeError, "input arrays `image1' and `image2' have shape = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) which differs from that of `u' = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", height, width, u->shape[0], u->shape[1]);
+  return PyBobIpOptflow_RegionsAsList(regions);
+
+}
+
+static auto s_block_matching = bob::extension::FunctionDoc(
+    "block_matching",
+
+    "Estimates a coarse flow by block matching, to initialize the solvers "
+    "on large displacements.",
+
+    "Horn & Schunck only converges well for displacements of about a "
+    "pixel. For faster motion, pass the flow returned by this function as "
+    "the initial ``u`` and ``v`` of the solvers, which then converge in "
+    "far fewer iterations.\n"
+    "\n"
+    "The images are first downsampled by averaging cells of ``scale`` x "
+    "``scale`` pixels. The first downsampled image is divided in blocks of "
+    "``block`` x ``block`` pixels and, for every block, the displacement "
+    "within ``radius`` (downsampled) pixels in each direction with the "
+    "smallest sum of absolute differences to the last image is kept. The "
+    "displacements are scaled back to pixels and bilinearly interpolated "
+    "between the centres of the blocks. With 3 images (as for "
+    ":py:class:`Flow`), the first image is matched to the last and the "
+    "displacements are halved, giving the flow per frame."
+    )
+    .add_prototype("image1, image2, [image3], [radius], [block], [scale]", "u, v")
+    .add_parameter("image1, image2, image3", "array-like (2D, float64)",
+      "The 2 or 3 consecutive images to estimate the flow from")
+    .add_parameter("radius", "int", "[Default: ``4``] The largest displacement searched in each direction, in downsampled pixels")
+    .add_parameter("block", "int", "[Default: ``8``] The side of the square blocks matched, in downsampled pixels")
+    .add_parameter("scale", "int", "[Default: ``4``] The side of the cells averaged when downsampling the images")
+    .add_return("u, v", "array (2D, float)", "The flow in the horizontal and vertical directions (respectively), with the same shape as the images")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_BlockMatching(
+    PyObject*, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"image1", "image2", "image3",
+    "radius", "block", "scale", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* image1 = 0;
+  PyBlitzArrayObject* image2 = 0;
+  PyBlitzArrayObject* image3 = 0;
+  int radius = 4;
+  int block = 8;
+  int scale = 4;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|O&iii", kwlist,
+        &PyBobIpOptflow_InputConverter, &image1,
+        &PyBobIpOptflow_InputConverter, &image2,
+        &PyBobIpOptflow_InputConverter, &image3,
+        &radius, &block, &scale)) return 0;
+
+  //protects acquired resources through this scope
+  auto image1_ = make_safe(image1);
+  auto image2_ = make_safe(image2);
+  auto image3_ = make_xsafe(image3);
+
+  if (image1->type_num != NPY_FLOAT64 || image1->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `image1' array");
     return 0;
   }
 
-  if (v->shape[0] != height || v->shape[1] != width) {
-    PyErr_Format(PyExc_RuntimeError, "input arrays `image1', `image2' and `u' have shape = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) which differs from that of `v' = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", height, width, v->shape[0], v->shape[1]);
+  if (image2->type_num != NPY_FLOAT64 || image2->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `image2' array");
     return 0;
   }
 
-  //allocates the error return
-  auto error = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64,
+  if (image3 && (image3->type_num != NPY_FLOAT64 || image3->ndim != 2)) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `image3' array");
+    return 0;
+  }
+
+  if (radius < 0) {
+    PyErr_Format(PyExc_ValueError, "`radius' should be non-negative, but you set it to %d", radius);
+    return 0;
+  }
+
+  if (block < 1) {
+    PyErr_Format(PyExc_ValueError, "`block' should be at least 1, but you set it to %d", block);
+    return 0;
+  }
+
+  if (scale < 1) {
+    PyErr_Format(PyExc_ValueError, "`scale' should be at least 1, but you set it to %d", scale);
+    return 0;
+  }
+
+  //allocates the outputs
+  auto u = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64,
       image1->ndim, image1->shape);
-  auto error_ = make_safe(error);
+  if (!u) return 0;
+  auto u_ = make_safe(u);
+
+  auto v = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64,
+      image1->ndim, image1->shape);
+  if (!v) return 0;
+  auto v_ = make_safe(v);
 
-  /** all basic checks are done, can call the functor now **/
   try {
-    bob::ip::optflow::flowError(
-        *PyBlitzArrayCxx_AsBlitz<double,2>(image1),
-        *PyBlitzArrayCxx_AsBlitz<double,2>(image2),
-        *PyBlitzArrayCxx_AsBlitz<double,2>(u),
-        *PyBlitzArrayCxx_AsBlitz<double,2>(v),
-        *PyBlitzArrayCxx_AsBlitz<double,2>(error)
-        );
+    if (image3) {
+      bob::ip::optflow::blockMatching(
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image1),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image2),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image3),
+          radius, block, scale,
+          *PyBlitzArrayCxx_AsBlitz<double,2>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(v)
+          );
+    }
+    else {
+      bob::ip::optflow::blockMatching(
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image1),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image2),
+          radius, block, scale,
+          *PyBlitzArrayCxx_AsBlitz<double,2>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(v)
+          );
+    }
   }
   catch (std::exception& e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
     return 0;
   }
   catch (...) {
-    PyErr_SetString(PyExc_RuntimeError, "cannot estimate flow error: unknown exception caught");
+    PyErr_SetString(PyExc_RuntimeError, "cannot match blocks: unknown exception caught");
     return 0;
   }
 
-  Py_INCREF(error);
-  return PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(error));
+  return Py_BuildValue("(NN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v))
+    );
 
 }
 
-static PyMethodDef module_methods[] = {
-  {
-    s_laplacian_avg_hs.name(),
-    (PyCFunction)PyBobIpOptflowHornAndSchunck_LaplacianAverage,
-    METH_VARARGS|METH_KEYWORDS,
-    s_laplacian_avg_hs.doc()
-  },
-  {
-    s_laplacian_avg_hs_opencv.name(),
-    (PyCFunction)PyBobIpOptflowHornAndSchunck_LaplacianAverageOpenCV,
-    METH_VARARGS|METH_KEYWORDS,
-    s_laplacian_avg_hs_opencv.doc()
-  },
-  {
-    s_flow_error.name(),
-    (PyCFunction)PyBobIpOptflowHornAndSchunck_FlowError,
-    METH_VARARGS|METH_KEYWORDS,
-    s_flow_error.doc()
-  },
-  {0}  /* Sentinel */
-};
+static auto s_warp = bob::extension::FunctionDoc(
+    "warp",
 
-PyDoc_STRVAR(module_docstr, "Optical flow framework of Horn & Schunck");
+    "Warps an image by a flow field, with bilinear sampling.",
 
-#if PY_VERSION_HEX >= 0x03000000
-static PyModuleDef module_definition = {
-  PyModuleDef_HEAD_INIT,
-  BOB_EXT_MODULE_NAME,
-  module_docstr,
-  -1,
-  module_methods,
-  0, 0, 0, 0
-};
-#endif
+    "Computes ``output[y,x] = image[y+v[y,x], x+u[y,x]]``, interpolating "
+    "bilinearly between pixels. With the flow estimated from ``i1`` to "
+    "``i2``, warping ``i2`` compensates its motion, giving back an estimate "
+    "of ``i1``. Flow vectors that are not finite give 0. 8-bit images are "
+    "warped into 8-bit outputs, rounding the samples to the nearest "
+    "integer."
+    )
+    .add_prototype("image, u, v, [output], [border], [threads]", "output")
+    .add_parameter("image", "array-like (2D, float64 or uint8)", "The image to warp")
+    .add_parameter("u, v", "array-like (2D, float64)", "The flow in the horizontal and vertical directions (respectively), with the same shape as ``image``")
+    .add_parameter("output", "array (2D, same type as ``image``)", "[Default: ``None``] If given, the warped image is written into it (it should not overlap ``image``); otherwise, a new array is allocated")
+    .add_parameter("border", "str", "[Default: ``'clamp'``] How pixels beyond the borders of the image are sampled: ``'clamp'`` (the nearest border pixel), ``'zero'`` or ``'mirror'`` (the image mirrored on its borders)")
+    .add_parameter("threads", "int", "[Default: ``1``] The number of threads warping rows in parallel, or 0 for one thread per core")
+    .add_return("output", "array (2D, same type as ``image``)", "The warped image")
+    ;
 
-static PyObject* create_module (void) {
+PyObject* PyBobIpOptflowHornAndSchunck_Warp(
+    PyObject*, PyObject* args, PyObject* kwds) {
 
-  PyBobIpOptflowHornAndSchunck_Type.tp_new = PyType_GenericNew;
-  if (PyType_Ready(&PyBobIpOptflowHornAndSchunck_Type) < 0) return 0;
+  static const char* const_kwlist[] = {"image", "u", "v", "output",
+    "border", "threads", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
 
-  PyBobIpOptflowVanillaHornAndSchunck_Type.tp_new = PyType_GenericNew;
-  if (PyType_Ready(&PyBobIpOptflowVanillaHornAndSchunck_Type) < 0) return 0;
+  PyBlitzArrayObject* image = 0;
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  PyBlitzArrayObject* output = 0;
+  const char* border = "clamp";
+  Py_ssize_t threads = 1;
 
-  PyBobIpOptflowForwardGradient_Type.tp_new = PyType_GenericNew;
-  if (PyType_Ready(&PyBobIpOptflowForwardGradient_Type) < 0) return 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&O&|O&sn", kwlist,
+        &PyBobIpOptflow_InputConverter, &image,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v,
+        &PyBlitzArray_OutputConverter, &output,
+        &border, &threads)) return 0;
 
-  PyBobIpOptflowHornAndSchunckGradient_Type.tp_base =
-    &PyBobIpOptflowForwardGradient_Type;
-  if (PyType_Ready(&PyBobIpOptflowHornAndSchunckGradient_Type) < 0) return 0;
+  //protects acquired resources through this scope
+  auto image_ = make_safe(image);
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+  auto output_ = make_xsafe(output);
 
-  PyBobIpOptflowCentralGradient_Type.tp_new = PyType_GenericNew;
-  if (PyType_Ready(&PyBobIpOptflowCentralGradient_Type) < 0) return 0;
+  if ((image->type_num != NPY_FLOAT64 && image->type_num != NPY_UINT8) ||
+      image->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float or 8-bit unsigned integer arrays for `image' array");
+    return 0;
+  }
 
-  PyBobIpOptflowSobelGradient_Type.tp_base = &PyBobIpOptflowCentralGradient_Type;
-  if (PyType_Ready(&PyBobIpOptflowSobelGradient_Type) < 0) return 0;
+  if (u->type_num != NPY_FLOAT64 || u->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `u' array");
+    return 0;
+  }
 
-  PyBobIpOptflowPrewittGradient_Type.tp_base = &PyBobIpOptflowCentralGradient_Type;
-  if (PyType_Ready(&PyBobIpOptflowPrewittGradient_Type) < 0) return 0;
+  if (v->type_num != NPY_FLOAT64 || v->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `v' array");
+    return 0;
+  }
 
-  PyBobIpOptflowIsotropicGradient_Type.tp_base =
-    &PyBobIpOptflowCentralGradient_Type;
-  if (PyType_Ready(&PyBobIpOptflowIsotropicGradient_Type) < 0) return 0;
+  if (output && (output->type_num != image->type_num || output->ndim != 2)) {
+    PyErr_Format(PyExc_TypeError, "function requires the `output' array to be 2D, with the same type as `image' (%s), but it is %s", PyBlitzArray_TypenumAsString(image->type_num), PyBlitzArray_TypenumAsString(output->type_num));
+    return 0;
+  }
 
-# if PY_VERSION_HEX >= 0x03000000
-  PyObject* module = PyModule_Create(&module_definition);
-  auto module_ = make_xsafe(module);
-  const char* ret = "O";
-# else
-  PyObject* module = Py_InitModule3(BOB_EXT_MODULE_NAME, module_methods, module_docstr);
-  const char* ret = "N";
-# endif
-  if (!module) return 0;
+  bob::ip::optflow::WarpBorder border_;
+  if (std::string(border) == "clamp") border_ = bob::ip::optflow::WarpClamp;
+  else if (std::string(border) == "zero") border_ = bob::ip::optflow::WarpZero;
+  else if (std::string(border) == "mirror") border_ = bob::ip::optflow::WarpMirror;
+  else {
+    PyErr_Format(PyExc_ValueError, "`border' should be either 'clamp', 'zero' or 'mirror', but you set it to '%s'", border);
+    return 0;
+  }
 
-  /* register the types to python */
-  Py_INCREF(&PyBobIpOptflowHornAndSchunck_Type);
-  if (PyModule_AddObject(module, "Flow",
-        (PyObject *)&PyBobIpOptflowHornAndSchunck_Type) < 0) return 0;
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`threads' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", threads);
+    return 0;
+  }
 
-  Py_INCREF(&PyBobIpOptflowVanillaHornAndSchunck_Type);
-  if (PyModule_AddObject(module, "VanillaFlow",
-        (PyObject *)&PyBobIpOptflowVanillaHornAndSchunck_Type) < 0) return 0;
+  //allocates the output, if not given
+  if (!output) {
+    output = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(image->type_num,
+        image->ndim, image->shape);
+    if (!output) return 0;
+    output_ = make_safe(output);
+  }
 
-  Py_INCREF(&PyBobIpOptflowForwardGradient_Type);
-  if (PyModule_AddObject(module, "ForwardGradient",
-        (PyObject *)&PyBobIpOptflowForwardGradient_Type) < 0) return 0;
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (image->type_num == NPY_UINT8) {
+      bob::ip::optflow::warp(
+          *PyBlitzArrayCxx_AsBlitz<uint8_t,2>(image),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(v),
+          *PyBlitzArrayCxx_AsBlitz<uint8_t,2>(output),
+          border_, threads
+          );
+    }
+    else {
+      bob::ip::optflow::warp(
+          *PyBlitzArrayCxx_AsBlitz<double,2>(image),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(v),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(output),
+          border_, threads
+          );
+    }
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot warp image: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", output));
+
+}
+
+static auto s_label_statistics = bob::extension::FunctionDoc(
+    "label_statistics",
+
+    "Computes statistics of a flow field per label of a label image.",
+
+    "The label image (e.g., the segments of a segmentation) assigns a label "
+    "to every pixel: statistics are computed for labels 0 to "
+    "``n_labels - 1``, and pixels with other labels (e.g., negative ones) "
+    "are ignored. For every label, these are the number of pixels, the "
+    "mean flow, its covariance (normalized by the number of pixels) and a "
+    "histogram counting the pixels of every magnitude "
+    ":math:`\\sqrt{u^2 + v^2}`, with ``bins`` bins of equal width over "
+    "``[0, range)`` (larger magnitudes count in the last bin). Labels "
+    "without pixels have all statistics set to zero. All statistics are "
+    "computed in a single pass, by native threads, with the same results "
+    "whatever their number. To compute them while estimating the flow "
+    "instead, see :py:meth:`Flow.estimate_label_statistics`."
+    )
+    .add_prototype("u, v, labels, [n_labels], [bins], [range], [threads]", "statistics")
+    .add_parameter("u, v", "array-like (2D, float64)", "The flow in the horizontal and vertical directions (respectively)")
+    .add_parameter("labels", "array-like (2D, int32)", "The label of every pixel, with the same shape as the flow")
+    .add_parameter("n_labels", "int", "[Default: ``labels.max() + 1``] The number of labels to compute statistics for")
+    .add_parameter("bins", "int", "[Default: ``10``] The number of bins of the magnitude histograms")
+    .add_parameter("range", "float", "[Default: ``10.``] The upper limit, in pixels, of the magnitude histograms")
+    .add_parameter("threads", "int", "[Default: ``1``] The number of threads computing statistics in parallel, or 0 for one thread per core")
+    .add_return("statistics", "dict", "The number of pixels (``count``, 1D, int64), the mean flow (``mean``, 2D, with ``u`` then ``v`` on each row), its covariance (``covariance``, 3D, a 2x2 matrix per label) and the magnitude histogram (``histogram``, 2D, int64, with bins on the last dimension) of every label")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_LabelStatistics(
+    PyObject*, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"u", "v", "labels", "n_labels",
+    "bins", "range", "threads", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  PyBlitzArrayObject* labels = 0;
+  int n_labels = -1;
+  int bins = 10;
+  double range = 10.;
+  Py_ssize_t threads = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&O&|iidn", kwlist,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v,
+        &PyBobIpOptflow_InputConverter, &labels,
+        &n_labels, &bins, &range, &threads)) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+  auto labels_ = make_safe(labels);
+
+  if (u->type_num != NPY_FLOAT64 || u->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `u' array");
+    return 0;
+  }
+
+  if (v->type_num != NPY_FLOAT64 || v->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `v' array");
+    return 0;
+  }
+
+  if (labels->type_num != NPY_INT32 || labels->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 32-bit integer arrays for `labels' array");
+    return 0;
+  }
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`threads' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", threads);
+    return 0;
+  }
+
+  auto bz_labels = PyBlitzArrayCxx_AsBlitz<int32_t,2>(labels);
+  if (n_labels < 0) n_labels = bob::ip::optflow::countLabels(*bz_labels);
+
+  std::unique_ptr<bob::ip::optflow::LabelStatistics> statistics;
+  try {
+    statistics.reset(new bob::ip::optflow::LabelStatistics(n_labels, bins,
+          range));
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  }
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    bob::ip::optflow::labelStatistics(
+        *PyBlitzArrayCxx_AsBlitz<double,2>(u),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(v),
+        *bz_labels, *statistics, threads
+        );
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot compute label statistics: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return PyBobIpOptflowLabelStatistics_AsDict(*statistics);
+
+}
+
+static auto s_hoof = bob::extension::FunctionDoc(
+    "hoof",
+
+    "Computes histograms of oriented optical flow (HOOF) features, for "
+    "action recognition.",
+
+    "The flow field is divided in cells of ``cell`` x ``cell`` pixels "
+    "(partial cells on the right and bottom borders included) and every "
+    "pixel adds its magnitude :math:`\\sqrt{u^2 + v^2}` to the bin of its "
+    "direction :math:`\\mathrm{atan2}(v, u)` in the histogram of its cell, "
+    "with ``bins`` bins of equal width starting at :math:`-\\pi`. Cell "
+    "histograms are grouped in overlapping blocks of ``block`` x ``block`` "
+    "cells (with a stride of one cell), concatenated and normalized: each "
+    "value is divided by :math:`\\sqrt{\\|h\\|^2 + \\epsilon^2}`, where "
+    ":math:`h` holds the histograms of the block. Rows of cells are "
+    "computed in parallel by native threads, with the same results whatever "
+    "their number. To compute the features while estimating the flow "
+    "instead, see :py:meth:`Flow.estimate_hoof`."
+    )
+    .add_prototype("u, v, [cell], [bins], [block], [epsilon], [threads]", "features")
+    .add_parameter("u, v", "array-like (2D, float64)", "The flow in the horizontal and vertical directions (respectively)")
+    .add_parameter("cell", "int", "[Default: ``8``] The size of the cells, in pixels")
+    .add_parameter("bins", "int", "[Default: ``8``] The number of orientation bins of every cell histogram")
+    .add_parameter("block", "int", "[Default: ``2``] The size of the normalization blocks, in cells")
+    .add_parameter("epsilon", "float", "[Default: ``0.01``] Regularizes the block norms, so blocks with little motion are not amplified")
+    .add_parameter("threads", "int", "[Default: ``1``] The number of threads computing the features in parallel, or 0 for one thread per core")
+    .add_return("features", "dict", "The cell histograms (``cells``, 3D, with bins on the last dimension) and the normalized block descriptors (``blocks``, 3D, with the ``block * block * bins`` values of every block, ordered by cell row, cell column and bin, on the last dimension)")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_Hoof(
+    PyObject*, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"u", "v", "cell", "bins", "block",
+    "epsilon", "threads", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  int cell = 8;
+  int bins = 8;
+  int block = 2;
+  double epsilon = 0.01;
+  Py_ssize_t threads = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|iiidn", kwlist,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v,
+        &cell, &bins, &block, &epsilon, &threads)) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+
+  if (u->type_num != NPY_FLOAT64 || u->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `u' array");
+    return 0;
+  }
+
+  if (v->type_num != NPY_FLOAT64 || v->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays for `v' array");
+    return 0;
+  }
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`threads' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", threads);
+    return 0;
+  }
+
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  std::unique_ptr<bob::ip::optflow::HoofFeatures> features;
+  try {
+    features.reset(new bob::ip::optflow::HoofFeatures(bz_u->shape(), cell,
+          bins, block, epsilon));
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  }
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    bob::ip::optflow::hoof(*bz_u, *PyBlitzArrayCxx_AsBlitz<double,2>(v),
+        *features, threads);
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot compute HOOF features: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return PyBobIpOptflowHoofFeatures_AsDict(*features);
+
+}
+
+static auto s_synthetic_sequence = bob::extension::FunctionDoc(
+    "synthetic_sequence",
+
+    "Generates a sequence of textured images under known motion, with its "
+    "exact flow.",
+
+    "Images show a texture made of sinusoids of random orientations, "
+    "wavelengths (4 to 24 pixels) and phases, drawn from ``seed``, with "
+    "values in ``[0, 255]``. Between consecutive frames, the texture is "
+    "zoomed by ``zoom``, rotated by ``rotation`` radians (from the x axis "
+    "towards the y axis) around the image centre and translated by "
+    "``translation``. Patches are discs with a texture of their own, moving "
+    "by constant translations over the background (later patches on top). "
+    "Textures are evaluated analytically where every pixel comes from, so "
+    "images are never interpolated and the flow is exact. The flow of frame "
+    "``k`` goes from frame ``k`` to frame ``k + 1``, like the flow "
+    "estimated by the solvers. Long sequences can be generated in pieces, "
+    "using ``first``. Rows are generated in parallel by native threads, "
+    "with the same results whatever their number."
+    )
+    .add_prototype("shape, frames, [translation], [rotation], [zoom], [patches], [first], [seed], [threads]", "images, u, v")
+    .add_parameter("shape", "(int, int)", "The shape of the images, as ``(height, width)``")
+    .add_parameter("frames", "int", "The number of frames to generate")
+    .add_parameter("translation", "(float, float)", "[Default: ``(0., 0.)``] The horizontal and vertical translation of the background between consecutive frames, in pixels")
+    .add_parameter("rotation", "float", "[Default: ``0.``] The rotation of the background between consecutive frames, in radians")
+    .add_parameter("zoom", "float", "[Default: ``1.``] The scale factor of the background between consecutive frames")
+    .add_parameter("patches", "array-like (2D, float64)", "[Default: ``None``] The moving patches, as a patches x 5 array of ``(y, x, radius, u, v)`` rows, with their centres on the first frame and their translations between consecutive frames")
+    .add_parameter("first", "int", "[Default: ``0``] The index of the first frame to generate")
+    .add_parameter("seed", "int", "[Default: ``0``] The seed of the texture")
+    .add_parameter("threads", "int", "[Default: ``1``] The number of threads generating rows in parallel, or 0 for one thread per core")
+    .add_return("images", "array (3D, float64)", "The images, as a frames x height x width array")
+    .add_return("u, v", "array (3D, float64)", "The exact flow from every frame to the next one, in the horizontal and vertical directions (respectively)")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_SyntheticSequence(
+    PyObject*, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"shape", "frames", "translation",
+    "rotation", "zoom", "patches", "first", "seed", "threads", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t height = 0;
+  Py_ssize_t width = 0;
+  Py_ssize_t frames = 0;
+  double tu = 0.;
+  double tv = 0.;
+  double rotation = 0.;
+  double zoom = 1.;
+  PyBlitzArrayObject* patches = 0;
+  Py_ssize_t first = 0;
+  Py_ssize_t seed = 0;
+  Py_ssize_t threads = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "(nn)n|(dd)ddO&nnn", kwlist,
+        &height, &width, &frames, &tu, &tv, &rotation, &zoom,
+        &PyBobIpOptflow_InputConverter, &patches,
+        &first, &seed, &threads)) return 0;
+
+  //protects acquired resources through this scope
+  auto patches_ = make_xsafe(patches);
+
+  if (patches && (patches->type_num != NPY_FLOAT64 || patches->ndim != 2 ||
+        patches->shape[1] != 5)) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 64-bit float arrays with 5 columns for `patches' array");
+    return 0;
+  }
+
+  if (frames < 0 || first < 0 || seed < 0 || threads < 0) {
+    PyErr_SetString(PyExc_ValueError, "`frames', `first', `seed' and `threads' should be non-negative");
+    return 0;
+  }
+
+  std::unique_ptr<bob::ip::optflow::SyntheticSequence> sequence;
+  try {
+    sequence.reset(new bob::ip::optflow::SyntheticSequence(
+          blitz::TinyVector<int,2>(height, width), seed));
+    sequence->setMotion(tu, tv, rotation, zoom);
+    if (patches) {
+      auto bz_patches = PyBlitzArrayCxx_AsBlitz<double,2>(patches);
+      for (int k=0; k<bz_patches->extent(0); ++k)
+        sequence->addPatch((*bz_patches)(k,0), (*bz_patches)(k,1),
+            (*bz_patches)(k,2), (*bz_patches)(k,3), (*bz_patches)(k,4));
+    }
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  }
+
+  //allocates the outputs
+  Py_ssize_t shape[3] = {frames, height, width};
+  auto images = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 3,
+      shape);
+  if (!images) return 0;
+  auto images_ = make_safe(images);
+  auto u = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 3, shape);
+  if (!u) return 0;
+  auto u_ = make_safe(u);
+  auto v = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 3, shape);
+  if (!v) return 0;
+  auto v_ = make_safe(v);
+
+  auto bz_images = PyBlitzArrayCxx_AsBlitz<double,3>(images);
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,3>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,3>(v);
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    for (int k=0; k<frames; ++k) {
+      blitz::Array<double,2> image = (*bz_images)(k, blitz::Range::all(),
+          blitz::Range::all());
+      blitz::Array<double,2> uk = (*bz_u)(k, blitz::Range::all(),
+          blitz::Range::all());
+      blitz::Array<double,2> vk = (*bz_v)(k, blitz::Range::all(),
+          blitz::Range::all());
+      sequence->image(first + k, image, threads);
+      sequence->flow(first + k, uk, vk, threads);
+    }
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot generate synthetic sequence: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return Py_BuildValue("(NNN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", images)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v))
+    );
+
+}
+
+static auto s_integer_gradient = bob::extension::FunctionDoc(
+    "integer_gradient",
+
+    "Evaluates the spatio-temporal gradients of 8-bit images exactly, in "
+    "16-bit integers.",
+
+    "The Horn & Schunck (2 images), Sobel and Prewitt (3 images) gradients "
+    "are evaluated with integer kernels, with the same borders as "
+    ":py:class:`HornAndSchunckGradient`, :py:class:`SobelGradient` and "
+    ":py:class:`PrewittGradient`: the gradients of those are ``scale`` "
+    "times the ones returned, exactly. All values fit 16 bits. The "
+    "gradients may be handed to :py:meth:`Solver.estimate_gradients` with "
+    "``scale``, which folds it into the regularization."
+    )
+    .add_prototype("image1, image2, [image3], [kernel]", "ex, ey, et, scale")
+    .add_parameter("image1, image2, image3", "array-like (2D, uint8)",
+      "The 2 (Horn & Schunck) or 3 (Sobel and Prewitt) consecutive images")
+    .add_parameter("kernel", "str", "[Default: ``None``] The gradient: ``'hs'``, ``'sobel'`` or ``'prewitt'``; by default, ``'hs'`` for 2 images and ``'sobel'`` for 3")
+    .add_return("ex, ey, et", "array (2D, int16)", "The gradients in the horizontal, vertical and time directions (respectively)")
+    .add_return("scale", "float", "The factor from these gradients to those of the floating-point operators: ``0.25`` for ``'hs'`` and ``1.`` for the others")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_IntegerGradient(
+    PyObject*, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"image1", "image2", "image3",
+    "kernel", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* image1 = 0;
+  PyBlitzArrayObject* image2 = 0;
+  PyBlitzArrayObject* image3 = 0;
+  const char* kernel = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|O&z", kwlist,
+        &PyBobIpOptflow_InputConverter, &image1,
+        &PyBobIpOptflow_InputConverter, &image2,
+        &PyBobIpOptflow_InputConverter, &image3,
+        &kernel)) return 0;
+
+  //protects acquired resources through this scope
+  auto image1_ = make_safe(image1);
+  auto image2_ = make_safe(image2);
+  auto image3_ = make_xsafe(image3);
+
+  if (image1->type_num != NPY_UINT8 || image1->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 8-bit unsigned integer arrays for `image1' array");
+    return 0;
+  }
+
+  if (image2->type_num != NPY_UINT8 || image2->ndim != 2) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 8-bit unsigned integer arrays for `image2' array");
+    return 0;
+  }
+
+  if (image3 && (image3->type_num != NPY_UINT8 || image3->ndim != 2)) {
+    PyErr_SetString(PyExc_TypeError, "function only supports 2D 8-bit unsigned integer arrays for `image3' array");
+    return 0;
+  }
+
+  bob::ip::optflow::IntegerKernel kernel_ = image3 ?
+    bob::ip::optflow::IntegerSobel : bob::ip::optflow::IntegerHornAndSchunck;
+  if (kernel) {
+    if (std::string(kernel) == "hs") kernel_ = bob::ip::optflow::IntegerHornAndSchunck;
+    else if (std::string(kernel) == "sobel") kernel_ = bob::ip::optflow::IntegerSobel;
+    else if (std::string(kernel) == "prewitt") kernel_ = bob::ip::optflow::IntegerPrewitt;
+    else {
+      PyErr_Format(PyExc_ValueError, "`kernel' should be either 'hs', 'sobel' or 'prewitt', but you set it to '%s'", kernel);
+      return 0;
+    }
+  }
+
+  std::unique_ptr<bob::ip::optflow::IntegerGradient> gradient;
+  try {
+    gradient.reset(new bob::ip::optflow::IntegerGradient(kernel_,
+          blitz::TinyVector<int,2>(image1->shape[0], image1->shape[1])));
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  }
+
+  if ((image3 ? 3 : 2) != gradient->getFrames()) {
+    PyErr_Format(PyExc_ValueError, "kernel `%s' takes %d images, but you gave %d", kernel, gradient->getFrames(), image3 ? 3 : 2);
+    return 0;
+  }
+
+  //allocates the outputs
+  auto ex = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT16, 2,
+      image1->shape);
+  if (!ex) return 0;
+  auto ex_ = make_safe(ex);
+  auto ey = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT16, 2,
+      image1->shape);
+  if (!ey) return 0;
+  auto ey_ = make_safe(ey);
+  auto et = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT16, 2,
+      image1->shape);
+  if (!et) return 0;
+  auto et_ = make_safe(et);
+
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (image3) {
+      (*gradient)(
+          *PyBlitzArrayCxx_AsBlitz<uint8_t,2>(image1),
+          *PyBlitzArrayCxx_AsBlitz<uint8_t,2>(image2),
+          *PyBlitzArrayCxx_AsBlitz<uint8_t,2>(image3),
+          *PyBlitzArrayCxx_AsBlitz<int16_t,2>(ex),
+          *PyBlitzArrayCxx_AsBlitz<int16_t,2>(ey),
+          *PyBlitzArrayCxx_AsBlitz<int16_t,2>(et)
+          );
+    }
+    else {
+      (*gradient)(
+          *PyBlitzArrayCxx_AsBlitz<uint8_t,2>(image1),
+          *PyBlitzArrayCxx_AsBlitz<uint8_t,2>(image2),
+          *PyBlitzArrayCxx_AsBlitz<int16_t,2>(ex),
+          *PyBlitzArrayCxx_AsBlitz<int16_t,2>(ey),
+          *PyBlitzArrayCxx_AsBlitz<int16_t,2>(et)
+          );
+    }
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot evaluate integer gradient: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return Py_BuildValue("(NNNd)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", ex)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", ey)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", et)),
+    gradient->getScale()
+    );
+
+}
+
+static auto s_estimate_many = bob::extension::FunctionDoc(
+    "estimate_many",
+
+    "Estimates the optical flow of many streams in a single call.",
+
+    "Every job is a tuple ``(solver, images)`` or ``(solver, images, u, "
+    "v)``, where ``solver`` is a :py:class:`Flow` (taking 3 images), a "
+    ":py:class:`VanillaFlow` (taking 2 images) or a :py:class:`Solver`, of "
+    "any shape, and ``u`` and "
+    "``v`` are initial estimates, updated in place, like for "
+    ":py:meth:`Flow.estimate`. The global interpreter lock is released once "
+    "for all jobs, which are run by native threads, the most expensive "
+    "first. Jobs on the same solver share its buffers, so they run one "
+    "after the other, in the order given. Every flow is the same as the one "
+    "``estimate`` would return for its job.\n\n"
+    "Without ``tile``, a job runs on a single thread, so a few large jobs "
+    "leave the other threads idle. With ``tile``, every job is split in "
+    "tiles of ``tile`` x ``tile`` pixels, which are spread over all threads. "
+    "Every tile is solved on its own (see :py:meth:`Solver.estimate_regions`),"
+    " grown by ``halo`` pixels on each side, with the flow around it kept as "
+    "the boundary condition, and only the tile itself is kept. As boundary "
+    "effects travel one pixel per iteration, the flows are the same as "
+    "without tiles when ``halo`` is at least ``iterations`` (the default), "
+    "but for gradients with smoothing (see :py:attr:`Solver.sigma`), which "
+    "are evaluated on the tiles grown by :math:`4\\sigma`. Smaller halos "
+    "cost less, but change the flow near tile edges: with 20 iterations on "
+    "480x640 synthetic frames and tiles of 64 or 128 pixels, the largest "
+    "difference was 60% of the largest flow magnitude with no halo, 7% with "
+    "4 pixels, 0.3% with 8 and below :math:`10^{-7}` with 16; with 100 "
+    "iterations, it was 11-14% with 8 pixels, 1% with 16 and :math:`10^{-5}`"
+    " with 32. Tiles cost more as the halo grows, by :math:`(t+2h)^2/t^2` "
+    "for tiles of :math:`t` pixels and halos of :math:`h`. Jobs on the same "
+    "solver still run one after the other, the tiles of each running in "
+    "parallel."
+    )
+    .add_prototype("alpha, iterations, jobs, [threads], [tile], [halo]", "flows")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`Flow.estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("jobs", "[tuple]", "The ``(solver, images)`` or ``(solver, images, u, v)`` jobs to run")
+    .add_parameter("threads", "int", "[Default: ``0``] The number of threads running jobs in parallel, or 0 for one thread per core")
+    .add_parameter("tile", "int", "[Default: ``0``] If set, the size of the tiles jobs are split in, to run in parallel")
+    .add_parameter("halo", "int", "[Default: ``iterations``] By how many pixels every tile is grown on each side")
+    .add_return("flows", "[(array, array)]", "The flows ``(u, v)`` of every job, in the order of ``jobs``")
+    ;
+
+/**
+ * A flow estimation of estimate_many()
+ */
+struct FlowJob {
+  PyObject* solver;
+  bob::ip::optflow::FlowSolver* cxx;
+  bool* busy; ///< raised while the solver runs without the GIL
+  blitz::Array<double,2>* images[3];
+  PyBlitzArrayObject* u;
+  PyBlitzArrayObject* v;
+  blitz::Array<double,2>* bz_u;
+  blitz::Array<double,2>* bz_v;
+};
+
+/**
+ * Converts an array of a job, checking it has the shape of its solver. The
+ * array is kept alive by the list keep. Returns 0 (with an exception set)
+ * on errors.
+ */
+static PyBlitzArrayObject* job_array(PyObject* o, bool output,
+    const blitz::TinyVector<int,2>& shape, Py_ssize_t job, const char* name,
+    PyObject* keep) {
+
+  PyBlitzArrayObject* a = 0;
+  if (!(output ? PyBlitzArray_OutputConverter(o, &a) :
+        PyBobIpOptflow_InputConverter(o, &a))) return 0;
+  auto a_ = make_safe(a);
+
+  if (a->type_num != NPY_FLOAT64 || a->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "job %" PY_FORMAT_SIZE_T "d: `estimate_many' only supports 2D 64-bit float arrays for `%s'", job, name);
+    return 0;
+  }
+
+  if (a->shape[0] != shape(0) || a->shape[1] != shape(1)) {
+    PyErr_Format(PyExc_RuntimeError, "job %" PY_FORMAT_SIZE_T "d: `estimate_many' requires arrays with the shape of the solver, (%d, %d), for `%s', but its shape is (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", job, shape(0), shape(1), name, a->shape[0], a->shape[1]);
+    return 0;
+  }
+
+  if (PyList_Append(keep, reinterpret_cast<PyObject*>(a)) != 0) return 0;
+  return a;
+
+}
+
+/**
+ * Runs worker on the given number of threads (the calling one included)
+ */
+static void run_workers(size_t threads, const std::function<void()>& worker) {
+
+  std::vector<std::thread> workers;
+  try {
+    while (workers.size() + 1 < threads)
+      workers.push_back(std::thread(worker));
+  }
+  catch (std::system_error&) {
+    //runs with the threads that could be started
+  }
+  worker();
+  for (auto& w: workers) w.join();
+
+}
+
+/**
+ * The images of a job
+ */
+static bob::ip::optflow::Frames job_frames(const FlowJob& j) {
+  if (j.cxx->getFrames() == 3)
+    return bob::ip::optflow::Frames(*j.images[0], *j.images[1], *j.images[2]);
+  return bob::ip::optflow::Frames(*j.images[0], *j.images[1]);
+}
+
+/**
+ * Runs groups of jobs on the given number of threads (the calling one
+ * included), taking groups in order. Jobs of a group run in turn. Errors
+ * are stored per job.
+ */
+static void run_groups(double alpha, size_t iterations,
+    const std::vector<FlowJob>& jobs,
+    const std::vector<std::vector<size_t> >& groups, size_t threads,
+    std::vector<std::string>& errors) {
+
+  std::atomic<size_t> next(0);
+  run_workers(threads, [&]() {
+    for (size_t g = next++; g < groups.size(); g = next++) {
+      for (size_t k: groups[g]) {
+        const FlowJob& j = jobs[k];
+        try {
+          (*j.cxx)(alpha, iterations, job_frames(j), *j.bz_u, *j.bz_v);
+        }
+        catch (std::exception& e) {
+          errors[k] = e.what();
+        }
+        catch (...) {
+          errors[k] = "unknown exception caught";
+        }
+      }
+    }
+  });
+
+}
+
+/**
+ * Runs groups of jobs split in tiles of tile x tile pixels, on the given
+ * number of threads (the calling one included). Jobs of a group run in
+ * turn, so jobs run in rounds: the first jobs of all groups, then the
+ * second ones, and so on, with the tiles of all jobs of a round spread over
+ * the threads. Errors are stored per job.
+ */
+static void run_tiles(double alpha, size_t iterations,
+    const std::vector<FlowJob>& jobs,
+    const std::vector<std::vector<size_t> >& groups, int tile, int halo,
+    size_t threads, std::vector<std::string>& errors) {
+
+  size_t rounds = 0;
+  for (const auto& group: groups) rounds = std::max(rounds, group.size());
+
+  for (size_t r=0; r<rounds; ++r) {
+
+    //tiles start from copies of the estimates, as the tiles next to them
+    //overwrite their halos meanwhile
+    std::vector<size_t> round;
+    std::vector<blitz::Array<double,2> > u_init, v_init;
+    std::vector<std::pair<size_t, bob::ip::optflow::Region> > tiles;
+    for (const auto& group: groups) {
+      if (r >= group.size()) continue;
+      const FlowJob& j = jobs[group[r]];
+      std::vector<bob::ip::optflow::Region> regions;
+      bob::ip::optflow::tileRegions(j.cxx->getShape(), tile, regions);
+      for (const auto& region: regions)
+        tiles.push_back(std::make_pair(round.size(), region));
+      round.push_back(group[r]);
+      u_init.push_back(j.bz_u->copy());
+      v_init.push_back(j.bz_v->copy());
+    }
+
+    std::vector<std::string> failed(tiles.size());
+    std::atomic<size_t> next(0);
+    run_workers(std::min(threads, tiles.size()), [&]() {
+      for (size_t t = next++; t < tiles.size(); t = next++) {
+        const size_t n = tiles[t].first;
+        const FlowJob& j = jobs[round[n]];
+        try {
+          j.cxx->estimateTile(alpha, iterations, job_frames(j), u_init[n],
+              v_init[n], tiles[t].second, halo, *j.bz_u, *j.bz_v);
+        }
+        catch (std::exception& e) {
+          failed[t] = e.what();
+        }
+        catch (...) {
+          failed[t] = "unknown exception caught";
+        }
+      }
+    });
+
+    //reports the first failure of every job
+    for (size_t t=0; t<tiles.size(); ++t) {
+      std::string& error = errors[round[tiles[t].first]];
+      if (error.empty()) error = failed[t];
+    }
+
+  }
+
+}
+
+PyObject* PyBobIpOptflowHornAndSchunck_EstimateMany(PyObject*,
+    PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solvers
+  bob::ip::optflow::trace::Span span("python:estimate_many");
+
+  static const char* const_kwlist[] = {"alpha", "iterations", "jobs",
+    "threads", "tile", "halo", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  double alpha;
+  Py_ssize_t iterations;
+  PyObject* jobs = 0;
+  Py_ssize_t threads = 0;
+  int tile = 0;
+  PyObject* halo_ = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "dnO|niO", kwlist,
+        &alpha, &iterations, &jobs, &threads, &tile, &halo_)) return 0;
+
+  if (iterations < 0) {
+    PyErr_Format(PyExc_ValueError, "`iterations' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", iterations);
+    return 0;
+  }
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`threads' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", threads);
+    return 0;
+  }
+
+  if (tile < 0) {
+    PyErr_Format(PyExc_ValueError, "`tile' should be non-negative, but you set it to %d", tile);
+    return 0;
+  }
+
+  //halos beyond the image are clipped, so they may be bounded
+  Py_ssize_t halo = std::min<Py_ssize_t>(iterations, INT_MAX);
+  if (halo_ && halo_ != Py_None) {
+    halo = PyNumber_AsSsize_t(halo_, PyExc_OverflowError);
+    if (halo == -1 && PyErr_Occurred()) return 0;
+    if (halo < 0) {
+      PyErr_Format(PyExc_ValueError, "`halo' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", halo);
+      return 0;
+    }
+    halo = std::min<Py_ssize_t>(halo, INT_MAX);
+  }
+
+  auto sequence = make_xsafe(PySequence_Fast(jobs, "`jobs' should be a sequence of (solver, images) or (solver, images, u, v) tuples"));
+  if (!sequence) return 0;
+  Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence.get());
+
+  //keeps the solvers and arrays of all jobs alive through this scope
+  auto keep = make_xsafe(PyList_New(0));
+  if (!keep) return 0;
+
+  std::vector<FlowJob> cxx_jobs(size);
+  for (Py_ssize_t k=0; k<size; ++k) {
+
+    auto job = make_xsafe(PySequence_Tuple(PySequence_Fast_GET_ITEM(sequence.get(), k)));
+    if (!job) return 0;
+
+    PyObject* solver = 0;
+    PyObject* images = 0;
+    PyObject* u = 0;
+    PyObject* v = 0;
+    if (!PyArg_ParseTuple(job.get(), "OO|OO", &solver, &images, &u, &v)) return 0;
+
+    if (u && !v) {
+      PyErr_Format(PyExc_RuntimeError, "job %" PY_FORMAT_SIZE_T "d: `estimate_many' requires either both `u' and `v' or none, but you provided `u' and not `v'", k);
+      return 0;
+    }
+
+    FlowJob& j = cxx_jobs[k];
+    j.solver = solver;
+    j.cxx = PyBobIpOptflowSolver_AsCxx(solver, &j.busy);
+    if (!j.cxx) {
+      PyErr_Format(PyExc_TypeError, "job %" PY_FORMAT_SIZE_T "d: `estimate_many' requires a Flow, VanillaFlow or Solver, but you passed a `%s'", k, Py_TYPE(solver)->tp_name);
+      return 0;
+    }
+    if (PyList_Append(keep.get(), solver) != 0) return 0;
+    const blitz::TinyVector<int,2> shape = j.cxx->getShape();
+
+    auto frames = make_xsafe(PySequence_Fast(images, "the images of a job should be given as a sequence"));
+    if (!frames) return 0;
+    const Py_ssize_t n = j.cxx->getFrames();
+    if (PySequence_Fast_GET_SIZE(frames.get()) != n) {
+      PyErr_Format(PyExc_ValueError, "job %" PY_FORMAT_SIZE_T "d: `%s' requires %" PY_FORMAT_SIZE_T "d images, but you passed %" PY_FORMAT_SIZE_T "d", k, Py_TYPE(solver)->tp_name, n, PySequence_Fast_GET_SIZE(frames.get()));
+      return 0;
+    }
+    for (Py_ssize_t i=0; i<n; ++i) {
+      auto image = job_array(PySequence_Fast_GET_ITEM(frames.get(), i), false,
+          shape, k, "images", keep.get());
+      if (!image) return 0;
+      j.images[i] = PyBlitzArrayCxx_AsBlitz<double,2>(image);
+    }
+
+    if (u) { //&& v
+      j.u = job_array(u, true, shape, k, "u", keep.get());
+      if (!j.u) return 0;
+      j.v = job_array(v, true, shape, k, "v", keep.get());
+      if (!j.v) return 0;
+    }
+    else { //allocates u and v
+      Py_ssize_t flow_shape[2] = {shape(0), shape(1)};
+      for (PyBlitzArrayObject** a: {&j.u, &j.v}) {
+        *a = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, flow_shape);
+        if (!*a) return 0;
+        auto a_ = make_safe(*a);
+        (*PyBlitzArrayCxx_AsBlitz<double,2>(*a)) = 0.;
+        if (PyList_Append(keep.get(), reinterpret_cast<PyObject*>(*a)) != 0) return 0;
+      }
+    }
+    j.bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(j.u);
+    j.bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(j.v);
+
+  }
+
+  //jobs on the same solver share its buffers, so they are grouped
+  std::vector<std::vector<size_t> > groups;
+  std::vector<double> cost;
+  std::map<PyObject*, size_t> group_of;
+  for (size_t k=0; k<cxx_jobs.size(); ++k) {
+    auto it = group_of.find(cxx_jobs[k].solver);
+    if (it == group_of.end()) {
+      it = group_of.insert(std::make_pair(cxx_jobs[k].solver, groups.size())).first;
+      groups.push_back(std::vector<size_t>());
+      cost.push_back(0.);
+    }
+    groups[it->second].push_back(k);
+    cost[it->second] += double(cxx_jobs[k].u->shape[0]) *
+      cxx_jobs[k].u->shape[1] * (iterations + 1);
+  }
+
+  //the most expensive groups go first, not to be the last ones running
+  std::vector<size_t> order(groups.size());
+  for (size_t g=0; g<order.size(); ++g) order[g] = g;
+  std::stable_sort(order.begin(), order.end(),
+      [&](size_t a, size_t b) { return cost[a] > cost[b]; });
+  std::vector<std::vector<size_t> > sorted;
+  for (size_t g: order) sorted.push_back(groups[g]);
+
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  if (!tile) threads = std::min<Py_ssize_t>(threads, sorted.size());
+
+  //solvers may not run in other threads meanwhile
+  for (const auto& group: sorted) {
+    const FlowJob& j = cxx_jobs[group[0]];
+    if (*j.busy) {
+      PyErr_Format(PyExc_RuntimeError, "job %" PY_FORMAT_SIZE_T "d: `%s' is in use by another thread - estimators may not be called from several threads at the same time", (Py_ssize_t)group[0], Py_TYPE(j.solver)->tp_name);
+      return 0;
+    }
+  }
+
+  std::vector<std::string> errors(size);
+  for (const auto& group: sorted) *cxx_jobs[group[0]].busy = true;
+  Py_BEGIN_ALLOW_THREADS
+  if (tile) run_tiles(alpha, iterations, cxx_jobs, sorted, tile, halo,
+      threads, errors);
+  else run_groups(alpha, iterations, cxx_jobs, sorted, threads, errors);
+  Py_END_ALLOW_THREADS
+  for (const auto& group: sorted) *cxx_jobs[group[0]].busy = false;
+
+  for (Py_ssize_t k=0; k<size; ++k) {
+    if (!errors[k].empty()) {
+      PyErr_Format(PyExc_RuntimeError, "job %" PY_FORMAT_SIZE_T "d: %s", k, errors[k].c_str());
+      return 0;
+    }
+  }
+
+  PyObject* retval = PyList_New(size);
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+  for (Py_ssize_t k=0; k<size; ++k) {
+    PyObject* flow = Py_BuildValue("(NN)",
+        PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", cxx_jobs[k].u)),
+        PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", cxx_jobs[k].v))
+        );
+    if (!flow) return 0;
+    PyList_SET_ITEM(retval, k, flow);
+  }
+
+  Py_INCREF(retval);
+  return retval;
+
+}
+
+static auto s_flow_error = bob::extension::FunctionDoc(
+    "flow_error",
+
+    "Computes the generalized flow error between two images.",
+
+    "This function calculates the flow error between a pair of images:\n"
+    "\n"
+    ".. math::\n"
+    "   \n"
+    "   E = i2(x-u,y-v) - i1(x,y))\n"
+    "\n"
+    )
+    .add_prototype("image1, image2, u, v", "E")
+    .add_parameter("image1, image2", "array-like (2D, float64)",
+      "Sequence of images the flow was estimated with")
+    .add_parameter("u, v", "array-like (2D, float64)", "The estimated flows in the horizontal and vertical directions (respectively), which should have dimensions matching those of ``image1`` and ``image2``.")
+    .add_return("E", "array (2D, float)", "The estimated flow error E.")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_FlowError(PyObject*,
+    PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {
+    "image1",
+    "image2",
+    "u",
+    "v",
+    };
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  double alpha;
+  Py_ssize_t iterations;
+  PyBlitzArrayObject* image1 = 0;
+  PyBlitzArrayObject* image2 = 0;
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&O&O&", kwlist,
+        &alpha, &iterations,
+        &PyBobIpOptflow_InputConverter, &image1,
+        &PyBobIpOptflow_InputConverter, &image2,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto image1_ = make_safe(image1);
+  auto image2_ = make_safe(image2);
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+
+  if (image1->type_num != NPY_FLOAT64 || image1->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `image1' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", image1->ndim, PyBlitzArray_TypenumAsString(image1->type_num));
+    return 0;
+  }
+
+  if (image2->type_num != NPY_FLOAT64 || image2->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `image2' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", image2->ndim, PyBlitzArray_TypenumAsString(image2->type_num));
+    return 0;
+  }
+
+  if (u->type_num != NPY_FLOAT64 || u->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `u' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", u->ndim, PyBlitzArray_TypenumAsString(u->type_num));
+    return 0;
+  }
+
+  if (v->type_num != NPY_FLOAT64 || v->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "function only supports 2D 64-bit float arrays for input array `v' - you passed a %" PY_FORMAT_SIZE_T "d array of type `%s'", v->ndim, PyBlitzArray_TypenumAsString(v->type_num));
+    return 0;
+  }
+
+  //check all input image dimensions are consistent
+  Py_ssize_t height = image1->shape[0];
+  Py_ssize_t width  = image1->shape[1];
+
+  if (image2->shape[0] != height || image2->shape[1] != width) {
+    PyErr_Format(PyExc_RuntimeError, "input array `image1' has shape = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) which differs from that of `image2' = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", height, width, image2->shape[0], image2->shape[1]);
+    return 0;
+  }
+
+  if (u->shape[0] != height || u->shape[1] != width) {
+    PyErr_Format(PyExc_RuntimeError, "input arrays `image1' and `image2' have shape = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) which differs from that of `u' = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", height, width, u->shape[0], u->shape[1]);
+    return 0;
+  }
+
+  if (v->shape[0] != height || v->shape[1] != width) {
+    PyErr_Format(PyExc_RuntimeError, "input arrays `image1', `image2' and `u' have shape = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) which differs from that of `v' = (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", height, width, v->shape[0], v->shape[1]);
+    return 0;
+  }
+
+  //allocates the error return
+  auto error = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64,
+      image1->ndim, image1->shape);
+  auto error_ = make_safe(error);
+
+  /** all basic checks are done, can call the functor now **/
+  try {
+    bob::ip::optflow::flowError(
+        *PyBlitzArrayCxx_AsBlitz<double,2>(image1),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(image2),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(u),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(v),
+        *PyBlitzArrayCxx_AsBlitz<double,2>(error)
+        );
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_SetString(PyExc_RuntimeError, "cannot estimate flow error: unknown exception caught");
+    return 0;
+  }
+
+  Py_INCREF(error);
+  return PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(error));
+
+}
+
+static auto s_trace_enable = bob::extension::FunctionDoc(
+    "trace_enable",
+
+    "Switches recording of timed spans on or off.",
+
+    "While enabled, the gradient operators, the flow solvers (and each of "
+    "their iterations) and the Python bindings record the time they take, "
+    "tagged with the calling thread, on per-thread buffers that require no "
+    "locking. Use :py:func:`trace_dump` to export the recorded timeline. "
+    "Tracing is off by default and costs close to nothing while off."
+    )
+    .add_prototype("[on]", "None")
+    .add_parameter("on", "bool", "``True`` (the default) enables tracing, ``False`` disables it. Spans recorded so far are kept.")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_TraceEnable(PyObject*,
+    PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"on", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyObject* on = Py_True;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &on)) return 0;
+
+  int value = PyObject_IsTrue(on);
+  if (value < 0) return 0;
+
+  bob::ip::optflow::trace::enable(value);
+  Py_RETURN_NONE;
+
+}
+
+static auto s_trace_enabled = bob::extension::FunctionDoc(
+    "trace_enabled",
+    "Tells if timed spans are being recorded"
+    )
+    .add_prototype("", "enabled")
+    .add_return("enabled", "bool", "``True`` if tracing is on")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_TraceEnabled(PyObject*) {
+  if (bob::ip::optflow::trace::enabled()) Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+static auto s_trace_clear = bob::extension::FunctionDoc(
+    "trace_clear",
+    "Discards all spans recorded so far",
+    "Call it while no other thread is running a traced operation."
+    )
+    .add_prototype("", "None")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_TraceClear(PyObject*) {
+  bob::ip::optflow::trace::clear();
+  Py_RETURN_NONE;
+}
+
+static auto s_trace_now = bob::extension::FunctionDoc(
+    "trace_now",
+    "Returns the current time on the clock used for traces",
+    "Use it together with :py:func:`trace_record` to record spans from "
+    "Python code, such as the time a request waits on a queue."
+    )
+    .add_prototype("", "time")
+    .add_return("time", "int", "Nanoseconds elapsed on a monotonic clock")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_TraceNow(PyObject*) {
+  return PyLong_FromUnsignedLongLong(bob::ip::optflow::trace::now());
+}
+
+static auto s_trace_record = bob::extension::FunctionDoc(
+    "trace_record",
+    "Records a span measured with :py:func:`trace_now` on the calling thread",
+    "Nothing is recorded if tracing is disabled."
+    )
+    .add_prototype("name, begin, end", "None")
+    .add_parameter("name", "str", "The name of the span, as shown on the timeline")
+    .add_parameter("begin, end", "int", "The start and end times of the span, as returned by :py:func:`trace_now`")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_TraceRecord(PyObject*,
+    PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"name", "begin", "end", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  const char* name = 0;
+  unsigned long long begin = 0;
+  unsigned long long end = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "sKK", kwlist,
+        &name, &begin, &end)) return 0;
+
+  if (end < begin) {
+    PyErr_Format(PyExc_ValueError, "span `%s' ends (%llu) before it begins (%llu)", name, end, begin);
+    return 0;
+  }
+
+  if (!bob::ip::optflow::trace::enabled()) Py_RETURN_NONE;
+
+  try {
+    bob::ip::optflow::trace::record(bob::ip::optflow::trace::intern(name),
+        begin, end);
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_SetString(PyExc_RuntimeError, "cannot record span: unknown exception caught");
+    return 0;
+  }
+
+  Py_RETURN_NONE;
+
+}
+
+static auto s_trace_dump = bob::extension::FunctionDoc(
+    "trace_dump",
+
+    "Exports the recorded spans as Chrome trace events.",
+
+    "The output is a JSON document in the Chrome trace event format, which "
+    "can be opened with ``chrome://tracing`` or https://ui.perfetto.dev. "
+    "Every span is a complete (``X``) event with microsecond timestamps; "
+    "the number of spans dropped because a thread buffer filled up is "
+    "reported under ``otherData``."
+    )
+    .add_prototype("[filename]", "trace")
+    .add_parameter("filename", "str", "If given, the trace is written to this file instead of returned")
+    .add_return("trace", "str", "The trace, as a JSON string, or ``None`` if ``filename`` was given")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_TraceDump(PyObject*,
+    PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"filename", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  const char* filename = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &filename))
+    return 0;
+
+  std::string trace;
+  try {
+    trace = bob::ip::optflow::trace::json();
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_SetString(PyExc_RuntimeError, "cannot export trace: unknown exception caught");
+    return 0;
+  }
+
+  if (!filename) return Py_BuildValue("s#", trace.c_str(),
+      (Py_ssize_t)trace.size());
+
+  FILE* f = std::fopen(filename, "wb");
+  if (!f) return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+  size_t written = std::fwrite(trace.data(), 1, trace.size(), f);
+  if (std::fclose(f) != 0 || written != trace.size())
+    return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+
+  Py_RETURN_NONE;
+
+}
+
+static auto s_peak_bandwidth = bob::extension::FunctionDoc(
+    "peak_bandwidth",
+
+    "Measures the memory bandwidth sustained by a single thread.",
+
+    "Runs a STREAM-like triad (``a = b + s*c``) over three arrays that "
+    "should not fit in cache and returns the best rate observed. As in "
+    "STREAM, 24 bytes are counted per element. Use it as the memory roof "
+    "when comparing the kernels of this package against hardware limits."
+    )
+    .add_prototype("[elements], [repeat]", "bandwidth")
+    .add_parameter("elements", "int", "The number of elements on each array (defaults to 2**22, i.e. 32 MiB per array)")
+    .add_parameter("repeat", "int", "The number of repetitions, of which the best is kept (defaults to 5)")
+    .add_return("bandwidth", "float", "The bandwidth, in bytes per second")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_PeakBandwidth(PyObject*,
+    PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"elements", "repeat", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t elements = Py_ssize_t(1) << 22;
+  Py_ssize_t repeat = 5;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nn", kwlist,
+        &elements, &repeat)) return 0;
+
+  if (elements <= 0 || repeat <= 0) {
+    PyErr_Format(PyExc_ValueError, "`elements' and `repeat' should be positive, but you set them to %" PY_FORMAT_SIZE_T "d and %" PY_FORMAT_SIZE_T "d", elements, repeat);
+    return 0;
+  }
+
+  double retval = 0.;
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    retval = bob::ip::optflow::peakBandwidth(elements, repeat);
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot measure bandwidth: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  return PyFloat_FromDouble(retval);
+
+}
+
+static auto s_peak_flops = bob::extension::FunctionDoc(
+    "peak_flops",
+
+    "Measures the floating-point throughput of a single thread.",
+
+    "Runs many independent double-precision multiply-add chains and returns "
+    "the best rate observed. The result reflects the instruction set this "
+    "package was compiled for, which is also the one its kernels use. Use "
+    "it as the compute roof when comparing the kernels of this package "
+    "against hardware limits."
+    )
+    .add_prototype("[repeat]", "flops")
+    .add_parameter("repeat", "int", "The number of repetitions, of which the best is kept (defaults to 5)")
+    .add_return("flops", "float", "The throughput, in floating-point operations per second")
+    ;
+
+PyObject* PyBobIpOptflowHornAndSchunck_PeakFlops(PyObject*,
+    PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"repeat", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t repeat = 5;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &repeat))
+    return 0;
+
+  if (repeat <= 0) {
+    PyErr_Format(PyExc_ValueError, "`repeat' should be positive, but you set it to %" PY_FORMAT_SIZE_T "d", repeat);
+    return 0;
+  }
+
+  double retval = 0.;
+  Py_BEGIN_ALLOW_THREADS
+  retval = bob::ip::optflow::peakFlops(repeat);
+  Py_END_ALLOW_THREADS
+
+  return PyFloat_FromDouble(retval);
+
+}
+
+static PyMethodDef module_methods[] = {
+  {
+    s_laplacian_avg_hs.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_LaplacianAverage,
+    METH_VARARGS|METH_KEYWORDS,
+    s_laplacian_avg_hs.doc()
+  },
+  {
+    s_laplacian_avg_hs_opencv.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_LaplacianAverageOpenCV,
+    METH_VARARGS|METH_KEYWORDS,
+    s_laplacian_avg_hs_opencv.doc()
+  },
+  {
+    s_recursive_gaussian.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_RecursiveGaussian,
+    METH_VARARGS|METH_KEYWORDS,
+    s_recursive_gaussian.doc()
+  },
+  {
+    s_changed_regions.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_ChangedRegions,
+    METH_VARARGS|METH_KEYWORDS,
+    s_changed_regions.doc()
+  },
+  {
+    s_block_matching.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_BlockMatching,
+    METH_VARARGS|METH_KEYWORDS,
+    s_block_matching.doc()
+  },
+  {
+    s_warp.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_Warp,
+    METH_VARARGS|METH_KEYWORDS,
+    s_warp.doc()
+  },
+  {
+    s_label_statistics.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_LabelStatistics,
+    METH_VARARGS|METH_KEYWORDS,
+    s_label_statistics.doc()
+  },
+  {
+    s_hoof.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_Hoof,
+    METH_VARARGS|METH_KEYWORDS,
+    s_hoof.doc()
+  },
+  {
+    s_synthetic_sequence.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_SyntheticSequence,
+    METH_VARARGS|METH_KEYWORDS,
+    s_synthetic_sequence.doc()
+  },
+  {
+    s_integer_gradient.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_IntegerGradient,
+    METH_VARARGS|METH_KEYWORDS,
+    s_integer_gradient.doc()
+  },
+  {
+    s_estimate_many.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_EstimateMany,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_many.doc()
+  },
+  {
+    s_flow_error.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_FlowError,
+    METH_VARARGS|METH_KEYWORDS,
+    s_flow_error.doc()
+  },
+  {
+    s_trace_enable.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_TraceEnable,
+    METH_VARARGS|METH_KEYWORDS,
+    s_trace_enable.doc()
+  },
+  {
+    s_trace_enabled.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_TraceEnabled,
+    METH_NOARGS,
+    s_trace_enabled.doc()
+  },
+  {
+    s_trace_clear.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_TraceClear,
+    METH_NOARGS,
+    s_trace_clear.doc()
+  },
+  {
+    s_trace_now.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_TraceNow,
+    METH_NOARGS,
+    s_trace_now.doc()
+  },
+  {
+    s_trace_record.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_TraceRecord,
+    METH_VARARGS|METH_KEYWORDS,
+    s_trace_record.doc()
+  },
+  {
+    s_trace_dump.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_TraceDump,
+    METH_VARARGS|METH_KEYWORDS,
+    s_trace_dump.doc()
+  },
+  {
+    s_peak_bandwidth.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_PeakBandwidth,
+    METH_VARARGS|METH_KEYWORDS,
+    s_peak_bandwidth.doc()
+  },
+  {
+    s_peak_flops.name(),
+    (PyCFunction)PyBobIpOptflowHornAndSchunck_PeakFlops,
+    METH_VARARGS|METH_KEYWORDS,
+    s_peak_flops.doc()
+  },
+  {0}  /* Sentinel */
+};
+
+PyDoc_STRVAR(module_docstr, "Optical flow framework of Horn & Schunck");
+
+#if PY_VERSION_HEX >= 0x03000000
+static PyModuleDef module_definition = {
+  PyModuleDef_HEAD_INIT,
+  BOB_EXT_MODULE_NAME,
+  module_docstr,
+  -1,
+  module_methods,
+  0, 0, 0, 0
+};
+#endif
+
+static PyObject* create_module (void) {
+
+  if (PyType_Ready(&PyBobIpOptflowSolver_Type) < 0) return 0;
+
+  PyBobIpOptflowHornAndSchunck_Type.tp_base = &PyBobIpOptflowSolver_Type;
+  if (PyType_Ready(&PyBobIpOptflowHornAndSchunck_Type) < 0) return 0;
+
+  PyBobIpOptflowVanillaHornAndSchunck_Type.tp_base =
+    &PyBobIpOptflowSolver_Type;
+  if (PyType_Ready(&PyBobIpOptflowVanillaHornAndSchunck_Type) < 0) return 0;
+
+  PyBobIpOptflowForwardGradient_Type.tp_new = PyType_GenericNew;
+  if (PyType_Ready(&PyBobIpOptflowForwardGradient_Type) < 0) return 0;
+
+  PyBobIpOptflowHornAndSchunckGradient_Type.tp_base =
+    &PyBobIpOptflowForwardGradient_Type;
+  if (PyType_Ready(&PyBobIpOptflowHornAndSchunckGradient_Type) < 0) return 0;
+
+  PyBobIpOptflowCentralGradient_Type.tp_new = PyType_GenericNew;
+  if (PyType_Ready(&PyBobIpOptflowCentralGradient_Type) < 0) return 0;
+
+  PyBobIpOptflowSobelGradient_Type.tp_base = &PyBobIpOptflowCentralGradient_Type;
+  if (PyType_Ready(&PyBobIpOptflowSobelGradient_Type) < 0) return 0;
+
+  PyBobIpOptflowPrewittGradient_Type.tp_base = &PyBobIpOptflowCentralGradient_Type;
+  if (PyType_Ready(&PyBobIpOptflowPrewittGradient_Type) < 0) return 0;
+
+  PyBobIpOptflowIsotropicGradient_Type.tp_base =
+    &PyBobIpOptflowCentralGradient_Type;
+  if (PyType_Ready(&PyBobIpOptflowIsotropicGradient_Type) < 0) return 0;
+
+  if (PyType_Ready(&PyBobIpOptflowPerfCounters_Type) < 0) return 0;
+
+  if (PyType_Ready(&PyBobIpOptflowFlowArchiveWriter_Type) < 0) return 0;
+
+  if (PyType_Ready(&PyBobIpOptflowFlowArchiveReader_Type) < 0) return 0;
+
+  if (PyType_Ready(&PyBobIpOptflowTracker_Type) < 0) return 0;
+
+# if PY_VERSION_HEX >= 0x03000000
+  PyObject* module = PyModule_Create(&module_definition);
+  auto module_ = make_xsafe(module);
+  const char* ret = "O";
+# else
+  PyObject* module = Py_InitModule3(BOB_EXT_MODULE_NAME, module_methods, module_docstr);
+  const char* ret = "N";
+# endif
+  if (!module) return 0;
+
+  /* register the types to python */
+  Py_INCREF(&PyBobIpOptflowHornAndSchunck_Type);
+  if (PyModule_AddObject(module, "Flow",
+        (PyObject *)&PyBobIpOptflowHornAndSchunck_Type) < 0) return 0;
+
+  Py_INCREF(&PyBobIpOptflowVanillaHornAndSchunck_Type);
+  if (PyModule_AddObject(module, "VanillaFlow",
+        (PyObject *)&PyBobIpOptflowVanillaHornAndSchunck_Type) < 0) return 0;
+
+  Py_INCREF(&PyBobIpOptflowSolver_Type);
+  if (PyModule_AddObject(module, "Solver",
+        (PyObject *)&PyBobIpOptflowSolver_Type) < 0) return 0;
+
+  Py_INCREF(&PyBobIpOptflowForwardGradient_Type);
+  if (PyModule_AddObject(module, "ForwardGradient",
+        (PyObject *)&PyBobIpOptflowForwardGradient_Type) < 0) return 0;
 
   Py_INCREF(&PyBobIpOptflowHornAndSchunckGradient_Type);
   if (PyModule_AddObject(module, "HornAndSchunckGradient",
@@ -416,6 +2172,22 @@ static PyObject* create_module (void) {
   if (PyModule_AddObject(module, "IsotropicGradient",
         (PyObject *)&PyBobIpOptflowIsotropicGradient_Type) < 0) return 0;
 
+  Py_INCREF(&PyBobIpOptflowPerfCounters_Type);
+  if (PyModule_AddObject(module, "PerfCounters",
+        (PyObject *)&PyBobIpOptflowPerfCounters_Type) < 0) return 0;
+
+  Py_INCREF(&PyBobIpOptflowFlowArchiveWriter_Type);
+  if (PyModule_AddObject(module, "FlowArchiveWriter",
+        (PyObject *)&PyBobIpOptflowFlowArchiveWriter_Type) < 0) return 0;
+
+  Py_INCREF(&PyBobIpOptflowFlowArchiveReader_Type);
+  if (PyModule_AddObject(module, "FlowArchiveReader",
+        (PyObject *)&PyBobIpOptflowFlowArchiveReader_Type) < 0) return 0;
+
+  Py_INCREF(&PyBobIpOptflowTracker_Type);
+  if (PyModule_AddObject(module, "Tracker",
+        (PyObject *)&PyBobIpOptflowTracker_Type) < 0) return 0;
+
   /* imports dependencies */
   if (import_bob_blitz() < 0) return 0;
   if (import_bob_core_logging() < 0) return 0;
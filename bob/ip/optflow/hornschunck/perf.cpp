@@ -0,0 +1,249 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:02:07 2026 +0000
+ *
+ * @brief Bindings for hardware performance counters
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <bob.blitz/cppapi.h>
+#include <bob.blitz/cleanup.h>
+#include <bob.extension/documentation.h>
+#include <structmember.h>
+
+#include "PerfCounters.h"
+
+/****************************************
+ * Implementation of PerfCounters class *
+ ****************************************/
+
+#define CLASS_NAME "PerfCounters"
+
+static auto s_perf = bob::extension::ClassDoc(
+    BOB_EXT_MODULE_PREFIX "." CLASS_NAME,
+
+    "Reads hardware performance counters around a section of code.",
+
+    "Counts CPU cycles, retired instructions and last-level cache references "
+    "and misses for the calling thread between :py:meth:`start` and "
+    ":py:meth:`stop`, using the Linux ``perf_event_open`` interface. Only "
+    "user-space events are counted. Counters that cannot be opened on this "
+    "host (other operating systems, virtual machines without a PMU or a "
+    "restrictive ``kernel.perf_event_paranoid`` setting) are reported as "
+    "``None``: the wall-clock time is always available."
+    )
+    .add_constructor(
+        bob::extension::FunctionDoc(
+          CLASS_NAME,
+          "Opens all counters available on this host."
+          )
+        .add_prototype("", "")
+        )
+    ;
+
+typedef struct {
+  PyObject_HEAD
+  bob::ip::optflow::PerfCounters* cxx;
+} PyBobIpOptflowPerfCountersObject;
+
+
+static int PyBobIpOptflowPerfCounters_init
+(PyBobIpOptflowPerfCountersObject* self, PyObject* args, PyObject* kwds) {
+
+  /* Parses input arguments in a single shot */
+  static const char* const_kwlist[] = {0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist)) return -1;
+
+  try {
+    self->cxx = new bob::ip::optflow::PerfCounters();
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot create new object of type `%s' - unknown exception thrown", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static void PyBobIpOptflowPerfCounters_delete
+(PyBobIpOptflowPerfCountersObject* self) {
+
+  delete self->cxx;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+
+}
+
+static auto s_available = bob::extension::VariableDoc(
+    "available",
+    "tuple",
+    "The names of the events that can be counted on this host"
+    );
+
+static PyObject* PyBobIpOptflowPerfCounters_getAvailable
+(PyBobIpOptflowPerfCountersObject* self, void* /*closure*/) {
+
+  typedef bob::ip::optflow::PerfCounters P;
+
+  PyObject* retval = PyList_New(0);
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  for (int e=0; e<P::NumberOfEvents; ++e) {
+    if (!self->cxx->available(P::Event(e))) continue;
+    auto name = make_safe(Py_BuildValue("s", P::name(P::Event(e))));
+    if (!name) return 0;
+    if (PyList_Append(retval, name.get()) < 0) return 0;
+  }
+
+  return PyList_AsTuple(retval);
+
+}
+
+static PyGetSetDef PyBobIpOptflowPerfCounters_getseters[] = {
+    {
+      s_available.name(),
+      (getter)PyBobIpOptflowPerfCounters_getAvailable,
+      0,
+      s_available.doc(),
+      0
+    },
+    {0}  /* Sentinel */
+};
+
+static auto s_start = bob::extension::FunctionDoc(
+    "start",
+    "Resets and starts all counters and the wall-clock timer"
+    )
+    .add_prototype("", "None")
+    ;
+
+static PyObject* PyBobIpOptflowPerfCounters_start
+(PyBobIpOptflowPerfCountersObject* self) {
+
+  self->cxx->start();
+  Py_RETURN_NONE;
+
+}
+
+static auto s_stop = bob::extension::FunctionDoc(
+    "stop",
+    "Stops all counters and returns their values since :py:meth:`start`",
+    "Values are scaled if the kernel multiplexed the counters. Events that "
+    "cannot be counted on this host are set to ``None``."
+    )
+    .add_prototype("", "values")
+    .add_return("values", "dict", "A dictionary with the wall-clock time in ``seconds`` and the ``cycles``, ``instructions``, ``cache_references`` and ``cache_misses`` counted.")
+    ;
+
+static PyObject* PyBobIpOptflowPerfCounters_stop
+(PyBobIpOptflowPerfCountersObject* self) {
+
+  typedef bob::ip::optflow::PerfCounters P;
+
+  self->cxx->stop();
+
+  PyObject* retval = PyDict_New();
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  auto seconds = make_safe(PyFloat_FromDouble(self->cxx->seconds()));
+  if (!seconds) return 0;
+  if (PyDict_SetItemString(retval, "seconds", seconds.get()) < 0) return 0;
+
+  for (int e=0; e<P::NumberOfEvents; ++e) {
+    int64_t value = self->cxx->value(P::Event(e));
+    PyObject* o = 0;
+    if (value < 0) {
+      Py_INCREF(Py_None);
+      o = Py_None;
+    }
+    else {
+      o = PyLong_FromLongLong(value);
+      if (!o) return 0;
+    }
+    auto o_ = make_safe(o);
+    if (PyDict_SetItemString(retval, P::name(P::Event(e)), o) < 0) return 0;
+  }
+
+  Py_INCREF(retval);
+  return retval;
+
+}
+
+static PyMethodDef PyBobIpOptflowPerfCounters_methods[] = {
+  {
+    s_start.name(),
+    (PyCFunction)PyBobIpOptflowPerfCounters_start,
+    METH_NOARGS,
+    s_start.doc()
+  },
+  {
+    s_stop.name(),
+    (PyCFunction)PyBobIpOptflowPerfCounters_stop,
+    METH_NOARGS,
+    s_stop.doc()
+  },
+  {0} /* Sentinel */
+};
+
+static PyObject* PyBobIpOptflowPerfCounters_new
+(PyTypeObject* type, PyObject*, PyObject*) {
+
+  /* Allocates the python object itself */
+  PyBobIpOptflowPerfCountersObject* self =
+    (PyBobIpOptflowPerfCountersObject*)type->tp_alloc(type, 0);
+
+  self->cxx = 0;
+
+  return reinterpret_cast<PyObject*>(self);
+
+}
+
+PyTypeObject PyBobIpOptflowPerfCounters_Type = {
+    PyVarObject_HEAD_INIT(0, 0)
+    s_perf.name(),                                      /* tp_name */
+    sizeof(PyBobIpOptflowPerfCountersObject),           /* tp_basicsize */
+    0,                                                  /* tp_itemsize */
+    (destructor)PyBobIpOptflowPerfCounters_delete,      /* tp_dealloc */
+    0,                                                  /* tp_print */
+    0,                                                  /* tp_getattr */
+    0,                                                  /* tp_setattr */
+    0,                                                  /* tp_compare */
+    0,                                                  /* tp_repr */
+    0,                                                  /* tp_as_number */
+    0,                                                  /* tp_as_sequence */
+    0,                                                  /* tp_as_mapping */
+    0,                                                  /* tp_hash */
+    0,                                                  /* tp_call */
+    0,                                                  /* tp_str */
+    0,                                                  /* tp_getattro */
+    0,                                                  /* tp_setattro */
+    0,                                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,           /* tp_flags */
+    s_perf.doc(),                                       /* tp_doc */
+    0,                                                  /* tp_traverse */
+    0,                                                  /* tp_clear */
+    0,                                                  /* tp_richcompare */
+    0,                                                  /* tp_weaklistoffset */
+    0,                                                  /* tp_iter */
+    0,                                                  /* tp_iternext */
+    PyBobIpOptflowPerfCounters_methods,                 /* tp_methods */
+    0,                                                  /* tp_members */
+    PyBobIpOptflowPerfCounters_getseters,               /* tp_getset */
+    0,                                                  /* tp_base */
+    0,                                                  /* tp_dict */
+    0,                                                  /* tp_descr_get */
+    0,                                                  /* tp_descr_set */
+    0,                                                  /* tp_dictoffset */
+    (initproc)PyBobIpOptflowPerfCounters_init,          /* tp_init */
+    0,                                                  /* tp_alloc */
+    PyBobIpOptflowPerfCounters_new,                     /* tp_new */
+};
@@ -0,0 +1,73 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:27:00 2026 +0000
+ *
+ * @brief Conversion of image regions from and into Python objects
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <bob.blitz/cppapi.h>
+#include <bob.blitz/cleanup.h>
+
+#include "HornAndSchunckFlow.h"
+
+/**
+ * Converts a sequence of (y, x, height, width) sequences into regions, for
+ * PyArg_ParseTupleAndKeywords()'s ``O&``. Returns 1 on success, 0 (with an
+ * exception set) otherwise.
+ */
+int PyBobIpOptflow_RegionsConverter(PyObject* o,
+    std::vector<bob::ip::optflow::Region>* regions) {
+
+  auto sequence = make_xsafe(PySequence_Fast(o, "regions should be given as a sequence of (y, x, height, width) tuples"));
+  if (!sequence) return 0;
+
+  Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence.get());
+  for (Py_ssize_t k=0; k<size; ++k) {
+
+    PyObject* item = PySequence_Fast_GET_ITEM(sequence.get(), k);
+    auto tuple = make_xsafe(PySequence_Tuple(item));
+    if (!tuple) return 0;
+
+    int y, x, height, width;
+    if (!PyArg_ParseTuple(tuple.get(), "iiii", &y, &x, &height, &width)) {
+      PyErr_Format(PyExc_TypeError, "region %" PY_FORMAT_SIZE_T "d should be a tuple of 4 integers (y, x, height, width)", k);
+      return 0;
+    }
+
+    if (height < 0 || width < 0) {
+      PyErr_Format(PyExc_ValueError, "region %" PY_FORMAT_SIZE_T "d should have a non-negative height and width, but it is (%d, %d, %d, %d)", k, y, x, height, width);
+      return 0;
+    }
+
+    regions->push_back(bob::ip::optflow::Region(y, x, height, width));
+
+  }
+
+  return 1;
+
+}
+
+/**
+ * Returns a new list of (y, x, height, width) tuples, or 0 (with an
+ * exception set) on errors
+ */
+PyObject* PyBobIpOptflow_RegionsAsList
+(const std::vector<bob::ip::optflow::Region>& regions) {
+
+  PyObject* retval = PyList_New(regions.size());
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  for (size_t k=0; k<regions.size(); ++k) {
+    const bob::ip::optflow::Region& r = regions[k];
+    PyObject* item = Py_BuildValue("(iiii)", r(0), r(1), r(2), r(3));
+    if (!item) return 0;
+    PyList_SET_ITEM(retval, k, item);
+  }
+
+  Py_INCREF(retval);
+  return retval;
+
+}
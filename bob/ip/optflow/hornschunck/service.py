@@ -0,0 +1,552 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 13:58:26 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""A local optical flow service, shared by all processes on a host.
+
+The server accepts requests on a Unix domain socket. Frames are not sent
+through the socket: the client places them on a POSIX shared memory segment
+(a file under ``/dev/shm``) and only sends the segment name together with the
+estimation parameters. The segment contains, in order, the input frames
+(``float64``, C-order) followed by the ``u`` and ``v`` planes, which the server
+fills with the estimated flow before replying.
+
+Requests are dynamically batched: the dispatcher collects whatever arrives
+within a short window and groups it by solver type and shape. Each group is
+split in (at most) one batch per worker thread, and every batch is handed to a
+single worker, which solves all its requests on the same warm solver, with a
+single call to :py:func:`bob.ip.optflow.hornschunck.estimate_many` per
+``(alpha, iterations)``. Workers keep the solvers of the last few ``(method,
+shape)`` they served, so buffers are allocated once per host and not once per
+call. The estimators release the GIL while solving, so workers run in
+parallel.
+
+The socket is only accessible to the user running the server (mode ``0600``),
+unless a group is given, whose members may then connect as well (mode
+``0660``). Requests are checked before any memory is mapped: frame shapes
+should hold 2 positive integers, not larger than a configurable number of
+pixels, ``iterations`` a non-negative integer and ``alpha`` a finite number.
+
+Example::
+
+  $ optflow_hs_service.py /tmp/optflow.sock --threads=4
+
+  >>> client = Client('/tmp/optflow.sock')
+  >>> u, v = client.estimate('flow', 200, 20, [i1, i2, i3])
+"""
+
+import os
+import sys
+import json
+import collections
+import math
+import mmap
+import numbers
+import stat
+import socket
+import threading
+import time
+import uuid
+
+try:
+  import queue
+except ImportError: #python 2.x
+  import Queue as queue
+
+import numpy
+
+from . import Flow, VanillaFlow, estimate_many, trace_now, trace_record
+
+SHM_ROOT = '/dev/shm'
+
+SEGMENT_PREFIX = 'bob-optflow-'
+"""Prefix of the names of all segments created by clients"""
+
+METHODS = {
+    'flow': (Flow, 3),
+    'vanilla': (VanillaFlow, 2),
+    }
+"""Solvers served, with the number of frames each one requires"""
+
+MAX_PIXELS = 1 << 25
+"""Default limit on the number of pixels of the frames of a request"""
+
+
+def _segment_size(nframes, shape):
+  return (nframes + 2) * shape[0] * shape[1] * 8
+
+
+def _solver(solvers, key, limit):
+  """Returns the warm solver for ``key = (method, shape)`` from an ordered
+  dictionary, creating it if required and evicting the least recently used
+  ones beyond ``limit``"""
+
+  if key in solvers:
+    solver = solvers.pop(key)
+  else:
+    solver = METHODS[key[0]][0](key[1])
+  solvers[key] = solver #most recently used last
+  while len(solvers) > limit: solvers.popitem(last=False)
+  return solver
+
+
+def _check_segment(name):
+  """Checks a segment name designates a file of this service under
+  ``/dev/shm``, and not any other file the server may write to"""
+
+  if not hasattr(name, 'startswith') or not name.startswith(SEGMENT_PREFIX) or \
+      '/' in name or '..' in name or '\0' in name:
+    raise ValueError("invalid shared memory segment name `%s' - names should start with `%s' and contain no `/', `..' or NUL characters" % (name, SEGMENT_PREFIX))
+
+
+def _integer(value):
+  return isinstance(value, numbers.Integral) and not isinstance(value, bool)
+
+
+def _check_request(request, max_pixels):
+  """Checks the parameters of a request decoded from a client, before the
+  server maps any memory or allocates any solver for it"""
+
+  if not isinstance(request, dict):
+    raise ValueError("requests should be JSON objects, but you sent a `%s'" % type(request).__name__)
+  if request.get('method') not in METHODS:
+    raise ValueError("unknown method `%s' - choose one of %s" % (request.get('method'), ', '.join(sorted(METHODS))))
+
+  shape = request.get('shape')
+  if not isinstance(shape, list) or len(shape) != 2 or \
+      not all(_integer(k) and k > 0 for k in shape):
+    raise ValueError("`shape' should hold 2 positive integers, but you set it to %r" % (shape,))
+  if shape[0] * shape[1] > max_pixels:
+    raise ValueError("frames of shape (%d, %d) have more than the %d pixels this server accepts" % (shape[0], shape[1], max_pixels))
+
+  iterations = request.get('iterations')
+  if not _integer(iterations) or iterations < 0:
+    raise ValueError("`iterations' should be a non-negative integer, but you set it to %r" % (iterations,))
+
+  alpha = request.get('alpha')
+  if not isinstance(alpha, numbers.Real) or isinstance(alpha, bool) or \
+      math.isinf(alpha) or math.isnan(alpha):
+    raise ValueError("`alpha' should be a finite number, but you set it to %r" % (alpha,))
+
+  request['shape'] = tuple(shape)
+
+
+def _remove_socket(path):
+  """Removes a (stale) socket file, refusing to remove any other file"""
+
+  if not os.path.lexists(path): return
+  if not stat.S_ISSOCK(os.lstat(path).st_mode):
+    raise RuntimeError("`%s' exists and is not a socket - refusing to remove it" % path)
+  os.unlink(path)
+
+
+class SharedFrames(object):
+  """A POSIX shared memory segment holding input frames and the output flow
+
+  Parameters:
+
+  name (str)
+    The segment name (as used with ``shm_open``). It is placed under
+    ``/dev/shm``, should start with ``bob-optflow-`` and may not contain
+    ``/``, ``..`` or NUL characters.
+
+  nframes (int)
+    The number of input frames stored on the segment
+
+  shape (tuple)
+    The ``(height, width)`` of every frame
+
+  create (bool)
+    If ``True``, creates (and later owns) the segment, otherwise attach to an
+    existing one.
+  """
+
+  def __init__(self, name, nframes, shape, create=False):
+
+    _check_segment(name)
+    self.name = name
+    self.shape = tuple(shape)
+    self.nframes = nframes
+    self.owner = create
+    self.path = os.path.join(SHM_ROOT, name)
+    size = _segment_size(nframes, self.shape)
+
+    flags = os.O_RDWR | os.O_NOFOLLOW
+    if create: flags |= os.O_CREAT | os.O_EXCL
+    fd = os.open(self.path, flags, 0o600)
+    try:
+      if create: os.ftruncate(fd, size)
+      elif os.fstat(fd).st_size != size:
+        raise RuntimeError("shared memory segment `%s' has %d bytes, expected %d for %d frame(s) of shape %s" % (name, os.fstat(fd).st_size, size, nframes, self.shape))
+      self.buffer = mmap.mmap(fd, size)
+    finally:
+      os.close(fd)
+
+    planes = numpy.frombuffer(self.buffer, dtype='float64')
+    planes = planes.reshape((nframes + 2,) + self.shape)
+    self.frames = [planes[k] for k in range(nframes)]
+    self.u = planes[nframes]
+    self.v = planes[nframes + 1]
+
+  def close(self):
+    """Unmaps the segment, unlinking it if this object created it"""
+
+    # views must go before the mapping can be closed
+    del self.frames, self.u, self.v
+    self.buffer.close()
+    if self.owner and os.path.exists(self.path): os.unlink(self.path)
+
+
+class Server(object):
+  """Serves optical flow requests over a Unix domain socket
+
+  Parameters:
+
+  path (str)
+    The path of the Unix domain socket to listen on
+
+  threads (int)
+    The number of worker threads solving requests in parallel
+
+  window (float)
+    How long (in seconds) the dispatcher waits for further requests after the
+    first one arrives, before dispatching a batch
+
+  solvers (int)
+    The number of warm solvers each worker thread keeps, one per
+    ``(method, shape)``. Beyond it, the least recently used are released.
+
+  group (str, int)
+    If set, the name or id of a group whose members may also connect to the
+    socket. Otherwise, only the user running the server may connect.
+
+  max_pixels (int)
+    The largest number of pixels of the frames of a request. Larger requests
+    are refused.
+  """
+
+  def __init__(self, path, threads=1, window=0.002, solvers=4, group=None,
+      max_pixels=MAX_PIXELS):
+
+    if solvers < 1:
+      raise ValueError("`solvers' should be at least 1, but you set it to %d" % solvers)
+    if max_pixels < 1:
+      raise ValueError("`max_pixels' should be at least 1, but you set it to %d" % max_pixels)
+    self.path = path
+    self.window = window
+    self.solvers = solvers
+    self.group = group
+    self.max_pixels = max_pixels
+    self.requests = queue.Queue()
+    self.work = queue.Queue()
+    self.running = False
+    self.batches = 0 #number of batches dispatched so far
+    self.threads = [threading.Thread(target=self._worker) for k in range(max(1, threads))]
+
+  def start(self):
+    """Binds the socket and starts serving on background threads"""
+
+    _remove_socket(self.path)
+    if self.group is not None:
+      import grp
+      if _integer(self.group): gid = self.group
+      elif self.group.isdigit(): gid = int(self.group)
+      else: gid = grp.getgrnam(self.group).gr_gid
+
+    self.socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    # the socket is created with mode 0600, so no one else may connect before
+    # permissions are set - the umask is process-wide, so keep this short
+    mask = os.umask(0o177)
+    try:
+      self.socket.bind(self.path)
+    finally:
+      os.umask(mask)
+    if self.group is not None:
+      os.chown(self.path, -1, gid)
+      os.chmod(self.path, 0o660)
+    self.socket.listen(64)
+    self.running = True
+
+    self.acceptor = threading.Thread(target=self._accept)
+    self.dispatcher = threading.Thread(target=self._dispatch)
+    for t in [self.acceptor, self.dispatcher] + self.threads:
+      t.daemon = True
+      t.start()
+
+  def stop(self):
+    """Stops serving and removes the socket file"""
+
+    self.running = False
+    try:
+      # wakes the acceptor up
+      s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+      s.connect(self.path)
+      s.close()
+    except socket.error:
+      pass
+    self.requests.put(None)
+    self.acceptor.join()
+    self.dispatcher.join()
+    for t in self.threads: self.work.put(None)
+    for t in self.threads: t.join()
+    self.socket.close()
+    _remove_socket(self.path)
+
+  def _accept(self):
+
+    while self.running:
+      connection, _ = self.socket.accept()
+      if not self.running:
+        connection.close()
+        break
+      t = threading.Thread(target=self._read, args=(connection,))
+      t.daemon = True
+      t.start()
+
+  def _read(self, connection):
+    """Reads newline-delimited requests from a single client"""
+
+    lock = threading.Lock() #serializes replies on this connection
+    stream = connection.makefile('r')
+    try:
+      for line in stream:
+        if not line.strip(): continue
+        request = None
+        try:
+          request = json.loads(line)
+          _check_request(request, self.max_pixels)
+        except Exception as e:
+          identifier = request.get('id') if isinstance(request, dict) else None
+          self._reply(connection, lock, {'id': identifier, 'status': 'error', 'message': str(e)})
+          continue
+        self.requests.put((connection, lock, request, trace_now()))
+    finally:
+      stream.close()
+
+  def _reply(self, connection, lock, answer):
+
+    data = (json.dumps(answer) + '\n').encode('utf-8')
+    with lock:
+      try:
+        connection.sendall(data)
+      except socket.error:
+        pass #client went away
+
+  def _dispatch(self):
+    """Collects requests for a short window and dispatches them, in batches
+    of the same method and shape, to the workers"""
+
+    while True:
+      first = self.requests.get()
+      if first is None: break
+      pending = [first]
+      deadline = time.time() + self.window
+      while True:
+        timeout = deadline - time.time()
+        if timeout <= 0: break
+        try:
+          item = self.requests.get(timeout=timeout)
+        except queue.Empty:
+          break
+        if item is None:
+          self.requests.put(None) #exits after this batch
+          break
+        pending.append(item)
+
+      groups = {}
+      for item in pending:
+        key = (item[2]['method'], item[2]['shape'])
+        groups.setdefault(key, []).append(item)
+      for key in groups:
+        # one batch per worker at most, so large groups still run in parallel
+        items = groups[key]
+        size = -(-len(items) // len(self.threads))
+        for k in range(0, len(items), size):
+          self.batches += 1
+          self.work.put((key, items[k:k+size]))
+
+  def _worker(self):
+    """Solves batches of requests, keeping warm solvers per method and shape.
+    Requests of a batch with the same ``alpha`` and ``iterations`` are solved
+    together, through :py:func:`estimate_many`"""
+
+    solvers = collections.OrderedDict()
+    while True:
+      job = self.work.get()
+      if job is None: break
+      key, batch = job
+      try:
+        solver = _solver(solvers, key, self.solvers)
+      except Exception as e:
+        solver, error = None, str(e)
+      nframes = METHODS[key[0]][1]
+
+      replies = []
+      groups = collections.OrderedDict() #(alpha, iterations) -> [(answer, segment)]
+      for connection, lock, request, received in batch:
+        # time spent batching and waiting for a free worker
+        trace_record('service.queue', received, trace_now())
+        answer = {'id': request.get('id'), 'status': 'ok'}
+        replies.append((connection, lock, answer))
+        try:
+          if solver is None: raise RuntimeError(error)
+          segment = SharedFrames(request['segment'], nframes, key[1])
+        except Exception as e:
+          answer['status'] = 'error'
+          answer['message'] = str(e)
+          continue
+        if not request.get('initial', False):
+          segment.u.fill(0.)
+          segment.v.fill(0.)
+        parameters = (request['alpha'], request['iterations'])
+        groups.setdefault(parameters, []).append((answer, segment))
+
+      for (alpha, iterations), items in groups.items():
+        try:
+          # jobs share the solver, so they run one after the other
+          estimate_many(alpha, iterations,
+              [(solver, s.frames, s.u, s.v) for a, s in items], 1)
+        except Exception as e:
+          for answer, segment in items:
+            answer['status'] = 'error'
+            answer['message'] = str(e)
+        finally:
+          for answer, segment in items: segment.close()
+
+      for connection, lock, answer in replies:
+        self._reply(connection, lock, answer)
+
+
+class Client(object):
+  """Connects to a :py:class:`Server` running on the same host
+
+  Parameters:
+
+  path (str)
+    The path of the Unix domain socket the server listens on
+  """
+
+  def __init__(self, path):
+
+    self.socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    self.socket.connect(path)
+    self.stream = self.socket.makefile('r')
+    self.segments = {} #one reusable segment per (method, shape)
+
+  def close(self):
+    """Closes the connection, releasing all shared memory segments"""
+
+    for segment in self.segments.values(): segment.close()
+    self.segments = {}
+    self.stream.close()
+    self.socket.close()
+
+  def _segment(self, method, shape):
+
+    key = (method, tuple(shape))
+    if key not in self.segments:
+      name = '%s%d-%s' % (SEGMENT_PREFIX, os.getpid(), uuid.uuid4().hex)
+      self.segments[key] = SharedFrames(name, METHODS[method][1], shape,
+          create=True)
+    return self.segments[key]
+
+  def estimate(self, method, alpha, iterations, frames, u=None, v=None):
+    """Estimates the flow on the server
+
+    Parameters:
+
+    method (str)
+      ``'flow'`` (:py:class:`Flow`, 3 frames) or ``'vanilla'``
+      (:py:class:`VanillaFlow`, 2 frames)
+
+    alpha (float), iterations (int)
+      Parameters passed to the ``estimate`` method of the solver
+
+    frames (sequence)
+      The 2D ``float64`` input frames
+
+    u, v (array, optional)
+      Initial conditions. If given, they are also updated with the result.
+
+    Returns ``(u, v)``
+    """
+
+    if method not in METHODS:
+      raise RuntimeError("unknown method `%s' - choose one of %s" % (method, ', '.join(sorted(METHODS))))
+    if len(frames) != METHODS[method][1]:
+      raise RuntimeError("method `%s' requires %d frames, but you provided %d" % (method, METHODS[method][1], len(frames)))
+    if (u is None) != (v is None):
+      raise RuntimeError("you must provide either both `u' and `v' or none")
+
+    shape = frames[0].shape
+    segment = self._segment(method, shape)
+    for k, frame in enumerate(frames): segment.frames[k][:] = frame
+    if u is not None:
+      segment.u[:] = u
+      segment.v[:] = v
+
+    request = {
+        'id': uuid.uuid4().hex,
+        'method': method,
+        'alpha': alpha,
+        'iterations': iterations,
+        'shape': list(shape),
+        'segment': segment.name,
+        'initial': u is not None,
+        }
+    self.socket.sendall((json.dumps(request) + '\n').encode('utf-8'))
+    answer = json.loads(self.stream.readline())
+    if answer['status'] != 'ok':
+      raise RuntimeError("flow service failed: %s" % answer.get('message'))
+
+    if u is None:
+      return segment.u.copy(), segment.v.copy()
+    u[:] = segment.u
+    v[:] = segment.v
+    return u, v
+
+
+def main(user_input=None):
+
+  import argparse
+
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+
+  parser.add_argument("socket", type=str, metavar='PATH',
+      help="The Unix domain socket to listen on")
+  parser.add_argument("-t", "--threads",
+      action="store", dest="threads", default=1, type=int, metavar='INT',
+      help="Number of worker threads solving requests (defaults to %(default)s)")
+  parser.add_argument("-w", "--window",
+      action="store", dest="window", default=0.002, type=float,
+      metavar='FLOAT',
+      help="Batching window, in seconds (defaults to %(default)s)")
+  parser.add_argument("-s", "--solvers",
+      action="store", dest="solvers", default=4, type=int, metavar='INT',
+      help="Number of warm solvers each worker keeps, one per method and shape (defaults to %(default)s)")
+  parser.add_argument("-g", "--group",
+      action="store", dest="group", default=None, type=str, metavar='GROUP',
+      help="A group whose members may also connect to the socket (by default, only the user running the server may)")
+  parser.add_argument("-p", "--max-pixels",
+      action="store", dest="max_pixels", default=MAX_PIXELS, type=int,
+      metavar='INT',
+      help="Largest number of pixels of the frames of a request (defaults to %(default)s)")
+
+  args = parser.parse_args(args=user_input)
+
+  server = Server(args.socket, args.threads, args.window, args.solvers,
+      args.group, args.max_pixels)
+  server.start()
+  print("Serving optical flow on %s with %d thread(s)" % (args.socket, args.threads))
+  try:
+    while True: time.sleep(3600)
+  except KeyboardInterrupt:
+    pass
+  finally:
+    server.stop()
+
+  return 0
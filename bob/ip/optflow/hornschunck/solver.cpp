@@ -0,0 +1,1668 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:38:59 2026 +0000
+ *
+ * @brief Bindings for Horn & Schunck solvers with any gradient and Laplacian
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <bob.blitz/cppapi.h>
+#include <bob.blitz/cleanup.h>
+#include <bob.extension/documentation.h>
+#include <structmember.h>
+
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "HornAndSchunckFlow.h"
+#include "Trace.h"
+
+int PyBobIpOptflow_InputConverter(PyObject* o, PyBlitzArrayObject** a);
+
+int PyBobIpOptflow_RegionsConverter(PyObject* o,
+    std::vector<bob::ip::optflow::Region>* regions);
+
+PyObject* PyBobIpOptflowFlowStatistics_AsDict
+(const bob::ip::optflow::FlowStatistics& s);
+
+PyObject* PyBobIpOptflowLabelStatistics_AsDict
+(const bob::ip::optflow::LabelStatistics& s);
+
+PyObject* PyBobIpOptflowHoofFeatures_AsDict
+(const bob::ip::optflow::HoofFeatures& f);
+
+/***************************************
+ * Implementation of Solver base class *
+ ***************************************/
+
+#define CLASS_NAME "Solver"
+
+static const char* GRADIENTS[] = {"hs", "sobel", "prewitt", "isotropic", 0};
+static const char* LAPLACIANS[] = {"hs", "opencv", 0};
+
+static auto s_solver = bob::extension::ClassDoc(
+    BOB_EXT_MODULE_PREFIX "." CLASS_NAME,
+
+    "Estimates the Optical Flow with any gradient and Laplacian.",
+
+    "This is the Horn & Schunck method of :py:class:`VanillaFlow` and "
+    ":py:class:`Flow`, on which the gradient and the Laplacian (the "
+    "smoothness stencil) are chosen independently. The gradient is one of "
+    "``'hs'`` (:py:class:`HornAndSchunckGradient`, taking 2 images), "
+    "``'sobel'`` (:py:class:`SobelGradient`), ``'prewitt'`` "
+    "(:py:class:`PrewittGradient`) or ``'isotropic'`` "
+    "(:py:class:`IsotropicGradient`), the latter 3 taking 3 images. The "
+    "Laplacian is ``'hs'`` (:py:func:`laplacian_avg_hs`) or ``'opencv'`` "
+    "(:py:func:`laplacian_avg_hs_opencv`). A ``Solver(shape, 'hs', "
+    "'hs')`` estimates the same flow as a :py:class:`VanillaFlow` and a "
+    "``Solver(shape, 'sobel', 'opencv')`` the same as a :py:class:`Flow`.\n"
+    "\n"
+    ":py:class:`VanillaFlow` and :py:class:`Flow` are the subclasses fixing "
+    "these two combinations. Their methods are the ones of this class, but "
+    "take the images as separate arguments, ``image1, image2`` and "
+    "``image1, image2, image3`` (respectively), instead of a sequence "
+    "``images``.\n"
+    "\n"
+    "All combinations are compiled from a single implementation, on which "
+    "both operators are resolved at compile time."
+    )
+    .add_constructor(
+        bob::extension::FunctionDoc(
+          CLASS_NAME,
+          "Initializes the functor with the sizes of images to be treated and its operators."
+          )
+        .add_prototype("(height, width), [gradient], [laplacian]", "")
+        .add_parameter("(height, width)", "tuple", "the height and width of images to be fed into the the flow estimator")
+        .add_parameter("gradient", "str", "[Default: ``'sobel'``] The gradient: ``'hs'``, ``'sobel'``, ``'prewitt'`` or ``'isotropic'``")
+        .add_parameter("laplacian", "str", "[Default: ``'opencv'``] The Laplacian: ``'hs'`` or ``'opencv'``")
+        )
+    ;
+
+
+typedef struct {
+  PyObject_HEAD
+  bob::ip::optflow::FlowSolver* cxx;
+  const char* gradient; ///< one of GRADIENTS
+  const char* laplacian; ///< one of LAPLACIANS
+  bool fixed; ///< set by subclasses fixing both, taking separate images
+  bool busy; ///< set while a call runs on the estimator without the GIL
+} PyBobIpOptflowSolverObject;
+
+/**
+ * Checks no other thread is running a call on this object, which uses the
+ * buffers of the estimator, with the GIL released. Sets a python exception
+ * otherwise.
+ */
+static bool check_idle(PyBobIpOptflowSolverObject* self) {
+
+  if (self->busy) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' is in use by another thread - estimators may not be called from several threads at the same time", Py_TYPE(self)->tp_name);
+    return false;
+  }
+
+  return true;
+
+}
+
+/**
+ * Returns the entry of choices equal to name, or 0 if there is none
+ */
+static const char* find_choice(const char** choices, const char* name) {
+  for (const char** c = choices; *c; ++c)
+    if (std::string(*c) == name) return *c;
+  return 0;
+}
+
+/**
+ * Creates the estimator of self, with the given shape and operators. Returns
+ * 0 on success, or -1 with a python exception set.
+ */
+static int setup(PyBobIpOptflowSolverObject* self, Py_ssize_t height,
+    Py_ssize_t width, const char* gradient, const char* laplacian) {
+
+  self->gradient = find_choice(GRADIENTS, gradient);
+  if (!self->gradient) {
+    PyErr_Format(PyExc_ValueError, "`%s' does not support gradient `%s' - choose between `hs', `sobel', `prewitt' and `isotropic'", Py_TYPE(self)->tp_name, gradient);
+    return -1;
+  }
+
+  self->laplacian = find_choice(LAPLACIANS, laplacian);
+  if (!self->laplacian) {
+    PyErr_Format(PyExc_ValueError, "`%s' does not support Laplacian `%s' - choose between `hs' and `opencv'", Py_TYPE(self)->tp_name, laplacian);
+    return -1;
+  }
+
+  if (!check_idle(self)) return -1;
+
+  try {
+    blitz::TinyVector<int,2> shape;
+    shape(0) = height; shape(1) = width;
+    bob::ip::optflow::FlowSolver* cxx =
+      bob::ip::optflow::createSolver(self->gradient, self->laplacian, shape);
+    delete self->cxx;
+    self->cxx = cxx;
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot create new object of type `%s' - unknown exception thrown", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static int PyBobIpOptflowSolver_init
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  /* Parses input arguments in a single shot */
+  static const char* const_kwlist[] = {"shape", "gradient", "laplacian", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t height, width;
+  const char* gradient = "sobel";
+  const char* laplacian = "opencv";
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "(nn)|ss", kwlist,
+        &height, &width, &gradient, &laplacian)) return -1;
+
+  self->fixed = false;
+  return setup(self, height, width, gradient, laplacian);
+
+}
+
+/**
+ * Initializes a subclass of Solver fixing the gradient and the Laplacian,
+ * such as Flow and VanillaFlow, from its only argument ``shape``. The images
+ * are then given to its methods as separate arguments.
+ */
+int PyBobIpOptflowSolver_InitFixed(PyObject* self, PyObject* args,
+    PyObject* kwds, const char* gradient, const char* laplacian) {
+
+  /* Parses input arguments in a single shot */
+  static const char* const_kwlist[] = {"shape", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t height, width;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "(nn)", kwlist,
+        &height, &width)) return -1;
+
+  auto solver = reinterpret_cast<PyBobIpOptflowSolverObject*>(self);
+  solver->fixed = true;
+  return setup(solver, height, width, gradient, laplacian);
+
+}
+
+static void PyBobIpOptflowSolver_delete
+(PyBobIpOptflowSolverObject* self) {
+
+  delete self->cxx;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+
+}
+
+static auto s_shape = bob::extension::VariableDoc(
+    "shape",
+    "tuple",
+    "The shape pre-configured for this flow estimator: ``(height, width)``"
+    );
+
+static PyObject* PyBobIpOptflowSolver_getShape
+(PyBobIpOptflowSolverObject* self, void* /*closure*/) {
+  auto shape = self->cxx->getShape();
+  return Py_BuildValue("nn", shape(0), shape(1));
+}
+
+static int PyBobIpOptflowSolver_setShape (PyBobIpOptflowSolverObject* self, PyObject* o, void* /*closure*/) {
+
+  Py_ssize_t height = 0;
+  Py_ssize_t width = 0;
+
+  if (!PyArg_ParseTuple(o, "nn", &height, &width)) return -1;
+
+  if (!check_idle(self)) return -1;
+
+  try {
+    blitz::TinyVector<int,2> shape;
+    shape(0) = height; shape(1) = width;
+    self->cxx->setShape(shape);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `shape' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static auto s_sigma = bob::extension::VariableDoc(
+    "sigma",
+    "float",
+    "The standard deviation, in pixels, of a Gaussian smoothing applied to the input images before the gradient is evaluated, or 0 (the default) for no smoothing",
+    "The smoothing uses the recursive filter of Young & van Vliet, so its cost does not depend on ``sigma``, which should be at least 0.5. Borders are extended by replicating the pixels on the edges."
+    );
+
+static PyObject* PyBobIpOptflowSolver_getSigma
+(PyBobIpOptflowSolverObject* self, void* /*closure*/) {
+  return Py_BuildValue("d", self->cxx->getSigma());
+}
+
+static int PyBobIpOptflowSolver_setSigma
+(PyBobIpOptflowSolverObject* self, PyObject* o, void* /*closure*/) {
+
+  double sigma = PyFloat_AsDouble(o);
+  if (PyErr_Occurred()) return -1;
+
+  if (!check_idle(self)) return -1;
+
+  try {
+    self->cxx->setSigma(sigma);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_ValueError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `sigma' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static auto s_frames = bob::extension::VariableDoc(
+    "frames",
+    "int",
+    "The number of images the flow is estimated from: 2 for the ``'hs'`` gradient, 3 otherwise"
+    );
+
+static PyObject* PyBobIpOptflowSolver_getFrames
+(PyBobIpOptflowSolverObject* self, void* /*closure*/) {
+  return Py_BuildValue("i", self->cxx->getFrames());
+}
+
+static auto s_gradient = bob::extension::VariableDoc(
+    "gradient",
+    "str",
+    "The name of the gradient of this solver"
+    );
+
+static PyObject* PyBobIpOptflowSolver_getGradient
+(PyBobIpOptflowSolverObject* self, void* /*closure*/) {
+  return Py_BuildValue("s", self->gradient);
+}
+
+static auto s_laplacian = bob::extension::VariableDoc(
+    "laplacian",
+    "str",
+    "The name of the Laplacian of this solver"
+    );
+
+static PyObject* PyBobIpOptflowSolver_getLaplacian
+(PyBobIpOptflowSolverObject* self, void* /*closure*/) {
+  return Py_BuildValue("s", self->laplacian);
+}
+
+static PyGetSetDef PyBobIpOptflowSolver_getseters[] = {
+    {
+      s_sigma.name(),
+      (getter)PyBobIpOptflowSolver_getSigma,
+      (setter)PyBobIpOptflowSolver_setSigma,
+      s_sigma.doc(),
+      0
+    },
+    {
+      s_shape.name(),
+      (getter)PyBobIpOptflowSolver_getShape,
+      (setter)PyBobIpOptflowSolver_setShape,
+      s_shape.doc(),
+      0
+    },
+    {
+      s_frames.name(),
+      (getter)PyBobIpOptflowSolver_getFrames,
+      0,
+      s_frames.doc(),
+      0
+    },
+    {
+      s_gradient.name(),
+      (getter)PyBobIpOptflowSolver_getGradient,
+      0,
+      s_gradient.doc(),
+      0
+    },
+    {
+      s_laplacian.name(),
+      (getter)PyBobIpOptflowSolver_getLaplacian,
+      0,
+      s_laplacian.doc(),
+      0
+    },
+    {0}  /* Sentinel */
+};
+
+PyObject* PyBobIpOptflowSolver_Repr(PyBobIpOptflowSolverObject* self) {
+
+  /**
+   * Expected output:
+   *
+   * <bob.ip.optflow.hornschunck.Solver((3, 2), gradient='sobel', laplacian='opencv')>
+   *
+   * or, for subclasses fixing the operators:
+   *
+   * <bob.ip.optflow.hornschunck.Flow((3, 2))>
+   */
+
+  auto shape = make_safe(PyBobIpOptflowSolver_getShape(self, 0));
+  if (!shape) return 0;
+  auto shape_str = make_safe(PyObject_Str(shape.get()));
+
+  PyObject* retval = self->fixed ?
+    PyUnicode_FromFormat("<%s(%U)>", Py_TYPE(self)->tp_name,
+        shape_str.get()) :
+    PyUnicode_FromFormat("<%s(%U, gradient='%s', laplacian='%s')>",
+        Py_TYPE(self)->tp_name, shape_str.get(), self->gradient,
+        self->laplacian);
+
+#if PYTHON_VERSION_HEX < 0x03000000
+  if (!retval) return 0;
+  PyObject* tmp = PyObject_Str(retval);
+  Py_DECREF(retval);
+  retval = tmp;
+#endif
+
+  return retval;
+
+}
+
+/**
+ * Returns the name of the trace span covering a method of self, such as
+ * ``python:Flow.estimate``, or 0 if tracing is off. Spans keep the pointer,
+ * so names are kept for good. Callers hold the GIL, which guards them.
+ */
+static const char* span_name(PyBobIpOptflowSolverObject* self,
+    const char* method) {
+
+  if (!bob::ip::optflow::trace::enabled()) return 0;
+
+  static std::set<std::string> names;
+  const char* type = Py_TYPE(self)->tp_name;
+  const char* dot = std::strrchr(type, '.');
+  std::string name = std::string("python:") + (dot? dot + 1 : type) + "." +
+    method;
+  return names.insert(name).first->c_str();
+
+}
+
+/**
+ * Checks the given array is a 2D 64-bit float array with the shape
+ * pre-configured for this estimator. Sets a python exception otherwise.
+ */
+static bool check_input(PyBobIpOptflowSolverObject* self, PyBlitzArrayObject* a,
+    const char* name) {
+
+  if (a->type_num != NPY_FLOAT64 || a->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 64-bit float arrays for input array `%s'", Py_TYPE(self)->tp_name, name);
+    return false;
+  }
+
+  Py_ssize_t height = self->cxx->getShape()(0);
+  Py_ssize_t width = self->cxx->getShape()(1);
+
+  if (a->shape[0] != height || a->shape[1] != width) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' only supports arrays with shape (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d) for input array `%s', but `%s''s shape is (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", Py_TYPE(self)->tp_name, height, width, name, name, a->shape[0], a->shape[1]);
+    return false;
+  }
+
+  return true;
+
+}
+
+/**
+ * Converts an image to estimate the flow from, checking it like
+ * check_input(). The array is kept alive by the list keep. Sets a python
+ * exception on errors.
+ */
+static bool convert_image(PyBobIpOptflowSolverObject* self, PyObject* o,
+    const char* name, PyObject* keep,
+    std::vector<blitz::Array<double,2>*>& images) {
+
+  PyBlitzArrayObject* a = 0;
+  if (!PyBobIpOptflow_InputConverter(o, &a)) return false;
+  auto a_ = make_safe(a);
+  if (!check_input(self, a, name)) return false;
+  if (PyList_Append(keep, reinterpret_cast<PyObject*>(a)) != 0) return false;
+  images.push_back(PyBlitzArrayCxx_AsBlitz<double,2>(a));
+  return true;
+
+}
+
+/**
+ * Converts the sequence of images to estimate the flow from, checking there
+ * are as many as the gradient takes, like convert_image(). Sets a python
+ * exception on errors.
+ */
+static bool convert_images(PyBobIpOptflowSolverObject* self, PyObject* o,
+    PyObject* keep, std::vector<blitz::Array<double,2>*>& images) {
+
+  auto sequence = make_xsafe(PySequence_Fast(o, "`images' should be a sequence of arrays"));
+  if (!sequence) return false;
+
+  Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence.get());
+  if (size != self->cxx->getFrames()) {
+    PyErr_Format(PyExc_ValueError, "`%s' with gradient `%s' estimates the flow from %d images, but you passed %" PY_FORMAT_SIZE_T "d", Py_TYPE(self)->tp_name, self->gradient, self->cxx->getFrames(), size);
+    return false;
+  }
+
+  for (Py_ssize_t k=0; k<size; ++k)
+    if (!convert_image(self, PySequence_Fast_GET_ITEM(sequence.get(), k),
+          "images", keep, images)) return false;
+
+  return true;
+
+}
+
+/**
+ * The arguments all estimator methods start with, as parsed by
+ * parse_leading(), and the arguments left for each method to parse
+ */
+struct Leading {
+
+  Leading(): alpha(0.), iterations(0), keep(0), args(0), kwds(0) {}
+
+  ~Leading() {
+    Py_XDECREF(keep);
+    Py_XDECREF(args);
+    Py_XDECREF(kwds);
+  }
+
+  bob::ip::optflow::Frames frames() const {
+    if (images.size() == 2)
+      return bob::ip::optflow::Frames(*images[0], *images[1]);
+    return bob::ip::optflow::Frames(*images[0], *images[1], *images[2]);
+  }
+
+  double alpha;
+  Py_ssize_t iterations;
+  std::vector<blitz::Array<double,2>*> images; ///< kept alive by keep
+  PyObject* keep;
+  PyObject* args; ///< the positional arguments left
+  PyObject* kwds; ///< the keyword arguments left
+
+};
+
+/**
+ * Parses the arguments all estimator methods start with: ``alpha`` and
+ * ``iterations`` if solve is set, then the images. These are a sequence
+ * ``images`` or, on subclasses fixing the operators, separate arguments
+ * ``image1``, ``image2`` (and ``image3`` for 3 frames). Every argument is
+ * taken by position or else by keyword. Sets a python exception on errors.
+ */
+static bool parse_leading(PyBobIpOptflowSolverObject* self, PyObject* args,
+    PyObject* kwds, bool solve, Leading& leading) {
+
+  static const char* image_names[] = {"image1", "image2", "image3"};
+
+  std::vector<const char*> names;
+  if (solve) {
+    names.push_back("alpha");
+    names.push_back("iterations");
+  }
+  if (self->fixed)
+    names.insert(names.end(), image_names,
+        image_names + self->cxx->getFrames());
+  else names.push_back("images");
+
+  Py_ssize_t given = PyTuple_GET_SIZE(args);
+  std::vector<PyObject*> values; //borrowed
+  for (size_t k=0; k<names.size(); ++k) {
+    PyObject* keyword = kwds? PyDict_GetItemString(kwds, names[k]) : 0;
+    if ((Py_ssize_t)k < given && keyword) {
+      PyErr_Format(PyExc_TypeError, "`%s' got multiple values for argument `%s'", Py_TYPE(self)->tp_name, names[k]);
+      return false;
+    }
+    if ((Py_ssize_t)k < given) values.push_back(PyTuple_GET_ITEM(args, k));
+    else if (keyword) values.push_back(keyword);
+    else {
+      PyErr_Format(PyExc_TypeError, "`%s' requires argument `%s' (pos %d)", Py_TYPE(self)->tp_name, names[k], (int)k + 1);
+      return false;
+    }
+  }
+
+  leading.args = PyTuple_GetSlice(args, names.size(), given);
+  if (!leading.args) return false;
+  leading.kwds = kwds? PyDict_Copy(kwds) : PyDict_New();
+  if (!leading.kwds) return false;
+  for (auto name: names) {
+    if (PyDict_GetItemString(leading.kwds, name) &&
+        PyDict_DelItemString(leading.kwds, name) != 0) return false;
+  }
+
+  size_t k = 0;
+  if (solve) {
+    leading.alpha = PyFloat_AsDouble(values[k++]);
+    if (PyErr_Occurred()) return false;
+    leading.iterations = PyNumber_AsSsize_t(values[k++], PyExc_OverflowError);
+    if (PyErr_Occurred()) return false;
+    if (leading.iterations < 0) {
+      PyErr_Format(PyExc_ValueError, "`%s' requires `iterations' to be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", Py_TYPE(self)->tp_name, leading.iterations);
+      return false;
+    }
+  }
+
+  leading.keep = PyList_New(0);
+  if (!leading.keep) return false;
+
+  if (!self->fixed)
+    return convert_images(self, values[k], leading.keep, leading.images);
+
+  for (size_t j=0; k+j<names.size(); ++j)
+    if (!convert_image(self, values[k+j], image_names[j], leading.keep,
+          leading.images)) return false;
+  return true;
+
+}
+
+/**
+ * Checks the (optional) initial flow estimates ``u`` and ``v``. If none was
+ * given, allocates both, filled with zeros. Returns new references.
+ */
+static bool prepare_flow(PyBobIpOptflowSolverObject* self, PyBlitzArrayObject*& u,
+    PyBlitzArrayObject*& v) {
+
+  if (u && !v) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' requires either both `u' and `v' or none, but you provided `u' and not `v'", Py_TYPE(self)->tp_name);
+    return false;
+  }
+
+  if (v && !u) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' requires either both `u' and `v' or none, but you provided `v' and not `u'", Py_TYPE(self)->tp_name);
+    return false;
+  }
+
+  if (u) { //&& v
+    if (!check_input(self, u, "u") || !check_input(self, v, "v")) return false;
+    Py_INCREF(u);
+    Py_INCREF(v);
+    return true;
+  }
+
+  Py_ssize_t shape[2] = {self->cxx->getShape()(0), self->cxx->getShape()(1)};
+
+  u = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, shape);
+  if (!u) return false;
+  (*PyBlitzArrayCxx_AsBlitz<double,2>(u)) = 0.;
+
+  v = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, shape);
+  if (!v) {
+    Py_DECREF(u);
+    u = 0;
+    return false;
+  }
+  (*PyBlitzArrayCxx_AsBlitz<double,2>(v)) = 0.;
+
+  return true;
+
+}
+
+/**
+ * Runs the given call on the C++ estimator with the GIL released, so other
+ * python threads may run meanwhile, converting C++ exceptions into python
+ * ones. The call may only touch blitz arrays.
+ */
+template <typename F>
+static bool run_without_gil(PyBobIpOptflowSolverObject* self, F call,
+    const char* action) {
+
+  if (!check_idle(self)) return false;
+
+  std::string error;
+  bool unknown = false;
+
+  self->busy = true;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    call();
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    unknown = true;
+  }
+  Py_END_ALLOW_THREADS
+  self->busy = false;
+
+  if (unknown) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot %s: unknown exception caught", Py_TYPE(self)->tp_name, action);
+    return false;
+  }
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return false;
+  }
+
+  return true;
+
+}
+
+static const char* s_alpha_doc = "The weighting factor between brightness constness and the field smoothness. According to original paper, :math:`\\alpha^2` should be more or less set to noise in estimating :math:`E_x^2 + E_y^2`. In practice, many algorithms consider values around 200 a good default. The higher this number is, the more importance on smoothing you will be putting.";
+
+static const char* s_images_doc = "The :py:attr:`frames` images to estimate the flow from, in time order. :py:class:`VanillaFlow` and :py:class:`Flow` take them as separate arguments instead, ``image1, image2`` and ``image1, image2, image3`` (respectively).";
+
+static auto s_estimate = bob::extension::FunctionDoc(
+    "estimate",
+    "Estimates the optical flow leading to the central image of ``images``, or to the last of 2 images.",
+    "All input images should be 2D 64-bit float arrays with the shape ``(height, width)`` as specified in the construction of the object. Calling the object is the same as calling this method."
+    )
+    .add_prototype("alpha, iterations, images, [u, v]", "u, v")
+    .add_parameter("alpha", "float", s_alpha_doc)
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array (2D, float64)", "The estimated flows in the horizontal and vertical directions (respectively) will be output in these variables, which should have dimensions matching those of this functor. If you don't provide arrays for ``u`` and ``v``, then they will be allocated internally and returned. You must either provide neither ``u`` and ``v`` or both, otherwise an exception will be raised. Notice that, if you provide ``u`` and ``v`` which are non-zero, they will be taken as initial values for the error minimization. These arrays will be updated with the final value of the flow.")
+    .add_return("u, v", "array (2D, float)", "The estimated flows in the horizontal and vertical directions (respectively)."
+    )
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimate
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate"));
+
+  static const char* const_kwlist[] = {"u", "v", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "|O&O&", kwlist,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  if (!prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_safe(u);
+  auto vflow_ = make_safe(v);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->operator()(a.alpha, a.iterations, frames, *bz_u, *bz_v);
+        }, "estimate flow")) return 0;
+
+  return Py_BuildValue("(NN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v))
+    );
+
+}
+
+static auto s_estimate_gradients = bob::extension::FunctionDoc(
+    "estimate_gradients",
+    "Estimates the optical flow from gradients evaluated beforehand, like :py:meth:`estimate` would from the images they come from.",
+    "The gradients are 2D 16-bit integer arrays, e.g. from :py:func:`integer_gradient`, with the shape of this solver. The gradients of the images are ``scale`` times these ones, a factor folded into the weighting factor (``alpha / scale``): the flow is the one of the scaled gradients. The gradient of this solver, and its smoothing (:py:attr:`sigma`), are not used."
+    )
+    .add_prototype("alpha, iterations, ex, ey, et, [scale], [u, v]", "u, v")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("ex, ey, et", "array-like (2D, int16)", "The gradients in the horizontal, vertical and time directions (respectively)")
+    .add_parameter("scale", "float", "[Default: ``1.``] The factor from the given gradients to those of the images, such as the one returned by :py:func:`integer_gradient`")
+    .add_parameter("u, v", "array (2D, float64)", "The initial flow estimates, updated in place. If not given, the flow is estimated from zero and returned in new arrays. See :py:meth:`estimate`.")
+    .add_return("u, v", "array (2D, float)", "The estimated flows in the horizontal and vertical directions (respectively)."
+    )
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimate_gradients
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate_gradients"));
+
+  static const char* const_kwlist[] = {
+    "alpha",
+    "iterations",
+    "ex",
+    "ey",
+    "et",
+    "scale",
+    "u",
+    "v",
+    0
+    };
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  double alpha;
+  Py_ssize_t iterations;
+  PyBlitzArrayObject* ex = 0;
+  PyBlitzArrayObject* ey = 0;
+  PyBlitzArrayObject* et = 0;
+  double scale = 1.;
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "dnO&O&O&|dO&O&", kwlist,
+        &alpha, &iterations,
+        &PyBobIpOptflow_InputConverter, &ex,
+        &PyBobIpOptflow_InputConverter, &ey,
+        &PyBobIpOptflow_InputConverter, &et,
+        &scale,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto ex_ = make_safe(ex);
+  auto ey_ = make_safe(ey);
+  auto et_ = make_safe(et);
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  PyBlitzArrayObject* gradients[] = {ex, ey, et};
+  const char* names[] = {"ex", "ey", "et"};
+  for (int k=0; k<3; ++k) {
+    if (gradients[k]->type_num != NPY_INT16 || gradients[k]->ndim != 2) {
+      PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 16-bit integer arrays for input array `%s'", Py_TYPE(self)->tp_name, names[k]);
+      return 0;
+    }
+  }
+
+  if (!(scale > 0.)) {
+    PyErr_Format(PyExc_ValueError, "`scale' should be positive, but you set it to %g", scale);
+    return 0;
+  }
+
+  if (!prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_safe(u);
+  auto vflow_ = make_safe(v);
+
+  /** all basic checks are done, can call the functor now **/
+  auto bz_ex = PyBlitzArrayCxx_AsBlitz<int16_t,2>(ex);
+  auto bz_ey = PyBlitzArrayCxx_AsBlitz<int16_t,2>(ey);
+  auto bz_et = PyBlitzArrayCxx_AsBlitz<int16_t,2>(et);
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->estimateGradients(alpha, iterations, *bz_ex, *bz_ey,
+            *bz_et, scale, *bz_u, *bz_v);
+        }, "estimate flow from gradients")) return 0;
+
+  return Py_BuildValue("(NN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v))
+    );
+
+}
+
+static auto s_estimate_convergence = bob::extension::FunctionDoc(
+    "estimate_convergence",
+    "Estimates the optical flow like :py:meth:`estimate`, while keeping track of where in the image the estimate keeps changing.",
+    "The image is divided in blocks of ``block`` x ``block`` pixels (partial blocks on the right and bottom borders included). For every block, this method records the last iteration (counting from 1) in which the update magnitude :math:`\\sqrt{\\Delta u^2 + \\Delta v^2}` of any of its pixels exceeded ``threshold``, or 0 if that never happened, and the largest update magnitude of the final iteration. Both are collected on the same pass that updates the flow."
+    )
+    .add_prototype("alpha, iterations, images, [u, v], [threshold], [block]", "u, v, last, magnitude")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array (2D, float64)", "The initial flow estimates, updated in place. If not given, the flow is estimated from zero and returned in new arrays. See :py:meth:`estimate`.")
+    .add_parameter("threshold", "float", "[Default: ``1e-3``] The update magnitude, in pixels, above which an update is considered significant")
+    .add_parameter("block", "int", "[Default: ``1``] The side of the square blocks diagnostics are reported for. Use 1 for per-pixel results.")
+    .add_return("u, v", "array (2D, float)", "The estimated flows in the horizontal and vertical directions (respectively).")
+    .add_return("last", "array (2D, int32)", "The last iteration with a significant update, per block")
+    .add_return("magnitude", "array (2D, float)", "The largest update magnitude of the final iteration, per block")
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimateConvergence
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate_convergence"));
+
+  static const char* const_kwlist[] = {"u", "v", "threshold", "block", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  double threshold = 1e-3;
+  int block = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "|O&O&di", kwlist,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v,
+        &threshold, &block
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  if (block < 1) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `block' to be at least 1, but you set it to %d", Py_TYPE(self)->tp_name, block);
+    return 0;
+  }
+
+  if (!prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_safe(u);
+  auto vflow_ = make_safe(v);
+
+  //allocates the diagnostics
+  auto shape = bob::ip::optflow::blockShape(self->cxx->getShape(), block);
+  Py_ssize_t dshape[2] = {shape(0), shape(1)};
+  auto last = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT32, 2, dshape);
+  if (!last) return 0;
+  auto last_ = make_safe(last);
+  auto magnitude = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, dshape);
+  if (!magnitude) return 0;
+  auto magnitude_ = make_safe(magnitude);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  auto bz_last = PyBlitzArrayCxx_AsBlitz<int32_t,2>(last);
+  auto bz_magnitude = PyBlitzArrayCxx_AsBlitz<double,2>(magnitude);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->estimateConvergence(a.alpha, a.iterations, frames,
+          *bz_u, *bz_v, threshold, block, *bz_last, *bz_magnitude);
+        }, "estimate flow")) return 0;
+
+  return Py_BuildValue("(NNNN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", last)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", magnitude))
+    );
+
+}
+
+static auto s_estimate_statistics = bob::extension::FunctionDoc(
+    "estimate_statistics",
+    "Estimates the optical flow like :py:meth:`estimate`, computing summary statistics of the result on the way.",
+    "The statistics are accumulated while the final iteration updates the flow, so no further pass over ``u`` and ``v`` is required. For a pixel with flow :math:`(u, v)`, the magnitude is :math:`\\sqrt{u^2 + v^2}` and the motion energy is :math:`u^2 + v^2`. The direction histogram has ``bins`` bins of equal width over the angle :math:`\\mathrm{atan2}(v, u)`, starting at :math:`-\\pi`, and accumulates the magnitude of every pixel on the bin of its direction, so static pixels do not count. Statistics are given for the whole frame and for every tile of ``tile`` x ``tile`` pixels (partial tiles on the right and bottom borders included)."
+    )
+    .add_prototype("alpha, iterations, images, [u, v], [tile], [bins]", "u, v, statistics")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array (2D, float64)", "The initial flow estimates, updated in place. If not given, the flow is estimated from zero and returned in new arrays. See :py:meth:`estimate`.")
+    .add_parameter("tile", "int", "[Default: ``16``] The side of the square tiles statistics are reported for")
+    .add_parameter("bins", "int", "[Default: ``8``] The number of bins of the direction histograms")
+    .add_return("u, v", "array (2D, float)", "The estimated flows in the horizontal and vertical directions (respectively).")
+    .add_return("statistics", "dict", "The mean (``mean``) and maximum (``max``) magnitudes, the mean motion energy (``energy``) and the direction histogram (``histogram``, 1D) of the whole frame, together with the same statistics per tile (``tile_mean``, ``tile_max``, ``tile_energy``, all 2D, and ``tile_histogram``, 3D, with bins on the last dimension).")
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimateStatistics
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate_statistics"));
+
+  static const char* const_kwlist[] = {"u", "v", "tile", "bins", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  int tile = 16;
+  int bins = 8;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "|O&O&ii", kwlist,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v,
+        &tile, &bins
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  if (tile < 1 || bins < 1) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `tile' and `bins' to be at least 1, but you set them to %d and %d", Py_TYPE(self)->tp_name, tile, bins);
+    return 0;
+  }
+
+  if (!prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_safe(u);
+  auto vflow_ = make_safe(v);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  bob::ip::optflow::FlowStatistics statistics(self->cxx->getShape(), tile,
+      bins);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->estimateStatistics(a.alpha, a.iterations, frames,
+          *bz_u, *bz_v, statistics);
+        }, "estimate flow")) return 0;
+
+  PyObject* stats = PyBobIpOptflowFlowStatistics_AsDict(statistics);
+  if (!stats) return 0;
+
+  return Py_BuildValue("(NNN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v)),
+    stats
+    );
+
+}
+
+static auto s_estimate_label_statistics = bob::extension::FunctionDoc(
+    "estimate_label_statistics",
+    "Estimates the optical flow like :py:meth:`estimate`, computing its statistics per label of a label image on the way.",
+    "The statistics are accumulated while the final iteration updates the flow, so no further pass over ``u`` and ``v`` is required, and are the same as those of :py:func:`label_statistics` on the result: for labels 0 to ``n_labels - 1``, the number of pixels, the mean flow, its covariance and a histogram of the magnitudes, with ``bins`` bins of equal width over ``[0, range)``. Pixels with other labels are ignored."
+    )
+    .add_prototype("alpha, iterations, images, labels, [u, v], [n_labels], [bins], [range]", "u, v, statistics")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("labels", "array-like (2D, int32)", "The label of every pixel, with the same shape as the images")
+    .add_parameter("u, v", "array (2D, float64)", "The initial flow estimates, updated in place. If not given, the flow is estimated from zero and returned in new arrays. See :py:meth:`estimate`.")
+    .add_parameter("n_labels", "int", "[Default: ``labels.max() + 1``] The number of labels to compute statistics for")
+    .add_parameter("bins", "int", "[Default: ``10``] The number of bins of the magnitude histograms")
+    .add_parameter("range", "float", "[Default: ``10.``] The upper limit, in pixels, of the magnitude histograms")
+    .add_return("u, v", "array (2D, float)", "The estimated flows in the horizontal and vertical directions (respectively).")
+    .add_return("statistics", "dict", "The statistics of every label, as returned by :py:func:`label_statistics`")
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimateLabelStatistics
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self,
+        "estimate_label_statistics"));
+
+  static const char* const_kwlist[] = {"labels", "u", "v", "n_labels",
+    "bins", "range", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* labels = 0;
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  int n_labels = -1;
+  int bins = 10;
+  double range = 10.;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "O&|O&O&iid", kwlist,
+        &PyBobIpOptflow_InputConverter, &labels,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v,
+        &n_labels, &bins, &range
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto labels_ = make_safe(labels);
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  if (labels->type_num != NPY_INT32 || labels->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 32-bit integer arrays for input array `labels'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  if (bins < 1 || !(range > 0.)) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `bins' to be at least 1 and `range' to be positive, but you set them to %d and %g", Py_TYPE(self)->tp_name, bins, range);
+    return 0;
+  }
+
+  if (!prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_safe(u);
+  auto vflow_ = make_safe(v);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_labels = PyBlitzArrayCxx_AsBlitz<int32_t,2>(labels);
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  if (n_labels < 0) n_labels = bob::ip::optflow::countLabels(*bz_labels);
+  bob::ip::optflow::LabelStatistics statistics(n_labels, bins, range);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->estimateLabelStatistics(a.alpha, a.iterations, frames,
+          *bz_u, *bz_v, *bz_labels, statistics);
+        }, "estimate flow")) return 0;
+
+  PyObject* stats = PyBobIpOptflowLabelStatistics_AsDict(statistics);
+  if (!stats) return 0;
+
+  return Py_BuildValue("(NNN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v)),
+    stats
+    );
+
+}
+
+static auto s_estimate_hoof = bob::extension::FunctionDoc(
+    "estimate_hoof",
+    "Estimates the optical flow like :py:meth:`estimate`, computing its histograms of oriented optical flow (HOOF) on the way.",
+    "The features are accumulated while the final iteration updates the flow, so no further pass over ``u`` and ``v`` is required, and are the same as those of :py:func:`hoof` on the result."
+    )
+    .add_prototype("alpha, iterations, images, [u, v], [cell], [bins], [block], [epsilon]", "u, v, features")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array (2D, float64)", "The initial flow estimates, updated in place. If not given, the flow is estimated from zero and returned in new arrays. See :py:meth:`estimate`.")
+    .add_parameter("cell", "int", "[Default: ``8``] The size of the cells, in pixels")
+    .add_parameter("bins", "int", "[Default: ``8``] The number of orientation bins of every cell histogram")
+    .add_parameter("block", "int", "[Default: ``2``] The size of the normalization blocks, in cells")
+    .add_parameter("epsilon", "float", "[Default: ``0.01``] Regularizes the block norms. See :py:func:`hoof`.")
+    .add_return("u, v", "array (2D, float)", "The estimated flows in the horizontal and vertical directions (respectively).")
+    .add_return("features", "dict", "The cell histograms and block descriptors, as returned by :py:func:`hoof`")
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimateHoof
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate_hoof"));
+
+  static const char* const_kwlist[] = {"u", "v", "cell", "bins", "block",
+    "epsilon", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  int cell = 8;
+  int bins = 8;
+  int block = 2;
+  double epsilon = 0.01;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "|O&O&iiid", kwlist,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v,
+        &cell, &bins, &block, &epsilon
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  if (cell < 1 || bins < 1 || block < 1 || !(epsilon > 0.)) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `cell', `bins' and `block' to be at least 1 and `epsilon' to be positive, but you set them to %d, %d, %d and %g", Py_TYPE(self)->tp_name, cell, bins, block, epsilon);
+    return 0;
+  }
+
+  if (!prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_safe(u);
+  auto vflow_ = make_safe(v);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  bob::ip::optflow::HoofFeatures features(self->cxx->getShape(), cell, bins,
+      block, epsilon);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->estimateHoof(a.alpha, a.iterations, frames, *bz_u, *bz_v,
+          features);
+        }, "estimate flow")) return 0;
+
+  PyObject* retval = PyBobIpOptflowHoofFeatures_AsDict(features);
+  if (!retval) return 0;
+
+  return Py_BuildValue("(NNN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v)),
+    retval
+    );
+
+}
+
+static auto s_estimate_mask = bob::extension::FunctionDoc(
+    "estimate_mask",
+    "Estimates the optical flow like :py:meth:`estimate`, returning only a mask of the moving pixels.",
+    "A pixel is moving if the magnitude of its flow, :math:`\\sqrt{u^2 + v^2}`, is larger than ``threshold``. The mask is set while the final iteration updates the flow, so no further pass over ``u`` and ``v`` is required. If ``u`` and ``v`` are not given, the flow is estimated from zero on buffers owned by this object, which are reused by the next call, so no flow arrays are allocated. If ``packed`` is set, the mask is packed in bits along rows, like :py:func:`numpy.packbits` with ``axis=1`` would do: the most significant bit of byte ``mask[y, x // 8]`` holds pixel ``(y, x)`` for ``x`` multiple of 8. Otherwise, the mask has one byte per pixel, set to 1 for moving pixels and 0 for static ones, and may be cleaned up with a 3x3 morphological opening (an erosion followed by a dilation), which removes moving regions thinner than 3 pixels."
+    )
+    .add_prototype("alpha, iterations, images, [u, v], [threshold], [packed], [cleanup]", "mask")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array (2D, float64)", "The initial flow estimates, updated in place. If not given, the flow is estimated from zero and not returned.")
+    .add_parameter("threshold", "float", "[Default: ``1.0``] The flow magnitude, in pixels, above which a pixel is moving")
+    .add_parameter("packed", "bool", "[Default: ``False``] Packs the mask in bits, 8 pixels per byte")
+    .add_parameter("cleanup", "bool", "[Default: ``False``] Applies a 3x3 morphological opening to the mask. Cannot be used with ``packed``.")
+    .add_return("mask", "array (2D, uint8)", "The motion mask, with the shape of the images, or with ``(width + 7) // 8`` columns if ``packed`` is set")
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimateMask
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate_mask"));
+
+  static const char* const_kwlist[] = {"u", "v", "threshold", "packed",
+    "cleanup", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  double threshold = 1.;
+  PyObject* packed = Py_False;
+  PyObject* cleanup = Py_False;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "|O&O&dOO", kwlist,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v,
+        &threshold, &packed, &cleanup
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  int packed_ = PyObject_IsTrue(packed);
+  if (packed_ < 0) return 0;
+  int cleanup_ = PyObject_IsTrue(cleanup);
+  if (cleanup_ < 0) return 0;
+
+  if (packed_ && cleanup_) {
+    PyErr_Format(PyExc_ValueError, "`%s' cannot clean up packed masks: set either `packed' or `cleanup'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  if (threshold < 0.) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `threshold' to be non-negative, but you set it to %g", Py_TYPE(self)->tp_name, threshold);
+    return 0;
+  }
+
+  //only checks the flow estimates if given: the solver owns them otherwise
+  bool given = u || v;
+  if (given && !prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_xsafe(given ? u : 0);
+  auto vflow_ = make_xsafe(given ? v : 0);
+
+  //allocates the mask
+  auto shape = bob::ip::optflow::maskShape(self->cxx->getShape(), packed_);
+  Py_ssize_t mshape[2] = {shape(0), shape(1)};
+  auto mask = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_UINT8, 2, mshape);
+  if (!mask) return 0;
+  auto mask_ = make_safe(mask);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = given ? PyBlitzArrayCxx_AsBlitz<double,2>(u) : 0;
+  auto bz_v = given ? PyBlitzArrayCxx_AsBlitz<double,2>(v) : 0;
+  auto bz_mask = PyBlitzArrayCxx_AsBlitz<uint8_t,2>(mask);
+  if (!run_without_gil(self, [&]() {
+        if (given) {
+          self->cxx->estimateMask(a.alpha, a.iterations, frames,
+            *bz_u, *bz_v, threshold, packed_, *bz_mask);
+        }
+        else {
+          self->cxx->estimateMask(a.alpha, a.iterations, frames,
+            threshold, packed_, *bz_mask);
+        }
+        if (cleanup_) bob::ip::optflow::openMask(*bz_mask);
+        }, "estimate motion mask")) return 0;
+
+  return PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", mask));
+
+}
+
+static auto s_estimate_blocks = bob::extension::FunctionDoc(
+    "estimate_blocks",
+    "Estimates the optical flow like :py:meth:`estimate`, returning one flow vector per block of pixels.",
+    "The flow is pooled over blocks of ``block`` x ``block`` pixels (partial blocks on the right and bottom borders included) while the final iteration updates it, so no further pass over ``u`` and ``v`` is required. Each block gets the mean or the median of the horizontal and vertical flows of its pixels, taken separately. The median of an even number of values is the mean of the middle two, as for :py:func:`numpy.median`. If ``u`` and ``v`` are not given, the flow is estimated from zero on buffers owned by this object, which are reused by the next call, so no dense flow arrays are allocated."
+    )
+    .add_prototype("alpha, iterations, images, [u, v], [block], [reduction]", "bu, bv")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array (2D, float64)", "The initial flow estimates, updated in place. If not given, the flow is estimated from zero and not returned.")
+    .add_parameter("block", "int", "[Default: ``16``] The side of the square blocks the flow is pooled over")
+    .add_parameter("reduction", "str", "[Default: ``'mean'``] How the flow of a block is pooled: ``'mean'`` or ``'median'``")
+    .add_return("bu, bv", "array (2D, float)", "The pooled flows in the horizontal and vertical directions (respectively), with one row per ``block`` image rows and one column per ``block`` image columns, rounding up")
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimateBlocks
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate_blocks"));
+
+  static const char* const_kwlist[] = {"u", "v", "block", "reduction", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  int block = 16;
+  const char* reduction = "mean";
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "|O&O&is", kwlist,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v,
+        &block, &reduction
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_xsafe(u);
+  auto v_ = make_xsafe(v);
+
+  if (block < 1) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `block' to be at least 1, but you set it to %d", Py_TYPE(self)->tp_name, block);
+    return 0;
+  }
+
+  bob::ip::optflow::BlockReduction reduction_;
+  if (std::string(reduction) == "mean") reduction_ = bob::ip::optflow::BlockMean;
+  else if (std::string(reduction) == "median") reduction_ = bob::ip::optflow::BlockMedian;
+  else {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `reduction' to be either 'mean' or 'median', but you set it to '%s'", Py_TYPE(self)->tp_name, reduction);
+    return 0;
+  }
+
+  //only checks the flow estimates if given: the solver owns them otherwise
+  bool given = u || v;
+  if (given && !prepare_flow(self, u, v)) return 0;
+  auto uflow_ = make_xsafe(given ? u : 0);
+  auto vflow_ = make_xsafe(given ? v : 0);
+
+  //allocates the pooled flow
+  auto shape = bob::ip::optflow::blockShape(self->cxx->getShape(), block);
+  Py_ssize_t bshape[2] = {shape(0), shape(1)};
+  auto bu = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, bshape);
+  if (!bu) return 0;
+  auto bu_ = make_safe(bu);
+  auto bv = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, bshape);
+  if (!bv) return 0;
+  auto bv_ = make_safe(bv);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = given ? PyBlitzArrayCxx_AsBlitz<double,2>(u) : 0;
+  auto bz_v = given ? PyBlitzArrayCxx_AsBlitz<double,2>(v) : 0;
+  auto bz_bu = PyBlitzArrayCxx_AsBlitz<double,2>(bu);
+  auto bz_bv = PyBlitzArrayCxx_AsBlitz<double,2>(bv);
+  if (!run_without_gil(self, [&]() {
+        if (given) {
+          self->cxx->estimateBlocks(a.alpha, a.iterations, frames,
+            *bz_u, *bz_v, block, reduction_, *bz_bu, *bz_bv);
+        }
+        else {
+          self->cxx->estimateBlocks(a.alpha, a.iterations, frames,
+            block, reduction_, *bz_bu, *bz_bv);
+        }
+        }, "estimate flow")) return 0;
+
+  return Py_BuildValue("(NN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", bu)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", bv))
+    );
+
+}
+
+static auto s_estimate_regions = bob::extension::FunctionDoc(
+    "estimate_regions",
+    "Re-estimates the optical flow in the regions of the images that changed only, keeping the previous flow elsewhere.",
+    "This is meant for sequences in which little changes between frames, such as screen captures. ``u`` and ``v`` should hold the previous estimates, and are updated in place. Every region, grown by ``halo`` pixels on each side and clipped to the image, is updated like :py:meth:`estimate` would, while the flow around it is kept as the boundary condition. Gradients are only evaluated around the regions, so the cost is proportional to their area rather than to the image size. Regions are processed in order. With a single region covering the image, the results are the same as :py:meth:`estimate`'s. If ``regions`` is not given, they are found with :py:func:`changed_regions`, from the changes between consecutive images. With smoothing (see :py:attr:`sigma`), gradients are evaluated on the regions grown by :math:`4\\sigma`, so they may differ slightly from the ones on the whole image."
+    )
+    .add_prototype("alpha, iterations, images, u, v, [regions], [halo], [threshold], [block]", "u, v")
+    .add_parameter("alpha", "float", "The weighting factor between brightness constness and the field smoothness. See :py:meth:`estimate`.")
+    .add_parameter("iterations", "int", "Number of iterations for which to minimize the flow error, in every region")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array (2D, float64)", "The previous flow estimates, updated in place")
+    .add_parameter("regions", "[(int, int, int, int)]", "[Default: ``None``] The regions to update, as ``(y, x, height, width)`` tuples. If not given, the regions that changed are found from the images.")
+    .add_parameter("halo", "int", "[Default: ``16``] By how many pixels every region is grown on each side, to let the flow around changes settle")
+    .add_parameter("threshold, block", "float, int", "[Default: ``0.``, ``16``] Used to find the regions that changed, if ``regions`` is not given. See :py:func:`changed_regions`.")
+    .add_return("u, v", "array (2D, float)", "The updated flows in the horizontal and vertical directions (respectively)")
+    ;
+
+static PyObject* PyBobIpOptflowSolver_estimateRegions
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  //covers argument parsing and checks, on top of the solver
+  bob::ip::optflow::trace::Span span(span_name(self, "estimate_regions"));
+
+  static const char* const_kwlist[] = {"u", "v", "regions", "halo",
+    "threshold", "block", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, true, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  PyObject* regions = 0;
+  int halo = 16;
+  double threshold = 0.;
+  int block = 16;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "O&O&|Oidi", kwlist,
+        &PyBlitzArray_OutputConverter, &u,
+        &PyBlitzArray_OutputConverter, &v,
+        &regions, &halo, &threshold, &block
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+
+  if (!check_input(self, u, "u") || !check_input(self, v, "v")) return 0;
+
+  if (halo < 0) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires `halo' to be non-negative, but you set it to %d", Py_TYPE(self)->tp_name, halo);
+    return 0;
+  }
+
+  //only finds the regions that changed if none were given
+  bool given = regions && regions != Py_None;
+  std::vector<bob::ip::optflow::Region> regions_;
+  if (given) {
+    if (!PyBobIpOptflow_RegionsConverter(regions, &regions_)) return 0;
+  }
+  else {
+    if (threshold < 0.) {
+      PyErr_Format(PyExc_ValueError, "`%s' requires `threshold' to be non-negative, but you set it to %g", Py_TYPE(self)->tp_name, threshold);
+      return 0;
+    }
+    if (block < 1) {
+      PyErr_Format(PyExc_ValueError, "`%s' requires `block' to be at least 1, but you set it to %d", Py_TYPE(self)->tp_name, block);
+      return 0;
+    }
+  }
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  if (!run_without_gil(self, [&]() {
+        if (!given && frames.size == 2) {
+          bob::ip::optflow::changedRegions(*frames.image[0],
+            *frames.image[1], threshold, block, regions_);
+        }
+        else if (!given) {
+          bob::ip::optflow::changedRegions(*frames.image[0],
+            *frames.image[1], *frames.image[2], threshold, block, regions_);
+        }
+        self->cxx->estimateRegions(a.alpha, a.iterations, frames,
+          *bz_u, *bz_v, regions_, halo);
+        }, "estimate flow")) return 0;
+
+  return Py_BuildValue("(NN)",
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", u)),
+    PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", v))
+    );
+
+}
+
+static auto s_eval_ec2 = bob::extension::FunctionDoc(
+    "eval_ec2",
+    "Calculates the square of the smoothness error (:math:`E_c^2`) by using the formula described in the paper: :math:`E_c^2 = (\\bar{u} - u)^2 + (\\bar{v} - v)^2`, with the Laplacian of this solver."
+    )
+    .add_prototype("u, v", "error")
+    .add_parameter("u, v", "array-like (2D, float64)", "The estimated flows in the horizontal and vertical directions (respectively), which should have dimensions matching those of this functor.")
+    .add_return("error", "array (2D, float)", "The square of the smoothness error."
+    )
+    ;
+
+static PyObject* PyBobIpOptflowSolver_eval_ec2
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"u", "v", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&", kwlist,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+
+  if (!check_input(self, u, "u") || !check_input(self, v, "v")) return 0;
+
+  //allocates the error return
+  auto error = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64,
+      u->ndim, u->shape);
+  if (!error) return 0;
+  auto error_ = make_safe(error);
+
+  /** all basic checks are done, can call the functor now **/
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  auto bz_error = PyBlitzArrayCxx_AsBlitz<double,2>(error);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->evalEc2(*bz_u, *bz_v, *bz_error);
+        }, "calculate smoothness error")) return 0;
+
+  return PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", error));
+
+}
+
+static auto s_eval_eb = bob::extension::FunctionDoc(
+    "eval_eb",
+    "Calculates the brightness error (:math:`E_b`) as defined in the paper: :math:`E_b = (E_x u + E_y v + E_t)`, with the gradient of this solver."
+    )
+    .add_prototype("images, u, v", "error")
+    .add_parameter("images", "[array-like (2D, float64)]", s_images_doc)
+    .add_parameter("u, v", "array-like (2D, float64)", "The estimated flows in the horizontal and vertical directions (respectively), which should have dimensions matching those of this functor.")
+    .add_return("error", "array (2D, float)", "The evaluated brightness error."
+    )
+    ;
+
+static PyObject* PyBobIpOptflowSolver_eval_eb
+(PyBobIpOptflowSolverObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"u", "v", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Leading a;
+  if (!parse_leading(self, args, kwds, false, a)) return 0;
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(a.args, a.kwds, "O&O&", kwlist,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+
+  if (!check_input(self, u, "u") || !check_input(self, v, "v")) return 0;
+
+  //allocates the error return
+  auto error = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64,
+      u->ndim, u->shape);
+  if (!error) return 0;
+  auto error_ = make_safe(error);
+
+  /** all basic checks are done, can call the functor now **/
+  const bob::ip::optflow::Frames frames = a.frames();
+  auto bz_u = PyBlitzArrayCxx_AsBlitz<double,2>(u);
+  auto bz_v = PyBlitzArrayCxx_AsBlitz<double,2>(v);
+  auto bz_error = PyBlitzArrayCxx_AsBlitz<double,2>(error);
+  if (!run_without_gil(self, [&]() {
+        self->cxx->evalEb(frames, *bz_u, *bz_v, *bz_error);
+        }, "estimate brightness error")) return 0;
+
+  return PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", error));
+
+}
+
+static PyMethodDef PyBobIpOptflowSolver_methods[] = {
+  {
+    s_estimate.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimate,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate.doc()
+  },
+  {
+    s_estimate_gradients.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimate_gradients,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_gradients.doc()
+  },
+  {
+    s_estimate_convergence.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimateConvergence,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_convergence.doc()
+  },
+  {
+    s_estimate_statistics.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimateStatistics,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_statistics.doc()
+  },
+  {
+    s_estimate_label_statistics.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimateLabelStatistics,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_label_statistics.doc()
+  },
+  {
+    s_estimate_hoof.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimateHoof,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_hoof.doc()
+  },
+  {
+    s_estimate_mask.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimateMask,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_mask.doc()
+  },
+  {
+    s_estimate_blocks.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimateBlocks,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_blocks.doc()
+  },
+  {
+    s_estimate_regions.name(),
+    (PyCFunction)PyBobIpOptflowSolver_estimateRegions,
+    METH_VARARGS|METH_KEYWORDS,
+    s_estimate_regions.doc()
+  },
+  {
+    s_eval_ec2.name(),
+    (PyCFunction)PyBobIpOptflowSolver_eval_ec2,
+    METH_VARARGS|METH_KEYWORDS,
+    s_eval_ec2.doc()
+  },
+  {
+    s_eval_eb.name(),
+    (PyCFunction)PyBobIpOptflowSolver_eval_eb,
+    METH_VARARGS|METH_KEYWORDS,
+    s_eval_eb.doc()
+  },
+  {0} /* Sentinel */
+};
+
+static PyObject* PyBobIpOptflowSolver_new
+(PyTypeObject* type, PyObject*, PyObject*) {
+
+  /* Allocates the python object itself */
+  PyBobIpOptflowSolverObject* self =
+    (PyBobIpOptflowSolverObject*)type->tp_alloc(type, 0);
+
+  self->cxx = 0;
+  self->busy = false;
+  self->fixed = false;
+  self->gradient = 0;
+  self->laplacian = 0;
+
+  return reinterpret_cast<PyObject*>(self);
+
+}
+
+PyTypeObject PyBobIpOptflowSolver_Type = {
+    PyVarObject_HEAD_INIT(0, 0)
+    s_solver.name(),                                    /* tp_name */
+    sizeof(PyBobIpOptflowSolverObject),                 /* tp_basicsize */
+    0,                                                  /* tp_itemsize */
+    (destructor)PyBobIpOptflowSolver_delete,            /* tp_dealloc */
+    0,                                                  /* tp_print */
+    0,                                                  /* tp_getattr */
+    0,                                                  /* tp_setattr */
+    0,                                                  /* tp_compare */
+    (reprfunc)PyBobIpOptflowSolver_Repr,                /* tp_repr */
+    0,                                                  /* tp_as_number */
+    0,                                                  /* tp_as_sequence */
+    0,                                                  /* tp_as_mapping */
+    0,                                                  /* tp_hash */
+    (ternaryfunc)PyBobIpOptflowSolver_estimate,         /* tp_call */
+    (reprfunc)PyBobIpOptflowSolver_Repr,                /* tp_str */
+    0,                                                  /* tp_getattro */
+    0,                                                  /* tp_setattro */
+    0,                                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,           /* tp_flags */
+    s_solver.doc(),                                     /* tp_doc */
+    0,                                                  /* tp_traverse */
+    0,                                                  /* tp_clear */
+    0,                                                  /* tp_richcompare */
+    0,                                                  /* tp_weaklistoffset */
+    0,                                                  /* tp_iter */
+    0,                                                  /* tp_iternext */
+    PyBobIpOptflowSolver_methods,                       /* tp_methods */
+    0,                                                  /* tp_members */
+    PyBobIpOptflowSolver_getseters,                     /* tp_getset */
+    0,                                                  /* tp_base */
+    0,                                                  /* tp_dict */
+    0,                                                  /* tp_descr_get */
+    0,                                                  /* tp_descr_set */
+    0,                                                  /* tp_dictoffset */
+    (initproc)PyBobIpOptflowSolver_init,                /* tp_init */
+    0,                                                  /* tp_alloc */
+    PyBobIpOptflowSolver_new,                           /* tp_new */
+};
+
+/**
+ * Returns the estimator of a Solver object (Flow and VanillaFlow included),
+ * or 0 if o is not a Solver. If busy is given, it is set to the flag raised
+ * while the estimator runs without the GIL.
+ */
+bob::ip::optflow::FlowSolver* PyBobIpOptflowSolver_AsCxx(PyObject* o,
+    bool** busy) {
+  if (!PyObject_TypeCheck(o, &PyBobIpOptflowSolver_Type)) return 0;
+  auto self = reinterpret_cast<PyBobIpOptflowSolverObject*>(o);
+  if (busy) *busy = &self->busy;
+  return self->cxx;
+}
@@ -0,0 +1,105 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:11:43 2026 +0000
+ *
+ * @brief Conversion of flow statistics into Python objects
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <bob.blitz/cppapi.h>
+#include <bob.blitz/cleanup.h>
+
+#include "HornAndSchunckFlow.h"
+
+/**
+ * Copies a blitz array into a new numpy array and sets it on a dictionary
+ */
+template <typename T, int N>
+static bool set_array(PyObject* dict, const char* key,
+    const blitz::Array<T,N>& value) {
+
+  Py_ssize_t shape[N];
+  for (int k=0; k<N; ++k) shape[k] = value.extent(k);
+  auto a = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(
+      PyBlitzArrayCxx_CToTypenum<T>(), N, shape);
+  if (!a) return false;
+  auto a_ = make_safe(a);
+  *PyBlitzArrayCxx_AsBlitz<T,N>(a) = value;
+
+  auto wrapped = make_xsafe(PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", a)));
+  if (!wrapped) return false;
+  return PyDict_SetItemString(dict, key, wrapped.get()) == 0;
+
+}
+
+static bool set_float(PyObject* dict, const char* key, double value) {
+  auto o = make_xsafe(PyFloat_FromDouble(value));
+  if (!o) return false;
+  return PyDict_SetItemString(dict, key, o.get()) == 0;
+}
+
+/**
+ * Returns a new dictionary with the contents of the given statistics, or 0
+ * (with an exception set) on errors
+ */
+PyObject* PyBobIpOptflowFlowStatistics_AsDict
+(const bob::ip::optflow::FlowStatistics& s) {
+
+  PyObject* retval = PyDict_New();
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  if (!set_float(retval, "mean", s.mean)) return 0;
+  if (!set_float(retval, "max", s.max)) return 0;
+  if (!set_float(retval, "energy", s.energy)) return 0;
+  if (!set_array(retval, "histogram", s.histogram)) return 0;
+  if (!set_array(retval, "tile_mean", s.tileMean)) return 0;
+  if (!set_array(retval, "tile_max", s.tileMax)) return 0;
+  if (!set_array(retval, "tile_energy", s.tileEnergy)) return 0;
+  if (!set_array(retval, "tile_histogram", s.tileHistogram)) return 0;
+
+  Py_INCREF(retval);
+  return retval;
+
+}
+
+/**
+ * Returns a new dictionary with the contents of the given statistics per
+ * label, or 0 (with an exception set) on errors
+ */
+PyObject* PyBobIpOptflowLabelStatistics_AsDict
+(const bob::ip::optflow::LabelStatistics& s) {
+
+  PyObject* retval = PyDict_New();
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  if (!set_array(retval, "count", s.count)) return 0;
+  if (!set_array(retval, "mean", s.mean)) return 0;
+  if (!set_array(retval, "covariance", s.covariance)) return 0;
+  if (!set_array(retval, "histogram", s.histogram)) return 0;
+
+  Py_INCREF(retval);
+  return retval;
+
+}
+
+/**
+ * Returns a new dictionary with the given HOOF features, or 0 (with an
+ * exception set) on errors
+ */
+PyObject* PyBobIpOptflowHoofFeatures_AsDict
+(const bob::ip::optflow::HoofFeatures& f) {
+
+  PyObject* retval = PyDict_New();
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  if (!set_array(retval, "cells", f.cells)) return 0;
+  if (!set_array(retval, "blocks", f.blocks)) return 0;
+
+  Py_INCREF(retval);
+  return retval;
+
+}
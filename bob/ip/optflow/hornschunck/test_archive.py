@@ -0,0 +1,196 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:09:40 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests the indexed, compressed flow archives
+"""
+
+import os
+import struct
+import tempfile
+import numpy
+import nose.tools
+
+from . import FlowArchiveWriter, FlowArchiveReader
+
+def flows(count, shape):
+  y, x = numpy.mgrid[0:shape[0], 0:shape[1]]
+  return [(numpy.sin(0.1*x + 0.05*k) * 3., numpy.cos(0.07*y - 0.03*k) * 2.)
+      for k in range(count)]
+
+def roundtrip(step, keyframe, prediction='previous'):
+
+  data = flows(11, (9, 13))
+  fd, filename = tempfile.mkstemp(suffix='.bfa')
+  os.close(fd)
+  try:
+    writer = FlowArchiveWriter(filename, (9, 13), step, keyframe, queue=2,
+        prediction=prediction)
+    for u, v in data: writer.write(u, v)
+    writer.close()
+    assert len(writer) == len(data)
+    assert writer.prediction == prediction
+    assert writer.saturated == 0
+
+    reader = FlowArchiveReader(filename)
+    assert len(reader) == len(data)
+    assert reader.shape == (9, 13)
+    assert reader.step == step
+    assert reader.keyframe == keyframe
+    assert reader.prediction == prediction
+
+    tolerance = step / 2. + 1e-12
+    for k in (5, 10, 0, 6, 7, 3, 4, -1):
+      u, v = reader[k]
+      if step:
+        assert numpy.abs(u - data[k][0]).max() <= tolerance
+        assert numpy.abs(v - data[k][1]).max() <= tolerance
+      else:
+        assert numpy.array_equal(u, data[k][0])
+        assert numpy.array_equal(v, data[k][1])
+    u, v = reader.read(2)
+    assert numpy.allclose(u, data[2][0], atol=tolerance)
+    nose.tools.assert_raises(IndexError, reader.read, len(data))
+  finally:
+    os.unlink(filename)
+
+def test_lossless():
+  roundtrip(0., 1)
+  roundtrip(0., 4)
+  roundtrip(0., 4, 'keyframe')
+
+def test_quantized():
+  roundtrip(1./64, 1)
+  roundtrip(1./64, 4)
+  roundtrip(1./64, 4, 'keyframe')
+
+def test_saturated():
+
+  # values beyond the int16 range of steps are saturated, and counted
+  step = 1./64
+  u, v = flows(1, (9, 13))[0]
+  u = u * 200. #up to +/-600 pixels
+  fd, filename = tempfile.mkstemp(suffix='.bfa')
+  os.close(fd)
+  try:
+    writer = FlowArchiveWriter(filename, (9, 13), step)
+    writer.write(u, v)
+    writer.write(v, -u)
+    writer.close()
+    over = (u / step > 32767.) | (u / step < -32768.)
+    under = (-u / step > 32767.) | (-u / step < -32768.)
+    assert over.sum() > 0
+    assert writer.saturated == over.sum() + under.sum()
+
+    ru, rv = FlowArchiveReader(filename)[0]
+    assert numpy.abs(ru[over]).max() <= 32768 * step
+    assert numpy.allclose(ru[~over], u[~over], atol=step/2. + 1e-12)
+
+    # lossless archives never saturate
+    writer = FlowArchiveWriter(filename, (9, 13))
+    writer.write(u, v)
+    writer.close()
+    assert writer.saturated == 0
+  finally:
+    os.unlink(filename)
+
+def test_version1():
+
+  # archives of version 1 (predicting from the previous frame, without the
+  # prediction on the header) are still read
+  data = flows(5, (9, 13))
+  fd, filename = tempfile.mkstemp(suffix='.bfa')
+  os.close(fd)
+  try:
+    writer = FlowArchiveWriter(filename, (9, 13), 1./64, 4)
+    for u, v in data: writer.write(u, v)
+    writer.close()
+    with open(filename, 'rb') as f: data2 = f.read()
+    assert struct.unpack('=I', data2[8:12]) == (2,)
+
+    # drops the 8 bytes of prediction, moving chunks and the index up
+    frames, index = struct.unpack('=QQ', data2[-24:-8])
+    entries = b''
+    for k in range(frames):
+      offset, sizes = struct.unpack('=Q8s', data2[index+16*k:index+16*(k+1)])
+      entries += struct.pack('=Q', offset - 8) + sizes
+    data1 = data2[:8] + struct.pack('=I', 1) + data2[12:32] + \
+        data2[40:index] + entries + struct.pack('=QQ', frames, index - 8) + \
+        data2[-8:]
+    with open(filename, 'wb') as f: f.write(data1)
+
+    reader = FlowArchiveReader(filename)
+    assert reader.prediction == 'previous'
+    for k in (4, 1, 2):
+      u, v = reader[k]
+      assert numpy.allclose(u, data[k][0], atol=1./128 + 1e-12)
+      assert numpy.allclose(v, data[k][1], atol=1./128 + 1e-12)
+  finally:
+    os.unlink(filename)
+
+def test_errors():
+
+  fd, filename = tempfile.mkstemp(suffix='.bfa')
+  os.close(fd)
+  try:
+    writer = FlowArchiveWriter(filename, (4, 5))
+    nose.tools.assert_raises(RuntimeError, writer.write, numpy.zeros((4, 4)),
+        numpy.zeros((4, 4)))
+    # not closed yet: the index is missing
+    nose.tools.assert_raises(RuntimeError, FlowArchiveReader, filename)
+    writer.close()
+    nose.tools.assert_raises(RuntimeError, writer.write, numpy.zeros((4, 5)),
+        numpy.zeros((4, 5)))
+    assert len(FlowArchiveReader(filename)) == 0
+    nose.tools.assert_raises(RuntimeError, FlowArchiveReader, __file__)
+  finally:
+    os.unlink(filename)
+
+def test_corrupted():
+
+  # Indexes that do not match the file, or the frames, are refused on open
+  fd, filename = tempfile.mkstemp(suffix='.bfa')
+  os.close(fd)
+  try:
+    writer = FlowArchiveWriter(filename, (9, 13))
+    for u, v in flows(3, (9, 13)): writer.write(u, v)
+    writer.close()
+    with open(filename, 'rb') as f: data = f.read()
+    frames, index = struct.unpack('=QQ', data[-24:-8])
+    assert frames == 3
+
+    def patch(offset, fmt, value):
+      return data[:offset] + struct.pack(fmt, value) + \
+          data[offset+struct.calcsize(fmt):]
+
+    variants = [
+        patch(len(data) - 24, '=Q', 1 << 40), #frames
+        patch(len(data) - 16, '=Q', len(data)), #index offset
+        patch(index + 8, '=I', 0), #empty chunk
+        patch(index + 8, '=I', len(data)), #chunk beyond the index
+        patch(index, '=Q', 3), #chunk over the header
+        patch(index + 12, '=I', 0), #empty frame
+        patch(index + 12, '=I', 0xffffffff), #frame larger than its values
+        patch(12, '=i', 0x7fffffff), #height
+        data[:40], #no footer
+        ]
+    for k, variant in enumerate(variants):
+      with open(filename, 'wb') as f: f.write(variant)
+      try:
+        FlowArchiveReader(filename)
+      except RuntimeError as e:
+        continue
+      assert False, 'variant %d was not refused' % k
+
+    with open(filename, 'wb') as f: f.write(data)
+    assert len(FlowArchiveReader(filename)) == 3
+  finally:
+    os.unlink(filename)
+
+  nose.tools.assert_raises(RuntimeError, FlowArchiveWriter, filename,
+      (1 << 15, 1 << 15))
+  nose.tools.assert_raises(ValueError, FlowArchiveWriter, filename, (9, 13),
+      prediction='next')
@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:02:07 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests the performance counters and the benchmark harness
+"""
+
+try:
+  from StringIO import StringIO
+except ImportError:
+  from io import StringIO
+
+from . import PerfCounters, peak_bandwidth, peak_flops
+from .benchmark import benchmark, roofline, models, opencv_hs, \
+    compare_opencv
+
+def test_counters():
+
+  counters = PerfCounters()
+  counters.start()
+  sum(range(10000))
+  values = counters.stop()
+  assert values['seconds'] > 0
+  for name in ('cycles', 'instructions', 'cache_references', 'cache_misses'):
+    assert name in values
+    if name in counters.available: assert values[name] >= 0
+    else: assert values[name] is None
+
+def test_benchmark():
+
+  output = StringIO()
+  results = benchmark([(16, 24)], 2, 1, output)
+  assert (16, 24) in results
+  assert len(results[(16, 24)]) == 6
+  for name, r in results[(16, 24)]:
+    assert r['ms'] > 0
+  assert 'ForwardGradient' in output.getvalue()
+
+def test_peaks():
+
+  assert peak_bandwidth(elements=1<<16, repeat=1) > 0
+  assert peak_flops(repeat=1) > 0
+
+def test_roofline():
+
+  output = StringIO()
+  results = benchmark([(16, 24)], 2, 1, output)[(16, 24)]
+  # a host with 10 GB/s and 1 GFLOP/s has its ridge at 0.1 flop/byte
+  placed = roofline(results, 2, 16*24, 10e9, 1e9)
+  assert len(placed) >= len(results)
+  model = models(2)
+  for name, r in placed:
+    assert (r['flops/px'], r['bytes/px']) == model[name]
+    assert r['attainable'] <= 1.
+    assert r['bound'] == ('memory' if r['intensity'] < 0.1 else 'compute')
+
+def test_opencv():
+
+  output = StringIO()
+  results = compare_opencv([(16, 24)], 2, 1, stream=output)
+  if opencv_hs() is None:
+    assert results == {}
+    assert 'not available' in output.getvalue()
+    return
+  assert len(results[(16, 24)]) == 3
+  for name, r in results[(16, 24)]:
+    assert r['ms'] > 0
+    assert r['epe'] <= r['epe max']
+  assert results[(16, 24)][-1][1]['epe max'] == 0.
@@ -9,12 +9,15 @@
 """
 
 import os
+import threading
 import numpy
 import nose.tools
 import pkg_resources
 
 
-from . import VanillaFlow, HornAndSchunckGradient, laplacian_avg_hs
+from . import VanillaFlow, Flow, HornAndSchunckGradient, laplacian_avg_hs
+from . import changed_regions, estimate_many, Solver, block_matching
+from . import label_statistics, hoof, warp, SobelGradient
 
 def F(f):
   """Returns the test file on the "data" subdirectory"""
@@ -108,6 +111,744 @@ def test_synthetic():
   assert  numpy.allclose(v_cxx, v_py, atol=1e-15)
 
 
+def test_convergence():
+
+  # The diagnostics must not change the flow and must be consistent with the
+  # update performed on the last iteration
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  for flow, images in ((VanillaFlow(i1.shape), (i1, i2)),
+      (Flow(i1.shape), (i1, i2, i3))):
+
+    u_ref, v_ref = flow.estimate(alpha, N-1, *images)
+    u_prev, v_prev = u_ref.copy(), v_ref.copy()
+    flow.estimate(alpha, 1, *(images + (u_ref, v_ref)))
+
+    u, v, last, magnitude = flow.estimate_convergence(alpha, N, *images,
+        threshold=1e-6)
+    assert numpy.allclose(u, u_ref, atol=1e-15)
+    assert numpy.allclose(v, v_ref, atol=1e-15)
+    assert last.shape == i1.shape
+    assert last.dtype == numpy.int32
+    assert last.max() <= N
+    update = numpy.sqrt((u_ref - u_prev)**2 + (v_ref - v_prev)**2)
+    assert numpy.allclose(magnitude, update, atol=1e-15)
+    assert (last[update > 1e-6] == N).all()
+
+    # per-block results aggregate the per-pixel ones
+    u, v, block_last, block_magnitude = flow.estimate_convergence(alpha, N,
+        *images, threshold=1e-6, block=2)
+    assert block_last.shape == (3, 3)
+    assert block_last[0,0] == last[:2,:2].max()
+    assert block_last[2,2] == last[4,4]
+    assert numpy.allclose(block_magnitude[1,2], magnitude[2:4,4].max())
+
+def test_statistics():
+
+  # Statistics computed on the final iteration must match those computed
+  # from the returned flow
+  N = 20
+  alpha = 1.5
+  bins = 3 #edges away from the axes and diagonals
+  i1, i2, i3 = make_image_tripplet()
+
+  for flow, images in ((VanillaFlow(i1.shape), (i1, i2)),
+      (Flow(i1.shape), (i1, i2, i3))):
+
+    u_ref, v_ref = flow.estimate(alpha, N, *images)
+    u, v, stats = flow.estimate_statistics(alpha, N, *images, tile=2,
+        bins=bins)
+    assert numpy.allclose(u, u_ref, atol=1e-15)
+    assert numpy.allclose(v, v_ref, atol=1e-15)
+
+    magnitude = numpy.sqrt(u**2 + v**2)
+    assert numpy.allclose(stats['mean'], magnitude.mean())
+    assert numpy.allclose(stats['max'], magnitude.max())
+    assert numpy.allclose(stats['energy'], (u**2 + v**2).mean())
+    angle = numpy.arctan2(v, u)
+    moving = magnitude > 0
+    histogram = numpy.histogram(angle[moving], bins=bins,
+        range=(-numpy.pi, numpy.pi), weights=magnitude[moving])[0]
+    assert numpy.allclose(stats['histogram'], histogram)
+
+    assert stats['tile_mean'].shape == (3, 3)
+    assert stats['tile_histogram'].shape == (3, 3, bins)
+    assert numpy.allclose(stats['tile_mean'][0,0], magnitude[:2,:2].mean())
+    assert numpy.allclose(stats['tile_mean'][2,2], magnitude[4,4])
+    assert numpy.allclose(stats['tile_max'][1,2], magnitude[2:4,4].max())
+    assert numpy.allclose(stats['tile_energy'][2,1],
+        (u[4,2:4]**2 + v[4,2:4]**2).mean())
+    assert numpy.allclose(stats['tile_histogram'].sum(axis=(0,1)),
+        stats['histogram'])
+
+    # without iterations, the initial conditions are summarized
+    u, v, stats = flow.estimate_statistics(alpha, 0, *(images + (u, v)))
+    assert numpy.allclose(stats['max'], magnitude.max())
+
+def label_statistics_python(u, v, labels, n_labels, bins, range):
+  """Computes the statistics of every label in numpy"""
+  count = numpy.zeros((n_labels,), 'int64')
+  mean = numpy.zeros((n_labels, 2))
+  covariance = numpy.zeros((n_labels, 2, 2))
+  histogram = numpy.zeros((n_labels, bins), 'int64')
+  for l in numpy.arange(n_labels):
+    select = labels == l
+    count[l] = select.sum()
+    if not count[l]: continue
+    flow = numpy.vstack((u[select], v[select]))
+    mean[l] = flow.mean(axis=1)
+    covariance[l] = numpy.cov(flow, bias=True)
+    magnitude = numpy.sqrt(u[select]**2 + v[select]**2)
+    index = numpy.minimum((magnitude * bins / range).astype(int), bins-1)
+    histogram[l] = numpy.bincount(index, minlength=bins)
+  return count, mean, covariance, histogram
+
+def test_label_statistics():
+
+  numpy.random.seed(3)
+  shape = (150, 70) #more than one stripe of rows
+  u = numpy.random.normal(0, 2, shape)
+  v = numpy.random.normal(1, 3, shape)
+  labels = numpy.random.randint(-1, 5, shape).astype('int32')
+  labels[labels == 3] = 2 #a label without pixels
+
+  stats = label_statistics(u, v, labels, bins=4, range=8.)
+  count, mean, covariance, histogram = \
+      label_statistics_python(u, v, labels, 5, 4, 8.)
+  assert numpy.array_equal(stats['count'], count)
+  assert numpy.allclose(stats['mean'], mean)
+  assert numpy.allclose(stats['covariance'], covariance)
+  assert numpy.array_equal(stats['histogram'], histogram)
+  assert stats['count'][3] == 0
+  assert numpy.all(stats['covariance'][3] == 0)
+
+  # Threads share the rows, with the same results
+  for threads in (2, 0):
+    other = label_statistics(u, v, labels, bins=4, range=8., threads=threads)
+    for key in stats: assert numpy.array_equal(other[key], stats[key]), key
+
+  # Labels beyond n_labels are ignored
+  stats = label_statistics(u, v, labels, 2)
+  assert numpy.array_equal(stats['count'], count[:2])
+
+  nose.tools.assert_raises(TypeError, label_statistics, u, v,
+      labels.astype('float64'))
+  nose.tools.assert_raises(ValueError, label_statistics, u, v, labels,
+      bins=0)
+  nose.tools.assert_raises(ValueError, label_statistics, u, v, labels,
+      range=0.)
+  nose.tools.assert_raises(RuntimeError, label_statistics, u, v[1:],
+      labels[1:])
+
+def test_label_statistics_moments():
+
+  # The covariance of flows far from zero does not cancel out
+  numpy.random.seed(4)
+  shape = (150, 70)
+  u = 1e6 + numpy.random.rand(*shape)
+  v = -3e5 + numpy.random.rand(*shape)
+  labels = numpy.random.randint(0, 3, shape).astype('int32')
+  stats = label_statistics(u, v, labels, threads=2)
+  count, mean, covariance, histogram = \
+      label_statistics_python(u, v, labels, 3, 10, 10.)
+  assert numpy.allclose(stats['mean'], mean)
+  assert numpy.allclose(stats['covariance'], covariance, rtol=1e-6, atol=0)
+
+  # Many labels take taller stripes, within bounded memory, still sharing
+  # rows between threads with the same results
+  shape = (2048, 4)
+  u = numpy.random.normal(0, 2, shape)
+  v = numpy.random.normal(1, 3, shape)
+  labels = numpy.arange(shape[0] * shape[1], dtype='int32').reshape(shape)
+  labels %= 1 << 12
+  stats = label_statistics(u, v, labels, 1 << 18)
+  assert stats['count'].sum() == labels.size
+  assert numpy.array_equal(stats['count'][:1 << 12], [2] * (1 << 12))
+  other = label_statistics(u, v, labels, 1 << 18, threads=4)
+  for key in stats: assert numpy.array_equal(other[key], stats[key]), key
+
+def test_estimate_label_statistics():
+
+  # Statistics accumulated on the final iteration must match those computed
+  # from the returned flow
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+  labels = numpy.zeros(i1.shape, 'int32')
+  labels[2:,:] = 1
+  labels[:,3:] = 2
+
+  for flow, images in ((VanillaFlow(i1.shape), (i1, i2)),
+      (Flow(i1.shape), (i1, i2, i3))):
+
+    u_ref, v_ref = flow.estimate(alpha, N, *images)
+    u, v, stats = flow.estimate_label_statistics(alpha, N, *images,
+        labels=labels, bins=3, range=1.)
+    assert numpy.allclose(u, u_ref, atol=1e-15)
+    assert numpy.allclose(v, v_ref, atol=1e-15)
+
+    expected = label_statistics(u, v, labels, bins=3, range=1.)
+    assert numpy.array_equal(stats['count'], [6, 9, 10])
+    assert numpy.array_equal(stats['histogram'], expected['histogram'])
+    assert numpy.allclose(stats['mean'], expected['mean'])
+    assert numpy.allclose(stats['covariance'], expected['covariance'])
+
+def hoof_python(u, v, cell, bins, block, epsilon):
+  """Computes HOOF features in numpy"""
+  cy, cx = (u.shape[0] + cell - 1) // cell, (u.shape[1] + cell - 1) // cell
+  cells = numpy.zeros((cy, cx, bins))
+  magnitude = numpy.sqrt(u**2 + v**2)
+  index = ((numpy.arctan2(v, u) + numpy.pi) * bins / (2*numpy.pi)).astype(int)
+  index = numpy.minimum(index, bins-1)
+  for y, x in zip(*numpy.nonzero(magnitude > 0)):
+    cells[y//cell, x//cell, index[y,x]] += magnitude[y,x]
+  blocks = numpy.zeros((max(cy-block+1, 0), max(cx-block+1, 0),
+    block*block*bins))
+  for by in range(blocks.shape[0]):
+    for bx in range(blocks.shape[1]):
+      h = cells[by:by+block, bx:bx+block].flatten()
+      blocks[by,bx] = h / numpy.sqrt((h**2).sum() + epsilon**2)
+  return cells, blocks
+
+def test_hoof():
+
+  numpy.random.seed(4)
+  shape = (45, 38) #partial cells on the borders
+  u = numpy.random.normal(0, 2, shape)
+  v = numpy.random.normal(0, 2, shape)
+  u[:8,:8] = v[:8,:8] = 0. #a static cell
+
+  features = hoof(u, v, cell=6, bins=9, block=3, epsilon=0.1)
+  cells, blocks = hoof_python(u, v, 6, 9, 3, 0.1)
+  assert features['cells'].shape == (8, 7, 9)
+  assert features['blocks'].shape == (6, 5, 81)
+  assert numpy.allclose(features['cells'], cells)
+  assert numpy.allclose(features['blocks'], blocks)
+  norms = numpy.sqrt((features['blocks']**2).sum(axis=2))
+  assert numpy.all(norms < 1) and numpy.all(norms > 0.99)
+
+  # Threads share rows of cells, with the same results
+  for threads in (3, 0):
+    other = hoof(u, v, cell=6, bins=9, block=3, epsilon=0.1, threads=threads)
+    for key in features: assert numpy.array_equal(other[key], features[key])
+
+  # Blocks larger than the image have no descriptors
+  assert hoof(u, v, cell=16, block=4)['blocks'].shape == (0, 0, 128)
+
+  nose.tools.assert_raises(ValueError, hoof, u, v, cell=0)
+  nose.tools.assert_raises(ValueError, hoof, u, v, bins=0)
+  nose.tools.assert_raises(ValueError, hoof, u, v, block=0)
+  nose.tools.assert_raises(ValueError, hoof, u, v, epsilon=0.)
+  nose.tools.assert_raises(RuntimeError, hoof, u, v[1:])
+
+def test_estimate_hoof():
+
+  # Features accumulated on the final iteration must match those computed
+  # from the returned flow
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  for flow, images in ((VanillaFlow(i1.shape), (i1, i2)),
+      (Flow(i1.shape), (i1, i2, i3))):
+
+    u_ref, v_ref = flow.estimate(alpha, N, *images)
+    u, v, features = flow.estimate_hoof(alpha, N, *images, cell=2, bins=4)
+    assert numpy.allclose(u, u_ref, atol=1e-15)
+    assert numpy.allclose(v, v_ref, atol=1e-15)
+
+    expected = hoof(u, v, cell=2, bins=4)
+    assert features['cells'].shape == (3, 3, 4)
+    assert features['blocks'].shape == (2, 2, 16)
+    assert numpy.allclose(features['cells'], expected['cells'])
+    assert numpy.allclose(features['blocks'], expected['blocks'])
+
+def test_mask():
+
+  # Masks set on the final iteration must match the thresholded flow
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  for flow, images in ((VanillaFlow(i1.shape), (i1, i2)),
+      (Flow(i1.shape), (i1, i2, i3))):
+
+    u, v = flow.estimate(alpha, N, *images)
+    magnitude = numpy.sqrt(u**2 + v**2)
+    threshold = numpy.median(magnitude)
+    reference = (magnitude > threshold).astype('uint8')
+
+    mask = flow.estimate_mask(alpha, N, *images, threshold=threshold)
+    assert mask.dtype == numpy.uint8
+    assert numpy.array_equal(mask, reference)
+    assert 0 < mask.sum() < mask.size
+
+    # internal buffers are reset between calls
+    mask = flow.estimate_mask(alpha, N, *images, threshold=threshold)
+    assert numpy.array_equal(mask, reference)
+
+    packed = flow.estimate_mask(alpha, N, *images, threshold=threshold,
+        packed=True)
+    assert packed.shape == (i1.shape[0], (i1.shape[1] + 7) // 8)
+    assert numpy.array_equal(packed, numpy.packbits(reference, axis=1))
+
+    # given estimates are updated in place
+    u0 = numpy.zeros(i1.shape, 'float64')
+    v0 = numpy.zeros(i1.shape, 'float64')
+    mask = flow.estimate_mask(alpha, N, *(images + (u0, v0)),
+        threshold=threshold)
+    assert numpy.allclose(u0, u, atol=1e-15)
+    assert numpy.allclose(v0, v, atol=1e-15)
+    assert numpy.array_equal(mask, reference)
+
+    cleaned = flow.estimate_mask(alpha, N, *images, threshold=threshold,
+        cleanup=True)
+    assert numpy.all(cleaned <= reference)
+
+    nose.tools.assert_raises(ValueError, flow.estimate_mask, alpha, N,
+        *images, packed=True, cleanup=True)
+    nose.tools.assert_raises(ValueError, flow.estimate_mask, alpha, N,
+        *images, threshold=-1.)
+
+def test_blocks():
+
+  # Flow pooled on the final iteration must match the pooled returned flow
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  for flow, images in ((VanillaFlow(i1.shape), (i1, i2)),
+      (Flow(i1.shape), (i1, i2, i3))):
+
+    u, v = flow.estimate(alpha, N, *images)
+
+    for reduction, pool in (('mean', numpy.mean), ('median', numpy.median)):
+      bu, bv = flow.estimate_blocks(alpha, N, *images, block=2,
+          reduction=reduction)
+      assert bu.shape == (3, 3)
+      assert bv.shape == (3, 3)
+      for y in range(3):
+        for x in range(3):
+          assert numpy.allclose(bu[y,x], pool(u[2*y:2*y+2,2*x:2*x+2]))
+          assert numpy.allclose(bv[y,x], pool(v[2*y:2*y+2,2*x:2*x+2]))
+
+    # given estimates are updated in place
+    u0 = numpy.zeros(i1.shape, 'float64')
+    v0 = numpy.zeros(i1.shape, 'float64')
+    bu, bv = flow.estimate_blocks(alpha, N, *(images + (u0, v0)), block=5)
+    assert numpy.allclose(u0, u, atol=1e-15)
+    assert numpy.allclose(v0, v, atol=1e-15)
+    assert numpy.allclose(bu, u.mean())
+    assert numpy.allclose(bv, v.mean())
+
+    nose.tools.assert_raises(ValueError, flow.estimate_blocks, alpha, N,
+        *images, reduction='max')
+    nose.tools.assert_raises(ValueError, flow.estimate_blocks, alpha, N,
+        *images, block=0)
+
+def test_regions():
+
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  for flow, images in ((VanillaFlow(i1.shape), (i1, i2)),
+      (Flow(i1.shape), (i1, i2, i3))):
+
+    u, v = flow.estimate(alpha, N, *images)
+
+    # a region covering the image gives the same results as estimate()
+    u0 = numpy.zeros(i1.shape, 'float64')
+    v0 = numpy.zeros(i1.shape, 'float64')
+    flow.estimate_regions(alpha, N, *(images + (u0, v0)),
+        regions=[(0, 0) + i1.shape], halo=0)
+    assert numpy.array_equal(u0, u)
+    assert numpy.array_equal(v0, v)
+
+    # the flow outside of the regions grown by the halo is kept
+    u0 = numpy.ones(i1.shape, 'float64')
+    v0 = numpy.ones(i1.shape, 'float64')
+    ru, rv = flow.estimate_regions(alpha, N, *(images + (u0, v0)),
+        regions=[(1, 1, 1, 1)], halo=1)
+    assert numpy.shares_memory(ru, u0)
+    assert numpy.all(u0[3:,:] == 1) and numpy.all(u0[:,3:] == 1)
+    assert numpy.all(v0[3:,:] == 1) and numpy.all(v0[:,3:] == 1)
+    assert numpy.any(u0[:3,:3] != 1)
+
+    # nothing changes between identical images
+    u0 = numpy.ones(i1.shape, 'float64')
+    v0 = numpy.ones(i1.shape, 'float64')
+    flow.estimate_regions(alpha, N, *((i1,) * len(images) + (u0, v0)))
+    assert numpy.all(u0 == 1) and numpy.all(v0 == 1)
+
+    nose.tools.assert_raises(ValueError, flow.estimate_regions, alpha, N,
+        *(images + (u0, v0)), halo=-1)
+    nose.tools.assert_raises(ValueError, flow.estimate_regions, alpha, N,
+        *(images + (u0, v0)), regions=[(0, 0, -1, 2)])
+    nose.tools.assert_raises(TypeError, flow.estimate_regions, alpha, N,
+        *(images + (u0, v0)), regions=[(0, 0, 2)])
+
+def test_changed_regions():
+
+  a = numpy.zeros((20, 20), 'float64')
+  b = a.copy()
+  b[3,5] = 1.
+  b[4,18] = 0.5
+  b[12,2] = 1.
+
+  assert changed_regions(a, a) == []
+  assert changed_regions(a, b, block=8) == [(0, 0, 16, 8), (0, 16, 8, 4)]
+  assert changed_regions(a, b, threshold=0.5, block=8) == [(0, 0, 16, 8)]
+  assert changed_regions(a, a, b, block=8) == changed_regions(a, b, block=8)
+  assert changed_regions(a, b, block=1) == [(3, 5, 1, 1), (4, 18, 1, 1),
+      (12, 2, 1, 1)]
+
+  nose.tools.assert_raises(ValueError, changed_regions, a, b, threshold=-1.)
+  nose.tools.assert_raises(ValueError, changed_regions, a, b, block=0)
+
+def test_many():
+
+  # Flows of many jobs must match those of estimate(), in the given order
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+  numpy.random.seed(0)
+  frames = numpy.random.rand(3, 8, 5)
+
+  flow = Flow(i1.shape)
+  vanilla = VanillaFlow(i1.shape)
+  other = Flow(frames.shape[1:])
+  expected = [
+      flow.estimate(alpha, N, i1, i2, i3),
+      vanilla.estimate(alpha, N, i1, i2),
+      other.estimate(alpha, N, *frames),
+      flow.estimate(alpha, N, i2, i3, i1),
+      ]
+
+  for threads in (1, 2, 0):
+    u0 = numpy.zeros(i1.shape, 'float64')
+    v0 = numpy.zeros(i1.shape, 'float64')
+    flows = estimate_many(alpha, N, [
+      (flow, (i1, i2, i3)),
+      (vanilla, [i1, i2]),
+      (other, frames),
+      (flow, (i2, i3, i1), u0, v0),
+      ], threads=threads)
+    assert len(flows) == len(expected)
+    for (u, v), (u_ref, v_ref) in zip(flows, expected):
+      assert numpy.array_equal(u, u_ref)
+      assert numpy.array_equal(v, v_ref)
+    assert numpy.array_equal(u0, expected[3][0])
+    assert numpy.array_equal(v0, expected[3][1])
+
+  assert estimate_many(alpha, N, []) == []
+  nose.tools.assert_raises(ValueError, estimate_many, alpha, N,
+      [(flow, (i1, i2))])
+  nose.tools.assert_raises(TypeError, estimate_many, alpha, N,
+      [(HornAndSchunckGradient(i1.shape), (i1, i2))])
+  nose.tools.assert_raises(RuntimeError, estimate_many, alpha, N,
+      [(other, (i1, i2, i3))])
+
+def test_many_tiles():
+
+  # Tiles with halos of at least as many pixels as iterations give the same
+  # flows as whole images, whatever the tile size and number of threads
+  N = 20
+  alpha = 1.5
+  numpy.random.seed(0)
+  i1, i2, i3 = 255 * numpy.random.rand(3, 40, 33)
+  frames = numpy.random.rand(3, 8, 5)
+
+  flow = Flow(i1.shape)
+  vanilla = VanillaFlow(i1.shape)
+  other = Flow(frames.shape[1:])
+  u_init = numpy.random.rand(*i1.shape)
+  v_init = numpy.random.rand(*i1.shape)
+  expected = [
+      flow.estimate(alpha, N, i1, i2, i3),
+      vanilla.estimate(alpha, N, i1, i2),
+      other.estimate(alpha, N, *frames),
+      flow.estimate(alpha, N, i2, i3, i1, u_init.copy(), v_init.copy()),
+      ]
+
+  for tile, halo, threads in ((7, None, 1), (7, N, 2), (16, N+5, 0),
+      (40, 0, 2)):
+    u0 = u_init.copy()
+    v0 = v_init.copy()
+    flows = estimate_many(alpha, N, [
+      (flow, (i1, i2, i3)),
+      (vanilla, [i1, i2]),
+      (other, frames),
+      (flow, (i2, i3, i1), u0, v0),
+      ], threads=threads, tile=tile, halo=halo)
+    for (u, v), (u_ref, v_ref) in zip(flows, expected):
+      assert numpy.array_equal(u, u_ref)
+      assert numpy.array_equal(v, v_ref)
+    assert numpy.array_equal(u0, expected[3][0])
+    assert numpy.array_equal(v0, expected[3][1])
+
+  # smaller halos change the flow near tile edges, less as they grow
+  u, v = estimate_many(alpha, N, [(flow, (i1, i2, i3))], tile=7, halo=0)[0]
+  assert not numpy.array_equal(u, expected[0][0])
+  u, v = estimate_many(alpha, N, [(flow, (i1, i2, i3))], tile=7, halo=N-2)[0]
+  assert numpy.allclose(u, expected[0][0], atol=1e-6)
+  assert numpy.allclose(v, expected[0][1], atol=1e-6)
+
+  nose.tools.assert_raises(ValueError, estimate_many, alpha, N,
+      [(flow, (i1, i2, i3))], tile=-1)
+  nose.tools.assert_raises(ValueError, estimate_many, alpha, N,
+      [(flow, (i1, i2, i3))], tile=7, halo=-1)
+
+def test_solver():
+
+  # Policy combinations of the classic solvers must reproduce them exactly
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  vanilla = Solver(i1.shape, 'hs', 'hs')
+  assert vanilla.frames == 2
+  assert vanilla.gradient == 'hs'
+  assert vanilla.laplacian == 'hs'
+  u, v = vanilla.estimate(alpha, N, (i1, i2))
+  u_ref, v_ref = VanillaFlow(i1.shape).estimate(alpha, N, i1, i2)
+  assert numpy.array_equal(u, u_ref)
+  assert numpy.array_equal(v, v_ref)
+  assert numpy.array_equal(vanilla.eval_eb((i1, i2), u, v),
+      VanillaFlow(i1.shape).eval_eb(i1, i2, u, v))
+
+  flow = Solver(i1.shape)
+  assert flow.frames == 3
+  assert flow.gradient == 'sobel'
+  assert flow.laplacian == 'opencv'
+  u, v = flow(alpha, N, (i1, i2, i3))
+  u_ref, v_ref = Flow(i1.shape).estimate(alpha, N, i1, i2, i3)
+  assert numpy.array_equal(u, u_ref)
+  assert numpy.array_equal(v, v_ref)
+  assert numpy.array_equal(flow.eval_ec2(u, v),
+      Flow(i1.shape).eval_ec2(u, v))
+
+  # Other combinations run as well, also within estimate_many()
+  for gradient in ('prewitt', 'isotropic'):
+    for laplacian in ('hs', 'opencv'):
+      solver = Solver(i1.shape, gradient, laplacian)
+      u, v = solver.estimate(alpha, N, (i1, i2, i3))
+      assert numpy.all(numpy.isfinite(u))
+      assert numpy.all(numpy.isfinite(v))
+      (u_many, v_many), = estimate_many(alpha, N, [(solver, (i1, i2, i3))])
+      assert numpy.array_equal(u_many, u)
+      assert numpy.array_equal(v_many, v)
+
+  nose.tools.assert_raises(ValueError, flow.estimate, alpha, N, (i1, i2))
+  nose.tools.assert_raises(ValueError, vanilla.estimate, alpha, N,
+      (i1, i2, i3))
+  nose.tools.assert_raises(ValueError, Solver, i1.shape, 'roberts')
+  nose.tools.assert_raises(ValueError, Solver, i1.shape, 'sobel', 'box')
+
+def test_solver_methods():
+
+  # Flow and VanillaFlow are solvers taking their images one by one
+  N = 10
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  for cls, images in ((Flow, (i1, i2, i3)), (VanillaFlow, (i1, i2))):
+    fixed = cls(i1.shape)
+    assert isinstance(fixed, Solver)
+    assert repr(fixed).endswith('%s(%s)>' % (cls.__name__, i1.shape))
+    solver = Solver(i1.shape, fixed.gradient, fixed.laplacian)
+
+    for method, kwargs in (('estimate', {}),
+        ('estimate_convergence', dict(block=4)),
+        ('estimate_statistics', dict(tile=4)),
+        ('estimate_hoof', dict(cell=4)),
+        ('estimate_mask', dict(threshold=0.01)),
+        ('estimate_blocks', dict(block=4))):
+      a = getattr(fixed, method)(alpha, N, *images, **kwargs)
+      b = getattr(solver, method)(alpha, N, images, **kwargs)
+      for x, y in zip(a, b):
+        if isinstance(x, dict):
+          for key in x: assert numpy.array_equal(x[key], y[key])
+        else: assert numpy.array_equal(x, y)
+
+    names = dict(('image%d' % (k+1), image) for k, image in enumerate(images))
+    u, v = fixed.estimate(alpha=alpha, iterations=N, **names)
+    assert numpy.array_equal(u, solver.estimate(alpha, N, images=images)[0])
+    u, v = fixed.estimate_regions(alpha, N, *images, u=u.copy(), v=v.copy())
+    u_ref, v_ref = solver.estimate(alpha, N, images)
+    u_ref, v_ref = solver.estimate_regions(alpha, N, images, u_ref, v_ref)
+    assert numpy.array_equal(u, u_ref)
+    assert numpy.array_equal(fixed.eval_eb(*(images + (u, v))),
+        solver.eval_eb(images, u, v))
+
+    nose.tools.assert_raises(TypeError, fixed.estimate, alpha, N, images)
+    nose.tools.assert_raises(TypeError, fixed.estimate, alpha, N,
+        *images, image1=i1)
+    nose.tools.assert_raises(TypeError, solver.estimate, alpha, N)
+    nose.tools.assert_raises(ValueError, solver.estimate, alpha, -1, images)
+
+def test_block_matching():
+
+  # Displacements of whole downsampled pixels are found exactly
+  numpy.random.seed(0)
+  scene = numpy.random.rand(140, 180)
+  i1 = scene[20:120,20:150]
+  i2 = scene[12:112,28:158] #i1(y,x) moves to i2(y+8,x-8)
+  i3 = scene[4:104,36:166]
+
+  u, v = block_matching(i1, i2)
+  assert u.shape == i1.shape
+  assert v.shape == i1.shape
+  assert numpy.all(u[32:-32,32:-32] == -8)
+  assert numpy.all(v[32:-32,32:-32] == 8)
+
+  # With 3 images, the flow is per frame
+  u3, v3 = block_matching(i1, i2, i3, radius=8)
+  assert numpy.all(u3[32:-32,32:-32] == -8)
+  assert numpy.all(v3[32:-32,32:-32] == 8)
+
+  # Without motion, and with a radius of 0, there is no displacement
+  u, v = block_matching(i1, i1.copy(), block=4, scale=2)
+  assert numpy.all(u == 0)
+  assert numpy.all(v == 0)
+  u, v = block_matching(i1, i2, radius=0)
+  assert numpy.all(u == 0)
+  assert numpy.all(v == 0)
+
+  # The result initializes the solvers
+  u, v = block_matching(i1, i2, i3, radius=8)
+  Flow(i1.shape).estimate(1.5, 5, i1, i2, i3, u, v)
+  assert numpy.all(numpy.isfinite(u))
+
+  nose.tools.assert_raises(ValueError, block_matching, i1, i2, radius=-1)
+  nose.tools.assert_raises(ValueError, block_matching, i1, i2, block=0)
+  nose.tools.assert_raises(ValueError, block_matching, i1, i2, scale=0)
+  nose.tools.assert_raises(RuntimeError, block_matching, i1, i2[1:])
+
+def test_reproducible():
+
+  # All estimation paths, run from any number of threads, must return
+  # bit-identical flows
+  N = 20
+  alpha = 1.5
+  i1, i2, i3 = make_image_tripplet()
+
+  for make, images in ((VanillaFlow, (i1, i2)), (Flow, (i1, i2, i3))):
+
+    u_ref, v_ref = make(i1.shape).estimate(alpha, N, *images)
+
+    flow = make(i1.shape)
+    results = [
+        flow.estimate(alpha, N, *images),
+        flow.estimate_convergence(alpha, N, *images)[:2],
+        flow.estimate_statistics(alpha, N, *images)[:2],
+        ]
+    for method, kwargs in ((flow.estimate_mask, {}),
+        (flow.estimate_blocks, {'reduction': 'median'})):
+      u = numpy.zeros(i1.shape, 'float64')
+      v = numpy.zeros(i1.shape, 'float64')
+      method(alpha, N, *(images + (u, v)), **kwargs)
+      results.append((u, v))
+
+    def run():
+      results.append(make(i1.shape).estimate(alpha, N, *images))
+    threads = [threading.Thread(target=run) for k in range(4)]
+    for t in threads: t.start()
+    for t in threads: t.join()
+
+    assert len(results) == 9
+    for u, v in results:
+      assert numpy.array_equal(u, u_ref)
+      assert numpy.array_equal(v, v_ref)
+
+def test_reproducible_threads():
+
+  # Kernels sharing their work between threads return bit-identical results
+  # with one thread and with many
+  numpy.random.seed(5)
+  frames = numpy.random.rand(7, 150, 45) #several stripes of rows
+  shape = frames.shape[1:]
+  u = numpy.random.uniform(-5, 5, shape)
+  v = numpy.random.uniform(-5, 5, shape)
+  labels = numpy.random.randint(-1, 7, shape).astype('int32')
+
+  for grad in (HornAndSchunckGradient(shape), SobelGradient(shape)):
+    reference = grad.evaluate_volume(frames, threads=1)
+    for threads in (2, 3, 0):
+      for g, r in zip(grad.evaluate_volume(frames, threads=threads),
+          reference):
+        assert numpy.array_equal(g, r)
+
+  for border in ('clamp', 'zero', 'mirror'):
+    reference = warp(frames[0], u, v, border=border, threads=1)
+    for threads in (2, 3, 0):
+      assert numpy.array_equal(warp(frames[0], u, v, border=border,
+        threads=threads), reference), border
+
+  for compute in (lambda t: label_statistics(u, v, labels, threads=t),
+      lambda t: hoof(u, v, threads=t)):
+    reference = compute(1)
+    for threads in (2, 3, 0):
+      other = compute(threads)
+      for key in reference:
+        assert numpy.array_equal(other[key], reference[key]), key
+
+  alpha, N = 1.5, 10
+  jobs = [(Flow(shape), frames[k:k+3]) for k in range(3)] + \
+      [(VanillaFlow(shape), frames[k:k+2]) for k in range(3)]
+  reference = estimate_many(alpha, N, jobs, threads=1)
+  for (solver, images), (u_ref, v_ref) in zip(jobs, reference):
+    u, v = type(solver)(shape).estimate(alpha, N, *images)
+    assert numpy.array_equal(u, u_ref)
+    assert numpy.array_equal(v, v_ref)
+  for threads in (2, 3, 0):
+    for (u, v), (u_ref, v_ref) in zip(estimate_many(alpha, N, jobs,
+        threads=threads), reference):
+      assert numpy.array_equal(u, u_ref)
+      assert numpy.array_equal(v, v_ref)
+
+def test_shared():
+
+  # A solver running in another thread refuses concurrent calls, instead of
+  # sharing its buffers, until it is done
+  numpy.random.seed(0)
+  frames = numpy.random.rand(3, 256, 256)
+  u_ref, v_ref = Flow(frames.shape[1:]).estimate(200., 1, *frames)
+
+  for flow in (Flow(frames.shape[1:]), Solver(frames.shape[1:])):
+
+    results = []
+    def run():
+      while not results: #until no other call holds the solver
+        try:
+          results.append(estimate_many(200., 2000, [(flow, frames)]))
+        except RuntimeError:
+          pass
+    worker = threading.Thread(target=run)
+    worker.start()
+
+    attempts = [lambda: setattr(flow, 'shape', frames.shape[1:]),
+        lambda: setattr(flow, 'sigma', 0.),
+        lambda: estimate_many(200., 1, [(flow, frames)]),
+        lambda: flow.eval_ec2(u_ref, v_ref)]
+    refused = set()
+    while worker.is_alive() and len(refused) < len(attempts):
+      for k, attempt in enumerate(attempts):
+        try:
+          attempt()
+        except RuntimeError as e:
+          assert 'in use by another thread' in str(e)
+          refused.add(k)
+    worker.join()
+    assert refused == set(range(len(attempts)))
+
+    # usable again, once the other thread is done
+    u, v = estimate_many(200., 1, [(flow, frames)])[0]
+    assert numpy.array_equal(u, u_ref)
+    assert numpy.array_equal(v, v_ref)
+
 #TODO: When enabaling this test, import bob.io.base and bob.io.image
 #TODO: This includes making this package dependent on bob.io.base and bob.io.image
 @nose.tools.nottest
@@ -11,7 +11,9 @@
 
 import numpy
 import scipy.signal
-from . import HornAndSchunckGradient, SobelGradient
+import nose.tools
+from . import HornAndSchunckGradient, SobelGradient, PrewittGradient, Flow, \
+    Solver, recursive_gaussian, integer_gradient
 
 def make_image_pair_1():
   """Creates two images for you to calculate the flow
@@ -212,3 +214,176 @@ def test_SobelCxxAgainstPythonSynthetic():
   assert numpy.array_equal(ex_cxx, ex_python)
   assert numpy.array_equal(ey_cxx, ey_python)
   assert numpy.array_equal(et_cxx, et_python)
+
+def test_volume():
+
+  # Gradients over a stack must match those of every pair or triplet
+  numpy.random.seed(0)
+  frames = numpy.random.rand(9, 6, 7)
+
+  for grad, n in ((HornAndSchunckGradient(frames.shape[1:]), 2),
+      (SobelGradient(frames.shape[1:]), 3)):
+
+    expected = [grad(*frames[k:k+n]) for k in range(len(frames) - n + 1)]
+
+    for threads in (1, 3, 0):
+      ex, ey, et = grad.evaluate_volume(frames, threads=threads)
+      assert ex.shape == (len(frames) - n + 1,) + frames.shape[1:]
+      for k, (ex_k, ey_k, et_k) in enumerate(expected):
+        assert numpy.array_equal(ex[k], ex_k)
+        assert numpy.array_equal(ey[k], ey_k)
+        assert numpy.array_equal(et[k], et_k)
+
+    # as many chunks as gradients
+    ex, ey, et = grad.evaluate_volume(frames[:n+1], threads=8)
+    assert numpy.array_equal(ex[1], expected[1][0])
+
+def test_channels():
+
+  # Channels evaluated alone must match those of a full evaluation
+  numpy.random.seed(0)
+  frames = numpy.random.rand(3, 6, 7)
+
+  for grad, images in ((HornAndSchunckGradient(frames.shape[1:]), frames[:2]),
+      (SobelGradient(frames.shape[1:]), frames)):
+
+    ex, ey, et = grad.evaluate(*images)
+
+    et_, = grad.evaluate_channels(*images, channels='t')
+    assert numpy.array_equal(et_, et)
+
+    ey_, ex_ = grad.evaluate_channels(*images, channels='yx')
+    assert numpy.array_equal(ex_, ex)
+    assert numpy.array_equal(ey_, ey)
+
+    grad.sigma = 1.
+    ex, ey, et = grad.evaluate(*images)
+    for k, g in zip('xyt', grad.evaluate_channels(*images, channels='xyt')):
+      assert numpy.array_equal(g, {'x': ex, 'y': ey, 't': et}[k])
+
+    for channels in ('', 'xx', 'z'):
+      nose.tools.assert_raises(ValueError, grad.evaluate_channels, *images,
+          channels=channels)
+
+def test_recursive_gaussian():
+
+  # constant images are preserved
+  image = 3 * numpy.ones((10, 12), 'float64')
+  assert numpy.allclose(recursive_gaussian(image, 2.), image)
+
+  # impulses approximate a sampled Gaussian, to a few percent of its peak
+  for sigma in (0.5, 1., 3., 10.):
+    image = numpy.zeros((121, 121), 'float64')
+    image[60, 60] = 1.
+    smoothed = recursive_gaussian(image, sigma)
+    x = numpy.arange(-60, 61)
+    g = numpy.exp(-x**2 / (2. * sigma**2))
+    g = numpy.outer(g, g) / g.sum()**2
+    assert abs(smoothed - g).max() < 0.2 * g.max()
+    assert numpy.allclose(smoothed.sum(), 1., atol=1e-2)
+
+  nose.tools.assert_raises(ValueError, recursive_gaussian, image, 0.4)
+
+def test_smoothing():
+
+  # Smoothing gradients is the same as differentiating smoothed images
+  numpy.random.seed(0)
+  frames = numpy.random.rand(5, 6, 7)
+  sigma = 1.5
+  smoothed = numpy.array([recursive_gaussian(f, sigma) for f in frames])
+
+  for make, n in ((HornAndSchunckGradient, 2), (SobelGradient, 3)):
+    plain = make(frames.shape[1:])
+    grad = make(frames.shape[1:])
+    assert grad.sigma == 0.
+    grad.sigma = sigma
+    assert grad.sigma == sigma
+
+    for g, e in zip(grad(*frames[:n]), plain(*smoothed[:n])):
+      assert numpy.array_equal(g, e)
+
+    for g, e in zip(grad.evaluate_volume(frames, threads=2),
+        plain.evaluate_volume(smoothed)):
+      assert numpy.array_equal(g, e)
+
+    # the gradient shape can be changed while smoothing
+    grad.shape = (4, 4)
+    plain.shape = (4, 4)
+    for g, e in zip(grad(*frames[:n,:4,:4]),
+        plain(*[recursive_gaussian(f, sigma) for f in frames[:n,:4,:4]])):
+      assert numpy.array_equal(g, e)
+
+    with nose.tools.assert_raises(ValueError):
+      grad.sigma = 0.2
+    grad.sigma = 0.
+
+  # the flow estimators forward it to their gradient
+  flow = Flow(frames.shape[1:])
+  flow.sigma = sigma
+  u, v = flow.estimate(200, 10, *frames[:3])
+  u_ref, v_ref = Flow(frames.shape[1:]).estimate(200, 10, *smoothed[:3])
+  assert numpy.array_equal(u, u_ref)
+  assert numpy.array_equal(v, v_ref)
+
+
+def test_integer_gradient():
+
+  # Integer gradients are exactly those of the floating-point operators,
+  # scaled, including on the borders and at the extremes of 8-bit values
+  numpy.random.seed(0)
+  frames = numpy.random.randint(0, 256, (3, 9, 11)).astype('uint8')
+  corner = numpy.zeros((3, 9, 11), 'uint8')
+  corner[:,4:,6:] = 255 #largest spatial gradients
+  flash = numpy.zeros((3, 9, 11), 'uint8')
+  flash[1:] = 255 #largest temporal gradients
+
+  for images in (frames, corner, flash, frames[:,:1,:], frames[:,:,:1]):
+    for kernel, make, n in (('hs', HornAndSchunckGradient, 2),
+        ('sobel', SobelGradient, 3), ('prewitt', PrewittGradient, 3)):
+      ex, ey, et, scale = integer_gradient(*images[:n], kernel=kernel)
+      assert ex.dtype == ey.dtype == et.dtype == numpy.int16
+      assert scale == (0.25 if kernel == 'hs' else 1.)
+      expected = make(images.shape[1:])(*images[:n].astype('float64'))
+      for g, e in zip((ex, ey, et), expected):
+        assert numpy.array_equal(scale * g, e)
+
+  # kernels default on the number of images
+  for n, make in ((2, HornAndSchunckGradient), (3, SobelGradient)):
+    ex, ey, et, scale = integer_gradient(*frames[:n])
+    expected = make(frames.shape[1:])(*frames[:n].astype('float64'))
+    assert numpy.array_equal(scale * et, expected[2])
+
+  nose.tools.assert_raises(TypeError, integer_gradient, *frames[:2].astype('float64'))
+  nose.tools.assert_raises(ValueError, integer_gradient, *frames[:2], kernel='sobel')
+  nose.tools.assert_raises(ValueError, integer_gradient, *frames, kernel='hs')
+  nose.tools.assert_raises(ValueError, integer_gradient, *frames, kernel='isotropic')
+  nose.tools.assert_raises(RuntimeError, integer_gradient, frames[0], frames[1,:8])
+
+def test_estimate_gradients():
+
+  # Solvers estimate the same flow from integer gradients, their scale being
+  # folded into alpha
+  numpy.random.seed(1)
+  frames = numpy.random.randint(0, 256, (3, 12, 14)).astype('uint8')
+  images = frames.astype('float64')
+
+  for gradient, n in (('hs', 2), ('sobel', 3), ('prewitt', 3)):
+    solver = Solver(images.shape[1:], gradient, 'hs')
+    ex, ey, et, scale = integer_gradient(*frames[:n], kernel=gradient)
+    u_ref, v_ref = solver.estimate(200., 20, images[:n])
+    u, v = solver.estimate_gradients(200., 20, ex, ey, et, scale)
+    assert numpy.allclose(u, u_ref, rtol=1e-9, atol=1e-12)
+    assert numpy.allclose(v, v_ref, rtol=1e-9, atol=1e-12)
+
+    # updates initial estimates in place
+    u0, v0 = numpy.zeros_like(u), numpy.zeros_like(v)
+    solver.estimate_gradients(200., 20, ex, ey, et, scale, u0, v0)
+    assert numpy.array_equal(u0, u)
+    assert numpy.array_equal(v0, v)
+
+  nose.tools.assert_raises(ValueError, solver.estimate_gradients, 200., 20,
+      ex, ey, et, 0.)
+  nose.tools.assert_raises(TypeError, solver.estimate_gradients, 200., 20,
+      ex.astype('float64'), ey, et)
+  nose.tools.assert_raises(RuntimeError, solver.estimate_gradients, 200., 20,
+      ex[:8], ey[:8], et[:8])
@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:23:31 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests inputs given through DLPack and the buffer protocol
+"""
+
+import numpy
+import nose.tools
+from nose.plugins.skip import SkipTest
+
+from . import Flow, SobelGradient, laplacian_avg_hs
+from .test_flow import make_image_tripplet
+
+class Tensor(object):
+  """A minimal DLPack producer, wrapping a numpy array"""
+
+  def __init__(self, array, device=(1, 0)):
+    self.array = array
+    self.device = device
+
+  def __dlpack__(self, **kwargs):
+    return self.array.__dlpack__(**kwargs)
+
+  def __dlpack_device__(self):
+    return self.device
+
+def readonly(a):
+  a = a.copy()
+  a.setflags(write=False)
+  return a
+
+def test_buffer():
+
+  i1, i2, i3 = make_image_tripplet()
+  u_ref, v_ref = Flow(i1.shape).estimate(200, 20, i1, i2, i3)
+
+  views = [memoryview(readonly(k)) for k in (i1, i2, i3)]
+  u, v = Flow(i1.shape).estimate(200, 20, *views)
+  assert numpy.array_equal(u, u_ref)
+  assert numpy.array_equal(v, v_ref)
+
+  ex, ey, et = SobelGradient(i1.shape).evaluate(*views)
+  assert numpy.array_equal(ex, SobelGradient(i1.shape)(i1, i2, i3)[0])
+
+  assert numpy.array_equal(laplacian_avg_hs(views[0]), laplacian_avg_hs(i1))
+
+def test_dlpack():
+
+  if not hasattr(numpy, 'from_dlpack'):
+    raise SkipTest("numpy does not support DLPack")
+
+  i1, i2, i3 = make_image_tripplet()
+  u_ref, v_ref = Flow(i1.shape).estimate(200, 20, i1, i2, i3)
+
+  tensors = [Tensor(k.copy()) for k in (i1, i2, i3)]
+  u, v = Flow(i1.shape).estimate(200, 20, *tensors)
+  assert numpy.array_equal(u, u_ref)
+  assert numpy.array_equal(v, v_ref)
+
+  assert numpy.array_equal(laplacian_avg_hs(tensors[0]),
+      laplacian_avg_hs(i1))
+
+  # outputs are exported without a copy
+  exported = numpy.from_dlpack(u)
+  assert numpy.shares_memory(exported, u)
+
+  # memory on other devices is refused
+  gpu = Tensor(i1, device=(2, 0))
+  nose.tools.assert_raises(TypeError, laplacian_avg_hs, gpu)
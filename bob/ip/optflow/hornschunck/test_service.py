@@ -0,0 +1,268 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 13:58:26 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests the shared-memory flow service against the local estimators
+"""
+
+import os
+import json
+import collections
+import socket
+import stat
+import uuid
+import tempfile
+import threading
+import numpy
+import nose.tools
+
+from . import Flow, VanillaFlow
+from . import service
+from .service import Server, Client, SharedFrames, _solver
+from .test_flow import make_image_tripplet
+
+def test_service():
+
+  path = os.path.join(tempfile.mkdtemp(), 'optflow.sock')
+  server = Server(path, threads=2)
+  server.start()
+
+  i1, i2, i3 = make_image_tripplet()
+  u_ref, v_ref = Flow(i1.shape).estimate(200, 20, i1, i2, i3)
+  uv_ref, vv_ref = VanillaFlow(i1.shape).estimate(200, 20, i1, i2)
+
+  errors = []
+  def run():
+    client = Client(path)
+    try:
+      for k in range(4):
+        u, v = client.estimate('flow', 200, 20, [i1, i2, i3])
+        if not (numpy.array_equal(u, u_ref) and numpy.array_equal(v, v_ref)):
+          errors.append('flow')
+        u = numpy.zeros(i1.shape, 'float64')
+        v = numpy.zeros(i1.shape, 'float64')
+        client.estimate('vanilla', 200, 20, [i1, i2], u, v)
+        if not (numpy.array_equal(u, uv_ref) and numpy.array_equal(v, vv_ref)):
+          errors.append('vanilla')
+    finally:
+      client.close()
+
+  try:
+    clients = [threading.Thread(target=run) for k in range(4)]
+    for c in clients: c.start()
+    for c in clients: c.join()
+  finally:
+    server.stop()
+
+  assert not errors, errors
+  assert not os.path.exists(path)
+
+def test_segment_names():
+
+  # the server only maps segments of its own, under /dev/shm
+  directory = tempfile.mkdtemp()
+  victim = os.path.join(directory, 'victim')
+  with open(victim, 'wb') as f: f.write(b'\x01' * (5 * 4 * 4 * 8))
+
+  path = os.path.join(directory, 'optflow.sock')
+  server = Server(path)
+  server.start()
+  try:
+    connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    connection.connect(path)
+    stream = connection.makefile('r')
+    names = ['..' + victim, 'bob-optflow-' + '/..' * 8 + victim,
+        'bob-optflow-x\0', 'victim']
+    for k, name in enumerate(names):
+      request = {'id': k, 'method': 'flow', 'alpha': 200, 'iterations': 1,
+          'shape': [4, 4], 'segment': name}
+      connection.sendall((json.dumps(request) + '\n').encode('utf-8'))
+      answer = json.loads(stream.readline())
+      assert answer['id'] == k
+      assert answer['status'] == 'error'
+      assert 'segment name' in answer['message']
+    stream.close()
+    connection.close()
+  finally:
+    server.stop()
+
+  with open(victim, 'rb') as f: assert f.read() == b'\x01' * (5 * 4 * 4 * 8)
+
+  for name in ('../x', 'bob-optflow-../x', 'other'):
+    nose.tools.assert_raises(ValueError, SharedFrames, name, 3, (4, 4))
+
+def test_batches():
+
+  # requests of the same method and shape reach a worker together, split in
+  # at most one batch per worker
+  server = Server('unused.sock', threads=2, window=1.)
+  shapes = [(4, 4)] * 5 + [(8, 8)]
+  for k, shape in enumerate(shapes):
+    request = {'id': k, 'method': 'flow', 'shape': shape}
+    server.requests.put((None, None, request, 0))
+  server.requests.put(None)
+  server._dispatch()
+
+  batches = []
+  while not server.work.empty(): batches.append(server.work.get())
+  assert server.batches == len(batches) == 3
+  ids = sorted([r[2]['id'] for r in batch] for key, batch in batches)
+  assert ids == [[0, 1, 2], [3, 4], [5]]
+  for key, batch in batches:
+    assert all(r[2]['shape'] == key[1] for r in batch)
+
+def test_solver_cache():
+
+  # workers keep the most recently used solvers only
+  solvers = collections.OrderedDict()
+  first = _solver(solvers, ('flow', (4, 4)), 2)
+  assert _solver(solvers, ('flow', (4, 4)), 2) is first
+  _solver(solvers, ('vanilla', (4, 4)), 2)
+  assert _solver(solvers, ('flow', (4, 4)), 2) is first
+  _solver(solvers, ('flow', (8, 8)), 2)
+  assert list(solvers) == [('flow', (4, 4)), ('flow', (8, 8))]
+  assert _solver(solvers, ('vanilla', (4, 4)), 2) is not None
+  assert list(solvers) == [('flow', (8, 8)), ('vanilla', (4, 4))]
+  assert _solver(solvers, ('flow', (4, 4)), 2) is not first
+
+  nose.tools.assert_raises(ValueError, Server, 'unused.sock', 1, 0.002, 0)
+
+def _send(path, lines):
+  """Sends raw request lines on a new connection, returning the answers"""
+
+  connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+  connection.connect(path)
+  stream = connection.makefile('r')
+  try:
+    connection.sendall(''.join(k + '\n' for k in lines).encode('utf-8'))
+    return [json.loads(stream.readline()) for k in lines]
+  finally:
+    stream.close()
+    connection.close()
+
+def test_requests():
+
+  # malformed requests are refused before anything is mapped or allocated
+  path = os.path.join(tempfile.mkdtemp(), 'optflow.sock')
+  server = Server(path, max_pixels=64)
+  server.start()
+  try:
+    valid = {'method': 'flow', 'alpha': 200, 'iterations': 1,
+        'shape': [4, 4], 'segment': 'bob-optflow-missing'}
+    invalid = [
+        ('shape', [4]), ('shape', [4, 4, 1]), ('shape', [0, 4]),
+        ('shape', [-4, 4]), ('shape', [4.5, 4]), ('shape', [True, 4]),
+        ('shape', '44'), ('shape', [8, 16]),
+        ('iterations', -1), ('iterations', 1.5), ('iterations', '1'),
+        ('iterations', None), ('alpha', '200'), ('alpha', None),
+        ('alpha', False), ('alpha', [200]), ('method', 'other'),
+        ]
+    lines = []
+    for k, (key, value) in enumerate(invalid):
+      request = dict(valid, id=k)
+      request[key] = value
+      lines.append(json.dumps(request))
+    lines.append(json.dumps(dict(valid, id='nan', alpha=float('nan'))))
+    for k, answer in enumerate(_send(path, lines)):
+      assert answer['status'] == 'error', (k, answer)
+      assert answer['id'] == (k if k < len(invalid) else 'nan'), answer
+      if k < len(invalid):
+        assert invalid[k][0] in answer['message'], answer
+
+    # non-objects and broken JSON get an answer without an id
+    for line in ('[1, 2]', '{"id": 3,'):
+      answer = _send(path, [line])[0]
+      assert answer['id'] is None and answer['status'] == 'error', answer
+
+    # a valid request goes through to the worker, which can't find its data
+    answer = _send(path, [json.dumps(dict(valid, id=0))])[0]
+    assert answer['id'] == 0 and answer['status'] == 'error'
+    assert 'should' not in answer['message'], answer
+  finally:
+    server.stop()
+
+  nose.tools.assert_raises(ValueError, Server, 'unused.sock', 1, 0.002, 4,
+      None, 0)
+
+def test_socket():
+
+  directory = tempfile.mkdtemp()
+  path = os.path.join(directory, 'optflow.sock')
+
+  # only the user running the server may connect
+  server = Server(path)
+  server.start()
+  try:
+    mode = os.lstat(path).st_mode
+    assert stat.S_ISSOCK(mode)
+    assert stat.S_IMODE(mode) == 0o600, oct(stat.S_IMODE(mode))
+  finally:
+    server.stop()
+
+  # unless a group is given
+  server = Server(path, group=os.getgid())
+  server.start()
+  try:
+    assert stat.S_IMODE(os.lstat(path).st_mode) == 0o660
+    assert os.lstat(path).st_gid == os.getgid()
+  finally:
+    server.stop()
+  assert not os.path.lexists(path)
+
+  # files that are not sockets are never removed
+  with open(path, 'wt') as f: f.write('data')
+  nose.tools.assert_raises(RuntimeError, Server(path).start)
+  with open(path, 'rt') as f: assert f.read() == 'data'
+  os.unlink(path)
+  os.symlink(os.path.join(directory, 'target'), path)
+  nose.tools.assert_raises(RuntimeError, Server(path).start)
+  assert os.path.islink(path)
+
+def test_estimate_many():
+
+  # batched requests are solved with a single call per alpha and iterations
+  calls = []
+  original = service.estimate_many
+  def estimate_many(alpha, iterations, jobs, threads=0):
+    calls.append((alpha, iterations, len(jobs)))
+    return original(alpha, iterations, jobs, threads)
+
+  i1, i2, i3 = make_image_tripplet()
+  references = {}
+  for iterations in (10, 20):
+    references[iterations] = Flow(i1.shape).estimate(200, iterations, i1, i2, i3)
+
+  path = os.path.join(tempfile.mkdtemp(), 'optflow.sock')
+  server = Server(path, threads=1, window=1.)
+  segments = []
+  service.estimate_many = estimate_many
+  server.start()
+  try:
+    lines = []
+    for k, iterations in enumerate((20, 20, 10, 20)):
+      name = '%s%d-%s' % (service.SEGMENT_PREFIX, os.getpid(), uuid.uuid4().hex)
+      segment = SharedFrames(name, 3, i1.shape, create=True)
+      segments.append((segment, iterations))
+      for frame, image in zip(segment.frames, (i1, i2, i3)): frame[:] = image
+      segment.u.fill(1.) #ignored, not an initial estimate
+      lines.append(json.dumps({'id': k, 'method': 'flow', 'alpha': 200,
+        'iterations': iterations, 'shape': list(i1.shape),
+        'segment': name}))
+    answers = _send(path, lines)
+  finally:
+    server.stop()
+    service.estimate_many = original
+
+  try:
+    assert [a['id'] for a in answers] == [0, 1, 2, 3]
+    assert all(a['status'] == 'ok' for a in answers), answers
+    assert sorted(calls) == [(200, 10, 1), (200, 20, 3)], calls
+    for segment, iterations in segments:
+      u_ref, v_ref = references[iterations]
+      assert numpy.array_equal(segment.u, u_ref)
+      assert numpy.array_equal(segment.v, v_ref)
+  finally:
+    for segment, iterations in segments: segment.close()
@@ -0,0 +1,112 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:53:32 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests the generation of synthetic sequences with exact ground-truth flow
+"""
+
+import numpy
+import nose.tools
+
+from . import synthetic_sequence, Flow
+
+def test_translation():
+
+  images, u, v = synthetic_sequence((30, 40), 4, translation=(2., -1.))
+  assert images.shape == (4, 30, 40)
+  assert u.shape == v.shape == images.shape
+  assert images.min() >= 0 and images.max() <= 255
+  assert images.std() > 10 #textured
+  assert numpy.all(u == 2.)
+  assert numpy.all(v == -1.)
+
+  # pixel (y, x) of frame k is pixel (y-1, x+2) of frame k+1
+  for k in range(3):
+    assert numpy.array_equal(images[k+1][:-1,2:], images[k][1:,:-2])
+
+def test_rotation_zoom():
+
+  shape = (31, 41)
+  rotation, zoom = 0.05, 1.02
+  images, u, v = synthetic_sequence(shape, 3, translation=(0.5, 0.),
+      rotation=rotation, zoom=zoom)
+
+  y, x = numpy.mgrid[:shape[0], :shape[1]].astype('float64')
+  cy, cx = (shape[0] - 1) / 2., (shape[1] - 1) / 2.
+  c, s = numpy.cos(rotation), numpy.sin(rotation)
+  nx = cx + zoom*(c*(x-cx) - s*(y-cy)) + 0.5
+  ny = cy + zoom*(s*(x-cx) + c*(y-cy))
+  for k in range(3):
+    assert numpy.allclose(u[k], nx - x, rtol=0, atol=1e-12)
+    assert numpy.allclose(v[k], ny - y, rtol=0, atol=1e-12)
+  assert abs(u[0,15,20] - 0.5) < 1e-12 and abs(v[0,15,20]) < 1e-12
+
+  # frames differ, as the background moves
+  assert not numpy.allclose(images[0], images[1])
+
+def test_patches():
+
+  shape = (40, 50)
+  patches = [(10., 12., 4., 1., 2.), (30., 30., 5., -2., 0.)]
+  images, u, v = synthetic_sequence(shape, 2, patches=patches)
+
+  y, x = numpy.mgrid[:shape[0], :shape[1]]
+  first = (y-10)**2 + (x-12)**2 <= 16
+  second = (y-30)**2 + (x-30)**2 <= 25
+  assert numpy.all(u[0][first] == 1.) and numpy.all(v[0][first] == 2.)
+  assert numpy.all(u[0][second] == -2.) and numpy.all(v[0][second] == 0.)
+  static = ~(first | second)
+  assert numpy.all(u[0][static] == 0.) and numpy.all(v[0][static] == 0.)
+
+  # patches carry their texture along
+  for py, px in zip(*numpy.nonzero(first)):
+    assert images[1][py+2,px+1] == images[0][py,px]
+  for py, px in zip(*numpy.nonzero(second)):
+    assert images[1][py,px-2] == images[0][py,px]
+
+  # the static background is unchanged where patches were not
+  moved = numpy.zeros(shape, bool)
+  moved[2:,1:] |= first[:-2,:-1]
+  moved[:,:-2] |= second[:,2:]
+  unchanged = static & ~moved
+  assert numpy.array_equal(images[1][unchanged], images[0][unchanged])
+
+def test_reproducible():
+
+  shape = (70, 33)
+  patches = numpy.array([[20., 20., 6., 0.5, -0.25]])
+  args = dict(translation=(0.3, 0.7), rotation=0.01, zoom=0.99,
+      patches=patches)
+  reference = synthetic_sequence(shape, 5, **args)
+
+  # pieces of the sequence match the whole one, whatever the threads
+  for threads in (1, 4, 0):
+    piece = synthetic_sequence(shape, 2, first=3, threads=threads, **args)
+    for a, b in zip(piece, reference):
+      assert numpy.allclose(a, b[3:5], rtol=0, atol=1e-9)
+
+  other = synthetic_sequence(shape, 1, seed=1)[0]
+  assert not numpy.allclose(other[0], synthetic_sequence(shape, 1)[0][0])
+
+def test_accuracy():
+
+  # the solvers find the ground truth of a slow translation
+  images, u, v = synthetic_sequence((64, 64), 3, translation=(0.5, 0.25))
+  flow = Flow((64, 64))
+  eu, ev = flow.estimate(50., 200, images[0], images[1], images[2])
+  error = numpy.sqrt((eu - u[1])**2 + (ev - v[1])**2)[8:-8,8:-8]
+  assert error.mean() < 0.25 * numpy.sqrt(0.5**2 + 0.25**2)
+
+def test_errors():
+
+  nose.tools.assert_raises(ValueError, synthetic_sequence, (10, 10), 2,
+      zoom=0.)
+  nose.tools.assert_raises(ValueError, synthetic_sequence, (10, 10), 2,
+      patches=[(5., 5., -1., 0., 0.)])
+  nose.tools.assert_raises(ValueError, synthetic_sequence, (0, 10), 2)
+  nose.tools.assert_raises(ValueError, synthetic_sequence, (10, 10), -1)
+  nose.tools.assert_raises(TypeError, synthetic_sequence, (10, 10), 2,
+      patches=[(5., 5., 1.)])
@@ -0,0 +1,95 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:04:36 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests the export of Chrome trace events
+"""
+
+import json
+import threading
+import numpy
+
+from . import Flow, trace_enable, trace_enabled, trace_clear, trace_dump, \
+    trace_now, trace_record
+
+def names(trace):
+  return [k['name'] for k in json.loads(trace)['traceEvents'] if k['ph'] == 'X']
+
+def test_trace():
+
+  i1 = numpy.random.rand(10, 12)
+  i2 = numpy.random.rand(10, 12)
+  i3 = numpy.random.rand(10, 12)
+  flow = Flow(i1.shape)
+
+  trace_clear()
+  assert not trace_enabled()
+  flow.estimate(200, 3, i1, i2, i3)
+  assert names(trace_dump()) == [] #off by default
+
+  trace_enable()
+  try:
+    flow.estimate(200, 3, i1, i2, i3)
+    begin = trace_now()
+    trace_record('python span', begin, trace_now())
+  finally:
+    trace_enable(False)
+
+  trace = json.loads(trace_dump())
+  spans = names(trace_dump())
+  assert spans.count('iteration') == 3
+  for name in ('CentralGradient', 'Flow.estimate', 'python:Flow.estimate',
+      'python span'):
+    assert name in spans
+  assert trace['otherData']['dropped'] == 0
+  for event in trace['traceEvents']:
+    if event['ph'] == 'X': assert event['dur'] >= 0
+
+  trace_clear()
+  assert names(trace_dump()) == []
+
+def test_thread_buffers():
+
+  # threads started one after the other reuse the same buffer, but each one
+  # starts it empty and under a thread id of its own
+  def run(): trace_record('thread span', trace_now(), trace_now())
+
+  trace_clear()
+  trace_enable()
+  try:
+    for k in range(20):
+      worker = threading.Thread(target=run)
+      worker.start()
+      worker.join()
+  finally:
+    trace_enable(False)
+
+  events = [k for k in json.loads(trace_dump())['traceEvents']
+      if k['ph'] == 'X' and k['name'] == 'thread span']
+  assert len(events) == 20
+  assert len(set(k['tid'] for k in events)) == 20
+  trace_clear()
+
+  # a thread filling its buffer does not make the next one drop spans
+  capacity = 1 << 16
+  def fill():
+    for k in range(capacity + 10): trace_record('fill', 0, 1)
+
+  trace_enable()
+  try:
+    for target in (fill, run):
+      worker = threading.Thread(target=target)
+      worker.start()
+      worker.join()
+  finally:
+    trace_enable(False)
+
+  trace = json.loads(trace_dump())
+  spans = names(trace_dump())
+  assert spans.count('fill') == capacity
+  assert spans.count('thread span') == 1
+  assert trace['otherData']['dropped'] == 10
+  trace_clear()
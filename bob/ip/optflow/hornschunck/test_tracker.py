@@ -0,0 +1,156 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:45:12 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests the tracking of points along sequences of flow fields
+"""
+
+import threading
+import numpy
+import nose.tools
+
+from . import Tracker
+
+def bilinear(flow, y, x):
+  """Samples a flow field at (y, x), within the image"""
+  y0 = min(int(y), max(flow.shape[0]-2, 0))
+  x0 = min(int(x), max(flow.shape[1]-2, 0))
+  y1 = min(y0+1, flow.shape[0]-1)
+  x1 = min(x0+1, flow.shape[1]-1)
+  ay, ax = y - y0, x - x0
+  return (1-ay)*((1-ax)*flow[y0,x0] + ax*flow[y0,x1]) + \
+      ay*((1-ax)*flow[y1,x0] + ax*flow[y1,x1])
+
+def test_constant():
+
+  tracker = Tracker((20, 30))
+  assert tracker.shape == (20, 30)
+  assert len(tracker) == 0
+  assert tracker.add([[5., 5.], [10.5, 2.25], [19., 29.]]) == 0
+  assert tracker.add([[-1., 3.], [2., numpy.nan]]) == 3
+  assert len(tracker) == 5
+  assert list(tracker.tracked) == [True, True, True, False, False]
+
+  u = numpy.full((20, 30), 1.5)
+  v = numpy.full((20, 30), -0.5)
+  tracker.advance(u, v)
+  positions = tracker.positions
+  assert numpy.allclose(positions[0], (4.5, 6.5))
+  assert numpy.allclose(positions[1], (10., 3.75))
+  assert numpy.array_equal(positions[2], (19., 29.)) #left the image
+  assert list(tracker.tracked) == [True, True, False, False, False]
+  assert list(tracker.length) == [1, 1, 0, 0, 0]
+
+  tracker.clear()
+  assert len(tracker) == 0
+
+def test_bilinear():
+
+  # Points follow the flow sampled bilinearly, and stacks of flow fields
+  # give the same trajectories as the fields one at a time
+  numpy.random.seed(0)
+  shape = (25, 35)
+  u = numpy.random.uniform(-1, 1, (4,) + shape)
+  v = numpy.random.uniform(-1, 1, (4,) + shape)
+  points = numpy.random.uniform(5, 20, (300, 2))
+
+  tracker = Tracker(shape)
+  tracker.add(points)
+  expected = points.copy()
+  for k in range(4):
+    tracker.advance(u[k], v[k])
+    for p in expected:
+      p += (bilinear(v[k], *p), bilinear(u[k], *p))
+  assert numpy.allclose(tracker.positions, expected, rtol=0, atol=1e-12)
+  assert numpy.all(tracker.length == 4)
+
+  stacked = Tracker(shape)
+  stacked.add(points)
+  stacked.advance(u, v)
+  assert numpy.array_equal(stacked.positions, tracker.positions)
+
+def test_forward_backward():
+
+  numpy.random.seed(1)
+  shape = (40, 50)
+  u = numpy.full(shape, 2.)
+  v = numpy.zeros(shape)
+  bu = numpy.full(shape, -2.)
+  bv = numpy.zeros(shape)
+  bu[:,25:] = 0. #inconsistent on the right half
+  points = numpy.random.uniform(0, 39, (5000, 2))
+
+  for threads in (1, 3, 0):
+    tracker = Tracker(shape, threshold=0.5, threads=threads)
+    assert tracker.threads == threads
+    tracker.add(points)
+    tracker.advance(u, v, bu, bv)
+    expected = points[:,1] + 2. <= 24.25 #interpolated up to 0.5 pixels
+    assert numpy.array_equal(tracker.tracked, expected)
+    if threads == 1: reference = tracker.positions
+    else: assert numpy.array_equal(tracker.positions, reference)
+
+  tracker.threshold = 3.
+  tracker.advance(u, v, bu, bv)
+  assert tracker.threshold == 3.
+
+def test_errors():
+
+  tracker = Tracker((10, 10))
+  nose.tools.assert_raises(ValueError, Tracker, (10, 10), -1.)
+  nose.tools.assert_raises(ValueError, Tracker, (10, 10), 1., -1)
+  nose.tools.assert_raises(TypeError, tracker.add, numpy.zeros((3, 3)))
+  nose.tools.assert_raises(TypeError, tracker.advance, numpy.zeros(10),
+      numpy.zeros(10))
+  nose.tools.assert_raises(RuntimeError, tracker.advance,
+      numpy.zeros((9, 10)), numpy.zeros((9, 10)))
+  nose.tools.assert_raises(RuntimeError, tracker.advance,
+      numpy.zeros((10, 10)), numpy.zeros((10, 10)), numpy.zeros((10, 10)))
+  def set_threshold(value): tracker.threshold = value
+  nose.tools.assert_raises(ValueError, set_threshold, -2.)
+
+def test_shared():
+
+  # While another thread advances the points, the tracker refuses to read or
+  # change them, instead of reallocating them under the other thread
+  numpy.random.seed(0)
+  tracker = Tracker((64, 64))
+  points = numpy.random.rand(200000, 2) * 63.
+  tracker.add(points)
+  u = numpy.zeros((50, 64, 64))
+  v = numpy.zeros((50, 64, 64))
+
+  done = []
+  def run():
+    while not done: tracker.advance(u, v)
+  worker = threading.Thread(target=run)
+  worker.start()
+
+  def restart(): #refills the tracker, if clear() was not refused
+    tracker.clear()
+    tracker.add(points)
+  attempts = [lambda: tracker.add([[1., 1.]]), lambda: len(tracker),
+      lambda: tracker.positions, lambda: tracker.tracked,
+      lambda: tracker.length, lambda: setattr(tracker, 'threshold', 1.),
+      lambda: tracker.advance(u[0], v[0]), restart]
+  refused = set()
+  try:
+    while len(refused) < len(attempts):
+      for k, attempt in enumerate(attempts):
+        try:
+          attempt()
+        except RuntimeError as e:
+          assert 'in use by another thread' in str(e)
+          refused.add(k)
+  finally:
+    done.append(True)
+    worker.join()
+
+  # usable again, once the other thread is done
+  restart()
+  tracker.advance(u, v)
+  assert numpy.array_equal(tracker.positions, points)
+  assert tracker.tracked.all()
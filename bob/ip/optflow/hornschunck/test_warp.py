@@ -0,0 +1,117 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# agent <agent@local>
+# Sun Oct 18 14:42:49 2026 +0000
+#
+# Copyright (C) 2026 agent <agent@local>
+
+"""Tests the bilinear warping of images by flow fields
+"""
+
+import numpy
+import nose.tools
+
+from . import warp
+
+def reference(image, u, v, border):
+  """Bilinear warping in numpy, one pixel at a time"""
+
+  height, width = image.shape
+
+  def sample(y, x):
+    if border == 'zero':
+      if y < 0 or y >= height or x < 0 or x >= width: return 0.
+    elif border == 'mirror':
+      y %= 2*height
+      if y >= height: y = 2*height - 1 - y
+      x %= 2*width
+      if x >= width: x = 2*width - 1 - x
+    else:
+      y = min(max(y, 0), height-1)
+      x = min(max(x, 0), width-1)
+    return float(image[y,x])
+
+  output = numpy.zeros(image.shape)
+  for y in range(height):
+    for x in range(width):
+      sy, sx = y + v[y,x], x + u[y,x]
+      y0, x0 = int(numpy.floor(sy)), int(numpy.floor(sx))
+      ay, ax = sy - y0, sx - x0
+      output[y,x] = (1-ay)*((1-ax)*sample(y0,x0) + ax*sample(y0,x0+1)) + \
+          ay*((1-ax)*sample(y0+1,x0) + ax*sample(y0+1,x0+1))
+  return output
+
+def test_integer_shift():
+
+  # Whole pixel displacements move pixels exactly
+  numpy.random.seed(0)
+  image = numpy.random.rand(20, 30)
+  u = numpy.full(image.shape, 3.)
+  v = numpy.full(image.shape, -2.)
+  output = warp(image, u, v)
+  assert numpy.array_equal(output[2:,:-3], image[:-2,3:])
+  assert numpy.array_equal(output[:2,:-3], numpy.tile(image[0,3:], (2, 1)))
+
+  output = warp(image, u, v, border='zero')
+  assert numpy.all(output[:2] == 0)
+  assert numpy.all(output[:,-3:] == 0)
+
+  output = warp(image, numpy.zeros(image.shape), numpy.zeros(image.shape))
+  assert numpy.array_equal(output, image)
+
+def test_bilinear():
+
+  numpy.random.seed(1)
+  image = numpy.random.rand(17, 23)
+  u = numpy.random.uniform(-30, 30, image.shape)
+  v = numpy.random.uniform(-20, 20, image.shape)
+  for border in ('clamp', 'zero', 'mirror'):
+    expected = reference(image, u, v, border)
+    output = warp(image, u, v, border=border)
+    assert numpy.allclose(output, expected, rtol=0, atol=1e-12), border
+
+    # Threads split rows, with the same results
+    for threads in (2, 0):
+      assert numpy.array_equal(warp(image, u, v, border=border,
+        threads=threads), output)
+
+def test_mirror_rounding():
+
+  # Displacements just below 0 wrap around to the origin, without sampling
+  # outside the image
+  image = numpy.arange(4*5, dtype='float64').reshape(4, 5)
+  for d in (-5e-324, -1e-300, -1e-17, -0.):
+    u = numpy.full(image.shape, d)
+    v = numpy.full(image.shape, d)
+    output = warp(image, u, v, border='mirror')
+    assert numpy.allclose(output, image, rtol=0, atol=1e-12), d
+    assert output[0,0] == image[0,0], d
+
+def test_uint8():
+
+  numpy.random.seed(2)
+  image = numpy.random.randint(0, 256, (15, 19)).astype('uint8')
+  u = numpy.random.uniform(-3, 3, image.shape)
+  v = numpy.random.uniform(-3, 3, image.shape)
+  output = numpy.zeros(image.shape, 'uint8')
+  retval = warp(image, u, v, output, 'mirror')
+  assert retval.dtype == numpy.uint8
+  assert numpy.array_equal(retval, output)
+  expected = numpy.floor(reference(image, u, v, 'mirror') + 0.5)
+  assert numpy.abs(output.astype('float64') - expected).max() <= 1
+
+def test_errors():
+
+  image = numpy.zeros((5, 6))
+  u = numpy.zeros((5, 6))
+  u[2,3] = numpy.nan
+  output = warp(image + 1., u, u)
+  assert output[2,3] == 0
+  assert numpy.all(numpy.delete(output.flatten(), 2*6+3) == 1)
+
+  nose.tools.assert_raises(ValueError, warp, image, u, u, border='wrap')
+  nose.tools.assert_raises(ValueError, warp, image, u, u, threads=-1)
+  nose.tools.assert_raises(TypeError, warp, image.astype('float32'), u, u)
+  nose.tools.assert_raises(TypeError, warp, image, u, u,
+      numpy.zeros((5, 6), 'uint8'))
+  nose.tools.assert_raises(RuntimeError, warp, image, u[1:], u[1:])
@@ -0,0 +1,603 @@
+/**
+ * @author agent <agent@local>
+ * @date Sun Oct 18 14:45:12 2026 +0000
+ *
+ * @brief Bindings for the trajectory tracker
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <bob.blitz/cppapi.h>
+#include <bob.blitz/cleanup.h>
+#include <bob.extension/documentation.h>
+#include <structmember.h>
+
+#include <string>
+
+#include "TrajectoryTracker.h"
+
+int PyBobIpOptflow_InputConverter(PyObject* o, PyBlitzArrayObject** a);
+
+/************************************
+ * Implementation of Tracker class *
+ **********************************/
+
+#define CLASS_NAME "Tracker"
+
+static auto s_tracker = bob::extension::ClassDoc(
+    BOB_EXT_MODULE_PREFIX "." CLASS_NAME,
+
+    "Tracks points along a sequence of flow fields, into long-range trajectories.",
+
+    "Points are advanced by the flow fields estimated between consecutive "
+    "frames (e.g., by :py:class:`Flow` or :py:func:`estimate_many`), "
+    "sampled bilinearly at the sub-pixel position of each point. A point "
+    "stops being tracked when it leaves the image, when the flow at its "
+    "position is not finite or, if the flow estimated backwards (from the "
+    "next frame to the current one) is given too, when following it from "
+    "the new position does not bring the point back within ``threshold`` "
+    "pixels of where it was. Points that are not tracked keep their last "
+    "position.\n"
+    "\n"
+    "Points are stored natively, as separate arrays of positions, states "
+    "and lengths, and are advanced in parallel by native threads, with the "
+    "same results whatever their number."
+    )
+    .add_constructor(
+        bob::extension::FunctionDoc(
+          CLASS_NAME,
+          "Creates a tracker without points."
+          )
+        .add_prototype("(height, width), [threshold], [threads]", "")
+        .add_parameter("(height, width)", "tuple", "The shape of the flow fields to track points on")
+        .add_parameter("threshold", "float", "[Default: ``1.``] The largest distance, in pixels, of the forward-backward check")
+        .add_parameter("threads", "int", "[Default: ``1``] The number of threads advancing points in parallel, or 0 for one thread per core")
+        )
+    ;
+
+typedef struct {
+  PyObject_HEAD
+  bob::ip::optflow::TrajectoryTracker* cxx;
+  bool busy; ///< set while advance() runs on the tracker without the GIL
+} PyBobIpOptflowTrackerObject;
+
+/**
+ * Raises a RuntimeError and returns false if another thread is advancing
+ * the points of this tracker
+ */
+static bool check_idle(PyBobIpOptflowTrackerObject* self) {
+
+  if (self->busy) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' is in use by another thread - points may not be read, added or removed while they advance", Py_TYPE(self)->tp_name);
+    return false;
+  }
+
+  return true;
+
+}
+
+
+static int PyBobIpOptflowTracker_init
+(PyBobIpOptflowTrackerObject* self, PyObject* args, PyObject* kwds) {
+
+  /* Parses input arguments in a single shot */
+  static const char* const_kwlist[] = {"shape", "threshold", "threads", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t height, width;
+  double threshold = 1.;
+  Py_ssize_t threads = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "(nn)|dn", kwlist,
+        &height, &width, &threshold, &threads)) return -1;
+
+  if (!check_idle(self)) return -1;
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`threads' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", threads);
+    return -1;
+  }
+
+  try {
+    blitz::TinyVector<int,2> shape;
+    shape(0) = height; shape(1) = width;
+    self->cxx = new bob::ip::optflow::TrajectoryTracker(shape, threshold,
+        threads);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_ValueError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot create new object of type `%s' - unknown exception thrown", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static void PyBobIpOptflowTracker_delete
+(PyBobIpOptflowTrackerObject* self) {
+
+  delete self->cxx;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+
+}
+
+static auto s_shape = bob::extension::VariableDoc(
+    "shape",
+    "tuple",
+    "The shape of the flow fields points are tracked on: ``(height, width)``"
+    );
+
+static PyObject* PyBobIpOptflowTracker_getShape
+(PyBobIpOptflowTrackerObject* self, void* /*closure*/) {
+  auto shape = self->cxx->getShape();
+  return Py_BuildValue("nn", (Py_ssize_t)shape(0), (Py_ssize_t)shape(1));
+}
+
+static auto s_threshold = bob::extension::VariableDoc(
+    "threshold",
+    "float",
+    "The largest distance, in pixels, of the forward-backward check"
+    );
+
+static PyObject* PyBobIpOptflowTracker_getThreshold
+(PyBobIpOptflowTrackerObject* self, void* /*closure*/) {
+  return PyFloat_FromDouble(self->cxx->getThreshold());
+}
+
+static int PyBobIpOptflowTracker_setThreshold
+(PyBobIpOptflowTrackerObject* self, PyObject* o, void* /*closure*/) {
+
+  double threshold = PyFloat_AsDouble(o);
+  if (PyErr_Occurred()) return -1;
+  if (!check_idle(self)) return -1;
+
+  try {
+    self->cxx->setThreshold(threshold);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_ValueError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `threshold' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static auto s_threads = bob::extension::VariableDoc(
+    "threads",
+    "int",
+    "The number of threads advancing points in parallel, or 0 for one thread per core"
+    );
+
+static PyObject* PyBobIpOptflowTracker_getThreads
+(PyBobIpOptflowTrackerObject* self, void* /*closure*/) {
+  return Py_BuildValue("n", (Py_ssize_t)self->cxx->getThreads());
+}
+
+static int PyBobIpOptflowTracker_setThreads
+(PyBobIpOptflowTrackerObject* self, PyObject* o, void* /*closure*/) {
+
+  Py_ssize_t threads = PyNumber_AsSsize_t(o, PyExc_OverflowError);
+  if (PyErr_Occurred()) return -1;
+  if (!check_idle(self)) return -1;
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`threads' should be non-negative, but you set it to %" PY_FORMAT_SIZE_T "d", threads);
+    return -1;
+  }
+
+  self->cxx->setThreads(threads);
+  return 0;
+
+}
+
+static auto s_positions = bob::extension::VariableDoc(
+    "positions",
+    "array (2D, float)",
+    "A copy of the positions of all points, as a points x 2 array of ``(y, x)`` rows, in the order they were added"
+    );
+
+static PyObject* PyBobIpOptflowTracker_getPositions
+(PyBobIpOptflowTrackerObject* self, void* /*closure*/) {
+
+  if (!check_idle(self)) return 0;
+
+  const std::vector<double>& y = self->cxx->getY();
+  const std::vector<double>& x = self->cxx->getX();
+  Py_ssize_t shape[2] = {(Py_ssize_t)y.size(), 2};
+  auto retval = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2,
+      shape);
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  auto bz = PyBlitzArrayCxx_AsBlitz<double,2>(retval);
+  for (size_t k=0; k<y.size(); ++k) {
+    (*bz)(k,0) = y[k];
+    (*bz)(k,1) = x[k];
+  }
+
+  return PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", retval));
+
+}
+
+static auto s_tracked = bob::extension::VariableDoc(
+    "tracked",
+    "array (1D, bool)",
+    "A copy of the states of all points: ``True`` while they are tracked"
+    );
+
+static PyObject* PyBobIpOptflowTracker_getTracked
+(PyBobIpOptflowTrackerObject* self, void* /*closure*/) {
+
+  if (!check_idle(self)) return 0;
+
+  const std::vector<uint8_t>& tracked = self->cxx->getTracked();
+  Py_ssize_t shape[1] = {(Py_ssize_t)tracked.size()};
+  auto retval = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_BOOL, 1,
+      shape);
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  auto bz = PyBlitzArrayCxx_AsBlitz<bool,1>(retval);
+  for (size_t k=0; k<tracked.size(); ++k) (*bz)(k) = tracked[k];
+
+  return PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", retval));
+
+}
+
+static auto s_length = bob::extension::VariableDoc(
+    "length",
+    "array (1D, int32)",
+    "A copy of the number of flow fields each point followed"
+    );
+
+static PyObject* PyBobIpOptflowTracker_getLength
+(PyBobIpOptflowTrackerObject* self, void* /*closure*/) {
+
+  if (!check_idle(self)) return 0;
+
+  const std::vector<int32_t>& length = self->cxx->getLength();
+  Py_ssize_t shape[1] = {(Py_ssize_t)length.size()};
+  auto retval = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT32, 1,
+      shape);
+  if (!retval) return 0;
+  auto retval_ = make_safe(retval);
+
+  auto bz = PyBlitzArrayCxx_AsBlitz<int32_t,1>(retval);
+  for (size_t k=0; k<length.size(); ++k) (*bz)(k) = length[k];
+
+  return PyBlitzArray_NUMPY_WRAP(Py_BuildValue("O", retval));
+
+}
+
+static PyGetSetDef PyBobIpOptflowTracker_getseters[] = {
+    {
+      s_shape.name(),
+      (getter)PyBobIpOptflowTracker_getShape,
+      0,
+      s_shape.doc(),
+      0
+    },
+    {
+      s_threshold.name(),
+      (getter)PyBobIpOptflowTracker_getThreshold,
+      (setter)PyBobIpOptflowTracker_setThreshold,
+      s_threshold.doc(),
+      0
+    },
+    {
+      s_threads.name(),
+      (getter)PyBobIpOptflowTracker_getThreads,
+      (setter)PyBobIpOptflowTracker_setThreads,
+      s_threads.doc(),
+      0
+    },
+    {
+      s_positions.name(),
+      (getter)PyBobIpOptflowTracker_getPositions,
+      0,
+      s_positions.doc(),
+      0
+    },
+    {
+      s_tracked.name(),
+      (getter)PyBobIpOptflowTracker_getTracked,
+      0,
+      s_tracked.doc(),
+      0
+    },
+    {
+      s_length.name(),
+      (getter)PyBobIpOptflowTracker_getLength,
+      0,
+      s_length.doc(),
+      0
+    },
+    {0}  /* Sentinel */
+};
+
+static auto s_add = bob::extension::FunctionDoc(
+    "add",
+    "Adds points to track",
+    "Points outside the image, or not finite, are added as not tracked."
+    )
+    .add_prototype("points", "first")
+    .add_parameter("points", "array-like (2D, float64)", "The positions of the new points, as a points x 2 array of ``(y, x)`` rows")
+    .add_return("first", "int", "The index of the first point added")
+    ;
+
+static PyObject* PyBobIpOptflowTracker_add
+(PyBobIpOptflowTrackerObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"points", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* points = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist,
+        &PyBobIpOptflow_InputConverter, &points)) return 0;
+
+  //protects acquired resources through this scope
+  auto points_ = make_safe(points);
+
+  if (!check_idle(self)) return 0;
+
+  if (points->type_num != NPY_FLOAT64 || points->ndim != 2 ||
+      points->shape[1] != 2) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 64-bit float arrays with 2 columns for `points'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  size_t first = 0;
+  try {
+    first = self->cxx->add(*PyBlitzArrayCxx_AsBlitz<double,2>(points));
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot add points: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  return Py_BuildValue("n", (Py_ssize_t)first);
+
+}
+
+static auto s_advance = bob::extension::FunctionDoc(
+    "advance",
+    "Advances all tracked points by one or more flow fields",
+    "Flow fields are either single ones (2D arrays with the shape of this "
+    "tracker) or sequences of them (3D arrays, frames x height x width), "
+    "followed one after the other. If the flow fields estimated backwards "
+    "are given too, points failing the forward-backward check stop being "
+    "tracked."
+    )
+    .add_prototype("u, v, [backward_u, backward_v]", "None")
+    .add_parameter("u, v", "array-like (2D or 3D, float64)", "The flow in the horizontal and vertical directions (respectively), from the current frame to the next")
+    .add_parameter("backward_u, backward_v", "array-like (2D or 3D, float64)", "[Default: ``None``] The flow in the horizontal and vertical directions (respectively), from the next frame to the current one")
+    ;
+
+static int check_flow(PyBobIpOptflowTrackerObject* self, PyBlitzArrayObject* a,
+    const char* name, Py_ssize_t ndim) {
+
+  if (a->type_num != NPY_FLOAT64 || a->ndim != ndim) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports %" PY_FORMAT_SIZE_T "dD 64-bit float arrays for `%s', like `u'", Py_TYPE(self)->tp_name, ndim, name);
+    return 0;
+  }
+
+  auto shape = self->cxx->getShape();
+  if (a->shape[ndim-2] != shape(0) || a->shape[ndim-1] != shape(1)) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' tracks points on flow fields of shape (%d, %d), but `%s' has fields of shape (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", Py_TYPE(self)->tp_name, shape(0), shape(1), name, a->shape[ndim-2], a->shape[ndim-1]);
+    return 0;
+  }
+
+  return 1;
+
+}
+
+static PyObject* PyBobIpOptflowTracker_advance
+(PyBobIpOptflowTrackerObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"u", "v", "backward_u", "backward_v",
+    0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* u = 0;
+  PyBlitzArrayObject* v = 0;
+  PyBlitzArrayObject* bu = 0;
+  PyBlitzArrayObject* bv = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|O&O&", kwlist,
+        &PyBobIpOptflow_InputConverter, &u,
+        &PyBobIpOptflow_InputConverter, &v,
+        &PyBobIpOptflow_InputConverter, &bu,
+        &PyBobIpOptflow_InputConverter, &bv
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto u_ = make_safe(u);
+  auto v_ = make_safe(v);
+  auto bu_ = make_xsafe(bu);
+  auto bv_ = make_xsafe(bv);
+
+  if (!bu != !bv) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' requires either both `backward_u' and `backward_v' or none", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  const Py_ssize_t ndim = u->ndim;
+  if (ndim != 2 && ndim != 3) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D or 3D 64-bit float arrays for `u'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+  if (!check_flow(self, u, "u", ndim) || !check_flow(self, v, "v", ndim))
+    return 0;
+  if (bu && (!check_flow(self, bu, "backward_u", ndim) ||
+        !check_flow(self, bv, "backward_v", ndim))) return 0;
+
+  if (!check_idle(self)) return 0;
+
+  std::string error;
+  self->busy = true;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (ndim == 2 && bu) {
+      self->cxx->advance(*PyBlitzArrayCxx_AsBlitz<double,2>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(v),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(bu),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(bv));
+    }
+    else if (ndim == 2) {
+      self->cxx->advance(*PyBlitzArrayCxx_AsBlitz<double,2>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,2>(v));
+    }
+    else if (bu) {
+      self->cxx->advance(*PyBlitzArrayCxx_AsBlitz<double,3>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,3>(v),
+          *PyBlitzArrayCxx_AsBlitz<double,3>(bu),
+          *PyBlitzArrayCxx_AsBlitz<double,3>(bv));
+    }
+    else {
+      self->cxx->advance(*PyBlitzArrayCxx_AsBlitz<double,3>(u),
+          *PyBlitzArrayCxx_AsBlitz<double,3>(v));
+    }
+  }
+  catch (std::exception& e) {
+    error = e.what();
+  }
+  catch (...) {
+    error = "cannot advance points: unknown exception caught";
+  }
+  Py_END_ALLOW_THREADS
+  self->busy = false;
+
+  if (!error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return 0;
+  }
+
+  Py_RETURN_NONE;
+
+}
+
+static auto s_clear = bob::extension::FunctionDoc(
+    "clear",
+    "Removes all points"
+    )
+    .add_prototype("", "None")
+    ;
+
+static PyObject* PyBobIpOptflowTracker_clear
+(PyBobIpOptflowTrackerObject* self) {
+  if (!check_idle(self)) return 0;
+  self->cxx->clear();
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef PyBobIpOptflowTracker_methods[] = {
+  {
+    s_add.name(),
+    (PyCFunction)PyBobIpOptflowTracker_add,
+    METH_VARARGS|METH_KEYWORDS,
+    s_add.doc()
+  },
+  {
+    s_advance.name(),
+    (PyCFunction)PyBobIpOptflowTracker_advance,
+    METH_VARARGS|METH_KEYWORDS,
+    s_advance.doc()
+  },
+  {
+    s_clear.name(),
+    (PyCFunction)PyBobIpOptflowTracker_clear,
+    METH_NOARGS,
+    s_clear.doc()
+  },
+  {0} /* Sentinel */
+};
+
+static Py_ssize_t PyBobIpOptflowTracker_len
+(PyBobIpOptflowTrackerObject* self) {
+  if (!check_idle(self)) return -1;
+  return self->cxx->size();
+}
+
+static PySequenceMethods PyBobIpOptflowTracker_sequence = {
+    (lenfunc)PyBobIpOptflowTracker_len,
+    0, /* concat */
+    0, /* repeat */
+    0, /* item */
+    0, /* slice */
+    0, /* ass_item */
+    0, /* ass_slice */
+    0, /* contains */
+    0, /* inplace_concat */
+    0, /* inplace_repeat */
+};
+
+static PyObject* PyBobIpOptflowTracker_new
+(PyTypeObject* type, PyObject*, PyObject*) {
+
+  /* Allocates the python object itself */
+  PyBobIpOptflowTrackerObject* self =
+    (PyBobIpOptflowTrackerObject*)type->tp_alloc(type, 0);
+
+  self->cxx = 0;
+  self->busy = false;
+
+  return reinterpret_cast<PyObject*>(self);
+
+}
+
+PyTypeObject PyBobIpOptflowTracker_Type = {
+    PyVarObject_HEAD_INIT(0, 0)
+    s_tracker.name(),                                   /* tp_name */
+    sizeof(PyBobIpOptflowTrackerObject),                /* tp_basicsize */
+    0,                                                  /* tp_itemsize */
+    (destructor)PyBobIpOptflowTracker_delete,           /* tp_dealloc */
+    0,                                                  /* tp_print */
+    0,                                                  /* tp_getattr */
+    0,                                                  /* tp_setattr */
+    0,                                                  /* tp_compare */
+    0,                                                  /* tp_repr */
+    0,                                                  /* tp_as_number */
+    &PyBobIpOptflowTracker_sequence,                    /* tp_as_sequence */
+    0,                                                  /* tp_as_mapping */
+    0,                                                  /* tp_hash */
+    0,                                                  /* tp_call */
+    0,                                                  /* tp_str */
+    0,                                                  /* tp_getattro */
+    0,                                                  /* tp_setattro */
+    0,                                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,           /* tp_flags */
+    s_tracker.doc(),                                    /* tp_doc */
+    0,                                                  /* tp_traverse */
+    0,                                                  /* tp_clear */
+    0,                                                  /* tp_richcompare */
+    0,                                                  /* tp_weaklistoffset */
+    0,                                                  /* tp_iter */
+    0,                                                  /* tp_iternext */
+    PyBobIpOptflowTracker_methods,                      /* tp_methods */
+    0,                                                  /* tp_members */
+    PyBobIpOptflowTracker_getseters,                    /* tp_getset */
+    0,                                                  /* tp_base */
+    0,                                                  /* tp_dict */
+    0,                                                  /* tp_descr_get */
+    0,                                                  /* tp_descr_set */
+    0,                                                  /* tp_dictoffset */
+    (initproc)PyBobIpOptflowTracker_init,               /* tp_init */
+    0,                                                  /* tp_alloc */
+    PyBobIpOptflowTracker_new,                          /* tp_new */
+};
+
+#undef CLASS_NAME
@@ -51,13 +51,30 @@ setup(
         [
           "bob/ip/optflow/hornschunck/SpatioTemporalGradient.cpp",
           "bob/ip/optflow/hornschunck/HornAndSchunckFlow.cpp",
+          "bob/ip/optflow/hornschunck/PerfCounters.cpp",
+          "bob/ip/optflow/hornschunck/Trace.cpp",
+          "bob/ip/optflow/hornschunck/BlockMatching.cpp",
+          "bob/ip/optflow/hornschunck/Warp.cpp",
+          "bob/ip/optflow/hornschunck/TrajectoryTracker.cpp",
+          "bob/ip/optflow/hornschunck/Synthetic.cpp",
+          "bob/ip/optflow/hornschunck/FlowArchive.cpp",
           "bob/ip/optflow/hornschunck/forward.cpp",
           "bob/ip/optflow/hornschunck/central.cpp",
           "bob/ip/optflow/hornschunck/vanilla.cpp",
           "bob/ip/optflow/hornschunck/flow.cpp",
+          "bob/ip/optflow/hornschunck/solver.cpp",
+          "bob/ip/optflow/hornschunck/statistics.cpp",
+          "bob/ip/optflow/hornschunck/input.cpp",
+          "bob/ip/optflow/hornschunck/regions.cpp",
+          "bob/ip/optflow/hornschunck/perf.cpp",
+          "bob/ip/optflow/hornschunck/archive.cpp",
+          "bob/ip/optflow/hornschunck/tracker.cpp",
           "bob/ip/optflow/hornschunck/main.cpp",
         ],
         bob_packages = bob_packages,
+        libraries = ['z'], #flow archives
+        #no fused multiply-add contraction: the same results on every ISA
+        extra_compile_args = ['-ffp-contract=off'],
         version = version,
       ),
     ],
@@ -66,6 +83,13 @@ setup(
       'build_ext': build_ext
     },
 
+    entry_points = {
+      'console_scripts': [
+        'optflow_hs_service.py = bob.ip.optflow.hornschunck.service:main',
+        'optflow_hs_benchmark.py = bob.ip.optflow.hornschunck.benchmark:main',
+      ],
+    },
+
     classifiers = [
       'Framework :: Bob',
       'Development Status :: 4 - Beta',